@@ -123,8 +123,29 @@ static int _pygear_admin_check_server_connection(pygear_AdminObject* self) {
             self->sockfd = -1;
             return self->sockfd;
         }
-        if (connect(self->sockfd,(struct sockaddr *) &server_addr, sizeof(server_addr)) < 0) {
-            // connect() - initiate a connection on a socket, return 0 on success
+        if (_pygear_cooperative_enabled()) {
+            // Every wait on this socket then goes through the wait hook
+            fcntl(self->sockfd, F_SETFL, fcntl(self->sockfd, F_GETFL, 0) | O_NONBLOCK);
+        }
+        int connect_result = connect(self->sockfd,(struct sockaddr *) &server_addr, sizeof(server_addr));
+        // connect() - initiate a connection on a socket, return 0 on success
+        if (connect_result < 0 && errno == EINPROGRESS) {
+            // non-blocking connect, wait for the socket to become writable
+            int ready = _pygear_cooperative_wait_fd(self->sockfd, true, _pygear_monotonic() + self->timeout);
+            if (ready < 0) {
+                close(self->sockfd);
+                self->sockfd = -1;
+                return self->sockfd;
+            }
+            int connect_errno = ETIMEDOUT;
+            socklen_t errno_len = sizeof(connect_errno);
+            if (ready > 0) {
+                getsockopt(self->sockfd, SOL_SOCKET, SO_ERROR, &connect_errno, &errno_len);
+            }
+            errno = connect_errno;
+            connect_result = (connect_errno == 0 ? 0 : -1);
+        }
+        if (connect_result < 0) {
             PyObject* err_string = PyString_FromFormat("Failed to connect: Socket error %s", strerror(errno));
             PyErr_SetObject(PyGearExn_ERROR, err_string);
             Py_XDECREF(err_string);
@@ -279,11 +300,33 @@ static PyObject* _pygear_admin_make_call(pygear_AdminObject* self, char* command
     if (_pygear_admin_check_server_connection(self) < 0) {
         return NULL;
     }
-    size_t bytes_written = write(self->sockfd, command, strlen(command));
-    // write() - write to a file descriptor
-    // return number of bytes written on success, return -1 and set errno on failure
-    if (bytes_written < 0) {
-        return NULL;
+    bool non_blocking = fcntl(self->sockfd, F_GETFL, 0) & O_NONBLOCK;
+    double deadline = _pygear_monotonic() + self->timeout;
+    size_t command_len = strlen(command);
+    size_t total_written = 0;
+    while (total_written < command_len) {
+        ssize_t bytes_written = write(self->sockfd, &(command[total_written]), command_len - total_written);
+        // write() - write to a file descriptor
+        // return number of bytes written on success, return -1 and set errno on failure
+        if (bytes_written < 0 && errno == EAGAIN && non_blocking) {
+            int ready = _pygear_cooperative_wait_fd(self->sockfd, true, deadline);
+            if (ready < 0) {
+                return NULL;
+            }
+            if (ready > 0) {
+                continue;
+            }
+            errno = ETIMEDOUT;
+        }
+        if (bytes_written < 0) {
+            PyObject* err_string = PyString_FromFormat("Failed to write to socket: %s", strerror(errno));
+            PyErr_SetObject(PyGearExn_ERROR, err_string);
+            Py_XDECREF(err_string);
+            close(self->sockfd);
+            self->sockfd = -1;
+            return NULL;
+        }
+        total_written += bytes_written;
     }
     PyObject* ret = NULL;
 
@@ -292,15 +335,31 @@ static PyObject* _pygear_admin_make_call(pygear_AdminObject* self, char* command
     char* result = malloc(sizeof(char) * SOCKET_BUFSIZE);
     char buf[SOCKET_BUFSIZE];
     size_t result_bytes = 0;
-    size_t bytes_read = 0;
+    ssize_t bytes_read = 0;
     do {
         errno = 0;
         bytes_read = read(self->sockfd, buf, SOCKET_BUFSIZE);
         // read() - read data on a socket
         int read_err = errno;
+        if (read_err == EAGAIN && non_blocking) {
+            int ready = _pygear_cooperative_wait_fd(self->sockfd, false, deadline);
+            if (ready < 0) {
+                goto catch;
+            }
+            if (ready > 0) {
+                continue;
+            }
+            break;  // timed out, same as SO_RCVTIMEO on a blocking socket
+        }
         if (read_err == EAGAIN) { // EAGAIN - there is no data available right now
             break;
         }
+        if (bytes_read == 0) {
+            // connection closed by the server, reconnect on the next call
+            close(self->sockfd);
+            self->sockfd = -1;
+            break;
+        }
         if (bytes_read < 0) {
             PyObject* err_string = PyString_FromFormat("Failed to read from socket: %s", strerror(read_err));
             PyErr_SetObject(PyGearExn_ERROR, err_string);
@@ -35,8 +35,10 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <fcntl.h>
 #include "structmember.h"
 #include "exception.h"
+#include "cooperative.h"
 
 #ifndef PyMODINIT_FUNC
 #define PyMODINIT_FUNC void
@@ -0,0 +1,558 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "asyncclient.h"
+
+static gearman_return_t _pygear_asyncclient_on_created(gearman_task_st* gear_task);
+static gearman_return_t _pygear_asyncclient_on_complete(gearman_task_st* gear_task);
+static gearman_return_t _pygear_asyncclient_on_exception(gearman_task_st* gear_task);
+static gearman_return_t _pygear_asyncclient_on_fail(gearman_task_st* gear_task);
+static gearman_return_t _pygear_asyncclient_on_status(gearman_task_st* gear_task);
+
+/*
+ * Class constructor / destructor methods
+ */
+
+int AsyncClient_init(pygear_AsyncClientObject* self, PyObject* args, PyObject* kwds) {
+    self->g_Client = gearman_client_create(NULL);
+    self->serializer = PyImport_ImportModule(PYTHON_SERIALIZER);
+    if (self->serializer == NULL) {
+        PyObject* err_string = PyString_FromFormat("Failed to import '%s'", PYTHON_SERIALIZER);
+        PyErr_SetObject(PyExc_ImportError, err_string);
+        Py_XDECREF(err_string);
+        return -1;
+    }
+    if (self->g_Client == NULL) {
+        PyErr_SetString(PyGearExn_ERROR, "Failed to create internal gearman client structure");
+        return -1;
+    }
+    self->pending = PySet_New(NULL);
+    self->resolved = PyList_New(0);
+    if (self->pending == NULL || self->resolved == NULL) {
+        return -1;
+    }
+    // Finished tasks are freed by libgearman, so memory stays proportional
+    // to the number of jobs in flight.
+    gearman_client_add_options(self->g_Client, GEARMAN_CLIENT_NON_BLOCKING | GEARMAN_CLIENT_FREE_TASKS);
+    gearman_client_set_created_fn(self->g_Client, _pygear_asyncclient_on_created);
+    gearman_client_set_complete_fn(self->g_Client, _pygear_asyncclient_on_complete);
+    gearman_client_set_exception_fn(self->g_Client, _pygear_asyncclient_on_exception);
+    gearman_client_set_fail_fn(self->g_Client, _pygear_asyncclient_on_fail);
+    gearman_client_set_status_fn(self->g_Client, _pygear_asyncclient_on_status);
+    return 0;
+}
+
+int AsyncClient_traverse(pygear_AsyncClientObject* self, visitproc visit, void* arg) {
+    Py_VISIT(self->serializer);
+    Py_VISIT(self->pending);
+    Py_VISIT(self->resolved);
+    return 0;
+}
+
+int AsyncClient_clear(pygear_AsyncClientObject* self) {
+    // Tasks only borrow their futures from 'pending', drop them first
+    if (self->g_Client) {
+        gearman_client_task_free_all(self->g_Client);
+    }
+    Py_CLEAR(self->serializer);
+    Py_CLEAR(self->pending);
+    Py_CLEAR(self->resolved);
+    return 0;
+}
+
+void AsyncClient_dealloc(pygear_AsyncClientObject* self) {
+    AsyncClient_clear(self);
+    if (self->g_Client) {
+        gearman_client_free(self->g_Client);
+        self->g_Client = NULL;
+    }
+    self->ob_type->tp_free((PyObject*)self);
+}
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+/*
+ * Deserialize data received for a task.
+ * Return value: New reference, NULL with a python exception set on failure.
+ */
+static PyObject* _pygear_asyncclient_decode(pygear_AsyncClientObject* self, gearman_task_st* gear_task) {
+    const char* task_data = gearman_task_data(gear_task);
+    size_t data_size = gearman_task_data_size(gear_task);
+    if (!task_data) {
+        Py_RETURN_NONE;
+    }
+    PyObject* py_data = PyString_FromStringAndSize(task_data, data_size);
+    if (!py_data) {
+        return NULL;
+    }
+    PyObject* decoded = PyObject_CallMethod(self->serializer, "loads", "O", py_data);
+    Py_DECREF(py_data);
+    return decoded;
+}
+
+/* Queue a future whose task reached a final state; see _pygear_asyncclient_poll */
+static void _pygear_asyncclient_mark_resolved(pygear_FutureObject* future) {
+    pygear_AsyncClientObject* client = (pygear_AsyncClientObject*) future->owner;
+    if (client && client->resolved && future->done) {
+        PyList_Append(client->resolved, (PyObject*) future);
+    }
+}
+
+/*
+ * Task callbacks. The task context is the Future the task was submitted for,
+ * borrowed from the client's 'pending' set.
+ */
+static gearman_return_t _pygear_asyncclient_on_created(gearman_task_st* gear_task) {
+    pygear_FutureObject* future = (pygear_FutureObject*) gearman_task_context(gear_task);
+    if (!future || future->kind != PYGEAR_FUTURE_BACKGROUND) {
+        return GEARMAN_SUCCESS;
+    }
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    PyObject* job_handle = PyString_FromString(gearman_task_job_handle(gear_task));
+    if (job_handle) {
+        _pygear_future_set_result(future, job_handle);
+    } else {
+        _pygear_future_set_exception_from_error(future);
+    }
+    Py_XDECREF(job_handle);
+    _pygear_asyncclient_mark_resolved(future);
+    PyGILState_Release(gstate);
+    return GEARMAN_SUCCESS;
+}
+
+static gearman_return_t _pygear_asyncclient_on_complete(gearman_task_st* gear_task) {
+    pygear_FutureObject* future = (pygear_FutureObject*) gearman_task_context(gear_task);
+    if (!future || future->kind != PYGEAR_FUTURE_FOREGROUND) {
+        return GEARMAN_SUCCESS;
+    }
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    PyObject* result = _pygear_asyncclient_decode((pygear_AsyncClientObject*) future->owner, gear_task);
+    if (result) {
+        _pygear_future_set_result(future, result);
+    } else {
+        _pygear_future_set_exception_from_error(future);
+    }
+    Py_XDECREF(result);
+    _pygear_asyncclient_mark_resolved(future);
+    PyGILState_Release(gstate);
+    return GEARMAN_SUCCESS;
+}
+
+static gearman_return_t _pygear_asyncclient_on_exception(gearman_task_st* gear_task) {
+    pygear_FutureObject* future = (pygear_FutureObject*) gearman_task_context(gear_task);
+    if (!future) {
+        return GEARMAN_SUCCESS;
+    }
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    // pygear workers send a serialized (type, args, traceback) tuple; fall
+    // back to the raw data for anything the serializer does not understand
+    PyObject* details = _pygear_asyncclient_decode((pygear_AsyncClientObject*) future->owner, gear_task);
+    if (!details) {
+        PyErr_Clear();
+        const char* task_data = gearman_task_data(gear_task);
+        details = PyString_FromStringAndSize(task_data, task_data ? gearman_task_data_size(gear_task) : 0);
+    }
+    PyObject* exception = PyObject_CallFunctionObjArgs(PyGearExn_WORK_EXCEPTION, details, NULL);
+    if (exception) {
+        _pygear_future_set_exception(future, exception);
+    } else {
+        _pygear_future_set_exception_from_error(future);
+    }
+    Py_XDECREF(details);
+    Py_XDECREF(exception);
+    _pygear_asyncclient_mark_resolved(future);
+    PyGILState_Release(gstate);
+    return GEARMAN_SUCCESS;
+}
+
+static gearman_return_t _pygear_asyncclient_on_fail(gearman_task_st* gear_task) {
+    pygear_FutureObject* future = (pygear_FutureObject*) gearman_task_context(gear_task);
+    if (!future) {
+        return GEARMAN_SUCCESS;
+    }
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    PyObject* exception = PyObject_CallFunction(PyGearExn_WORK_FAIL, "s", "WORK_FAIL");
+    if (exception) {
+        _pygear_future_set_exception(future, exception);
+    } else {
+        _pygear_future_set_exception_from_error(future);
+    }
+    Py_XDECREF(exception);
+    _pygear_asyncclient_mark_resolved(future);
+    PyGILState_Release(gstate);
+    return GEARMAN_SUCCESS;
+}
+
+static gearman_return_t _pygear_asyncclient_on_status(gearman_task_st* gear_task) {
+    pygear_FutureObject* future = (pygear_FutureObject*) gearman_task_context(gear_task);
+    if (!future || future->kind != PYGEAR_FUTURE_STATUS) {
+        return GEARMAN_SUCCESS;
+    }
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    PyObject* status_dict = Py_BuildValue(
+        "{s:O, s:O, s:I, s:I}",
+        "is_known", (gearman_task_is_known(gear_task) ? Py_True : Py_False),
+        "is_running", (gearman_task_is_running(gear_task) ? Py_True : Py_False),
+        "numerator", gearman_task_numerator(gear_task),
+        "denominator", gearman_task_denominator(gear_task)
+    );
+    if (status_dict) {
+        _pygear_future_set_result(future, status_dict);
+    } else {
+        _pygear_future_set_exception_from_error(future);
+    }
+    Py_XDECREF(status_dict);
+    _pygear_asyncclient_mark_resolved(future);
+    PyGILState_Release(gstate);
+    return GEARMAN_SUCCESS;
+}
+
+
+/*
+ * Fail every pending future with the currently raised python exception and
+ * drop the tasks that were still in flight. Clears the error indicator.
+ */
+static void _pygear_asyncclient_fail_pending(pygear_AsyncClientObject* self) {
+    PyObject *ptype, *pvalue, *ptraceback;
+    PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+    PyErr_NormalizeException(&ptype, &pvalue, &ptraceback);
+    gearman_client_task_free_all(self->g_Client);
+    PyObject* iterator = PyObject_GetIter(self->pending);
+    PyObject* item;
+    while (iterator && (item = PyIter_Next(iterator))) {
+        pygear_FutureObject* future = (pygear_FutureObject*) item;
+        if (!future->done) {
+            _pygear_future_set_exception(future, pvalue ? pvalue : Py_None);
+            PyList_Append(self->resolved, item);
+        }
+        Py_DECREF(item);
+    }
+    Py_XDECREF(iterator);
+    Py_XDECREF(ptype);
+    Py_XDECREF(pvalue);
+    Py_XDECREF(ptraceback);
+}
+
+/*
+ * Run one round of non-blocking I/O: send what is queued, wait up to
+ * 'timeout' milliseconds for activity and process the answers.
+ * Futures resolved in the round leave the pending set and get their
+ * done-callbacks run.
+ * Return the number of futures resolved, or -1 with a python exception set.
+ */
+static int _pygear_asyncclient_poll(pygear_AsyncClientObject* self, int timeout, bool* timed_out) {
+    *timed_out = false;
+    if (PySet_Size(self->pending) == 0) {
+        return 0;
+    }
+    int client_timeout = gearman_client_timeout(self->g_Client);
+    gearman_client_set_timeout(self->g_Client, timeout);
+    gearman_return_t ret;
+    if (_pygear_cooperative_enabled()) {
+        ret = gearman_client_run_tasks(self->g_Client);
+        if (ret == GEARMAN_IO_WAIT) {
+            ret = _pygear_cooperative_client_wait(self->g_Client);
+            if (gearman_success(ret)) {
+                ret = gearman_client_run_tasks(self->g_Client);
+            }
+        }
+    } else {
+        Py_BEGIN_ALLOW_THREADS
+        ret = gearman_client_run_tasks(self->g_Client);
+        if (ret == GEARMAN_IO_WAIT) {
+            ret = gearman_client_wait(self->g_Client);
+            if (gearman_success(ret)) {
+                ret = gearman_client_run_tasks(self->g_Client);
+            }
+        }
+        Py_END_ALLOW_THREADS
+    }
+    gearman_client_set_timeout(self->g_Client, client_timeout);
+    if (PyErr_Occurred()) {
+        // raised by the wait hook, the tasks stay in flight
+        return -1;
+    }
+
+    if (ret == GEARMAN_TIMEOUT) {
+        *timed_out = true;
+    } else if (ret != GEARMAN_SUCCESS && ret != GEARMAN_IO_WAIT) {
+        if (!_pygear_check_and_raise_exn(ret)) {
+            PyErr_SetString(PyGearExn_ERROR, gearman_strerror(ret));
+        }
+        _pygear_asyncclient_fail_pending(self);
+    }
+
+    // Swap the list first, callbacks may submit and resolve new futures
+    PyObject* resolved = self->resolved;
+    self->resolved = PyList_New(0);
+    if (!self->resolved) {
+        self->resolved = resolved;
+        return -1;
+    }
+    Py_ssize_t num_resolved = PyList_Size(resolved);
+    Py_ssize_t i;
+    for (i = 0; i < num_resolved; ++i) {
+        pygear_FutureObject* future = (pygear_FutureObject*) PyList_GetItem(resolved, i);
+        PySet_Discard(self->pending, (PyObject*) future);
+        Py_CLEAR(future->workload);
+        _pygear_future_run_callbacks(future);
+    }
+    Py_DECREF(resolved);
+    return (int) num_resolved;
+}
+
+
+/*
+ * Serialize a workload and queue a task for it.
+ * Return value: New reference to the task's Future, NULL on failure.
+ */
+static pygear_FutureObject* _pygear_asyncclient_submit(pygear_AsyncClientObject* self, int kind,
+    const char* function_name, PyObject* workload, const char* unique) {
+    PyObject* dumpstr = PyString_FromString("dumps");
+    PyObject* pickled_input = PyObject_CallMethodObjArgs(self->serializer, dumpstr, workload, NULL);
+    Py_XDECREF(dumpstr);
+    if (!pickled_input) {
+        return NULL;
+    }
+    char* workload_string;
+    Py_ssize_t workload_size;
+    if (PyString_AsStringAndSize(pickled_input, &workload_string, &workload_size) == -1) {
+        Py_DECREF(pickled_input);
+        return NULL;
+    }
+    pygear_FutureObject* future = _pygear_future_new((PyObject*) self, kind);
+    if (!future) {
+        Py_DECREF(pickled_input);
+        return NULL;
+    }
+    // libgearman does not copy the workload, the future keeps it until sent
+    future->workload = pickled_input;
+    // The task borrows the future from 'pending', which must hold it first
+    if (PySet_Add(self->pending, (PyObject*) future) < 0) {
+        Py_DECREF(future);
+        return NULL;
+    }
+    gearman_return_t ret;
+    if (kind == PYGEAR_FUTURE_BACKGROUND) {
+        gearman_client_add_task_background(self->g_Client, NULL, future, function_name, unique,
+            workload_string, workload_size, &ret);
+    } else {
+        gearman_client_add_task(self->g_Client, NULL, future, function_name, unique,
+            workload_string, workload_size, &ret);
+    }
+    if (_pygear_check_and_raise_exn(ret)) {
+        PySet_Discard(self->pending, (PyObject*) future);
+        Py_DECREF(future);
+        return NULL;
+    }
+    return future;
+}
+
+
+/********************
+ * Instance methods *
+ ********************/
+
+static PyObject* pygear_asyncclient_add_server(pygear_AsyncClientObject* self, PyObject* args) {
+    char* host;
+    int port;
+    if (!PyArg_ParseTuple(args, "zi", &host, &port)) {
+        return NULL;
+    }
+    gearman_return_t result = gearman_client_add_server(self->g_Client, host, port);
+    if (_pygear_check_and_raise_exn(result)) {
+        return NULL;
+    }
+    // exception callbacks are only called if exceptions are enabled on the server
+    const char *EXCEPTIONS = "exceptions";
+    gearman_client_set_server_option(self->g_Client, EXCEPTIONS, strlen(EXCEPTIONS));
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_asyncclient_add_servers(pygear_AsyncClientObject* self, PyObject* args) {
+    PyObject* server_list;
+    if (!PyArg_ParseTuple(args, "O!", &PyList_Type, &server_list)) {
+        return NULL;
+    }
+    Py_ssize_t num_servers = PyList_Size(server_list);
+    Py_ssize_t i;
+    for (i = 0; i < num_servers; ++i) {
+        char* server_string = PyString_AsString(PyList_GetItem(server_list, i));
+        if (!server_string) {
+            return NULL;
+        }
+        gearman_return_t result = gearman_client_add_servers(self->g_Client, server_string);
+        if (_pygear_check_and_raise_exn(result)) {
+            return NULL;
+        }
+    }
+    const char *EXCEPTIONS = "exceptions";
+    gearman_client_set_server_option(self->g_Client, EXCEPTIONS, strlen(EXCEPTIONS));
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_asyncclient_do(pygear_AsyncClientObject* self, PyObject* args, PyObject* kwargs) {
+    char* function_name;
+    PyObject* workload;
+    char* unique = NULL; /* optional */
+    static char* kwlist[] = {"function", "workload", "unique", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|z", kwlist,
+        &function_name, &workload, &unique)) {
+        return NULL;
+    }
+    return (PyObject*) _pygear_asyncclient_submit(self, PYGEAR_FUTURE_FOREGROUND, function_name, workload, unique);
+}
+
+
+static PyObject* pygear_asyncclient_do_background(pygear_AsyncClientObject* self, PyObject* args, PyObject* kwargs) {
+    char* function_name;
+    PyObject* workload;
+    char* unique = NULL; /* optional */
+    static char* kwlist[] = {"function", "workload", "unique", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|z", kwlist,
+        &function_name, &workload, &unique)) {
+        return NULL;
+    }
+    return (PyObject*) _pygear_asyncclient_submit(self, PYGEAR_FUTURE_BACKGROUND, function_name, workload, unique);
+}
+
+
+static PyObject* pygear_asyncclient_do_many(pygear_AsyncClientObject* self, PyObject* args, PyObject* kwargs) {
+    char* function_name;
+    PyObject* workloads;
+    static char* kwlist[] = {"function", "workloads", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO", kwlist, &function_name, &workloads)) {
+        return NULL;
+    }
+    PyObject* iterator = PyObject_GetIter(workloads);
+    if (!iterator) {
+        return NULL;
+    }
+    PyObject* futures = PyList_New(0);
+    PyObject* workload;
+    while (futures && (workload = PyIter_Next(iterator))) {
+        PyObject* future = (PyObject*) _pygear_asyncclient_submit(self, PYGEAR_FUTURE_FOREGROUND,
+            function_name, workload, NULL);
+        Py_DECREF(workload);
+        if (!future || PyList_Append(futures, future) < 0) {
+            Py_XDECREF(future);
+            Py_CLEAR(futures);
+            break;
+        }
+        Py_DECREF(future);
+    }
+    Py_DECREF(iterator);
+    if (PyErr_Occurred()) {
+        Py_XDECREF(futures);
+        return NULL;
+    }
+    return futures;
+}
+
+
+static PyObject* pygear_asyncclient_job_status(pygear_AsyncClientObject* self, PyObject* args) {
+    char* job_handle;
+    if (!PyArg_ParseTuple(args, "s", &job_handle)) {
+        return NULL;
+    }
+    pygear_FutureObject* future = _pygear_future_new((PyObject*) self, PYGEAR_FUTURE_STATUS);
+    if (!future) {
+        return NULL;
+    }
+    if (PySet_Add(self->pending, (PyObject*) future) < 0) {
+        Py_DECREF(future);
+        return NULL;
+    }
+    gearman_return_t ret;
+    gearman_client_add_task_status(self->g_Client, NULL, future, job_handle, &ret);
+    if (_pygear_check_and_raise_exn(ret)) {
+        PySet_Discard(self->pending, (PyObject*) future);
+        Py_DECREF(future);
+        return NULL;
+    }
+    return (PyObject*) future;
+}
+
+
+static PyObject* pygear_asyncclient_pending(pygear_AsyncClientObject* self) {
+    return Py_BuildValue("n", PySet_Size(self->pending));
+}
+
+
+static PyObject* pygear_asyncclient_poll(pygear_AsyncClientObject* self, PyObject* args) {
+    int timeout = gearman_client_timeout(self->g_Client);
+    if (!PyArg_ParseTuple(args, "|i", &timeout)) {
+        return NULL;
+    }
+    bool timed_out;
+    int resolved = _pygear_asyncclient_poll(self, timeout, &timed_out);
+    if (resolved < 0) {
+        return NULL;
+    }
+    return Py_BuildValue("i", resolved);
+}
+
+
+static PyObject* pygear_asyncclient_set_serializer(pygear_AsyncClientObject* self, PyObject* args) {
+    PyObject* serializer;
+    if (!PyArg_ParseTuple(args, "O", &serializer)) {
+        return NULL;
+    }
+    if (!PyObject_HasAttrString(serializer, "loads")) {
+        PyErr_SetString(PyExc_AttributeError, "Serializer does not implement 'loads'");
+        return NULL;
+    }
+    if (!PyObject_HasAttrString(serializer, "dumps")) {
+        PyErr_SetString(PyExc_AttributeError, "Serializer does not implement 'dumps'");
+        return NULL;
+    }
+    Py_INCREF(serializer);
+    Py_XDECREF(self->serializer);
+    self->serializer = serializer;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_asyncclient_set_timeout(pygear_AsyncClientObject* self, PyObject* args) {
+    int timeout;
+    if (!PyArg_ParseTuple(args, "i", &timeout)) {
+        return NULL;
+    }
+    gearman_client_set_timeout(self->g_Client, timeout);
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_asyncclient_timeout(pygear_AsyncClientObject* self) {
+    return Py_BuildValue("i", gearman_client_timeout(self->g_Client));
+}
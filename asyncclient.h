@@ -0,0 +1,213 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <libgearman-1.0/gearman.h>
+#include <stdio.h>
+#include "structmember.h"
+#include "future.h"
+#include "exception.h"
+
+#ifndef PyMODINIT_FUNC
+#define PyMODINIT_FUNC void
+#endif
+
+#ifndef ASYNCCLIENT_H
+#define ASYNCCLIENT_H
+
+#define _ASYNCCLIENTMETHOD(name,flags) {#name,(PyCFunction) pygear_asyncclient_##name,flags,pygear_asyncclient_##name##_doc},
+
+typedef struct {
+    PyObject_HEAD
+    struct gearman_client_st* g_Client;
+    PyObject* serializer;
+    PyObject* pending;      /* Futures submitted and not yet resolved */
+    PyObject* resolved;     /* Futures resolved during the current poll */
+} pygear_AsyncClientObject;
+
+PyDoc_STRVAR(asyncclient_module_docstring,
+"Represents a non-blocking Gearman client.\n\n"
+"Every submission returns a pygear.Future right away, and any number of jobs\n"
+"can be in flight on a single client. I/O is driven by 'poll', which runs\n"
+"libgearman in non-blocking mode with the GIL released and resolves futures\n"
+"from the task callbacks. Future.result() drives 'poll' itself, so simple\n"
+"callers never need to call it directly.");
+
+/* Class init methods */
+int AsyncClient_init(pygear_AsyncClientObject *self, PyObject *args, PyObject *kwds);
+int AsyncClient_traverse(pygear_AsyncClientObject *self, visitproc visit, void *arg);
+int AsyncClient_clear(pygear_AsyncClientObject *self);
+void AsyncClient_dealloc(pygear_AsyncClientObject* self);
+
+/* Private methods */
+static int _pygear_asyncclient_poll(pygear_AsyncClientObject* self, int timeout, bool* timed_out);
+
+/* Method definitions */
+static PyObject* pygear_asyncclient_add_server(pygear_AsyncClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_asyncclient_add_server_doc,
+"Add a job server to the client. No socket I/O happens here.\n\n"
+"@param[in] host - Hostname or IP address (IPv4 or IPv6) of the server to add.\n"
+"@param[in] port - Port of the server to add.\n\n"
+"@return None on success.\n"
+"@return NULL and raises pygear exception on failure.");
+
+static PyObject* pygear_asyncclient_add_servers(pygear_AsyncClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_asyncclient_add_servers_doc,
+"Add a list of job servers to the client.\n\n"
+"@param[in] servers_list - A list of servers each in the format of 'HOST[:PORT]'.\n\n"
+"@return None on success.\n"
+"@return NULL and raises pygear exception on failure.");
+
+static PyObject* pygear_asyncclient_do(pygear_AsyncClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_asyncclient_do_doc,
+"Submit a foreground job without waiting for it.\n\n"
+"@param[in] function_name - The name of the function to run.\n"
+"@param[in] workload - The workload to pass to the function when it is run.\n"
+"@param[in] unique - Optional unique job identifier.\n\n"
+"@return new Future resolving to the deserialized result of the job.");
+
+static PyObject* pygear_asyncclient_do_background(pygear_AsyncClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_asyncclient_do_background_doc,
+"Submit a background job without waiting for the server to accept it.\n"
+"See 'do' for parameters.\n\n"
+"@return new Future resolving to the job handle once the job is created.");
+
+static PyObject* pygear_asyncclient_do_many(pygear_AsyncClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_asyncclient_do_many_doc,
+"Submit one foreground job per workload.\n\n"
+"@param[in] function_name - The name of the function to run.\n"
+"@param[in] workloads - Iterable of workloads.\n\n"
+"@return list of new Futures, in the order of the workloads.");
+
+static PyObject* pygear_asyncclient_job_status(pygear_AsyncClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_asyncclient_job_status_doc,
+"Ask the server for the status of a background job.\n\n"
+"@param[in] job_handle - The job handle of the background job.\n\n"
+"@return new Future resolving to a dictionary with the keys\n"
+"'is_known', 'is_running', 'numerator' and 'denominator'.");
+
+static PyObject* pygear_asyncclient_pending(pygear_AsyncClientObject* self);
+PyDoc_STRVAR(pygear_asyncclient_pending_doc,
+"@return the number of submitted futures that are not resolved yet.");
+
+static PyObject* pygear_asyncclient_poll(pygear_AsyncClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_asyncclient_poll_doc,
+"Send queued jobs and process whatever the servers have answered, waiting\n"
+"at most 'timeout' milliseconds for activity. The GIL is released while\n"
+"waiting. Done-callbacks of the futures resolved by this call are run\n"
+"before it returns.\n\n"
+"@param[in] timeout - Optional milliseconds to wait. 0 never blocks, -1 waits\n"
+"\tindefinitely. Defaults to the client timeout.\n\n"
+"@return the number of futures resolved.\n"
+"@return NULL and raises pygear exception on failure.");
+
+static PyObject* pygear_asyncclient_set_serializer(pygear_AsyncClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_asyncclient_set_serializer_doc,
+"Specify the object to be used to serialize data passed through gearman.\n"
+"See Client.set_serializer.\n\n"
+"@param[in] serializer - Object implementing dumps and loads");
+
+static PyObject* pygear_asyncclient_set_timeout(pygear_AsyncClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_asyncclient_set_timeout_doc,
+"Set the default timeout, in milliseconds, of 'poll' and Future.result.\n"
+"A negative value means wait indefinitely.\n\n"
+"@param[in] timeout - Duration to wait in milliseconds.");
+
+static PyObject* pygear_asyncclient_timeout(pygear_AsyncClientObject* self);
+PyDoc_STRVAR(pygear_asyncclient_timeout_doc,
+"Get the current timeout value, in milliseconds, for the client.\n"
+"@return integer.");
+
+
+/* Module method specification */
+static PyMethodDef asyncclient_module_methods[] = {
+    // Server management
+    _ASYNCCLIENTMETHOD(add_server,          METH_VARARGS)
+    _ASYNCCLIENTMETHOD(add_servers,         METH_VARARGS)
+
+    // Job submission
+    _ASYNCCLIENTMETHOD(do,                  METH_VARARGS | METH_KEYWORDS)
+    _ASYNCCLIENTMETHOD(do_background,       METH_VARARGS | METH_KEYWORDS)
+    _ASYNCCLIENTMETHOD(do_many,             METH_VARARGS | METH_KEYWORDS)
+    _ASYNCCLIENTMETHOD(job_status,          METH_VARARGS)
+
+    // I/O
+    _ASYNCCLIENTMETHOD(poll,                METH_VARARGS)
+    _ASYNCCLIENTMETHOD(pending,             METH_NOARGS)
+
+    // Client Options
+    _ASYNCCLIENTMETHOD(timeout,             METH_NOARGS)
+    _ASYNCCLIENTMETHOD(set_timeout,         METH_VARARGS)
+    _ASYNCCLIENTMETHOD(set_serializer,      METH_VARARGS)
+
+    {NULL, NULL, 0, NULL}
+};
+
+PyTypeObject pygear_AsyncClientType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /*ob_size*/
+    "pygear.AsyncClient",                       /*tp_name*/
+    sizeof(pygear_AsyncClientObject),           /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)AsyncClient_dealloc,            /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_BASETYPE |
+    Py_TPFLAGS_HAVE_GC,                         /*tp_flags*/
+    asyncclient_module_docstring,               /* tp_doc */
+    (traverseproc)AsyncClient_traverse,         /* tp_traverse */
+    (inquiry)AsyncClient_clear,                 /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    asyncclient_module_methods,                 /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    (initproc)AsyncClient_init,                 /* tp_init */
+};
+
+#endif
@@ -0,0 +1,428 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <sys/mman.h>
+#include "cache.h"
+#include "hash.h"
+#include "cooperative.h"
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+static pygear_cache* _pygear_cache_new(const char* function_name, long ttl_ms, size_t max_bytes) {
+    pygear_cache* cache = calloc(1, sizeof(pygear_cache));
+    if (!cache) {
+        return NULL;
+    }
+    cache->function_name = strdup(function_name);
+    cache->buckets = calloc(CACHE_INITIAL_BUCKETS, sizeof(pygear_cache_entry*));
+    if (!cache->function_name || !cache->buckets) {
+        _pygear_cache_free(cache);
+        return NULL;
+    }
+    cache->num_buckets = CACHE_INITIAL_BUCKETS;
+    cache->ttl = ttl_ms / 1000.0;
+    cache->max_bytes = max_bytes;
+    return cache;
+}
+
+/*
+ * A cache whose entries are kept in an anonymous shared mapping of about
+ * 'max_bytes', so that processes forked afterwards share them. Results over
+ * 'max_result_bytes' are not stored. Sets errno and returns NULL on failure,
+ * EINVAL if 'max_bytes' does not hold one set of slots.
+ */
+static pygear_cache* _pygear_cache_new_shared(const char* function_name, long ttl_ms, size_t max_bytes,
+    size_t max_result_bytes) {
+    size_t slot_size = (sizeof(pygear_shared_cache_slot) + max_result_bytes + 7) & ~(size_t) 7;
+    size_t num_slots = (max_bytes / slot_size) / CACHE_SHARED_WAYS * CACHE_SHARED_WAYS;
+    if (!num_slots) {
+        errno = EINVAL;
+        return NULL;
+    }
+    pygear_cache* cache = _pygear_cache_new(function_name, ttl_ms, max_bytes);
+    if (!cache) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    size_t shared_size = sizeof(pygear_shared_cache) + num_slots * slot_size;
+    void* mapping = mmap(NULL, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        int error = errno;
+        _pygear_cache_free(cache);
+        errno = error;
+        return NULL;
+    }
+    /* The mapping is zero filled: every slot is free and the counters are 0 */
+    pygear_shared_cache* shared = mapping;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&shared->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    shared->num_slots = num_slots;
+    shared->slot_size = slot_size;
+    shared->max_result_bytes = max_result_bytes;
+    cache->shared = shared;
+    cache->shared_size = shared_size;
+    return cache;
+}
+
+static void _pygear_cache_free(pygear_cache* cache) {
+    if (cache->shared) {
+        munmap(cache->shared, cache->shared_size);
+    }
+    pygear_cache_entry* entry = cache->newest;
+    while (entry) {
+        pygear_cache_entry* older = entry->older;
+        free(entry->value);
+        free(entry);
+        entry = older;
+    }
+    free(cache->buckets);
+    free(cache->function_name);
+    free(cache);
+}
+
+static pygear_cache* _pygear_cache_find(pygear_cache* caches, const char* function_name) {
+    for (; caches; caches = caches->next) {
+        if (!strcmp(caches->function_name, function_name)) {
+            return caches;
+        }
+    }
+    return NULL;
+}
+
+/* What an entry counts against max_bytes */
+static size_t _pygear_cache_entry_bytes(const pygear_cache_entry* entry) {
+    return sizeof(pygear_cache_entry) + entry->size;
+}
+
+static pygear_cache_entry** _pygear_cache_bucket(pygear_cache* cache, const uint64_t* key) {
+    return &cache->buckets[key[0] & (cache->num_buckets - 1)];
+}
+
+static void _pygear_cache_unlink(pygear_cache* cache, pygear_cache_entry* entry) {
+    if (entry->newer) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+    entry->newer = entry->older = NULL;
+}
+
+static void _pygear_cache_link_newest(pygear_cache* cache, pygear_cache_entry* entry) {
+    entry->older = cache->newest;
+    entry->newer = NULL;
+    if (cache->newest) {
+        cache->newest->newer = entry;
+    } else {
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+}
+
+static void _pygear_cache_remove(pygear_cache* cache, pygear_cache_entry* entry) {
+    pygear_cache_entry** link = _pygear_cache_bucket(cache, entry->key);
+    while (*link != entry) {
+        link = &(*link)->bucket_next;
+    }
+    *link = entry->bucket_next;
+    _pygear_cache_unlink(cache, entry);
+    cache->bytes -= _pygear_cache_entry_bytes(entry);
+    cache->num_entries--;
+    free(entry->value);
+    free(entry);
+}
+
+/* Doubles the buckets; left as is if memory is short, chains just get longer */
+static void _pygear_cache_grow(pygear_cache* cache) {
+    size_t num_buckets = cache->num_buckets * 2;
+    pygear_cache_entry** buckets = calloc(num_buckets, sizeof(pygear_cache_entry*));
+    if (!buckets) {
+        return;
+    }
+    size_t i;
+    for (i = 0; i < cache->num_buckets; ++i) {
+        pygear_cache_entry* entry = cache->buckets[i];
+        while (entry) {
+            pygear_cache_entry* bucket_next = entry->bucket_next;
+            pygear_cache_entry** bucket = &buckets[entry->key[0] & (num_buckets - 1)];
+            entry->bucket_next = *bucket;
+            *bucket = entry;
+            entry = bucket_next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->num_buckets = num_buckets;
+}
+
+static void _pygear_shared_cache_lock(pygear_shared_cache* shared) {
+    if (pthread_mutex_lock(&shared->lock) == EOWNERDEAD) {
+        /* The owner died; slots are only marked used once fully written */
+        pthread_mutex_consistent(&shared->lock);
+    }
+}
+
+static pygear_shared_cache_slot* _pygear_shared_cache_slot(pygear_shared_cache* shared, size_t index) {
+    return (pygear_shared_cache_slot*) ((char*) (shared + 1) + index * shared->slot_size);
+}
+
+/* First slot of the set 'key' belongs to */
+static size_t _pygear_shared_cache_set(const pygear_shared_cache* shared, const uint64_t* key) {
+    return (key[0] % (shared->num_slots / CACHE_SHARED_WAYS)) * CACHE_SHARED_WAYS;
+}
+
+static bool _pygear_shared_cache_get(pygear_cache* cache, const uint64_t* key, void** value, size_t* size,
+    uint8_t* codec) {
+    pygear_shared_cache* shared = cache->shared;
+    double now = _pygear_monotonic();
+    bool hit = false;
+    _pygear_shared_cache_lock(shared);
+    size_t first = _pygear_shared_cache_set(shared, key);
+    size_t i;
+    for (i = first; i < first + CACHE_SHARED_WAYS; ++i) {
+        pygear_shared_cache_slot* slot = _pygear_shared_cache_slot(shared, i);
+        if (!slot->expires || slot->key[0] != key[0] || slot->key[1] != key[1]) {
+            continue;
+        }
+        if (slot->expires <= now) {
+            shared->num_entries--;
+            shared->bytes -= slot->size;
+            slot->expires = 0;
+            break;
+        }
+        *value = NULL;
+        if (slot->size) {
+            *value = malloc(slot->size);
+            if (!*value) {
+                break;
+            }
+            memcpy(*value, slot + 1, slot->size);
+        }
+        *size = slot->size;
+        *codec = slot->codec;
+        slot->used = now;
+        hit = true;
+        break;
+    }
+    if (hit) {
+        shared->hits++;
+    } else {
+        shared->misses++;
+    }
+    pthread_mutex_unlock(&shared->lock);
+    return hit;
+}
+
+static void _pygear_shared_cache_put(pygear_cache* cache, const uint64_t* key, const void* value, size_t size,
+    uint8_t codec) {
+    pygear_shared_cache* shared = cache->shared;
+    if (size > shared->max_result_bytes) {
+        return;
+    }
+    double now = _pygear_monotonic();
+    _pygear_shared_cache_lock(shared);
+    /* The slot holding the key already, else a free or expired one, else the least recently used */
+    size_t first = _pygear_shared_cache_set(shared, key);
+    pygear_shared_cache_slot* victim = NULL;
+    size_t i;
+    for (i = first; i < first + CACHE_SHARED_WAYS; ++i) {
+        pygear_shared_cache_slot* slot = _pygear_shared_cache_slot(shared, i);
+        if (slot->expires && slot->key[0] == key[0] && slot->key[1] == key[1]) {
+            victim = slot;
+            break;
+        }
+        if (!victim || (victim->expires > now && (slot->expires <= now || slot->used < victim->used))) {
+            victim = slot;
+        }
+    }
+    if (victim->expires) {
+        if (victim->expires > now && (victim->key[0] != key[0] || victim->key[1] != key[1])) {
+            shared->evictions++;
+        }
+        shared->num_entries--;
+        shared->bytes -= victim->size;
+        victim->expires = 0;
+    }
+    victim->key[0] = key[0];
+    victim->key[1] = key[1];
+    victim->size = size;
+    victim->codec = codec;
+    memcpy(victim + 1, value, size);
+    victim->used = now;
+    victim->expires = now + cache->ttl;
+    shared->num_entries++;
+    shared->bytes += size;
+    pthread_mutex_unlock(&shared->lock);
+}
+
+/*
+ * Looks 'key' up, counting a hit or a miss. On a hit '*value' is a copy of
+ * the result to be freed by the caller, NULL for an empty result, and
+ * '*codec' the codec id it was stored with.
+ */
+static bool _pygear_cache_get(pygear_cache* cache, const uint64_t* key, void** value, size_t* size,
+    uint8_t* codec) {
+    if (cache->shared) {
+        return _pygear_shared_cache_get(cache, key, value, size, codec);
+    }
+    pygear_cache_entry* entry = *_pygear_cache_bucket(cache, key);
+    while (entry && (entry->key[0] != key[0] || entry->key[1] != key[1])) {
+        entry = entry->bucket_next;
+    }
+    if (entry && entry->expires <= _pygear_monotonic()) {
+        _pygear_cache_remove(cache, entry);
+        entry = NULL;
+    }
+    if (entry && entry->size) {
+        *value = malloc(entry->size);
+        if (!*value) {
+            entry = NULL;
+        } else {
+            memcpy(*value, entry->value, entry->size);
+        }
+    } else if (entry) {
+        *value = NULL;
+    }
+    if (!entry) {
+        cache->misses++;
+        return false;
+    }
+    *size = entry->size;
+    *codec = entry->codec;
+    _pygear_cache_unlink(cache, entry);
+    _pygear_cache_link_newest(cache, entry);
+    cache->hits++;
+    return true;
+}
+
+/*
+ * Stores a copy of 'value' and the codec id decoding it under 'key',
+ * evicting the least recently used entries to stay within max_bytes. Results
+ * that could never fit are not stored; the cache is best effort, so running
+ * out of memory is not an error.
+ */
+static void _pygear_cache_put(pygear_cache* cache, const uint64_t* key, const void* value, size_t size,
+    uint8_t codec) {
+    if (cache->shared) {
+        _pygear_shared_cache_put(cache, key, value, size, codec);
+        return;
+    }
+    if (sizeof(pygear_cache_entry) + size > cache->max_bytes) {
+        return;
+    }
+    pygear_cache_entry** bucket = _pygear_cache_bucket(cache, key);
+    pygear_cache_entry* entry = *bucket;
+    while (entry && (entry->key[0] != key[0] || entry->key[1] != key[1])) {
+        entry = entry->bucket_next;
+    }
+    if (entry) {
+        _pygear_cache_remove(cache, entry);
+    }
+    entry = calloc(1, sizeof(pygear_cache_entry));
+    if (!entry) {
+        return;
+    }
+    if (size) {
+        entry->value = malloc(size);
+        if (!entry->value) {
+            free(entry);
+            return;
+        }
+        memcpy(entry->value, value, size);
+    }
+    entry->key[0] = key[0];
+    entry->key[1] = key[1];
+    entry->size = size;
+    entry->codec = codec;
+    entry->expires = _pygear_monotonic() + cache->ttl;
+    while (cache->oldest && cache->bytes + _pygear_cache_entry_bytes(entry) > cache->max_bytes) {
+        _pygear_cache_remove(cache, cache->oldest);
+        cache->evictions++;
+    }
+    if (cache->num_entries >= cache->num_buckets) {
+        _pygear_cache_grow(cache);
+    }
+    bucket = _pygear_cache_bucket(cache, key);
+    entry->bucket_next = *bucket;
+    *bucket = entry;
+    _pygear_cache_link_newest(cache, entry);
+    cache->bytes += _pygear_cache_entry_bytes(entry);
+    cache->num_entries++;
+}
+
+/* Drops every entry, and those of the siblings sharing a shared cache */
+static void _pygear_cache_clear(pygear_cache* cache) {
+    if (cache->shared) {
+        pygear_shared_cache* shared = cache->shared;
+        _pygear_shared_cache_lock(shared);
+        size_t i;
+        for (i = 0; i < shared->num_slots; ++i) {
+            _pygear_shared_cache_slot(shared, i)->expires = 0;
+        }
+        shared->num_entries = 0;
+        shared->bytes = 0;
+        pthread_mutex_unlock(&shared->lock);
+        return;
+    }
+    while (cache->oldest) {
+        _pygear_cache_remove(cache, cache->oldest);
+    }
+}
+
+static PyObject* _pygear_cache_stats(const pygear_cache* cache) {
+    if (cache->shared) {
+        pygear_shared_cache counters;
+        _pygear_shared_cache_lock(cache->shared);
+        memcpy(&counters, cache->shared, sizeof(pygear_shared_cache));
+        pthread_mutex_unlock(&cache->shared->lock);
+        return Py_BuildValue("{s:K, s:K, s:K, s:n, s:n}",
+            "hits", counters.hits,
+            "misses", counters.misses,
+            "evictions", counters.evictions,
+            "entries", (Py_ssize_t) counters.num_entries,
+            "bytes", (Py_ssize_t) counters.bytes);
+    }
+    return Py_BuildValue("{s:K, s:K, s:K, s:n, s:n}",
+        "hits", cache->hits,
+        "misses", cache->misses,
+        "evictions", cache->evictions,
+        "entries", (Py_ssize_t) cache->num_entries,
+        "bytes", (Py_ssize_t) cache->bytes);
+}
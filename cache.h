@@ -0,0 +1,120 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#define CACHE_INITIAL_BUCKETS 64
+#define CACHE_DEFAULT_MAX_BYTES (16 * 1024 * 1024)
+#define CACHE_SHARED_WAYS 4
+#define CACHE_SHARED_DEFAULT_MAX_RESULT_BYTES 4096
+
+typedef struct pygear_cache_entry {
+    uint64_t key[2];
+    char* value;                /* encoded result, NULL when empty */
+    size_t size;
+    uint8_t codec;              /* envelope codec id of the value */
+    double expires;             /* monotonic seconds */
+    struct pygear_cache_entry* bucket_next;
+    struct pygear_cache_entry* newer;
+    struct pygear_cache_entry* older;
+} pygear_cache_entry;
+
+typedef struct {
+    uint64_t key[2];
+    double expires;             /* monotonic seconds, 0 for a free slot */
+    double used;                /* monotonic seconds of the last hit or store */
+    size_t size;
+    uint8_t codec;
+    /* followed by max_result_bytes of data */
+} pygear_shared_cache_slot;
+
+/*
+ * Header of a cache in a MAP_SHARED mapping, inherited by forked processes.
+ * Slots have a fixed size and are grouped in sets of CACHE_SHARED_WAYS, a
+ * key lives in the set its hash picks and evicts the least recently used
+ * slot of that set. The mutex is process shared and robust, so a process
+ * dying while it holds the lock does not block its siblings.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t num_slots;
+    size_t slot_size;           /* stride, including pygear_shared_cache_slot */
+    size_t max_result_bytes;
+    size_t num_entries;
+    size_t bytes;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    /* followed by num_slots slots */
+} pygear_shared_cache;
+
+/*
+ * Encoded results of one function, keyed on a 128 bit hash of the function
+ * name and encoded workload,
+ * see _pygear_hash_job. Entries are chained in hash buckets and in a
+ * list from most to least recently used, which is evicted from the tail
+ * once the entries take more than 'max_bytes'. Only used with the GIL held.
+ */
+typedef struct pygear_cache {
+    char* function_name;
+    double ttl;                 /* seconds */
+    size_t max_bytes;
+    size_t bytes;
+    pygear_cache_entry** buckets;
+    size_t num_buckets;
+    size_t num_entries;
+    pygear_cache_entry* newest;
+    pygear_cache_entry* oldest;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    pygear_shared_cache* shared;    /* entries live here instead, if set */
+    size_t shared_size;
+    struct pygear_cache* next;
+} pygear_cache;
+
+/* Private methods */
+static pygear_cache* _pygear_cache_new(const char* function_name, long ttl_ms, size_t max_bytes);
+static pygear_cache* _pygear_cache_new_shared(const char* function_name, long ttl_ms, size_t max_bytes,
+    size_t max_result_bytes);
+static void _pygear_cache_free(pygear_cache* cache);
+static pygear_cache* _pygear_cache_find(pygear_cache* caches, const char* function_name);
+static bool _pygear_cache_get(pygear_cache* cache, const uint64_t* key, void** value, size_t* size,
+    uint8_t* codec);
+static void _pygear_cache_put(pygear_cache* cache, const uint64_t* key, const void* value, size_t size,
+    uint8_t codec);
+static void _pygear_cache_clear(pygear_cache* cache);
+static PyObject* _pygear_cache_stats(const pygear_cache* cache);
+
+#endif
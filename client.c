@@ -28,6 +28,16 @@
 
 #include "client.h"
 
+/* Transient errors retried unless the retry policy says otherwise */
+static void _pygear_client_default_retry_on(char* retry_on) {
+    memset(retry_on, 0, GEARMAN_MAX_RETURN);
+    retry_on[GEARMAN_LOST_CONNECTION] = 1;
+    retry_on[GEARMAN_COULD_NOT_CONNECT] = 1;
+    retry_on[GEARMAN_JOB_QUEUE_FULL] = 1;
+    retry_on[GEARMAN_TIMEOUT] = 1;
+}
+
+
 /*
  * Class constructor / destructor methods
  */
@@ -54,6 +64,40 @@ int Client_init(pygear_ClientObject* self, PyObject* args, PyObject*kwds) {
     self->cb_complete = NULL;
     self->cb_exception = NULL;
     self->cb_fail = NULL;
+    self->cb_async_fail = NULL;
+    // Background submitter
+    self->submitter = NULL;
+    self->async_capacity = SUBMITTER_DEFAULT_CAPACITY;
+    self->async_batch_size = SUBMITTER_DEFAULT_BATCH_SIZE;
+    self->async_interval_ms = SUBMITTER_DEFAULT_INTERVAL_MS;
+    // In-flight window
+    self->max_in_flight = 0;
+    self->in_flight = 0;
+    self->window_free_tasks = false;
+    self->tasks = NULL;
+    gearman_client_set_task_context_free_fn(self->g_Client, _pygear_client_task_context_free);
+    _pygear_router_init(&self->router);
+    // Hedging
+    _pygear_histogram_reset(&self->latency);
+    self->hedge_budget = CLIENT_DEFAULT_HEDGE_BUDGET;
+    self->hedge_requests = 0;
+    self->hedges_sent = 0;
+    self->hedges_won = 0;
+    // Retries
+    self->retry_attempts = 1;
+    self->retry_backoff_ms = CLIENT_DEFAULT_RETRY_BACKOFF_MS;
+    self->retry_max_backoff_ms = CLIENT_DEFAULT_RETRY_MAX_BACKOFF_MS;
+    self->retry_cooloff_ms = CLIENT_DEFAULT_RETRY_COOLOFF_MS;
+    _pygear_client_default_retry_on(self->retry_on);
+    self->retries = 0;
+    self->random_state = _pygear_random_seed(self);
+    self->unique_strategy = PYGEAR_UNIQUE_NONE;
+    self->result_caches = NULL;
+    self->envelope = false;
+    self->envelope_deadline_ms = 0;
+    self->trace = false;
+    self->release_gil = false;
+    _pygear_client_publish(self, NULL);
     return 0;
 }
 
@@ -67,6 +111,7 @@ int Client_traverse(pygear_ClientObject* self, visitproc visit, void* arg) {
     Py_VISIT(self->cb_exception);
     Py_VISIT(self->cb_fail);
     Py_VISIT(self->cb_log);
+    Py_VISIT(self->cb_async_fail);
     Py_VISIT(self->serializer);
     return 0;
 }
@@ -81,15 +126,33 @@ int Client_clear(pygear_ClientObject* self) {
     Py_CLEAR(self->cb_exception);
     Py_CLEAR(self->cb_fail);
     Py_CLEAR(self->cb_log);
+    Py_CLEAR(self->cb_async_fail);
     Py_CLEAR(self->serializer);
     return 0;
 }
 
 void Client_dealloc(pygear_ClientObject* self) {
+    if (self->submitter) {
+        // Sends what is still queued; the writer may need the GIL to report failures
+        Py_BEGIN_ALLOW_THREADS
+        _pygear_submitter_destroy(self->submitter);
+        Py_END_ALLOW_THREADS
+        self->submitter = NULL;
+    }
     if (self->g_Client) {
         gearman_client_free(self->g_Client);
         self->g_Client = NULL;
     }
+    // Waits for a load probe in progress
+    Py_BEGIN_ALLOW_THREADS
+    _pygear_router_free(&self->router);
+    Py_END_ALLOW_THREADS
+    while (self->result_caches) {
+        pygear_cache* next = self->result_caches->next;
+        _pygear_cache_free(self->result_caches);
+        self->result_caches = next;
+    }
+    _pygear_client_publish(self, NULL);
     Client_clear(self);
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -110,6 +173,9 @@ static PyObject* pygear_client_add_server(pygear_ClientObject* self, PyObject* a
     if (_pygear_check_and_raise_exn(result)) {
         return NULL;
     }
+    if (_pygear_router_add(&self->router, host, port) < 0) {
+        return NULL;
+    }
     // gearman_client_set_exception_fn() will only be called if exceptions are enabled on the server
     const char *EXCEPTIONS = "exceptions";
     gearman_client_set_server_option(self->g_Client, EXCEPTIONS, strlen(EXCEPTIONS));
@@ -142,6 +208,9 @@ static PyObject* pygear_client_add_servers(pygear_ClientObject* self, PyObject*
         if (_pygear_check_and_raise_exn(result)) {
             return NULL;
         }
+        if (_pygear_router_add_list(&self->router, server_string) < 0) {
+            return NULL;
+        }
     }
     const char *EXCEPTIONS="exceptions";
     gearman_client_set_server_option(self->g_Client, EXCEPTIONS, strlen(EXCEPTIONS));
@@ -149,40 +218,508 @@ static PyObject* pygear_client_add_servers(pygear_ClientObject* self, PyObject*
 }
 
 
+/*
+ * Connection a do* call goes through: the client itself, or with routing
+ * enabled the connection to the server picked for the job, whose index is
+ * put in *server (-1 for the client itself).
+ * Returns NULL with a python exception set on failure.
+ */
+static gearman_client_st* _pygear_client_route(pygear_ClientObject* self, const char* routing_key,
+    const char* unique, const char* function_name, const char* workload, size_t workload_size, int* server) {
+    *server = -1;
+    if (self->router.mode == PYGEAR_ROUTING_DEFAULT) {
+        return self->g_Client;
+    }
+    if (self->router.mode == PYGEAR_ROUTING_LEAST_LOADED) {
+        *server = _pygear_router_pick_least_loaded(&self->router, function_name);
+    } else {
+        uint64_t hash;
+        if (routing_key) {
+            hash = _pygear_hash64(routing_key, strlen(routing_key), 0);
+        } else if (unique) {
+            hash = _pygear_hash64(unique, strlen(unique), 0);
+        } else {
+            hash = _pygear_hash64(workload, workload_size, _pygear_hash64(function_name, strlen(function_name), 0));
+        }
+        *server = _pygear_router_pick(&self->router, hash);
+    }
+    if (*server < 0) {
+        _pygear_check_and_raise_exn(GEARMAN_NO_SERVERS);
+        return NULL;
+    }
+    return _pygear_router_connection(&self->router, *server, self->g_Client);
+}
+
+
+/*
+ * Delay before a call asking for hedging sends its duplicate, -1 for no
+ * hedge: over budget, or no delay given and too few calls to derive one.
+ */
+static int _pygear_client_hedge_delay(pygear_ClientObject* self, int hedge_after_ms) {
+    if (hedge_after_ms < 0) {
+        return -1;
+    }
+    if (hedge_after_ms == 0) {
+        if (self->latency.count < CLIENT_HEDGE_MIN_SAMPLES) {
+            return -1;
+        }
+        hedge_after_ms = (int) (_pygear_histogram_percentile(&self->latency, CLIENT_HEDGE_PERCENTILE) * 1000) + 1;
+    }
+    self->hedge_requests++;
+    if (self->hedges_sent >= self->hedge_budget / 100.0 * self->hedge_requests + 1) {
+        return -1;
+    }
+    return hedge_after_ms;
+}
+
+/*
+ * Foreground do with a hedge: if the task has not finished 'hedge_after_ms'
+ * after it was sent, a duplicate under another unique is added to the same
+ * connection, and the first successful result is returned. The loser is
+ * freed and its answer ignored. Call without the GIL unless 'cooperative'.
+ * *hedged tells whether a duplicate was sent, *hedge_won whether it won.
+ */
+static void* _pygear_client_do_hedged(gearman_client_st* client, pygear_add_task_fn add_task,
+    const char* function_name, const char* unique, const void* workload, size_t workload_size,
+    int hedge_after_ms, bool cooperative, bool* hedged, bool* hedge_won, size_t* result_size,
+    gearman_return_t* ret_ptr) {
+    bool free_tasks = gearman_client_has_option(client, GEARMAN_CLIENT_FREE_TASKS);
+    bool non_blocking = gearman_client_has_option(client, GEARMAN_CLIENT_NON_BLOCKING);
+    int timeout = gearman_client_timeout(client);
+    gearman_client_remove_options(client, GEARMAN_CLIENT_FREE_TASKS);
+    gearman_client_add_options(client, GEARMAN_CLIENT_NON_BLOCKING);
+    *hedged = false;
+    *hedge_won = false;
+    *result_size = 0;
+    void* result = NULL;
+    double now = _pygear_monotonic();
+    double hedge_at = now + hedge_after_ms / 1000.0;
+    double deadline = timeout < 0 ? -1 : now + timeout / 1000.0;
+    gearman_task_st* tasks[2] = {NULL, NULL};
+    gearman_task_st* winner = NULL;
+    gearman_return_t ret;
+    tasks[0] = add_task(client, NULL, NULL, function_name, unique, workload, workload_size, &ret);
+    while (gearman_success(ret) && !winner) {
+        ret = gearman_client_run_tasks(client);
+        if (ret != GEARMAN_SUCCESS && ret != GEARMAN_IO_WAIT) {
+            break;
+        }
+        // First successful answer wins, the call fails once every copy failed
+        size_t i, failed = 0, sent = tasks[1] ? 2 : 1;
+        for (i = 0; i < sent && !winner; ++i) {
+            if (!gearman_task_is_active(tasks[i])) {
+                if (gearman_success(gearman_task_return(tasks[i]))) {
+                    winner = tasks[i];
+                    *hedge_won = (i == 1);
+                } else {
+                    failed++;
+                }
+            }
+        }
+        if (winner || failed == sent) {
+            ret = winner ? GEARMAN_SUCCESS : gearman_task_return(tasks[0]);
+            break;
+        }
+        now = _pygear_monotonic();
+        if (deadline >= 0 && now >= deadline) {
+            ret = GEARMAN_TIMEOUT;
+            break;
+        }
+        if (!tasks[1] && now >= hedge_at) {
+            char hedge_unique[GEARMAN_MAX_UNIQUE_SIZE];
+            if (unique) {
+                snprintf(hedge_unique, sizeof(hedge_unique), "%.*s~h", GEARMAN_MAX_UNIQUE_SIZE - 3, unique);
+            }
+            tasks[1] = add_task(client, NULL, NULL, function_name, unique ? hedge_unique : NULL,
+                workload, workload_size, &ret);
+            *hedged = (tasks[1] != NULL);
+            continue;
+        }
+        // Wake up for the hedge, the deadline, or an answer, whichever comes first
+        double until = tasks[1] ? deadline : hedge_at;
+        if (deadline >= 0 && deadline < until) {
+            until = deadline;
+        }
+        gearman_client_set_timeout(client, until < 0 ? -1 : (int) ((until - now) * 1000) + 1);
+        ret = cooperative ? _pygear_cooperative_client_wait(client) : gearman_client_wait(client);
+        gearman_client_set_timeout(client, timeout);
+        if (ret == GEARMAN_TIMEOUT || ret == GEARMAN_IO_WAIT) {
+            ret = GEARMAN_SUCCESS;
+        }
+    }
+    if (winner) {
+        gearman_result_st* task_result = gearman_task_result(winner);
+        if (task_result && gearman_result_size(task_result)) {
+            *result_size = gearman_result_size(task_result);
+            result = malloc(*result_size);
+            if (result) {
+                memcpy(result, gearman_result_value(task_result), *result_size);
+            } else {
+                *result_size = 0;
+                ret = GEARMAN_MEMORY_ALLOCATION_FAILURE;
+            }
+        }
+    }
+    size_t i;
+    for (i = 0; i < 2; ++i) {
+        if (tasks[i]) {
+            gearman_task_free(tasks[i]);
+        }
+    }
+    gearman_client_set_timeout(client, timeout);
+    if (!non_blocking) {
+        gearman_client_remove_options(client, GEARMAN_CLIENT_NON_BLOCKING);
+    }
+    if (free_tasks) {
+        gearman_client_add_options(client, GEARMAN_CLIENT_FREE_TASKS);
+    }
+    *ret_ptr = ret;
+    return result;
+}
+
+
+/*
+ * Unique key a job is submitted with: 'unique' if the caller gave one, else
+ * one generated into 'buffer' (PYGEAR_UNIQUE_SIZE bytes) by the client's
+ * unique strategy, else NULL.
+ */
+static char* _pygear_client_unique(pygear_ClientObject* self, char* unique, const char* function_name,
+    const char* workload, size_t workload_size, char* buffer) {
+    if (unique) {
+        return unique;
+    }
+    switch (self->unique_strategy) {
+        case PYGEAR_UNIQUE_CONTENT:
+            _pygear_unique_content(function_name, workload, workload_size, buffer);
+            return buffer;
+        case PYGEAR_UNIQUE_RANDOM:
+            _pygear_unique_random(&self->random_state, buffer);
+            return buffer;
+        default:
+            return NULL;
+    }
+}
+
+
+/*
+ * Puts the payload in an envelope if the client sends them. Returns the size
+ * of the envelope, 0 if none, -1 with a python exception set and the payload
+ * released on failure.
+ */
+static int _pygear_client_envelope(pygear_ClientObject* self, pygear_payload* payload, bool serialized) {
+    if (!self->envelope) {
+        return 0;
+    }
+    pygear_envelope envelope;
+    envelope.version = ENVELOPE_VERSION;
+    envelope.codec = serialized ? _pygear_envelope_codec_id(self->serializer) : ENVELOPE_CODEC_RAW;
+    envelope.flags = 0;
+    envelope.sent_us = _pygear_envelope_now_us();
+    envelope.deadline_us = self->envelope_deadline_ms > 0 ?
+        envelope.sent_us + (uint64_t) self->envelope_deadline_ms * 1000 : 0;
+    uint64_t trace_id[2] = {_pygear_random64(&self->random_state), _pygear_random64(&self->random_state)};
+    memcpy(envelope.trace_id, trace_id, ENVELOPE_TRACE_ID_SIZE);
+    envelope.grabbed_us = 0;
+    envelope.started_us = 0;
+    if (_pygear_envelope_wrap(payload, &envelope) < 0) {
+        _pygear_payload_release(payload);
+        return -1;
+    }
+    return ENVELOPE_SIZE;
+}
+
+/*
+ * Return value: New reference.
+ * The timings of a do* call for 'timings=True', with the times of the
+ * worker that sent 'reply' (may be NULL) moved onto the monotonic clock.
+ */
+static PyObject* _pygear_client_timings(const pygear_client_timings* timings, const pygear_envelope* reply) {
+    double worker[3] = {0, 0, 0};
+    if (reply) {
+        uint64_t worker_us[3] = {reply->grabbed_us, reply->started_us, reply->sent_us};
+        int i;
+        for (i = 0; i < 3; ++i) {
+            if (worker_us[i]) {
+                worker[i] = timings->start + (int64_t) (worker_us[i] - timings->start_us) / 1e6;
+            }
+        }
+    }
+    double times[] = {timings->start, timings->serialized, timings->submitted, timings->received,
+        timings->deserialized, worker[0], worker[1], worker[2]};
+    const char* names[] = {"start", "serialized", "submitted", "received",
+        "deserialized", "worker_grabbed", "worker_started", "worker_finished"};
+    PyObject* ret = PyDict_New();
+    size_t i;
+    for (i = 0; ret && i < sizeof(times) / sizeof(times[0]); ++i) {
+        PyObject* value = times[i] ? PyFloat_FromDouble(times[i]) : Py_None;
+        if (value == Py_None) {
+            Py_INCREF(value);
+        }
+        if (!value || PyDict_SetItemString(ret, names[i], value) < 0) {
+            Py_CLEAR(ret);
+        }
+        Py_XDECREF(value);
+    }
+    return ret;
+}
+
+
+/* Drops the result cache of 'function_name', or all caches if NULL */
+static void _pygear_client_free_result_caches(pygear_ClientObject* self, const char* function_name) {
+    pygear_cache** link = &self->result_caches;
+    while (*link) {
+        pygear_cache* cache = *link;
+        if (function_name && strcmp(cache->function_name, function_name)) {
+            link = &cache->next;
+            continue;
+        }
+        *link = cache->next;
+        _pygear_cache_free(cache);
+    }
+}
+
+
+/* Errors that say nothing good about the server the call went to */
+static bool _pygear_client_server_failed(gearman_return_t ret) {
+    switch (ret) {
+        case GEARMAN_COULD_NOT_CONNECT:
+        case GEARMAN_LOST_CONNECTION:
+        case GEARMAN_GETADDRINFO:
+        case GEARMAN_NOT_CONNECTED:
+        case GEARMAN_JOB_QUEUE_FULL:
+        case GEARMAN_SERVER_ERROR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Decide whether attempt number 'attempt' of a do* call, which failed with
+ * 'ret' through router server 'server' (-1 if not routed), is tried again.
+ * The server is marked down for the cool-off period first, so that routing
+ * fails over to another one. Sleeps the jittered exponential backoff before
+ * returning 1; returns 0 to give up, -1 with a python exception set if the
+ * wait hook raised.
+ */
+static int _pygear_client_retry(pygear_ClientObject* self, gearman_return_t ret, int attempt, int server) {
+    if (server >= 0 && _pygear_client_server_failed(ret) && self->retry_cooloff_ms > 0) {
+        _pygear_router_mark_down(&self->router, server, self->retry_cooloff_ms / 1000.0);
+    }
+    if (attempt >= self->retry_attempts || ret <= 0 || ret >= GEARMAN_MAX_RETURN || !self->retry_on[ret]) {
+        return 0;
+    }
+    // Half of the exponential delay is fixed, the other half random
+    double delay_ms = self->retry_backoff_ms;
+    int i;
+    for (i = 1; i < attempt && delay_ms < self->retry_max_backoff_ms; ++i) {
+        delay_ms *= 2;
+    }
+    if (delay_ms > self->retry_max_backoff_ms) {
+        delay_ms = self->retry_max_backoff_ms;
+    }
+    delay_ms = delay_ms / 2 + (_pygear_random64(&self->random_state) % 1000) / 1000.0 * delay_ms / 2;
+    self->retries++;
+    _pygear_statshm_add(self->shm, self->shm_retries, 1);
+    if (_pygear_cooperative_enabled()) {
+        if (_pygear_cooperative_wait_fd(-1, false, _pygear_monotonic() + delay_ms / 1000.0) < 0) {
+            return -1;
+        }
+    } else {
+        Py_BEGIN_ALLOW_THREADS
+        usleep((useconds_t) (delay_ms * 1000));
+        Py_END_ALLOW_THREADS
+    }
+    return 1;
+}
+
+/*
+ * Publish the stats of the client in 'shm', or stop publishing with NULL. The
+ * counters are added to the series, so the clients of a pool can share one
+ * segment and the readers see their sums.
+ */
+static void _pygear_client_publish(pygear_ClientObject* self, pygear_statshm* shm) {
+    _pygear_statshm_decref(self->shm);
+    self->shm = shm;
+    self->shm_latency = NULL;
+    self->shm_hedges_sent = NULL;
+    self->shm_hedges_won = NULL;
+    self->shm_retries = NULL;
+    if (!shm) {
+        return;
+    }
+    _pygear_statshm_incref(shm);
+    self->shm_latency = _pygear_statshm_series(shm, "latency", STATSHM_HISTOGRAM);
+    self->shm_hedges_sent = _pygear_statshm_series(shm, "hedges_sent", STATSHM_COUNTER);
+    self->shm_hedges_won = _pygear_statshm_series(shm, "hedges_won", STATSHM_COUNTER);
+    self->shm_retries = _pygear_statshm_series(shm, "retries", STATSHM_COUNTER);
+    _pygear_statshm_merge(shm, self->shm_latency, &self->latency);
+    _pygear_statshm_add(shm, self->shm_hedges_sent, self->hedges_sent);
+    _pygear_statshm_add(shm, self->shm_hedges_won, self->hedges_won);
+    _pygear_statshm_add(shm, self->shm_retries, self->retries);
+}
+
+
+/*
+ * Give 'task' a context linked into the client, holding a new reference to
+ * 'workload' (may be NULL) and counted in the in-flight window if 'windowed'.
+ * The context is set after libgearman accepted the task, so a task that
+ * failed to be added is never freed with it.
+ * Return the context, or NULL with a python exception set.
+ */
+static pygear_task_context* _pygear_client_task_context_new(pygear_ClientObject* self,
+    gearman_task_st* task, PyObject* workload, bool windowed) {
+    pygear_task_context* context = calloc(1, sizeof(pygear_task_context));
+    if (!context) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    context->client = self;
+    context->task = task;
+    Py_XINCREF(workload);
+    context->workload = workload;
+    context->windowed = windowed;
+    context->next = self->tasks;
+    if (self->tasks) {
+        self->tasks->prev = context;
+    }
+    self->tasks = context;
+    if (windowed) {
+        self->in_flight++;
+    }
+    gearman_task_set_context(task, context);
+    return context;
+}
+
+/*
+ * Task context free function, called by libgearman whenever it frees a task:
+ * as soon as it finishes with 'free_tasks', else with the client. It may run
+ * inside run_tasks with the GIL released.
+ */
+static void _pygear_client_task_context_free(gearman_task_st* gear_task, void* context) {
+    pygear_task_context* task_context = (pygear_task_context*) context;
+    if (!task_context) {
+        return; /* internal tasks carry no context */
+    }
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    pygear_ClientObject* client = task_context->client;
+    if (task_context->windowed) {
+        client->in_flight--;
+    }
+    if (task_context->prev) {
+        task_context->prev->next = task_context->next;
+    } else {
+        client->tasks = task_context->next;
+    }
+    if (task_context->next) {
+        task_context->next->prev = task_context->prev;
+    }
+    Py_XDECREF(task_context->workload);
+    free(task_context);
+    PyGILState_Release(gstate);
+}
+
+/*
+ * Release the workloads of the tasks that finished and take them out of the
+ * in-flight window. They may not be freed yet: do and the cooperative
+ * helpers turn 'free_tasks' off while they drive run_tasks, and the user may
+ * have turned it off.
+ * Return the number of tasks left in the window.
+ */
+static int _pygear_client_reap_tasks(pygear_ClientObject* self) {
+    pygear_task_context* context;
+    for (context = self->tasks; context; context = context->next) {
+        if ((context->windowed || context->workload) && !gearman_task_is_active(context->task)) {
+            Py_CLEAR(context->workload);
+            if (context->windowed) {
+                context->windowed = false;
+                self->in_flight--;
+            }
+        }
+    }
+    return self->in_flight;
+}
+
+/*
+ * Run the queued tasks until the in-flight window has room for one more.
+ * Return 0 on success, -1 with a python exception set on failure.
+ */
+static int _pygear_client_wait_for_window(pygear_ClientObject* self) {
+    if (!self->max_in_flight || _pygear_client_reap_tasks(self) < self->max_in_flight) {
+        return 0;
+    }
+    bool was_non_blocking = gearman_client_has_option(self->g_Client, GEARMAN_CLIENT_NON_BLOCKING);
+    gearman_client_add_options(self->g_Client, GEARMAN_CLIENT_NON_BLOCKING);
+    gearman_return_t ret = GEARMAN_SUCCESS;
+    while (_pygear_client_reap_tasks(self) >= self->max_in_flight) {
+        if (_pygear_cooperative_enabled()) {
+            ret = gearman_client_run_tasks(self->g_Client);
+            if (ret == GEARMAN_IO_WAIT) {
+                ret = _pygear_cooperative_client_wait(self->g_Client);
+            }
+        } else {
+            CLIENT_BEGIN_ALLOW_THREADS(self)
+            ret = gearman_client_run_tasks(self->g_Client);
+            if (ret == GEARMAN_IO_WAIT) {
+                ret = gearman_client_wait(self->g_Client);
+            }
+            CLIENT_END_ALLOW_THREADS
+        }
+        if (ret != GEARMAN_SUCCESS && ret != GEARMAN_IO_WAIT) {
+            break;
+        }
+    }
+    if (!was_non_blocking) {
+        gearman_client_remove_options(self->g_Client, GEARMAN_CLIENT_NON_BLOCKING);
+    }
+    if (PyErr_Occurred() || _pygear_check_and_raise_exn(ret)) {
+        return -1;
+    }
+    return 0;
+}
+
+
 #define CLIENT_ADD_TASK(TASKTYPE) \
 static PyObject* pygear_client_add_task##TASKTYPE(pygear_ClientObject* self, PyObject* args, PyObject* kwargs) { \
     /* Parsing input arguments */ \
     char* function_name; \
     PyObject* workload; \
     char* unique = NULL; /* optional */ \
-    static char* kwlist[] = {"function", "workload", "unique", NULL}; \
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|s", kwlist, \
-        &function_name, &workload, &unique)) { \
+    int serialize = 1; /* optional */ \
+    static char* kwlist[] = {"function", "workload", "unique", "serialize", NULL}; \
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|si", kwlist, \
+        &function_name, &workload, &unique, &serialize)) { \
         return NULL; \
     } \
-    /* Convert python input to string */ \
-    PyObject* dumpstr = PyString_FromString("dumps"); \
-    PyObject* pickled_input = PyObject_CallMethodObjArgs( \
-        self->serializer, \
-        dumpstr, \
-        workload, \
-        NULL \
-    ); \
-    Py_XDECREF(dumpstr); \
-    if (!pickled_input) { \
+    /* Make room in the in-flight window */ \
+    if (_pygear_client_wait_for_window(self) < 0) { \
+        return NULL; \
+    } \
+    /* Serialize the workload, or take its buffers as they are */ \
+    pygear_payload payload; \
+    if (_pygear_payload_init(&payload, self->serializer, workload, serialize) < 0) { \
+        return NULL; \
+    } \
+    int envelope_size = _pygear_client_envelope(self, &payload, serialize); \
+    if (envelope_size < 0) { \
+        return NULL; \
+    } \
+    const char* workload_string = payload.data; \
+    Py_ssize_t workload_size = payload.size; \
+    char unique_buffer[PYGEAR_UNIQUE_SIZE]; \
+    unique = _pygear_client_unique(self, unique, function_name, workload_string + envelope_size, \
+        workload_size - envelope_size, unique_buffer); \
+    /* libgearman points to the workload until the task is sent, its context keeps it */ \
+    PyObject* pending = _pygear_payload_capsule(&payload); \
+    if (!pending) { \
         return NULL; \
     } \
-    char* workload_string; \
-    Py_ssize_t workload_size; \
-    PyString_AsStringAndSize(pickled_input, &workload_string, &workload_size); \
-    /* Py_XDECREF(pickled_input); */ \
-    /* dealloc pickled_input will cause error because tasks are not sented until client_run_tasks() is called */ \
     /* Call gearman_add_task function */ \
     gearman_return_t ret; \
     gearman_task_st* new_task = gearman_client_add_task##TASKTYPE( \
         self->g_Client, \
         NULL, /* task */ \
-        self, /* context */ \
+        NULL, /* context, set once the task is added */ \
         function_name, \
         unique, \
         workload_string, \
@@ -190,8 +727,17 @@ static PyObject* pygear_client_add_task##TASKTYPE(pygear_ClientObject* self, PyO
         &ret \
     ); \
     if (_pygear_check_and_raise_exn(ret)) { \
+        Py_DECREF(pending); \
         return NULL; \
     } \
+    pygear_task_context* context = _pygear_client_task_context_new(self, new_task, pending, \
+        self->max_in_flight > 0); \
+    Py_DECREF(pending); \
+    if (!context) { \
+        gearman_task_free(new_task); \
+        return NULL; \
+    } \
+    context->envelope = envelope_size > 0; \
     /* Creating new python task */ \
     PyObject *argList = Py_BuildValue("(O, O)", Py_None, Py_None); \
     pygear_TaskObject* python_task = (pygear_TaskObject*) PyObject_CallObject((PyObject *) &pygear_TaskType, argList); \
@@ -205,6 +751,7 @@ static PyObject* pygear_client_add_task##TASKTYPE(pygear_ClientObject* self, PyO
     Py_XDECREF(argList); \
     /* Return task */ \
     python_task->g_Task = new_task; \
+    python_task->envelope = context->envelope; \
     PyObject* result = Py_BuildValue("O", python_task); \
     python_task->g_Task = NULL; \
     Py_XDECREF(python_task); \
@@ -229,18 +776,23 @@ static PyObject* pygear_client_add_task_status(pygear_ClientObject* self, PyObje
     gearman_task_st* new_task = gearman_client_add_task_status(
         self->g_Client,
         NULL,
-        (void*) self,
+        NULL,
         job_handle,
         &gearman_return
     );
     if (_pygear_check_and_raise_exn(gearman_return)) {
         return NULL;
     }
+    if (!_pygear_client_task_context_new(self, new_task, NULL, false)) {
+        gearman_task_free(new_task);
+        return NULL;
+    }
     pygear_TaskObject* python_task = (pygear_TaskObject*) _PyObject_New(&pygear_TaskType);
     if (!python_task){
         return NULL;
     }
     python_task->g_Task = new_task;
+    python_task->envelope = false;
     PyObject* ret = Py_BuildValue("O", python_task);
     Py_XDECREF(python_task);
     return ret;
@@ -267,7 +819,47 @@ static PyObject* pygear_client_clone(pygear_ClientObject* self) {
     PyObject* ret = NULL;
     argList = Py_BuildValue("(O, O)", Py_None, Py_None);
     python_client = (pygear_ClientObject*) PyObject_CallObject((PyObject *) &pygear_ClientType, argList);
+    if (!python_client) {
+        Py_XDECREF(argList);
+        return NULL;
+    }
+    gearman_client_free(python_client->g_Client);
     python_client->g_Client = gearman_client_clone(NULL, self->g_Client);
+    gearman_client_set_task_context_free_fn(python_client->g_Client, _pygear_client_task_context_free);
+    if (self->window_free_tasks) {
+        // The clone has no window, the option was not the user's
+        gearman_client_remove_options(python_client->g_Client, GEARMAN_CLIENT_FREE_TASKS);
+    }
+    if (_pygear_router_copy(&python_client->router, &self->router) < 0) {
+        Py_XDECREF(argList);
+        Py_XDECREF(python_client);
+        return NULL;
+    }
+    python_client->hedge_budget = self->hedge_budget;
+    python_client->retry_attempts = self->retry_attempts;
+    python_client->retry_backoff_ms = self->retry_backoff_ms;
+    python_client->retry_max_backoff_ms = self->retry_max_backoff_ms;
+    python_client->retry_cooloff_ms = self->retry_cooloff_ms;
+    memcpy(python_client->retry_on, self->retry_on, sizeof(self->retry_on));
+    python_client->unique_strategy = self->unique_strategy;
+    python_client->envelope = self->envelope;
+    python_client->envelope_deadline_ms = self->envelope_deadline_ms;
+    python_client->trace = self->trace;
+    pygear_cache* cache;
+    for (cache = self->result_caches; cache; cache = cache->next) {
+        pygear_cache* copy = _pygear_cache_new(cache->function_name, 0, cache->max_bytes);
+        if (!copy) {
+            Py_XDECREF(argList);
+            Py_XDECREF(python_client);
+            return PyErr_NoMemory();
+        }
+        copy->ttl = cache->ttl;
+        copy->next = python_client->result_caches;
+        python_client->result_caches = copy;
+    }
+    Py_INCREF(self->serializer);
+    Py_XDECREF(python_client->serializer);
+    python_client->serializer = self->serializer;
     ret = Py_BuildValue("O", python_client);
     Py_XDECREF(argList);
     Py_XDECREF(python_client);
@@ -282,54 +874,241 @@ static PyObject* pygear_client_do##DOTYPE(pygear_ClientObject* self, PyObject* a
     PyObject* workload; \
     Py_ssize_t workload_size; \
     char* unique = NULL;  /* optional */ \
-    static char* kwlist[] = {"function", "workload", "unique", NULL}; \
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|s", kwlist, \
-        &function_name, &workload, &unique)) { \
+    char* routing_key = NULL;  /* optional */ \
+    int hedge_after_ms = -1;  /* optional */ \
+    int raw = 0;  /* optional */ \
+    int serialize = 1;  /* optional */ \
+    int timings = 0;  /* optional */ \
+    static char* kwlist[] = {"function", "workload", "unique", "routing_key", "hedge_after_ms", "raw", \
+        "serialize", "timings", NULL}; \
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|sziiii", kwlist, \
+        &function_name, &workload, &unique, &routing_key, &hedge_after_ms, &raw, &serialize, &timings)) { \
         return NULL; \
     } \
-    /* Convert python input to string */ \
-    PyObject* dumpstr = PyString_FromString("dumps"); \
-    PyObject* pickled_input = PyObject_CallMethodObjArgs( \
-        self->serializer, \
-        dumpstr, \
-        workload, \
-        NULL \
-    ); \
-    Py_XDECREF(dumpstr); \
-    char* workload_string; \
-    PyString_AsStringAndSize(pickled_input, &workload_string, &workload_size); \
-    /* Call gearman_do function */ \
+    pygear_client_timings call_timings = {_pygear_monotonic(), _pygear_envelope_now_us(), 0, 0, 0, 0}; \
+    /* Serialize the workload, or take its buffers as they are */ \
+    pygear_payload payload; \
+    if (_pygear_payload_init(&payload, self->serializer, workload, serialize) < 0) { \
+        return NULL; \
+    } \
+    /* Unique keys, cache keys and routing ignore the envelope */ \
+    int envelope_size = _pygear_client_envelope(self, &payload, serialize); \
+    if (envelope_size < 0) { \
+        return NULL; \
+    } \
+    call_timings.serialized = _pygear_monotonic(); \
+    /* Spans are recorded once over, so that early returns leave none open */ \
+    if (self->trace) { \
+        _pygear_trace("client", "encode", 'B', function_name, call_timings.start); \
+        _pygear_trace("client", "encode", 'E', NULL, call_timings.serialized); \
+    } \
+    const char* workload_string = payload.data; \
+    workload_size = payload.size; \
+    const char* bare_workload = workload_string + envelope_size; \
+    size_t bare_size = workload_size - envelope_size; \
+    char unique_buffer[PYGEAR_UNIQUE_SIZE]; \
+    unique = _pygear_client_unique(self, unique, function_name, bare_workload, bare_size, unique_buffer); \
     size_t result_size; \
-    gearman_return_t ret; \
-    void* work_result = gearman_client_do##DOTYPE( \
-        self->g_Client, \
-        function_name, \
-        unique, \
-        workload_string, \
-        workload_size, \
-        &result_size, \
-        &ret); /* work_result must be freed later to avoid memory leak */ \
-    Py_XDECREF(pickled_input); /* safely dealloc workload */ \
+    gearman_return_t ret = GEARMAN_SUCCESS; \
+    void* work_result = NULL; /* work_result must be freed later to avoid memory leak */ \
+    /* Serve the result from the cache if the function has one */ \
+    pygear_cache* cache = _pygear_cache_find(self->result_caches, function_name); \
+    uint64_t cache_key[2]; \
+    bool cache_hit = false; \
+    uint8_t cache_codec = ENVELOPE_CODEC_LOCAL; \
+    if (cache) { \
+        _pygear_hash_job(function_name, bare_workload, bare_size, cache_key); \
+        cache_hit = _pygear_cache_get(cache, cache_key, &work_result, &result_size, &cache_codec); \
+    } \
+    /* Call gearman_do function, as many times as the retry policy allows */ \
+    hedge_after_ms = cache_hit ? -1 : _pygear_client_hedge_delay(self, hedge_after_ms); \
+    int attempt; \
+    for (attempt = 1; !cache_hit; ++attempt) { \
+        /* Pick the server */ \
+        int server; \
+        gearman_client_st* g_Client = _pygear_client_route(self, routing_key, unique, \
+            function_name, bare_workload, bare_size, &server); \
+        if (!g_Client) { \
+            _pygear_payload_release(&payload); \
+            return NULL; \
+        } \
+        double started = _pygear_monotonic(); \
+        call_timings.submitted = started; \
+        if (hedge_after_ms >= 0) { \
+            bool cooperative = _pygear_cooperative_enabled(); \
+            bool hedged, hedge_won; \
+            if (cooperative) { \
+                work_result = _pygear_client_do_hedged(g_Client, gearman_client_add_task##DOTYPE, \
+                    function_name, unique, workload_string, workload_size, hedge_after_ms, true, \
+                    &hedged, &hedge_won, &result_size, &ret); \
+            } else { \
+                CLIENT_BEGIN_ALLOW_THREADS(self) \
+                work_result = _pygear_client_do_hedged(g_Client, gearman_client_add_task##DOTYPE, \
+                    function_name, unique, workload_string, workload_size, hedge_after_ms, false, \
+                    &hedged, &hedge_won, &result_size, &ret); \
+                CLIENT_END_ALLOW_THREADS \
+            } \
+            self->hedges_sent += hedged; \
+            self->hedges_won += hedge_won; \
+            _pygear_statshm_add(self->shm, self->shm_hedges_sent, hedged); \
+            _pygear_statshm_add(self->shm, self->shm_hedges_won, hedge_won); \
+            if (PyErr_Occurred()) { \
+                _pygear_payload_release(&payload); \
+                free(work_result); \
+                return NULL; \
+            } \
+        } else if (_pygear_cooperative_enabled()) { \
+            work_result = _pygear_cooperative_client_do( \
+                g_Client, \
+                gearman_client_add_task##DOTYPE, \
+                function_name, \
+                unique, \
+                workload_string, \
+                workload_size, \
+                &result_size, \
+                NULL, \
+                &ret); \
+            if (PyErr_Occurred()) { \
+                _pygear_payload_release(&payload); \
+                free(work_result); \
+                return NULL; \
+            } \
+        } else { \
+            CLIENT_BEGIN_ALLOW_THREADS(self) \
+            work_result = gearman_client_do##DOTYPE( \
+                g_Client, \
+                function_name, \
+                unique, \
+                workload_string, \
+                workload_size, \
+                &result_size, \
+                &ret); \
+            CLIENT_END_ALLOW_THREADS \
+        } \
+        if (ret == GEARMAN_SUCCESS) { \
+            double elapsed = _pygear_monotonic() - started; \
+            _pygear_histogram_record(&self->latency, elapsed); \
+            _pygear_statshm_record(self->shm, self->shm_latency, elapsed); \
+            if (server >= 0) { \
+                _pygear_router_observe(&self->router, server, elapsed); \
+            } \
+            break; \
+        } \
+        int retry = _pygear_client_retry(self, ret, attempt, server); \
+        if (retry < 0) { \
+            _pygear_payload_release(&payload); \
+            free(work_result); \
+            return NULL; \
+        } \
+        if (!retry) { \
+            break; \
+        } \
+        free(work_result); \
+        work_result = NULL; \
+    } \
+    call_timings.received = _pygear_monotonic(); \
+    if (self->trace && !cache_hit) { \
+        _pygear_trace("client", "submit", 'B', function_name, call_timings.submitted); \
+        _pygear_trace("client", "submit", 'E', NULL, call_timings.received); \
+    } \
+    _pygear_payload_release(&payload); \
     if (_pygear_check_and_raise_exn(ret)) { \
         free(work_result); \
         return NULL; \
     } \
-    /* Convert result to python format */ \
-    PyObject* py_result = Py_BuildValue("s#", work_result, result_size); \
-    free(work_result); \
-    if (py_result == Py_None) { \
-        Py_XDECREF(py_result); \
-        Py_RETURN_NONE; \
+    /* Only requests sent in an envelope get replies in one */ \
+    pygear_envelope result_envelope; \
+    size_t result_envelope_size = envelope_size && !cache_hit ? \
+        _pygear_envelope_parse(work_result, result_size, &result_envelope) : 0; \
+    if (cache_hit) { \
+        memset(&result_envelope, 0, sizeof(result_envelope)); \
+        result_envelope.codec = cache_codec; \
+    } else if (cache) { \
+        /* Stored bare with its codec, so that a hit decodes however the call was sent */ \
+        _pygear_cache_put(cache, cache_key, (char*) work_result + result_envelope_size, \
+            result_size - result_envelope_size, \
+            result_envelope_size ? result_envelope.codec : ENVELOPE_CODEC_LOCAL); \
     } \
-    PyObject* ret_dict = PyObject_CallMethod(self->serializer, "loads", "O", py_result); \
-    Py_XDECREF(py_result); \
-    return ret_dict; \
+    bool result_codec = cache_hit || result_envelope_size; \
+    PyObject* ret_dict; \
+    if (!work_result) { \
+        Py_INCREF(Py_None); \
+        ret_dict = Py_None; \
+    } else if (raw) { \
+        /* A raw result is handed over as is, the view frees it */ \
+        ret_dict = _pygear_view_new((char*) work_result + result_envelope_size, \
+            result_size - result_envelope_size, work_result); \
+        if (!ret_dict) { \
+            free(work_result); \
+        } \
+    } else { \
+        /* Convert result to python format */ \
+        ret_dict = _pygear_envelope_loads(result_codec ? &result_envelope : NULL, \
+            self->serializer, (char*) work_result + result_envelope_size, result_size - result_envelope_size); \
+        free(work_result); \
+    } \
+    call_timings.deserialized = _pygear_monotonic(); \
+    if (self->trace) { \
+        _pygear_trace("client", "decode", 'B', function_name, call_timings.received); \
+        _pygear_trace("client", "decode", 'E', NULL, call_timings.deserialized); \
+        if (ret_dict) { \
+            _pygear_trace("client", "complete", 'i', function_name, call_timings.deserialized); \
+        } \
+    } \
+    if (!ret_dict || !timings) { \
+        return ret_dict; \
+    } \
+    if (cache_hit) { \
+        call_timings.submitted = 0; \
+    } \
+    /* A cached reply carries the times of the worker that ran the job back then */ \
+    bool worker_reply = result_envelope_size && (result_envelope.flags & ENVELOPE_FLAG_REPLY) && !cache_hit; \
+    PyObject* timings_dict = _pygear_client_timings(&call_timings, worker_reply ? &result_envelope : NULL); \
+    if (!timings_dict) { \
+        Py_DECREF(ret_dict); \
+        return NULL; \
+    } \
+    return Py_BuildValue("(NN)", ret_dict, timings_dict); \
 }
 
 CLIENT_DO()
 CLIENT_DO(_high)
 CLIENT_DO(_low)
 
+
+static PyObject* pygear_client_do_stream(pygear_ClientObject* self, PyObject* args, PyObject* kwargs) {
+    char* function_name;
+    PyObject* workload;
+    char* unique = NULL;
+    char* routing_key = NULL;
+    static char* kwlist[] = {"function", "workload", "unique", "routing_key", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|sz", kwlist,
+        &function_name, &workload, &unique, &routing_key)) {
+        return NULL;
+    }
+    PyObject* pickled_input = PyObject_CallMethod(self->serializer, "dumps", "O", workload);
+    if (!pickled_input) {
+        return NULL;
+    }
+    if (!PyString_Check(pickled_input)) {
+        Py_DECREF(pickled_input);
+        PyErr_SetString(PyExc_TypeError, "Serializer 'dumps' must return a string");
+        return NULL;
+    }
+    char unique_buffer[PYGEAR_UNIQUE_SIZE];
+    unique = _pygear_client_unique(self, unique, function_name, PyString_AS_STRING(pickled_input),
+        PyString_GET_SIZE(pickled_input), unique_buffer);
+    int server;
+    gearman_client_st* g_Client = _pygear_client_route(self, routing_key, unique, function_name,
+        PyString_AS_STRING(pickled_input), PyString_GET_SIZE(pickled_input), &server);
+    PyObject* stream = NULL;
+    if (g_Client) {
+        stream = _pygear_stream_new((PyObject*) self, g_Client, function_name, unique, pickled_input);
+    }
+    Py_DECREF(pickled_input);
+    return stream;
+}
+
 #define CLIENT_DO_BACKGROUND(DOTYPE) \
 static PyObject* pygear_client_do##DOTYPE##_background(pygear_ClientObject* self, PyObject* args, PyObject* kwargs) { \
     /* Parsing input arguments */ \
@@ -337,33 +1116,85 @@ static PyObject* pygear_client_do##DOTYPE##_background(pygear_ClientObject* self
     PyObject* workload; \
     Py_ssize_t workload_size; \
     char* unique = NULL; /* optional */ \
-    static char* kwlist[] = {"function", "workload", "unique", NULL}; \
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|s", kwlist, \
-        &function_name, &workload, &unique)) { \
+    char* routing_key = NULL; /* optional */ \
+    int serialize = 1; /* optional */ \
+    static char* kwlist[] = {"function", "workload", "unique", "routing_key", "serialize", NULL}; \
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|szi", kwlist, \
+        &function_name, &workload, &unique, &routing_key, &serialize)) { \
         return NULL; \
     } \
-    /* Convert python input to string */ \
-    PyObject* dumpstr = PyString_FromString("dumps"); \
-    PyObject* pickled_input = PyObject_CallMethodObjArgs( \
-        self->serializer, \
-        dumpstr, \
-        workload, \
-        NULL \
-    ); \
-    Py_XDECREF(dumpstr); \
-    char* workload_string; \
-    PyString_AsStringAndSize(pickled_input, &workload_string, &workload_size); \
-    /* Call libgearman function */ \
+    /* Serialize the workload, or take its buffers as they are */ \
+    pygear_payload payload; \
+    if (_pygear_payload_init(&payload, self->serializer, workload, serialize) < 0) { \
+        return NULL; \
+    } \
+    /* Unique keys, cache keys and routing ignore the envelope */ \
+    int envelope_size = _pygear_client_envelope(self, &payload, serialize); \
+    if (envelope_size < 0) { \
+        return NULL; \
+    } \
+    const char* workload_string = payload.data; \
+    workload_size = payload.size; \
+    const char* bare_workload = workload_string + envelope_size; \
+    size_t bare_size = workload_size - envelope_size; \
+    char unique_buffer[PYGEAR_UNIQUE_SIZE]; \
+    unique = _pygear_client_unique(self, unique, function_name, bare_workload, bare_size, unique_buffer); \
+    /* Call libgearman function, as many times as the retry policy allows */ \
     char* job_handle = malloc(sizeof(char) * GEARMAN_JOB_HANDLE_SIZE); \
-    gearman_return_t work_result = gearman_client_do##DOTYPE##_background( \
-        self->g_Client, \
-        function_name, \
-        unique, \
-        workload_string, \
-        workload_size, \
-        job_handle \
-    ); \
-    Py_XDECREF(pickled_input); /* safely dealloc workload */ \
+    gearman_return_t work_result; \
+    int attempt; \
+    for (attempt = 1; ; ++attempt) { \
+        /* Pick the server */ \
+        int server; \
+        gearman_client_st* g_Client = _pygear_client_route(self, routing_key, unique, \
+            function_name, bare_workload, bare_size, &server); \
+        if (!g_Client) { \
+            _pygear_payload_release(&payload); \
+            free(job_handle); \
+            return NULL; \
+        } \
+        if (_pygear_cooperative_enabled()) { \
+            _pygear_cooperative_client_do( \
+                g_Client, \
+                gearman_client_add_task##DOTYPE##_background, \
+                function_name, \
+                unique, \
+                workload_string, \
+                workload_size, \
+                NULL, \
+                job_handle, \
+                &work_result); \
+            if (PyErr_Occurred()) { \
+                _pygear_payload_release(&payload); \
+                free(job_handle); \
+                return NULL; \
+            } \
+        } else { \
+            CLIENT_BEGIN_ALLOW_THREADS(self) \
+            work_result = gearman_client_do##DOTYPE##_background( \
+                g_Client, \
+                function_name, \
+                unique, \
+                workload_string, \
+                workload_size, \
+                job_handle \
+            ); \
+            CLIENT_END_ALLOW_THREADS \
+        } \
+        if (work_result == GEARMAN_SUCCESS) { \
+            break; \
+        } \
+        int retry = _pygear_client_retry(self, work_result, attempt, server); \
+        if (retry < 0) { \
+            _pygear_payload_release(&payload); \
+            free(job_handle); \
+            return NULL; \
+        } \
+        if (!retry) { \
+            break; \
+        } \
+    } \
+    _pygear_payload_release(&payload); \
     if (_pygear_check_and_raise_exn(work_result)) { \
         free(job_handle); \
         return NULL; \
@@ -380,6 +1211,143 @@ CLIENT_DO_BACKGROUND()
 CLIENT_DO_BACKGROUND(_high)
 CLIENT_DO_BACKGROUND(_low)
 
+static PyObject* pygear_client_submit_background_async(pygear_ClientObject* self, PyObject* args, PyObject* kwargs) {
+    char* function_name;
+    PyObject* workload;
+    char* unique = NULL; /* optional */
+    static char* kwlist[] = {"function", "workload", "unique", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|z", kwlist,
+        &function_name, &workload, &unique)) {
+        return NULL;
+    }
+    if (!self->submitter) {
+        self->submitter = _pygear_submitter_create((PyObject*) self, self->g_Client,
+            self->async_capacity, self->async_batch_size, self->async_interval_ms);
+        if (!self->submitter) {
+            return NULL;
+        }
+    }
+    PyObject* dumpstr = PyString_FromString("dumps");
+    PyObject* pickled_input = PyObject_CallMethodObjArgs(self->serializer, dumpstr, workload, NULL);
+    Py_XDECREF(dumpstr);
+    if (!pickled_input) {
+        return NULL;
+    }
+    char* workload_string;
+    Py_ssize_t workload_size;
+    if (PyString_AsStringAndSize(pickled_input, &workload_string, &workload_size) == -1) {
+        Py_DECREF(pickled_input);
+        return NULL;
+    }
+    char unique_buffer[PYGEAR_UNIQUE_SIZE];
+    unique = _pygear_client_unique(self, unique, function_name, workload_string, workload_size, unique_buffer);
+    pygear_submitter_item* item = calloc(1, sizeof(pygear_submitter_item));
+    if (item) {
+        item->add_task = gearman_client_add_task_background;
+        item->function_name = strdup(function_name);
+        item->unique = (unique ? strdup(unique) : NULL);
+        item->workload = malloc(workload_size ? workload_size : 1);
+        item->workload_size = workload_size;
+    }
+    if (!item || !item->function_name || (unique && !item->unique) || !item->workload) {
+        _pygear_submitter_item_free(item);
+        Py_DECREF(pickled_input);
+        return PyErr_NoMemory();
+    }
+    memcpy(item->workload, workload_string, workload_size);
+    Py_DECREF(pickled_input);
+    bool queued;
+    int timeout = gearman_client_timeout(self->g_Client);
+    Py_BEGIN_ALLOW_THREADS
+    queued = _pygear_submitter_push(self->submitter, item, timeout);
+    Py_END_ALLOW_THREADS
+    if (!queued) {
+        _pygear_submitter_item_free(item);
+        PyErr_SetString(PyGearExn_TIMEOUT, "Background submission queue is full");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_client_flush(pygear_ClientObject* self, PyObject* args) {
+    int timeout = gearman_client_timeout(self->g_Client);
+    if (!PyArg_ParseTuple(args, "|i", &timeout)) {
+        return NULL;
+    }
+    if (!self->submitter) {
+        Py_RETURN_NONE;
+    }
+    bool flushed;
+    Py_BEGIN_ALLOW_THREADS
+    flushed = _pygear_submitter_flush(self->submitter, timeout);
+    Py_END_ALLOW_THREADS
+    if (!flushed) {
+        PyErr_SetString(PyGearExn_TIMEOUT, "TIMEOUT");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_client_set_async_options(pygear_ClientObject* self, PyObject* args, PyObject* kwargs) {
+    Py_ssize_t batch_size = self->async_batch_size;
+    int flush_interval = self->async_interval_ms;
+    Py_ssize_t capacity = self->async_capacity;
+    static char* kwlist[] = {"batch_size", "flush_interval", "capacity", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|nin", kwlist,
+        &batch_size, &flush_interval, &capacity)) {
+        return NULL;
+    }
+    if (self->submitter) {
+        PyErr_SetString(PyGearExn_ERROR, "Async options must be set before the first submit_background_async");
+        return NULL;
+    }
+    if (batch_size <= 0 || capacity <= 0 || flush_interval < 0) {
+        PyErr_SetString(PyExc_ValueError, "batch_size and capacity must be positive, flush_interval not negative");
+        return NULL;
+    }
+    self->async_batch_size = batch_size;
+    self->async_interval_ms = flush_interval;
+    self->async_capacity = capacity;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_client_set_async_fail_fn(pygear_ClientObject* self, PyObject* args) {
+    PyObject* callback;
+    if (!PyArg_ParseTuple(args, "O", &callback)) {
+        return NULL;
+    }
+    if (callback == Py_None) {
+        Py_CLEAR(self->cb_async_fail);
+        Py_RETURN_NONE;
+    }
+    Py_INCREF(callback);
+    Py_XDECREF(self->cb_async_fail);
+    self->cb_async_fail = callback;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_client_async_stats(pygear_ClientObject* self) {
+    unsigned long long queued = 0, delivered = 0, failed = 0;
+    if (self->submitter) {
+        pthread_mutex_lock(&self->submitter->lock);
+        queued = self->submitter->enqueued - self->submitter->completed;
+        delivered = self->submitter->delivered;
+        failed = self->submitter->failed;
+        pthread_mutex_unlock(&self->submitter->lock);
+    }
+    return Py_BuildValue(
+        "{s:K, s:K, s:K}",
+        "queued", queued,
+        "delivered", delivered,
+        "failed", failed
+    );
+}
+
+
 static PyObject* pygear_client_do_job_handle(pygear_ClientObject* self) {
     return Py_BuildValue("s", gearman_client_do_job_handle(self->g_Client));
 }
@@ -521,13 +1489,25 @@ static PyObject* pygear_client_job_status(pygear_ClientObject* self, PyObject* a
     if (!PyArg_ParseTuple(args, "s", &job_handle)) {
         return NULL;
     }
-    gearman_return_t result = gearman_client_job_status(
-        self->g_Client,
-        job_handle,
-        &is_known, &is_running,
-        &numerator, &denominator
-    );
-    if (_pygear_check_and_raise_exn(result)) {
+    gearman_return_t result;
+    if (_pygear_cooperative_enabled()) {
+        result = _pygear_cooperative_client_job_status(
+            self->g_Client,
+            job_handle,
+            &is_known, &is_running,
+            &numerator, &denominator
+        );
+    } else {
+        CLIENT_BEGIN_ALLOW_THREADS(self)
+        result = gearman_client_job_status(
+            self->g_Client,
+            job_handle,
+            &is_known, &is_running,
+            &numerator, &denominator
+        );
+        CLIENT_END_ALLOW_THREADS
+    }
+    if (PyErr_Occurred() || _pygear_check_and_raise_exn(result)) {
         return NULL;
     }
     PyObject* status_dict = Py_BuildValue(
@@ -543,13 +1523,44 @@ static PyObject* pygear_client_job_status(pygear_ClientObject* self, PyObject* a
 
 static PyObject* pygear_client_remove_servers(pygear_ClientObject* self) {
     gearman_client_remove_servers(self->g_Client);
+    _pygear_router_clear(&self->router);
     Py_RETURN_NONE;
 }
 
 
+static PyObject* pygear_client_remove_server(pygear_ClientObject* self, PyObject* args) {
+    char* host;
+    int port;
+    if (!PyArg_ParseTuple(args, "si", &host, &port)) {
+        return NULL;
+    }
+    if (port <= 0) {
+        port = GEARMAN_DEFAULT_TCP_PORT;
+    }
+    if (!_pygear_router_remove(&self->router, host, port)) {
+        Py_RETURN_FALSE;
+    }
+    // libgearman can only drop all servers, add back the ones that remain
+    gearman_client_remove_servers(self->g_Client);
+    size_t i;
+    for (i = 0; i < self->router.num_servers; ++i) {
+        gearman_return_t result = gearman_client_add_server(self->g_Client,
+            self->router.servers[i].host, self->router.servers[i].port);
+        if (_pygear_check_and_raise_exn(result)) {
+            return NULL;
+        }
+    }
+    Py_RETURN_TRUE;
+}
+
+
 static PyObject* pygear_client_run_tasks(pygear_ClientObject* self) {
-    gearman_return_t result = gearman_client_run_tasks(self->g_Client);
-    if (_pygear_check_and_raise_exn(result)) {
+    gearman_return_t result = (_pygear_cooperative_enabled() ?
+        _pygear_cooperative_client_run_tasks(self->g_Client) :
+        gearman_client_run_tasks(self->g_Client));
+    // Finished tasks that were not freed let go of their workloads
+    _pygear_client_reap_tasks(self);
+    if (PyErr_Occurred() || _pygear_check_and_raise_exn(result)) {
         return NULL;
     }
     Py_RETURN_NONE;
@@ -557,8 +1568,9 @@ static PyObject* pygear_client_run_tasks(pygear_ClientObject* self) {
 
 
 #define CALLBACK_WRAPPER(CB) gearman_return_t pygear_client_wrap_callback_##CB(gearman_task_st* gear_task) { \
-    pygear_ClientObject* client = (pygear_ClientObject*) gearman_task_context(gear_task); \
-    if (!client->cb_##CB) { \
+    pygear_task_context* context = (pygear_task_context*) gearman_task_context(gear_task); \
+    pygear_ClientObject* client = context ? context->client : NULL; \
+    if (!client || !client->cb_##CB) { /* internal tasks carry no context */ \
         return GEARMAN_SUCCESS; \
     } \
     /* Need to lock the GIL to avoid undefined behaviour */ \
@@ -575,6 +1587,7 @@ static PyObject* pygear_client_run_tasks(pygear_ClientObject* self) {
         return GEARMAN_ERROR; \
     } \
     python_task->g_Task = gear_task; \
+    python_task->envelope = context->envelope; \
     PyObject* callback_return = PyObject_CallFunction(client->cb_##CB, "O", python_task); \
     if (!callback_return) { \
         if (PyErr_Occurred()) { \
@@ -583,7 +1596,7 @@ static PyObject* pygear_client_run_tasks(pygear_ClientObject* self) {
     } \
     /* Release the thread */ \
     Py_XDECREF(argList); \
-    python_task->g_Task = NULL; \
+    _pygear_task_detach(python_task); \
     Py_XDECREF(python_task); \
     Py_XDECREF(method_result); \
     Py_XDECREF(callback_return); \
@@ -672,9 +1685,348 @@ static PyObject* pygear_client_set_options(pygear_ClientObject* self, PyObject*
             gearman_client_remove_options(self->g_Client, options_t_value[i]);
         }
     }
+    // free_tasks is the user's choice from now on, see set_max_in_flight
+    self->window_free_tasks = false;
+    _pygear_router_reset_connections(&self->router);
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_client_set_max_in_flight(pygear_ClientObject* self, PyObject* args) {
+    int max_in_flight;
+    if (!PyArg_ParseTuple(args, "i", &max_in_flight)) {
+        return NULL;
+    }
+    if (max_in_flight < 0) {
+        PyErr_SetString(PyExc_ValueError, "max_in_flight must not be negative");
+        return NULL;
+    }
+    if (max_in_flight && !self->max_in_flight) {
+        // Finished tasks are freed as they go, so memory stays bounded too
+        if (!gearman_client_has_option(self->g_Client, GEARMAN_CLIENT_FREE_TASKS)) {
+            gearman_client_add_options(self->g_Client, GEARMAN_CLIENT_FREE_TASKS);
+            self->window_free_tasks = true;
+        }
+    } else if (!max_in_flight && self->max_in_flight) {
+        if (self->window_free_tasks) {
+            gearman_client_remove_options(self->g_Client, GEARMAN_CLIENT_FREE_TASKS);
+            self->window_free_tasks = false;
+        }
+        // Tasks still pending no longer count, should a window come back
+        pygear_task_context* context;
+        for (context = self->tasks; context; context = context->next) {
+            context->windowed = false;
+        }
+        self->in_flight = 0;
+    }
+    self->max_in_flight = max_in_flight;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_client_max_in_flight(pygear_ClientObject* self) {
+    return Py_BuildValue("i", self->max_in_flight);
+}
+
+
+static const char* pygear_routing_names[] = {"default", "hash", "least_loaded", NULL};
+
+static PyObject* pygear_client_set_routing(pygear_ClientObject* self, PyObject* args) {
+    char* mode;
+    int probe_interval = ROUTER_DEFAULT_PROBE_INTERVAL_MS;
+    if (!PyArg_ParseTuple(args, "s|i", &mode, &probe_interval)) {
+        return NULL;
+    }
+    if (probe_interval <= 0) {
+        PyErr_SetString(PyExc_ValueError, "probe_interval must be positive");
+        return NULL;
+    }
+    int i;
+    for (i = 0; pygear_routing_names[i]; ++i) {
+        if (!strcmp(mode, pygear_routing_names[i])) {
+            break;
+        }
+    }
+    if (!pygear_routing_names[i]) {
+        PyErr_Format(PyExc_ValueError, "Unknown routing mode '%s'", mode);
+        return NULL;
+    }
+    if (i == PYGEAR_ROUTING_LEAST_LOADED) {
+        if (_pygear_router_start_probe(&self->router, probe_interval) < 0) {
+            return NULL;
+        }
+    } else {
+        Py_BEGIN_ALLOW_THREADS
+        _pygear_router_stop_probe(&self->router);
+        Py_END_ALLOW_THREADS
+    }
+    self->router.mode = (pygear_routing_mode) i;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_client_routing(pygear_ClientObject* self) {
+    return PyString_FromString(pygear_routing_names[self->router.mode]);
+}
+
+
+static PyObject* pygear_client_server_for(pygear_ClientObject* self, PyObject* args) {
+    char* routing_key;
+    int routing_key_size;
+    if (!PyArg_ParseTuple(args, "s#", &routing_key, &routing_key_size)) {
+        return NULL;
+    }
+    int server = _pygear_router_pick(&self->router, _pygear_hash64(routing_key, routing_key_size, 0));
+    if (server < 0) {
+        _pygear_check_and_raise_exn(GEARMAN_NO_SERVERS);
+        return NULL;
+    }
+    return PyString_FromString(self->router.servers[server].name);
+}
+
+
+static PyObject* pygear_client_routing_stats(pygear_ClientObject* self) {
+    return _pygear_router_stats(&self->router);
+}
+
+
+static PyObject* pygear_client_set_hedge_budget(pygear_ClientObject* self, PyObject* args) {
+    double percent;
+    if (!PyArg_ParseTuple(args, "d", &percent)) {
+        return NULL;
+    }
+    if (percent < 0 || percent > 100) {
+        PyErr_SetString(PyExc_ValueError, "Hedge budget must be between 0 and 100 percent");
+        return NULL;
+    }
+    self->hedge_budget = percent;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_client_hedge_stats(pygear_ClientObject* self) {
+    return Py_BuildValue("{s:K,s:K,s:K}",
+        "requests", self->hedge_requests,
+        "hedged", self->hedges_sent,
+        "won", self->hedges_won);
+}
+
+
+static PyObject* pygear_client_latency_stats(pygear_ClientObject* self) {
+    return _pygear_histogram_summary(&self->latency);
+}
+
+
+static const char* pygear_unique_strategy_names[] = {"none", "content", "random", NULL};
+
+static PyObject* pygear_client_set_unique_strategy(pygear_ClientObject* self, PyObject* args) {
+    char* strategy;
+    if (!PyArg_ParseTuple(args, "s", &strategy)) {
+        return NULL;
+    }
+    int i;
+    for (i = 0; pygear_unique_strategy_names[i]; ++i) {
+        if (!strcmp(strategy, pygear_unique_strategy_names[i])) {
+            self->unique_strategy = (pygear_unique_strategy) i;
+            Py_RETURN_NONE;
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "Unknown unique strategy '%s'", strategy);
+    return NULL;
+}
+
+
+static PyObject* pygear_client_unique_strategy(pygear_ClientObject* self) {
+    return PyString_FromString(pygear_unique_strategy_names[self->unique_strategy]);
+}
+
+
+static PyObject* pygear_client_set_envelope(pygear_ClientObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject* enabled;
+    int deadline_ms = 0;
+    static char* kwlist[] = {"enabled", "deadline_ms", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", kwlist, &enabled, &deadline_ms)) {
+        return NULL;
+    }
+    int truth = PyObject_IsTrue(enabled);
+    if (truth < 0) {
+        return NULL;
+    }
+    if (deadline_ms < 0) {
+        PyErr_SetString(PyExc_ValueError, "deadline_ms must not be negative");
+        return NULL;
+    }
+    self->envelope = truth;
+    self->envelope_deadline_ms = deadline_ms;
     Py_RETURN_NONE;
 }
 
+static PyObject* pygear_client_envelope(pygear_ClientObject* self) {
+    return PyBool_FromLong(self->envelope);
+}
+
+static PyObject* pygear_client_set_trace(pygear_ClientObject* self, PyObject* args) {
+    PyObject* enabled;
+    if (!PyArg_ParseTuple(args, "O", &enabled)) {
+        return NULL;
+    }
+    int truth = PyObject_IsTrue(enabled);
+    if (truth < 0) {
+        return NULL;
+    }
+    self->trace = truth;
+    Py_RETURN_NONE;
+}
+
+static PyObject* pygear_client_trace(pygear_ClientObject* self) {
+    return PyBool_FromLong(self->trace);
+}
+
+
+static PyObject* pygear_client_enable_result_cache(pygear_ClientObject* self, PyObject* args, PyObject* kwargs) {
+    char* function_name;
+    long ttl_ms;
+    Py_ssize_t max_bytes = CACHE_DEFAULT_MAX_BYTES;
+    static char* kwlist[] = {"function", "ttl_ms", "max_bytes", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sl|n", kwlist, &function_name, &ttl_ms, &max_bytes)) {
+        return NULL;
+    }
+    if (ttl_ms <= 0 || max_bytes <= 0) {
+        PyErr_SetString(PyExc_ValueError, "ttl_ms and max_bytes must be positive");
+        return NULL;
+    }
+    pygear_cache* cache = _pygear_cache_new(function_name, ttl_ms, max_bytes);
+    if (!cache) {
+        return PyErr_NoMemory();
+    }
+    _pygear_client_free_result_caches(self, function_name);
+    cache->next = self->result_caches;
+    self->result_caches = cache;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_client_disable_result_cache(pygear_ClientObject* self, PyObject* args, PyObject* kwargs) {
+    char* function_name = NULL;
+    static char* kwlist[] = {"function", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|z", kwlist, &function_name)) {
+        return NULL;
+    }
+    _pygear_client_free_result_caches(self, function_name);
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_client_result_cache_stats(pygear_ClientObject* self) {
+    PyObject* stats = PyDict_New();
+    if (!stats) {
+        return NULL;
+    }
+    pygear_cache* cache;
+    for (cache = self->result_caches; cache; cache = cache->next) {
+        PyObject* cache_stats = _pygear_cache_stats(cache);
+        if (!cache_stats || PyDict_SetItemString(stats, cache->function_name, cache_stats) < 0) {
+            Py_XDECREF(cache_stats);
+            Py_DECREF(stats);
+            return NULL;
+        }
+        Py_DECREF(cache_stats);
+    }
+    return stats;
+}
+
+
+static PyObject* pygear_client_set_retry_policy(pygear_ClientObject* self, PyObject* args, PyObject* kwargs) {
+    int attempts = 1;
+    int backoff_ms = CLIENT_DEFAULT_RETRY_BACKOFF_MS;
+    int max_backoff_ms = CLIENT_DEFAULT_RETRY_MAX_BACKOFF_MS;
+    PyObject* retry_on_list = Py_None;
+    int cooloff_ms = CLIENT_DEFAULT_RETRY_COOLOFF_MS;
+    static char* kwlist[] = {"attempts", "backoff_ms", "max_backoff_ms", "retry_on", "cooloff_ms", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|iiiOi", kwlist,
+        &attempts, &backoff_ms, &max_backoff_ms, &retry_on_list, &cooloff_ms)) {
+        return NULL;
+    }
+    if (attempts < 1 || backoff_ms < 0 || max_backoff_ms < backoff_ms || cooloff_ms < 0) {
+        PyErr_SetString(PyExc_ValueError,
+            "attempts must be positive, backoff_ms <= max_backoff_ms and none negative");
+        return NULL;
+    }
+    char retry_on[GEARMAN_MAX_RETURN];
+    if (retry_on_list == Py_None) {
+        _pygear_client_default_retry_on(retry_on);
+    } else {
+        memset(retry_on, 0, sizeof(retry_on));
+        PyObject* iterator = PyObject_GetIter(retry_on_list);
+        if (!iterator) {
+            return NULL;
+        }
+        PyObject* item;
+        while ((item = PyIter_Next(iterator))) {
+            // Find the return code each exception class is raised for
+            bool found = false;
+            int code;
+            for (code = GEARMAN_SUCCESS + 1; code < GEARMAN_MAX_RETURN; ++code) {
+                if (!_pygear_check_and_raise_exn((gearman_return_t) code)) {
+                    continue;
+                }
+                PyObject *type, *value, *traceback;
+                PyErr_Fetch(&type, &value, &traceback);
+                if (type == item) {
+                    retry_on[code] = 1;
+                    found = true;
+                }
+                Py_XDECREF(type);
+                Py_XDECREF(value);
+                Py_XDECREF(traceback);
+            }
+            if (!found) {
+                PyErr_Format(PyExc_ValueError, "retry_on expects pygear exception classes");
+                Py_DECREF(item);
+                break;
+            }
+            Py_DECREF(item);
+        }
+        Py_DECREF(iterator);
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+    self->retry_attempts = attempts;
+    self->retry_backoff_ms = backoff_ms;
+    self->retry_max_backoff_ms = max_backoff_ms;
+    self->retry_cooloff_ms = cooloff_ms;
+    memcpy(self->retry_on, retry_on, sizeof(retry_on));
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_client_retry_stats(pygear_ClientObject* self) {
+    return Py_BuildValue("{s:K}", "retries", self->retries);
+}
+
+static PyObject* pygear_client_publish_stats(pygear_ClientObject* self, PyObject* args, PyObject* kwargs) {
+    char* name;
+    char* directory = NULL;
+    static char* kwlist[] = {"name", "directory", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|z", kwlist, &name, &directory)) {
+        return NULL;
+    }
+    if (_pygear_statshm_live(self->shm)) {
+        PyErr_SetString(PyGearExn_ERROR, "Client stats are already published");
+        return NULL;
+    }
+    // A segment inherited through fork belongs to the parent
+    _pygear_client_publish(self, NULL);
+    pygear_statshm* shm = _pygear_statshm_open(directory, "client", name);
+    if (!shm) {
+        return NULL;
+    }
+    _pygear_client_publish(self, shm);
+    _pygear_statshm_decref(shm);
+    return _pygear_statshm_path(self->shm);
+}
+
 
 static PyObject* pygear_client_set_serializer(pygear_ClientObject* self, PyObject* args) {
     PyObject* serializer;
@@ -702,6 +2054,7 @@ static PyObject* pygear_client_set_timeout(pygear_ClientObject* self, PyObject*
         return NULL;
     }
     gearman_client_set_timeout(self->g_Client, timeout);
+    _pygear_router_reset_connections(&self->router);
     Py_RETURN_NONE;
 }
 
@@ -733,8 +2086,10 @@ static PyObject* pygear_client_unique_status(pygear_ClientObject* self, PyObject
 
 
 static PyObject* pygear_client_wait(pygear_ClientObject* self) {
-    gearman_return_t result = gearman_client_wait(self->g_Client);
-    if (_pygear_check_and_raise_exn(result)) {
+    gearman_return_t result = (_pygear_cooperative_enabled() ?
+        _pygear_cooperative_client_wait(self->g_Client) :
+        gearman_client_wait(self->g_Client));
+    if (PyErr_Occurred() || _pygear_check_and_raise_exn(result)) {
         return NULL;
     }
     Py_RETURN_NONE;
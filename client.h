@@ -32,6 +32,15 @@
 #include "structmember.h"
 #include "task.h"
 #include "exception.h"
+#include "cooperative.h"
+#include "submitter.h"
+#include "router.h"
+#include "histogram.h"
+#include "cache.h"
+#include "stream.h"
+#include "envelope.h"
+#include "trace.h"
+#include "statshm.h"
 
 #ifndef PyMODINIT_FUNC
 #define PyMODINIT_FUNC void
@@ -40,6 +49,45 @@
 #ifndef CLIENT_H
 #define CLIENT_H
 
+typedef enum {
+    PYGEAR_UNIQUE_NONE,         /* jobs without unique are sent without one */
+    PYGEAR_UNIQUE_CONTENT,      /* hash of the function name and encoded workload */
+    PYGEAR_UNIQUE_RANDOM        /* 128 random bits */
+} pygear_unique_strategy;
+
+/* When a do* call got through each step, in monotonic seconds, 0 if it did not */
+typedef struct {
+    double start;
+    uint64_t start_us;          /* the same instant on the wall clock, to place worker times */
+    double serialized;
+    double submitted;           /* of the last attempt */
+    double received;
+    double deserialized;
+} pygear_client_timings;
+
+#define CLIENT_DEFAULT_HEDGE_BUDGET 10.0
+/* do* round trips recorded before 'hedge_after_ms=0' derives a delay */
+#define CLIENT_HEDGE_MIN_SAMPLES 20
+#define CLIENT_HEDGE_PERCENTILE 95.0
+
+#define CLIENT_DEFAULT_RETRY_BACKOFF_MS 50
+#define CLIENT_DEFAULT_RETRY_MAX_BACKOFF_MS 2000
+#define CLIENT_DEFAULT_RETRY_COOLOFF_MS 5000
+
+/*
+ * Around blocking libgearman calls on the client's connection. Only pooled
+ * clients release the GIL there: a pool lends each to one thread at a time,
+ * while a plain Client shared between threads relies on the GIL to serialize
+ * its calls.
+ */
+#define CLIENT_BEGIN_ALLOW_THREADS(client) { \
+    PyThreadState* _save = (client)->release_gil ? PyEval_SaveThread() : NULL;
+#define CLIENT_END_ALLOW_THREADS \
+    if (_save) { \
+        PyEval_RestoreThread(_save); \
+    } \
+}
+
 #define _CLIENTMETHOD(name,flags) {#name,(PyCFunction) pygear_client_##name,flags,pygear_client_##name##_doc},
 
 typedef struct {
@@ -54,9 +102,58 @@ typedef struct {
     PyObject* cb_exception;
     PyObject* cb_fail;
     PyObject* cb_log;
+    PyObject* cb_async_fail;
     PyObject* serializer;
+    pygear_submitter* submitter;    /* started by the first submit_background_async */
+    size_t async_capacity;
+    size_t async_batch_size;
+    int async_interval_ms;
+    int max_in_flight;              /* 0 for no limit */
+    int in_flight;                  /* windowed tasks not seen finished yet */
+    bool window_free_tasks;         /* free_tasks was turned on by set_max_in_flight */
+    struct pygear_task_context* tasks;  /* of add_task*, linked through their contexts */
+    pygear_router router;           /* servers added, and how do* picks one */
+    pygear_histogram latency;       /* successful do* round trips */
+    double hedge_budget;            /* percent of hedgeable calls that may hedge */
+    unsigned long long hedge_requests;
+    unsigned long long hedges_sent;
+    unsigned long long hedges_won;
+    int retry_attempts;             /* 1 for no retries */
+    int retry_backoff_ms;
+    int retry_max_backoff_ms;
+    int retry_cooloff_ms;           /* how long a failing server is skipped by routing */
+    char retry_on[GEARMAN_MAX_RETURN];
+    unsigned long long retries;
+    uint64_t random_state;
+    pygear_unique_strategy unique_strategy;
+    pygear_cache* result_caches;    /* linked list, one per function */
+    bool envelope;                  /* see set_envelope */
+    int envelope_deadline_ms;
+    bool trace;                     /* see set_trace */
+    pygear_statshm* shm;            /* see publish_stats, shared by a pool */
+    pygear_statshm_series* shm_latency;
+    pygear_statshm_series* shm_hedges_sent;
+    pygear_statshm_series* shm_hedges_won;
+    pygear_statshm_series* shm_retries;
+    bool release_gil;               /* pooled, see CLIENT_BEGIN_ALLOW_THREADS */
 } pygear_ClientObject;
 
+/*
+ * Context of the tasks added with add_task* and add_task_status, freed by
+ * libgearman with the task. The callbacks find the client through it, the
+ * in-flight window counts the tasks that are still active, and it keeps the
+ * workload libgearman points to until the task is done with it.
+ */
+typedef struct pygear_task_context {
+    pygear_ClientObject* client;
+    gearman_task_st* task;
+    PyObject* workload;             /* payload capsule, NULL once the task finished */
+    bool windowed;                  /* counted in the client's in_flight */
+    bool envelope;                  /* the workload was sent in an envelope */
+    struct pygear_task_context* prev;
+    struct pygear_task_context* next;
+} pygear_task_context;
+
 PyDoc_STRVAR(client_module_docstring, "Represents a Gearman client.");
 
 /* Class init methods */
@@ -65,6 +162,10 @@ int Client_traverse(pygear_ClientObject *self, visitproc visit, void *arg);
 int Client_clear(pygear_ClientObject *self);
 void Client_dealloc(pygear_ClientObject* self);
 
+/* Private methods */
+static void _pygear_client_publish(pygear_ClientObject* self, pygear_statshm* shm);
+static void _pygear_client_task_context_free(gearman_task_st* gear_task, void* context);
+
 
 /* Method definitions */
 static PyObject* pygear_client_add_server(pygear_ClientObject *self, PyObject *args);
@@ -97,7 +198,10 @@ PyDoc_STRVAR(pygear_client_add_task_doc,
 "the server during 'run_tasks'.\n"
 "@param[in] function_name - The name of the function to run.\n"
 "@param[in] workload - The workload to pass to the function when it is run.\n"
-"@param[in] unique - Optional unique job identifier, or None for a new UUID.\n\n"
+"@param[in] unique - Optional unique job identifier, or None for a new UUID.\n"
+"@param[in] serialize - Optional, True by default. If False, the workload is sent\n"
+"\tas is: a string, any object exporting a buffer, or a list of those which is\n"
+"\tjoined into one buffer.\n\n"
 "@return new Task instance on success.\n"
 "@return NULL and raises pygear exception on failure.");
 
@@ -108,7 +212,8 @@ PyDoc_STRVAR(pygear_client_add_task_background_doc,
 "waiting for the result of the task during 'run_tasks'.\n\n"
 "@param[in] function_name - The name of the function to run.\n"
 "@param[in] workload - The workload to pass to the function when it is run.\n"
-"@param[in] unique - Optional unique job identifier, or None for a new UUID.\n\n"
+"@param[in] unique - Optional unique job identifier, or None for a new UUID.\n"
+"@param[in] serialize - Optional, see 'add_task'.\n\n"
 "@return new Task instance on success.\n"
 "@return NULL and raises pygear exception on failure.");
 
@@ -153,7 +258,26 @@ PyDoc_STRVAR(pygear_client_do_doc,
 "Send a foreground task to server immediately and wait for its result (blocking).\n\n"
 "@param[in] function_name - The name of the function to run.\n"
 "@param[in] unique - Optional unique job identifier, or None for a new UUID.\n"
-"@param[in] workload - The workload to pass to the function when it is run.\n\n"
+"@param[in] workload - The workload to pass to the function when it is run.\n"
+"@param[in] routing_key - Optional key choosing the server, see 'set_routing'.\n"
+"@param[in] hedge_after_ms - Optional. If no result has arrived after this many\n"
+"\tmilliseconds, send a duplicate under another unique and return whichever\n"
+"\tresult comes first; the other one is ignored. 0 derives the delay from the\n"
+"\tp95 of past calls. Limited by 'set_hedge_budget'.\n"
+"@param[in] raw - Optional. If True, return the serialized result as a\n"
+"\tpygear.View over the buffer libgearman allocated, without copying or\n"
+"\tdeserializing it.\n"
+"@param[in] serialize - Optional, True by default. If False, the workload is sent\n"
+"\tas is: a string, any object exporting a buffer, or a list of those which is\n"
+"\tjoined into one buffer.\n"
+"@param[in] timings - Optional, False by default. If True, return a tuple of\n"
+"\tthe result and a dict of when the call got through each step, in seconds\n"
+"\tof the monotonic clock: 'start', 'serialized', 'submitted' (None for a\n"
+"\tcached result), 'received' and 'deserialized'. If the workload was sent in\n"
+"\tan envelope (see 'set_envelope') and a pygear worker answered, the dict\n"
+"\talso says when it 'worker_grabbed', 'worker_started' and 'worker_finished'\n"
+"\tthe job, moved onto the same clock by assuming that both hosts' wall\n"
+"\tclocks agree; otherwise those are None.\n\n"
 "@return the result of the task (None if empty result) on success.\n"
 "@return NULL and raises pygear exception on failure.\n\n"
 "Note: If the exception is one of GEARMAN_WORK_DATA, GEARMAN_WORK_WARNING,\n"
@@ -165,13 +289,32 @@ PyDoc_STRVAR(pygear_client_do_doc,
 "data buffer will be returned. For GEARMAN_WORK_STATUS, the caller can use\n"
 "'do_status' to get the current task status.");
 
+static PyObject* pygear_client_do_stream(pygear_ClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_client_do_stream_doc,
+"Send a foreground task to server and iterate over the result as it arrives.\n"
+"Each WORK_DATA packet sent by the worker, e.g. by a handler that yields\n"
+"strings, is one chunk; a handler that returns its result sends it as the\n"
+"last chunk. Chunks are raw strings, the serializer is not applied to them.\n"
+"The socket is only read when the buffered chunks have been consumed.\n\n"
+"@param[in] function_name - The name of the function to run.\n"
+"@param[in] workload - The workload to pass to the function when it is run.\n"
+"@param[in] unique - Optional unique job identifier.\n"
+"@param[in] routing_key - Optional key choosing the server, see 'set_routing'.\n\n"
+"@return a pygear.Stream iterator. Iterating raises the pygear exception the\n"
+"\tjob failed with, if any.\n\n"
+"Example:\n"
+"for chunk in c.do_stream('export', {'table': 'users'}):\n"
+"    out.write(chunk)");
+
 static PyObject* pygear_client_do_background(pygear_ClientObject* self, PyObject* args, PyObject* kwargs);
 PyDoc_STRVAR(pygear_client_do_background_doc,
 "Send a background task to server and return immediately without waiting for\n"
 "the result (non-blocking).\n\n"
 "@param[in] function_name - The name of the function to run.\n"
 "@param[in] unique - Optional unique job identifier, or None for a new UUID.\n"
-"@param[in] workload - The workload to pass to the function when it is run.\n\n"
+"@param[in] workload - The workload to pass to the function when it is run.\n"
+"@param[in] routing_key - Optional key choosing the server, see 'set_routing'.\n"
+"@param[in] serialize - Optional, see 'do'.\n\n"
 "@return job_handle (string) of the task on success.\n"
 "@return NULL and raises pygear exception on failure.\n"
 "See 'do' for handling different exceptions.");
@@ -196,6 +339,48 @@ PyDoc_STRVAR(pygear_client_do_low_background_doc,
 "Run a low priority background task and return the job handle.\n"
 "See 'do_background' for parameters and return information.");
 
+static PyObject* pygear_client_submit_background_async(pygear_ClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_client_submit_background_async_doc,
+"Queue a background task and return immediately, without waiting for the\n"
+"server to create the job.\n\n"
+"Queued tasks are sent by a writer thread with its own connection, in\n"
+"pipelined batches, as soon as a batch is full or its oldest task has waited\n"
+"for the flush interval (see 'set_async_options'). Tasks the server does not\n"
+"accept are counted in 'async_stats' and passed to the 'set_async_fail_fn'\n"
+"callback. Servers and options must be set before the first call.\n\n"
+"@param[in] function_name - The name of the function to run.\n"
+"@param[in] workload - The workload to pass to the function when it is run.\n"
+"@param[in] unique - Optional unique job identifier, or None for a new UUID.\n\n"
+"@return None once queued.\n"
+"@return NULL and raises pygear.TIMEOUT if the queue stayed full for the client timeout.");
+
+static PyObject* pygear_client_flush(pygear_ClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_client_flush_doc,
+"Send every task queued by 'submit_background_async' now and wait until\n"
+"each of them was either created or failed.\n\n"
+"@param[in] timeout - Optional milliseconds to wait, defaults to the client timeout.\n\n"
+"@return None on success.\n"
+"@return NULL and raises pygear.TIMEOUT if the tasks were not all sent in time.");
+
+static PyObject* pygear_client_set_async_options(pygear_ClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_client_set_async_options_doc,
+"Tune 'submit_background_async'. Must be called before its first use.\n\n"
+"@param[in] batch_size - Tasks sent per batch, default 64.\n"
+"@param[in] flush_interval - Milliseconds a queued task may wait for its batch to fill, default 10.\n"
+"@param[in] capacity - Tasks that can be queued before submitters block, default 4096.");
+
+static PyObject* pygear_client_set_async_fail_fn(pygear_ClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_client_set_async_fail_fn_doc,
+"Set the callback for tasks queued by 'submit_background_async' that the\n"
+"server did not accept. It is called from the writer thread as\n"
+"callback(function_name, serialized_workload, return_code).\n\n"
+"@param[in] callback - Callable, or None to only count failures.");
+
+static PyObject* pygear_client_async_stats(pygear_ClientObject* self);
+PyDoc_STRVAR(pygear_client_async_stats_doc,
+"@return a dictionary of 'submit_background_async' counters: 'queued',\n"
+"'delivered' and 'failed'.");
+
 static PyObject* pygear_client_do_job_handle(pygear_ClientObject* self);
 PyDoc_STRVAR(pygear_client_do_job_handle_doc,
 "Get the job handle for the running task. This should be used between\n"
@@ -262,6 +447,14 @@ static PyObject* pygear_client_remove_servers(pygear_ClientObject* self);
 PyDoc_STRVAR(pygear_client_remove_servers_doc,
 "Remove all servers currently associated with the client.");
 
+static PyObject* pygear_client_remove_server(pygear_ClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_client_remove_server_doc,
+"Remove one job server from the client. With 'hash' routing, only the keys\n"
+"that server owned move to other servers.\n\n"
+"@param[in] host - Hostname or IP address the server was added with.\n"
+"@param[in] port - Port of the server, 0 for the default port.\n\n"
+"@return True if the server was removed, False if it was not known.");
+
 static PyObject* pygear_client_run_tasks(pygear_ClientObject* self);
 PyDoc_STRVAR(pygear_client_run_tasks_doc,
 "Run tasks that have been added by 'add_task' and/or 'add_task_background'.\n\n"
@@ -327,6 +520,159 @@ PyDoc_STRVAR(pygear_client_set_options_doc,
 "@return None on success, NULL on failure.");
 
 
+static PyObject* pygear_client_set_max_in_flight(pygear_ClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_client_set_max_in_flight_doc,
+"Bound the number of tasks added with 'add_task*' that are not finished yet.\n"
+"Once 'max_in_flight' tasks are pending, 'add_task*' runs the queued tasks\n"
+"itself, with the GIL released, until one of them finishes. Memory stays\n"
+"flat and the servers get a steady stream of jobs instead of one burst at\n"
+"'run_tasks'. While there is a limit the 'free_tasks' option is on, so\n"
+"finished tasks are freed; 0 restores it.\n\n"
+"@param[in] max_in_flight - Maximum number of pending tasks, 0 for no limit.");
+
+static PyObject* pygear_client_max_in_flight(pygear_ClientObject* self);
+PyDoc_STRVAR(pygear_client_max_in_flight_doc,
+"@return the limit set with 'set_max_in_flight', 0 if unlimited.");
+
+static PyObject* pygear_client_set_routing(pygear_ClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_client_set_routing_doc,
+"Choose how 'do*' and 'do_*_background' pick a job server.\n"
+"'default' leaves it to libgearman. 'hash' places every job by consistent\n"
+"hashing of its routing key: the 'routing_key' argument if given, else\n"
+"'unique', else the function name and workload. Jobs with the same key always\n"
+"reach the same server, which keeps server side unique coalescing and worker\n"
+"cache locality working across several servers. 'least_loaded' sends every\n"
+"job to the server with the most idle workers for its function, net of the\n"
+"jobs queued there. A background thread polls the admin 'status' of every\n"
+"server each 'probe_interval' milliseconds; servers not probed yet are ranked\n"
+"by the observed latency of 'do*' calls. With routing the client keeps one\n"
+"connection per server. 'add_task*' is not routed.\n\n"
+"@param[in] mode - 'default', 'hash' or 'least_loaded'.\n"
+"@param[in] probe_interval - Optional milliseconds between probes, 1000 by default.");
+
+static PyObject* pygear_client_routing(pygear_ClientObject* self);
+PyDoc_STRVAR(pygear_client_routing_doc,
+"@return the routing mode set with 'set_routing'.");
+
+static PyObject* pygear_client_server_for(pygear_ClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_client_server_for_doc,
+"@param[in] routing_key - A routing key.\n"
+"@return the 'HOST:PORT' server 'hash' routing sends the key to.");
+
+static PyObject* pygear_client_set_hedge_budget(pygear_ClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_client_set_hedge_budget_doc,
+"Limit hedged requests, see 'do', to a percentage of the calls that ask for\n"
+"hedging, so that a slow cluster is not loaded further by duplicates.\n"
+"One hedge is always allowed on top of the budget.\n\n"
+"@param[in] percent - 0 to 100, 10 by default.");
+
+static PyObject* pygear_client_hedge_stats(pygear_ClientObject* self);
+PyDoc_STRVAR(pygear_client_hedge_stats_doc,
+"@return a dict with the number of calls that asked for hedging ('requests'),\n"
+"of duplicates sent ('hedged') and of duplicates that answered first ('won').");
+
+static PyObject* pygear_client_latency_stats(pygear_ClientObject* self);
+PyDoc_STRVAR(pygear_client_latency_stats_doc,
+"@return a summary of the round trips of successful 'do*' calls: 'count', and\n"
+"'mean', 'p50', 'p90', 'p99' and 'max' in seconds.");
+
+static PyObject* pygear_client_set_unique_strategy(pygear_ClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_client_set_unique_strategy_doc,
+"Choose the unique key of jobs submitted without one, computed in C.\n"
+"'content' hashes the function name and serialized workload, so identical\n"
+"jobs get the same unique and are coalesced by the job server. 'random'\n"
+"generates 128 random bits, like uuid.uuid4().hex. Both are 32 hex digits.\n\n"
+"@param[in] strategy - 'none' (the default), 'content' or 'random'.");
+
+static PyObject* pygear_client_unique_strategy(pygear_ClientObject* self);
+PyDoc_STRVAR(pygear_client_unique_strategy_doc,
+"@return the strategy set with 'set_unique_strategy'.");
+
+static PyObject* pygear_client_set_envelope(pygear_ClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_client_set_envelope_doc,
+"Put the workloads of 'do*', 'do_*_background' and 'add_task*' in a small\n"
+"binary envelope carrying the codec id of the serializer (see\n"
+"pygear.register_codec), the time the job was sent, its deadline and a\n"
+"random trace id, see Job.envelope. pygear workers read both enveloped and\n"
+"bare workloads, and reply in an envelope only to enveloped ones; other\n"
+"workers would see the envelope as part of the workload, so only enable it\n"
+"for functions served by pygear workers. Off by default.\n"
+"@param[in] enabled - Whether to send envelopes.\n"
+"@param[in] deadline_ms - Optional. If positive, workers fail jobs still\n"
+"\tqueued this many milliseconds after they were sent, without running them.");
+
+static PyObject* pygear_client_envelope(pygear_ClientObject* self);
+PyDoc_STRVAR(pygear_client_envelope_doc,
+"@return whether workloads are sent in an envelope, see 'set_envelope'.");
+
+static PyObject* pygear_client_set_trace(pygear_ClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_client_set_trace_doc,
+"Record when the 'do*' calls of this client go through each step, for\n"
+"pygear.dump_trace: 'encode', 'submit' (from sending the job to receiving its\n"
+"result), 'decode' and an instant 'complete' event. Off by default.\n"
+"@param[in] enabled - Whether to record.");
+
+static PyObject* pygear_client_trace(pygear_ClientObject* self);
+PyDoc_STRVAR(pygear_client_trace_doc,
+"@return whether the client records trace events, see 'set_trace'.");
+
+static PyObject* pygear_client_publish_stats(pygear_ClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_client_publish_stats_doc,
+"Keep a copy of the client stats in a file that other processes can map and\n"
+"read without locks, see pygear_stats.py: the 'latency' histogram of 'do*'\n"
+"calls and the 'hedges_sent', 'hedges_won' and 'retries' counters. The file is\n"
+"removed when the client is collected. A forked child stops updating the file\n"
+"of its parent, and may publish its own.\n"
+"@param[in] name - Name the readers aggregate the processes by, such as the\n"
+"\tservice the client belongs to.\n"
+"@param[in] directory - Optional, '/dev/shm' by default.\n"
+"@return the path of the file.");
+
+static PyObject* pygear_client_set_retry_policy(pygear_ClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_client_set_retry_policy_doc,
+"Retry 'do*' and 'do_*_background' calls that fail with a transient error.\n"
+"Between attempts the client sleeps an exponential backoff, half of it random,\n"
+"with the GIL released. With a routing mode, a server that could not be\n"
+"reached, dropped the connection or had a full queue is skipped for\n"
+"'cooloff_ms', so the next attempt and later calls fail over to another server.\n\n"
+"@param[in] attempts - Total attempts per call, 1 (the default) for no retry.\n"
+"@param[in] backoff_ms - Delay before the first retry, doubled on every retry.\n"
+"@param[in] max_backoff_ms - Upper bound of the delay.\n"
+"@param[in] retry_on - pygear exception classes to retry on; by default\n"
+"\tLOST_CONNECTION, COULD_NOT_CONNECT, JOB_QUEUE_FULL and TIMEOUT.\n"
+"@param[in] cooloff_ms - How long a failing server is skipped, 0 to never skip.");
+
+static PyObject* pygear_client_retry_stats(pygear_ClientObject* self);
+PyDoc_STRVAR(pygear_client_retry_stats_doc,
+"@return a dict with the number of retries made ('retries').");
+
+static PyObject* pygear_client_enable_result_cache(pygear_ClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_client_enable_result_cache_doc,
+"Keep the results of an idempotent function for 'ttl_ms', so that 'do',\n"
+"'do_high' and 'do_low' calls with the same serialized workload are answered\n"
+"without a round trip to the job server. Enabling an enabled cache empties it.\n\n"
+"@param[in] function - Function name.\n"
+"@param[in] ttl_ms - How long a result is served, in milliseconds.\n"
+"@param[in] max_bytes - Memory for the results, least recently used ones are\n"
+"\tevicted first. 16 MB by default.");
+
+static PyObject* pygear_client_disable_result_cache(pygear_ClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_client_disable_result_cache_doc,
+"Drop the result cache of a function, or of every function.\n\n"
+"@param[in] function - Function name, None (the default) for all.");
+
+static PyObject* pygear_client_result_cache_stats(pygear_ClientObject* self);
+PyDoc_STRVAR(pygear_client_result_cache_stats_doc,
+"@return a dict from cached function names to their 'hits', 'misses',\n"
+"'evictions', and current 'entries' and 'bytes'.");
+
+static PyObject* pygear_client_routing_stats(pygear_ClientObject* self);
+PyDoc_STRVAR(pygear_client_routing_stats_doc,
+"@return what routing knows about each server, as a dict of 'HOST:PORT' to\n"
+"{'latency': average do* round trip in seconds (0.0 if none yet),\n"
+" 'probed': whether the admin status was read,\n"
+" 'functions': {function: (total, running, available_workers)}}.");
+
 static PyObject* pygear_client_set_serializer(pygear_ClientObject* self, PyObject* args);
 PyDoc_STRVAR(pygear_client_set_serializer_doc,
 "Specify the object to be used to serialize data passed through gearman.\n"
@@ -390,6 +736,7 @@ static PyMethodDef client_module_methods[] = {
     _CLIENTMETHOD(add_server,               METH_VARARGS)
     _CLIENTMETHOD(add_servers,              METH_VARARGS)
     _CLIENTMETHOD(remove_servers,           METH_NOARGS)
+    _CLIENTMETHOD(remove_server,            METH_VARARGS)
     _CLIENTMETHOD(echo,                     METH_VARARGS)
 
     // Task management
@@ -404,11 +751,15 @@ static PyMethodDef client_module_methods[] = {
     _CLIENTMETHOD(run_tasks,                METH_NOARGS)
     _CLIENTMETHOD(wait,                     METH_NOARGS)
     _CLIENTMETHOD(do,                       METH_VARARGS | METH_KEYWORDS)
+    _CLIENTMETHOD(do_stream,                METH_VARARGS | METH_KEYWORDS)
     _CLIENTMETHOD(do_background,            METH_VARARGS | METH_KEYWORDS)
     _CLIENTMETHOD(do_high,                  METH_VARARGS | METH_KEYWORDS)
     _CLIENTMETHOD(do_high_background,       METH_VARARGS | METH_KEYWORDS)
     _CLIENTMETHOD(do_low,                   METH_VARARGS | METH_KEYWORDS)
     _CLIENTMETHOD(do_low_background,        METH_VARARGS | METH_KEYWORDS)
+    _CLIENTMETHOD(submit_background_async,  METH_VARARGS | METH_KEYWORDS)
+    _CLIENTMETHOD(flush,                    METH_VARARGS)
+    _CLIENTMETHOD(async_stats,              METH_NOARGS)
 
     // Errors
     _CLIENTMETHOD(error,                    METH_NOARGS)
@@ -432,6 +783,7 @@ static PyMethodDef client_module_methods[] = {
     _CLIENTMETHOD(set_fail_fn,              METH_VARARGS)
     _CLIENTMETHOD(clear_fn,                 METH_NOARGS)
     _CLIENTMETHOD(set_log_fn,               METH_VARARGS)
+    _CLIENTMETHOD(set_async_fail_fn,        METH_VARARGS)
 
     // Client Options
     _CLIENTMETHOD(set_options,              METH_KEYWORDS)
@@ -439,6 +791,28 @@ static PyMethodDef client_module_methods[] = {
     _CLIENTMETHOD(timeout,                  METH_NOARGS)
     _CLIENTMETHOD(set_timeout,              METH_VARARGS)
     _CLIENTMETHOD(set_serializer,           METH_VARARGS)
+    _CLIENTMETHOD(set_max_in_flight,        METH_VARARGS)
+    _CLIENTMETHOD(max_in_flight,            METH_NOARGS)
+    _CLIENTMETHOD(set_routing,              METH_VARARGS)
+    _CLIENTMETHOD(routing,                  METH_NOARGS)
+    _CLIENTMETHOD(server_for,               METH_VARARGS)
+    _CLIENTMETHOD(routing_stats,            METH_NOARGS)
+    _CLIENTMETHOD(set_hedge_budget,         METH_VARARGS)
+    _CLIENTMETHOD(hedge_stats,              METH_NOARGS)
+    _CLIENTMETHOD(latency_stats,            METH_NOARGS)
+    _CLIENTMETHOD(set_retry_policy,         METH_VARARGS | METH_KEYWORDS)
+    _CLIENTMETHOD(retry_stats,              METH_NOARGS)
+    _CLIENTMETHOD(set_unique_strategy,      METH_VARARGS)
+    _CLIENTMETHOD(unique_strategy,          METH_NOARGS)
+    _CLIENTMETHOD(set_envelope,             METH_VARARGS | METH_KEYWORDS)
+    _CLIENTMETHOD(envelope,                 METH_NOARGS)
+    _CLIENTMETHOD(set_trace,                METH_VARARGS)
+    _CLIENTMETHOD(trace,                    METH_NOARGS)
+    _CLIENTMETHOD(publish_stats,            METH_VARARGS | METH_KEYWORDS)
+    _CLIENTMETHOD(enable_result_cache,      METH_VARARGS | METH_KEYWORDS)
+    _CLIENTMETHOD(disable_result_cache,     METH_VARARGS | METH_KEYWORDS)
+    _CLIENTMETHOD(result_cache_stats,       METH_NOARGS)
+    _CLIENTMETHOD(set_async_options,        METH_VARARGS | METH_KEYWORDS)
 
     {NULL, NULL, 0, NULL}
 };
@@ -0,0 +1,431 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "clientpool.h"
+
+/*
+ * Class constructor / destructor methods
+ */
+
+int ClientPool_init(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwds) {
+    Py_ssize_t size;
+    PyObject* servers = NULL; /* optional */
+    PyObject* options = NULL; /* optional */
+    int timeout = -1; /* optional */
+    int checkout_timeout = -1; /* optional */
+    static char* kwlist[] = {"size", "servers", "options", "timeout", "checkout_timeout", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "n|OOii", kwlist,
+        &size, &servers, &options, &timeout, &checkout_timeout)) {
+        return -1;
+    }
+    if (size <= 0 || (uint64_t) size > CLIENTPOOL_MAX_SIZE) {
+        PyErr_Format(PyExc_ValueError, "ClientPool size must be between 1 and %llu",
+            (unsigned long long) CLIENTPOOL_MAX_SIZE);
+        return -1;
+    }
+    if (self->clients) {
+        PyErr_SetString(PyGearExn_ERROR, "ClientPool is already initialized");
+        return -1;
+    }
+
+    int ret = -1;
+    PyObject* template = NULL;
+    PyObject* server_list = NULL;
+    PyObject* method_result = NULL;
+    PyObject* empty_args = NULL;
+    PyObject* set_options = NULL;
+
+    // Configure one client, every pooled client is a clone of it
+    template = PyObject_CallObject((PyObject*) &pygear_ClientType, NULL);
+    if (!template) {
+        goto catch;
+    }
+    if (servers && servers != Py_None) {
+        server_list = PySequence_List(servers);
+        if (!server_list) {
+            goto catch;
+        }
+        method_result = PyObject_CallMethod(template, "add_servers", "O", server_list);
+        if (!method_result) {
+            goto catch;
+        }
+    }
+    if (options && options != Py_None) {
+        empty_args = PyTuple_New(0);
+        set_options = PyObject_GetAttrString(template, "set_options");
+        if (!empty_args || !set_options) {
+            goto catch;
+        }
+        Py_XDECREF(method_result);
+        method_result = PyObject_Call(set_options, empty_args, options);
+        if (!method_result) {
+            goto catch;
+        }
+    }
+    gearman_client_set_timeout(((pygear_ClientObject*) template)->g_Client, timeout);
+
+    self->clients = PyList_New(size);
+    if (!self->clients) {
+        goto catch;
+    }
+    Py_ssize_t i;
+    for (i = 0; i < size; ++i) {
+        pygear_ClientObject* client = (pygear_ClientObject*) pygear_client_clone((pygear_ClientObject*) template);
+        if (!client) {
+            goto catch;
+        }
+        PyList_SET_ITEM(self->clients, i, (PyObject*) client);
+        // Lent to one thread at a time, so its calls can run without the GIL
+        client->release_gil = true;
+        if (servers && servers != Py_None) {
+            // exception callbacks are only called if exceptions are enabled on the server
+            const char *EXCEPTIONS = "exceptions";
+            gearman_client_set_server_option(client->g_Client, EXCEPTIONS, strlen(EXCEPTIONS));
+        }
+    }
+
+    // Every slot starts out free, chained in index order
+    self->free_next = calloc(size, sizeof(uint32_t));
+    if (!self->free_next) {
+        PyErr_NoMemory();
+        goto catch;
+    }
+    for (i = 0; i < size - 1; ++i) {
+        self->free_next[i] = i + 2;
+    }
+    self->free_next[size - 1] = CLIENTPOOL_EMPTY;
+    self->free_head = 1;
+    self->num_free = size;
+    self->waiters = 0;
+    self->size = size;
+    self->checkout_timeout = checkout_timeout;
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->released, NULL);
+    ret = 0;
+
+catch:
+    if (ret < 0) {
+        Py_CLEAR(self->clients);
+    }
+    Py_XDECREF(template);
+    Py_XDECREF(server_list);
+    Py_XDECREF(method_result);
+    Py_XDECREF(empty_args);
+    Py_XDECREF(set_options);
+    return ret;
+}
+
+int ClientPool_traverse(pygear_ClientPoolObject* self, visitproc visit, void* arg) {
+    Py_VISIT(self->clients);
+    return 0;
+}
+
+int ClientPool_clear(pygear_ClientPoolObject* self) {
+    Py_CLEAR(self->clients);
+    return 0;
+}
+
+void ClientPool_dealloc(pygear_ClientPoolObject* self) {
+    ClientPool_clear(self);
+    _pygear_statshm_decref(self->shm);
+    self->shm = NULL;
+    if (self->free_next) {
+        free((void*) self->free_next);
+        self->free_next = NULL;
+        pthread_mutex_destroy(&self->lock);
+        pthread_cond_destroy(&self->released);
+    }
+    self->ob_type->tp_free((PyObject*)self);
+}
+
+
+int ClientLease_traverse(pygear_ClientLeaseObject* self, visitproc visit, void* arg) {
+    Py_VISIT(self->pool);
+    Py_VISIT(self->client);
+    return 0;
+}
+
+int ClientLease_clear(pygear_ClientLeaseObject* self) {
+    if (self->pool && self->index >= 0) {
+        _pygear_clientpool_release((pygear_ClientPoolObject*) self->pool, self->index);
+        self->index = -1;
+    }
+    Py_CLEAR(self->pool);
+    Py_CLEAR(self->client);
+    return 0;
+}
+
+void ClientLease_dealloc(pygear_ClientLeaseObject* self) {
+    ClientLease_clear(self);
+    self->ob_type->tp_free((PyObject*)self);
+}
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+/* Return the index of a free slot, or -1 if there is none. Never blocks. */
+static Py_ssize_t _pygear_clientpool_pop(pygear_ClientPoolObject* self) {
+    uint64_t head, next;
+    do {
+        head = self->free_head;
+        uint32_t index = head & CLIENTPOOL_INDEX_MASK;
+        if (index == CLIENTPOOL_EMPTY) {
+            return -1;
+        }
+        next = (((head >> 32) + 1) << 32) | self->free_next[index - 1];
+    } while (!__sync_bool_compare_and_swap(&self->free_head, head, next));
+    __sync_fetch_and_sub(&self->num_free, 1);
+    return (Py_ssize_t) (head & CLIENTPOOL_INDEX_MASK) - 1;
+}
+
+static void _pygear_clientpool_push(pygear_ClientPoolObject* self, Py_ssize_t index) {
+    uint64_t head, next;
+    do {
+        head = self->free_head;
+        self->free_next[index] = head & CLIENTPOOL_INDEX_MASK;
+        next = (((head >> 32) + 1) << 32) | (uint64_t) (index + 1);
+    } while (!__sync_bool_compare_and_swap(&self->free_head, head, next));
+    __sync_fetch_and_add(&self->num_free, 1);
+}
+
+/*
+ * Take a free slot, waiting up to 'timeout' milliseconds with the GIL
+ * released when the pool is exhausted.
+ * Return the slot index, or -1 with pygear.TIMEOUT raised.
+ */
+static Py_ssize_t _pygear_clientpool_acquire(pygear_ClientPoolObject* self, int timeout) {
+    Py_ssize_t index = _pygear_clientpool_pop(self);
+    if (index >= 0 || timeout == 0) {
+        goto done;
+    }
+    _pygear_statshm_add(self->shm, self->shm_waits, 1);
+    Py_BEGIN_ALLOW_THREADS
+    struct timespec deadline;
+    if (timeout > 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (timeout % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+    pthread_mutex_lock(&self->lock);
+    // Registered before looking at the stack, see _pygear_clientpool_release
+    __sync_fetch_and_add(&self->waiters, 1);
+    while ((index = _pygear_clientpool_pop(self)) < 0) {
+        if (timeout < 0) {
+            pthread_cond_wait(&self->released, &self->lock);
+        } else if (pthread_cond_timedwait(&self->released, &self->lock, &deadline) == ETIMEDOUT) {
+            index = _pygear_clientpool_pop(self);
+            break;
+        }
+    }
+    __sync_fetch_and_sub(&self->waiters, 1);
+    pthread_mutex_unlock(&self->lock);
+    Py_END_ALLOW_THREADS
+done:
+    if (index < 0) {
+        _pygear_statshm_add(self->shm, self->shm_timeouts, 1);
+        PyErr_SetString(PyGearExn_TIMEOUT, "Timed out waiting for a free client");
+    } else {
+        _pygear_statshm_add(self->shm, self->shm_checkouts, 1);
+    }
+    _pygear_statshm_set(self->shm, self->shm_available, (uint64_t) self->num_free);
+    return index;
+}
+
+static void _pygear_clientpool_release(pygear_ClientPoolObject* self, Py_ssize_t index) {
+    _pygear_clientpool_push(self, index);
+    _pygear_statshm_set(self->shm, self->shm_available, (uint64_t) self->num_free);
+    // Waiters register under the lock before their last look at the stack,
+    // so either they see this slot or they are asleep and get signalled.
+    if (__sync_fetch_and_add(&self->waiters, 0) > 0) {
+        pthread_mutex_lock(&self->lock);
+        pthread_cond_signal(&self->released);
+        pthread_mutex_unlock(&self->lock);
+    }
+}
+
+/*
+ * Call a Client method on a borrowed client and give the client back.
+ * Return value: New reference, the method's return value.
+ */
+static PyObject* _pygear_clientpool_delegate(pygear_ClientPoolObject* self, const char* method_name,
+    PyObject* args, PyObject* kwargs) {
+    if (!self->clients) {
+        PyErr_SetString(PyGearExn_ERROR, "ClientPool is not initialized");
+        return NULL;
+    }
+    Py_ssize_t index = _pygear_clientpool_acquire(self, self->checkout_timeout);
+    if (index < 0) {
+        return NULL;
+    }
+    PyObject* method = PyObject_GetAttrString(PyList_GET_ITEM(self->clients, index), method_name);
+    PyObject* result = NULL;
+    if (method) {
+        result = PyObject_Call(method, args, kwargs);
+    }
+    Py_XDECREF(method);
+    _pygear_clientpool_release(self, index);
+    return result;
+}
+
+
+/********************
+ * Instance methods *
+ ********************/
+
+static PyObject* pygear_clientpool_publish_stats(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwargs) {
+    char* name;
+    char* directory = NULL;
+    static char* kwlist[] = {"name", "directory", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|z", kwlist, &name, &directory)) {
+        return NULL;
+    }
+    if (!self->clients) {
+        PyErr_SetString(PyGearExn_ERROR, "ClientPool is not initialized");
+        return NULL;
+    }
+    if (_pygear_statshm_live(self->shm)) {
+        PyErr_SetString(PyGearExn_ERROR, "ClientPool stats are already published");
+        return NULL;
+    }
+    // A segment inherited through fork belongs to the parent
+    _pygear_statshm_decref(self->shm);
+    self->shm = NULL;
+    self->shm = _pygear_statshm_open(directory, "pool", name);
+    if (!self->shm) {
+        return NULL;
+    }
+    _pygear_statshm_set(self->shm, _pygear_statshm_series(self->shm, "size", STATSHM_GAUGE), (uint64_t) self->size);
+    self->shm_available = _pygear_statshm_series(self->shm, "available", STATSHM_GAUGE);
+    self->shm_checkouts = _pygear_statshm_series(self->shm, "checkouts", STATSHM_COUNTER);
+    self->shm_waits = _pygear_statshm_series(self->shm, "waits", STATSHM_COUNTER);
+    self->shm_timeouts = _pygear_statshm_series(self->shm, "timeouts", STATSHM_COUNTER);
+    _pygear_statshm_set(self->shm, self->shm_available, (uint64_t) self->num_free);
+    Py_ssize_t i;
+    for (i = 0; i < self->size; ++i) {
+        _pygear_client_publish((pygear_ClientObject*) PyList_GET_ITEM(self->clients, i), self->shm);
+    }
+    return _pygear_statshm_path(self->shm);
+}
+
+static PyObject* pygear_clientpool_checkout(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject* py_timeout = NULL; /* optional */
+    static char* kwlist[] = {"timeout", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwlist, &py_timeout)) {
+        return NULL;
+    }
+    if (!self->clients) {
+        PyErr_SetString(PyGearExn_ERROR, "ClientPool is not initialized");
+        return NULL;
+    }
+    int timeout = self->checkout_timeout;
+    if (py_timeout && py_timeout != Py_None) {
+        timeout = (int) PyInt_AsLong(py_timeout);
+        if (timeout == -1 && PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+    pygear_ClientLeaseObject* lease = PyObject_GC_New(pygear_ClientLeaseObject, &pygear_ClientLeaseType);
+    if (!lease) {
+        return NULL;
+    }
+    lease->pool = NULL;
+    lease->client = NULL;
+    lease->index = -1;
+    PyObject_GC_Track(lease);
+    Py_ssize_t index = _pygear_clientpool_acquire(self, timeout);
+    if (index < 0) {
+        Py_DECREF(lease);
+        return NULL;
+    }
+    Py_INCREF(self);
+    lease->pool = (PyObject*) self;
+    lease->client = PyList_GET_ITEM(self->clients, index);
+    Py_INCREF(lease->client);
+    lease->index = index;
+    return (PyObject*) lease;
+}
+
+
+static PyObject* pygear_clientpool_available(pygear_ClientPoolObject* self) {
+    return Py_BuildValue("l", self->num_free);
+}
+
+
+static PyObject* pygear_clientpool_size(pygear_ClientPoolObject* self) {
+    return Py_BuildValue("n", self->size);
+}
+
+
+#define CLIENTPOOL_DELEGATE(NAME) \
+static PyObject* pygear_clientpool_##NAME(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwargs) { \
+    return _pygear_clientpool_delegate(self, #NAME, args, kwargs); \
+}
+
+CLIENTPOOL_DELEGATE(do)
+CLIENTPOOL_DELEGATE(do_high)
+CLIENTPOOL_DELEGATE(do_low)
+CLIENTPOOL_DELEGATE(do_background)
+CLIENTPOOL_DELEGATE(do_high_background)
+CLIENTPOOL_DELEGATE(do_low_background)
+CLIENTPOOL_DELEGATE(job_status)
+
+
+static PyObject* pygear_clientlease_enter(pygear_ClientLeaseObject* self) {
+    if (!self->client) {
+        PyErr_SetString(PyGearExn_ERROR, "ClientLease was already released");
+        return NULL;
+    }
+    Py_INCREF(self->client);
+    return self->client;
+}
+
+
+static PyObject* pygear_clientlease_exit(pygear_ClientLeaseObject* self, PyObject* args) {
+    PyObject* ret = pygear_clientlease_release(self);
+    if (!ret) {
+        return NULL;
+    }
+    Py_DECREF(ret);
+    Py_RETURN_FALSE;
+}
+
+
+static PyObject* pygear_clientlease_release(pygear_ClientLeaseObject* self) {
+    if (self->pool && self->index >= 0) {
+        _pygear_clientpool_release((pygear_ClientPoolObject*) self->pool, self->index);
+        self->index = -1;
+    }
+    Py_CLEAR(self->client);
+    Py_RETURN_NONE;
+}
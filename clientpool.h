@@ -0,0 +1,293 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <libgearman-1.0/gearman.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "structmember.h"
+#include "client.h"
+#include "statshm.h"
+#include "exception.h"
+
+#ifndef PyMODINIT_FUNC
+#define PyMODINIT_FUNC void
+#endif
+
+#ifndef CLIENTPOOL_H
+#define CLIENTPOOL_H
+
+#define _CLIENTPOOLMETHOD(name,flags) {#name,(PyCFunction) pygear_clientpool_##name,flags,pygear_clientpool_##name##_doc},
+#define _CLIENTLEASEMETHOD(name,flags) {#name,(PyCFunction) pygear_clientlease_##name,flags,pygear_clientlease_##name##_doc},
+
+/*
+ * The free-list is a Treiber stack of client indices. The head packs a
+ * generation tag in its upper 32 bits and index + 1 in the lower 32 bits,
+ * 0 meaning empty, so a pop racing with a pop/push pair can not succeed
+ * on a stale head (ABA).
+ */
+#define CLIENTPOOL_INDEX_MASK 0xffffffffULL
+#define CLIENTPOOL_EMPTY 0
+/* Slots are stored as index + 1 under the mask, 0 being CLIENTPOOL_EMPTY */
+#define CLIENTPOOL_MAX_SIZE (CLIENTPOOL_INDEX_MASK - 1)
+
+typedef struct {
+    PyObject_HEAD
+    PyObject* clients;              /* list of pygear.Client, indexed by slot */
+    Py_ssize_t size;
+    int checkout_timeout;           /* milliseconds, negative waits forever */
+    volatile uint64_t free_head;
+    volatile uint32_t* free_next;   /* next index + 1 for every free slot */
+    volatile long num_free;
+    volatile int waiters;
+    pthread_mutex_t lock;           /* only taken to sleep while the pool is empty */
+    pthread_cond_t released;
+    pygear_statshm* shm;            /* see publish_stats */
+    pygear_statshm_series* shm_available;
+    pygear_statshm_series* shm_checkouts;
+    pygear_statshm_series* shm_waits;
+    pygear_statshm_series* shm_timeouts;
+} pygear_ClientPoolObject;
+
+typedef struct {
+    PyObject_HEAD
+    PyObject* pool;
+    PyObject* client;
+    Py_ssize_t index;               /* slot held, -1 once released */
+} pygear_ClientLeaseObject;
+
+PyDoc_STRVAR(clientpool_module_docstring,
+"Represents a fixed set of Gearman clients shared between threads.\n\n"
+"The clients are cloned from a single template so they share servers and\n"
+"options, and keep their connections open between checkouts. A client is\n"
+"lent to one thread at a time, either for the duration of a 'with' block:\n\n"
+"    with pool.checkout() as client:\n"
+"        client.do('reverse', 'Hello python!')\n\n"
+"or for a single call through the pool's own do* methods. Checkout does not\n"
+"take a lock, and waits for a free client with the GIL released. Pooled\n"
+"clients also release the GIL while they wait on the network, so a client\n"
+"must not be used once it went back to the pool.\n\n"
+"@param[in] size - Number of clients in the pool.\n"
+"@param[in] servers - Optional list of servers in the format of 'HOST[:PORT]'.\n"
+"@param[in] options - Optional dictionary of client options, see Client.set_options.\n"
+"@param[in] timeout - Optional milliseconds the clients wait for jobs, see\n"
+"    Client.set_timeout.\n"
+"@param[in] checkout_timeout - Optional milliseconds to wait for a free client,\n"
+"    negative to wait forever (the default), 0 to fail at once.");
+
+PyDoc_STRVAR(clientlease_module_docstring,
+"A client checked out of a pygear.ClientPool. Returns the client to the pool\n"
+"when the 'with' block ends, when 'release' is called or when it is collected.");
+
+/* Class init methods */
+int ClientPool_init(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwds);
+int ClientPool_traverse(pygear_ClientPoolObject* self, visitproc visit, void* arg);
+int ClientPool_clear(pygear_ClientPoolObject* self);
+void ClientPool_dealloc(pygear_ClientPoolObject* self);
+
+int ClientLease_traverse(pygear_ClientLeaseObject* self, visitproc visit, void* arg);
+int ClientLease_clear(pygear_ClientLeaseObject* self);
+void ClientLease_dealloc(pygear_ClientLeaseObject* self);
+
+/* Private methods */
+static Py_ssize_t _pygear_clientpool_acquire(pygear_ClientPoolObject* self, int timeout);
+static void _pygear_clientpool_release(pygear_ClientPoolObject* self, Py_ssize_t index);
+
+/* Method definitions */
+static PyObject* pygear_clientpool_checkout(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_clientpool_checkout_doc,
+"Borrow a client, waiting for one to be returned if none is free.\n\n"
+"@param[in] timeout - Optional milliseconds to wait, defaults to the pool's\n"
+"    checkout_timeout.\n\n"
+"@return new ClientLease, to be used as a context manager.\n"
+"@return NULL and raises pygear.TIMEOUT if no client was freed in time.");
+
+static PyObject* pygear_clientpool_available(pygear_ClientPoolObject* self);
+PyDoc_STRVAR(pygear_clientpool_available_doc,
+"@return the number of clients that are not checked out.");
+
+static PyObject* pygear_clientpool_size(pygear_ClientPoolObject* self);
+PyDoc_STRVAR(pygear_clientpool_size_doc,
+"@return the number of clients in the pool.");
+
+static PyObject* pygear_clientpool_publish_stats(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_clientpool_publish_stats_doc,
+"Keep a copy of the pool stats in a file that other processes can map and\n"
+"read without locks, see pygear_stats.py: the 'size' and 'available' gauges,\n"
+"the 'checkouts', 'waits' (the pool was exhausted) and 'timeouts' counters,\n"
+"and the stats of the pooled clients summed, see Client.publish_stats. The\n"
+"file is removed when the pool is collected. A forked child stops updating\n"
+"the file of its parent, and may publish its own.\n"
+"@param[in] name - Name the readers aggregate the processes by.\n"
+"@param[in] directory - Optional, '/dev/shm' by default.\n"
+"@return the path of the file.");
+
+static PyObject* pygear_clientpool_do(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_clientpool_do_doc,
+"Run Client.do on a borrowed client. See Client.do.");
+
+static PyObject* pygear_clientpool_do_high(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_clientpool_do_high_doc,
+"Run Client.do_high on a borrowed client. See Client.do_high.");
+
+static PyObject* pygear_clientpool_do_low(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_clientpool_do_low_doc,
+"Run Client.do_low on a borrowed client. See Client.do_low.");
+
+static PyObject* pygear_clientpool_do_background(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_clientpool_do_background_doc,
+"Run Client.do_background on a borrowed client. See Client.do_background.");
+
+static PyObject* pygear_clientpool_do_high_background(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_clientpool_do_high_background_doc,
+"Run Client.do_high_background on a borrowed client. See Client.do_high_background.");
+
+static PyObject* pygear_clientpool_do_low_background(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_clientpool_do_low_background_doc,
+"Run Client.do_low_background on a borrowed client. See Client.do_low_background.");
+
+static PyObject* pygear_clientpool_job_status(pygear_ClientPoolObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_clientpool_job_status_doc,
+"Run Client.job_status on a borrowed client. See Client.job_status.");
+
+static PyObject* pygear_clientlease_enter(pygear_ClientLeaseObject* self);
+PyDoc_STRVAR(pygear_clientlease_enter_doc,
+"@return the borrowed Client.");
+
+static PyObject* pygear_clientlease_exit(pygear_ClientLeaseObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_clientlease_exit_doc,
+"Return the client to its pool. Exceptions are not suppressed.");
+
+static PyObject* pygear_clientlease_release(pygear_ClientLeaseObject* self);
+PyDoc_STRVAR(pygear_clientlease_release_doc,
+"Return the client to its pool. Calling it more than once has no effect.");
+
+
+/* Module method specification */
+static PyMethodDef clientpool_module_methods[] = {
+    // Checkout
+    _CLIENTPOOLMETHOD(checkout,             METH_VARARGS | METH_KEYWORDS)
+    _CLIENTPOOLMETHOD(available,            METH_NOARGS)
+    _CLIENTPOOLMETHOD(size,                 METH_NOARGS)
+    _CLIENTPOOLMETHOD(publish_stats,        METH_VARARGS | METH_KEYWORDS)
+
+    // Single job delegation
+    _CLIENTPOOLMETHOD(do,                   METH_VARARGS | METH_KEYWORDS)
+    _CLIENTPOOLMETHOD(do_high,              METH_VARARGS | METH_KEYWORDS)
+    _CLIENTPOOLMETHOD(do_low,               METH_VARARGS | METH_KEYWORDS)
+    _CLIENTPOOLMETHOD(do_background,        METH_VARARGS | METH_KEYWORDS)
+    _CLIENTPOOLMETHOD(do_high_background,   METH_VARARGS | METH_KEYWORDS)
+    _CLIENTPOOLMETHOD(do_low_background,    METH_VARARGS | METH_KEYWORDS)
+    _CLIENTPOOLMETHOD(job_status,           METH_VARARGS | METH_KEYWORDS)
+    {NULL, NULL, 0, NULL}
+};
+
+static PyMethodDef clientlease_module_methods[] = {
+    {"__enter__", (PyCFunction) pygear_clientlease_enter, METH_NOARGS, pygear_clientlease_enter_doc},
+    {"__exit__", (PyCFunction) pygear_clientlease_exit, METH_VARARGS, pygear_clientlease_exit_doc},
+    _CLIENTLEASEMETHOD(release,             METH_NOARGS)
+    {NULL, NULL, 0, NULL}
+};
+
+PyTypeObject pygear_ClientPoolType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /*ob_size*/
+    "pygear.ClientPool",                        /*tp_name*/
+    sizeof(pygear_ClientPoolObject),            /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)ClientPool_dealloc,             /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_BASETYPE |
+    Py_TPFLAGS_HAVE_GC,                         /*tp_flags*/
+    clientpool_module_docstring,                /* tp_doc */
+    (traverseproc)ClientPool_traverse,          /* tp_traverse */
+    (inquiry)ClientPool_clear,                  /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    clientpool_module_methods,                  /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    (initproc)ClientPool_init,                  /* tp_init */
+};
+
+PyTypeObject pygear_ClientLeaseType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /*ob_size*/
+    "pygear.ClientLease",                       /*tp_name*/
+    sizeof(pygear_ClientLeaseObject),           /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)ClientLease_dealloc,            /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_HAVE_GC,                         /*tp_flags*/
+    clientlease_module_docstring,               /* tp_doc */
+    (traverseproc)ClientLease_traverse,         /* tp_traverse */
+    (inquiry)ClientLease_clear,                 /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    clientlease_module_methods,                 /* tp_methods */
+};
+
+#endif
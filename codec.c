@@ -0,0 +1,607 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "codec.h"
+
+/*
+ * Class constructor / destructor methods
+ */
+
+int ArrayCodec_init(pygear_ArrayCodecObject* self, PyObject* args, PyObject* kwds) {
+    PyObject* fallback = Py_None;
+    static char* kwlist[] = {"fallback", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &fallback)) {
+        return -1;
+    }
+    if (fallback == Py_None) {
+        fallback = PyImport_ImportModule(PYTHON_SERIALIZER);
+        if (!fallback) {
+            return -1;
+        }
+    } else {
+        if (!PyObject_HasAttrString(fallback, "dumps") || !PyObject_HasAttrString(fallback, "loads")) {
+            PyErr_SetString(PyExc_AttributeError, "Fallback serializer must implement 'dumps' and 'loads'");
+            return -1;
+        }
+        Py_INCREF(fallback);
+    }
+    Py_XDECREF(self->fallback);
+    self->fallback = fallback;
+    return 0;
+}
+
+int ArrayCodec_traverse(pygear_ArrayCodecObject* self, visitproc visit, void* arg) {
+    Py_VISIT(self->fallback);
+    return 0;
+}
+
+int ArrayCodec_clear(pygear_ArrayCodecObject* self) {
+    Py_CLEAR(self->fallback);
+    return 0;
+}
+
+void ArrayCodec_dealloc(pygear_ArrayCodecObject* self) {
+    ArrayCodec_clear(self);
+    self->ob_type->tp_free((PyObject*)self);
+}
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+/*
+ * Return value: Borrowed reference.
+ * The numpy module, or NULL without an exception if it is not loaded and
+ * 'import' is false: then no ndarray can exist either.
+ */
+static PyObject* _pygear_arraycodec_numpy(bool import) {
+    static PyObject* numpy = NULL;
+    if (!numpy) {
+        if (import) {
+            numpy = PyImport_ImportModule("numpy");
+        } else {
+            numpy = PyDict_GetItemString(PyImport_GetModuleDict(), "numpy");
+            Py_XINCREF(numpy);
+        }
+    }
+    return numpy;
+}
+
+static void _pygear_arraycodec_put_uint(char* out, uint64_t value, int size) {
+    int i;
+    for (i = 0; i < size; ++i) {
+        out[i] = (char) (value >> (8 * i));
+    }
+}
+
+static uint64_t _pygear_arraycodec_get_uint(const char* in, int size) {
+    uint64_t value = 0;
+    int i;
+    for (i = 0; i < size; ++i) {
+        value |= (uint64_t) (unsigned char) in[i] << (8 * i);
+    }
+    return value;
+}
+
+/* Whether the attribute 'name' of 'obj' is true, -1 with an exception set on failure */
+static int _pygear_arraycodec_attr_true(PyObject* obj, const char* name) {
+    PyObject* attr = PyObject_GetAttrString(obj, name);
+    if (!attr) {
+        return -1;
+    }
+    int ret = PyObject_IsTrue(attr);
+    Py_DECREF(attr);
+    return ret;
+}
+
+/* Return value: New reference. The header and bytes of a C-contiguous array */
+static PyObject* _pygear_arraycodec_encode(PyObject* array) {
+    PyObject* ret = NULL;
+    PyObject* dtype = NULL;
+    PyObject* dtype_str = NULL;
+    PyObject* shape = NULL;
+    PyObject* strides = NULL;
+
+    dtype = PyObject_GetAttrString(array, "dtype");
+    if (!dtype) {
+        goto catch;
+    }
+    PyObject* names = PyObject_GetAttrString(dtype, "names");
+    if (!names) {
+        goto catch;
+    }
+    int structured = names != Py_None;
+    Py_DECREF(names);
+    int has_object = _pygear_arraycodec_attr_true(dtype, "hasobject");
+    if (has_object < 0) {
+        goto catch;
+    }
+    if (structured || has_object) {
+        PyErr_SetString(PyExc_TypeError, "Arrays of objects or of structured dtypes are not supported");
+        goto catch;
+    }
+    dtype_str = PyObject_GetAttrString(dtype, "str");
+    shape = PyObject_GetAttrString(array, "shape");
+    strides = PyObject_GetAttrString(array, "strides");
+    if (!dtype_str || !shape || !strides) {
+        goto catch;
+    }
+    if (!PyString_Check(dtype_str) || PyString_GET_SIZE(dtype_str) > UINT8_MAX
+        || !PyTuple_Check(shape) || !PyTuple_Check(strides)
+        || PyTuple_GET_SIZE(shape) != PyTuple_GET_SIZE(strides)) {
+        PyErr_SetString(PyExc_TypeError, "Unexpected dtype, shape or strides");
+        goto catch;
+    }
+    Py_ssize_t ndim = PyTuple_GET_SIZE(shape);
+    if (ndim > ARRAYCODEC_MAX_DIMS) {
+        PyErr_Format(PyExc_ValueError, "Arrays have at most %d dimensions", ARRAYCODEC_MAX_DIMS);
+        goto catch;
+    }
+    const void* data;
+    Py_ssize_t size;
+    if (PyObject_AsReadBuffer(array, &data, &size) < 0) {
+        goto catch;
+    }
+
+    Py_ssize_t dtype_size = PyString_GET_SIZE(dtype_str);
+    Py_ssize_t header_size = ARRAYCODEC_FIXED_SIZE + 2 * 8 * ndim + dtype_size;
+    header_size = (header_size + ARRAYCODEC_ALIGN - 1) / ARRAYCODEC_ALIGN * ARRAYCODEC_ALIGN;
+    ret = PyString_FromStringAndSize(NULL, header_size + size);
+    if (!ret) {
+        goto catch;
+    }
+    char* out = PyString_AS_STRING(ret);
+    memset(out, 0, header_size);
+    memcpy(out, ARRAYCODEC_MAGIC, ARRAYCODEC_MAGIC_SIZE);
+    _pygear_arraycodec_put_uint(out + 4, ndim, 1);
+    _pygear_arraycodec_put_uint(out + 5, dtype_size, 1);
+    _pygear_arraycodec_put_uint(out + 6, header_size, 2);
+    char* dims = out + ARRAYCODEC_FIXED_SIZE;
+    Py_ssize_t i;
+    for (i = 0; i < ndim; ++i) {
+        long long extent = PyLong_AsLongLong(PyTuple_GET_ITEM(shape, i));
+        long long stride = PyLong_AsLongLong(PyTuple_GET_ITEM(strides, i));
+        if (PyErr_Occurred()) {
+            Py_CLEAR(ret);
+            goto catch;
+        }
+        _pygear_arraycodec_put_uint(dims + 8 * i, (uint64_t) extent, 8);
+        _pygear_arraycodec_put_uint(dims + 8 * (ndim + i), (uint64_t) stride, 8);
+    }
+    memcpy(dims + 2 * 8 * ndim, PyString_AS_STRING(dtype_str), dtype_size);
+    memcpy(out + header_size, data, size);
+
+catch:
+    Py_XDECREF(dtype);
+    Py_XDECREF(dtype_str);
+    Py_XDECREF(shape);
+    Py_XDECREF(strides);
+    return ret;
+}
+
+/*
+ * Return value: New reference.
+ * An ndarray over the bytes following the header, which numpy checks the
+ * shape and strides against.
+ */
+static PyObject* _pygear_arraycodec_decode(PyObject* obj, const char* data, Py_ssize_t size) {
+    PyObject* ret = NULL;
+    PyObject* shape = NULL;
+    PyObject* strides = NULL;
+    PyObject* dtype = NULL;
+    PyObject* kwargs = NULL;
+
+    Py_ssize_t ndim = _pygear_arraycodec_get_uint(data + 4, 1);
+    Py_ssize_t dtype_size = _pygear_arraycodec_get_uint(data + 5, 1);
+    Py_ssize_t header_size = _pygear_arraycodec_get_uint(data + 6, 2);
+    if (ndim > ARRAYCODEC_MAX_DIMS || header_size > size
+        || ARRAYCODEC_FIXED_SIZE + 2 * 8 * ndim + dtype_size > header_size) {
+        PyErr_SetString(PyExc_ValueError, "Corrupt array header");
+        return NULL;
+    }
+    PyObject* numpy = _pygear_arraycodec_numpy(true);
+    if (!numpy) {
+        return NULL;
+    }
+    shape = PyTuple_New(ndim);
+    strides = PyTuple_New(ndim);
+    if (!shape || !strides) {
+        goto catch;
+    }
+    const char* dims = data + ARRAYCODEC_FIXED_SIZE;
+    Py_ssize_t i;
+    for (i = 0; i < ndim; ++i) {
+        PyObject* extent = PyLong_FromLongLong((long long) _pygear_arraycodec_get_uint(dims + 8 * i, 8));
+        if (!extent) {
+            goto catch;
+        }
+        PyTuple_SET_ITEM(shape, i, extent);
+        PyObject* stride = PyLong_FromLongLong((long long) _pygear_arraycodec_get_uint(dims + 8 * (ndim + i), 8));
+        if (!stride) {
+            goto catch;
+        }
+        PyTuple_SET_ITEM(strides, i, stride);
+    }
+    dtype = PyObject_CallMethod(numpy, "dtype", "s#", dims + 2 * 8 * ndim, (int) dtype_size);
+    if (!dtype) {
+        goto catch;
+    }
+    kwargs = Py_BuildValue("{s:O,s:O,s:O,s:n,s:O}",
+        "shape", shape, "dtype", dtype, "buffer", obj, "offset", header_size, "strides", strides);
+    if (!kwargs) {
+        goto catch;
+    }
+    PyObject* ndarray = PyObject_GetAttrString(numpy, "ndarray");
+    if (!ndarray) {
+        goto catch;
+    }
+    PyObject* empty = PyTuple_New(0);
+    if (empty) {
+        ret = PyObject_Call(ndarray, empty, kwargs);
+        Py_DECREF(empty);
+    }
+    Py_DECREF(ndarray);
+
+catch:
+    Py_XDECREF(shape);
+    Py_XDECREF(strides);
+    Py_XDECREF(dtype);
+    Py_XDECREF(kwargs);
+    return ret;
+}
+
+
+/********************
+ * Instance methods *
+ ********************
+ */
+
+static PyObject* pygear_arraycodec_dumps(pygear_ArrayCodecObject* self, PyObject* args) {
+    PyObject* obj;
+    if (!PyArg_ParseTuple(args, "O", &obj)) {
+        return NULL;
+    }
+    PyObject* numpy = _pygear_arraycodec_numpy(false);
+    if (numpy) {
+        PyObject* ndarray = PyObject_GetAttrString(numpy, "ndarray");
+        if (!ndarray) {
+            return NULL;
+        }
+        int is_array = PyObject_IsInstance(obj, ndarray);
+        Py_DECREF(ndarray);
+        if (is_array < 0) {
+            return NULL;
+        }
+        if (is_array) {
+            int contiguous = 0;
+            PyObject* flags = PyObject_GetAttrString(obj, "flags");
+            if (flags) {
+                contiguous = _pygear_arraycodec_attr_true(flags, "c_contiguous");
+                Py_DECREF(flags);
+            }
+            if (!flags || contiguous < 0) {
+                return NULL;
+            }
+            if (contiguous) {
+                return _pygear_arraycodec_encode(obj);
+            }
+            PyObject* copy = PyObject_CallMethod(numpy, "ascontiguousarray", "O", obj);
+            if (!copy) {
+                return NULL;
+            }
+            PyObject* ret = _pygear_arraycodec_encode(copy);
+            Py_DECREF(copy);
+            return ret;
+        }
+    }
+    return PyObject_CallMethod(self->fallback, "dumps", "O", obj);
+}
+
+static PyObject* pygear_arraycodec_loads(pygear_ArrayCodecObject* self, PyObject* args) {
+    PyObject* obj;
+    if (!PyArg_ParseTuple(args, "O", &obj)) {
+        return NULL;
+    }
+    const void* data = NULL;
+    Py_ssize_t size = 0;
+    // numpy keeps the pointer, which a Job or Task view only lends until it is released
+    if (PyObject_TypeCheck(obj, &pygear_ViewType) && ((pygear_ViewObject*) obj)->valid
+            && _pygear_view_own((pygear_ViewObject*) obj) < 0) {
+        return NULL;
+    }
+    if (PyString_Check(obj)) {
+        data = PyString_AS_STRING(obj);
+        size = PyString_GET_SIZE(obj);
+    } else if (PyObject_AsReadBuffer(obj, &data, &size) < 0) {
+        PyErr_Clear();
+        data = NULL;
+    }
+    if (data && size >= ARRAYCODEC_FIXED_SIZE && !memcmp(data, ARRAYCODEC_MAGIC, ARRAYCODEC_MAGIC_SIZE)) {
+        return _pygear_arraycodec_decode(obj, data, size);
+    }
+    return PyObject_CallMethod(self->fallback, "loads", "O", obj);
+}
+
+
+/*
+ * ZlibCodec constructor / destructor methods
+ */
+
+int ZlibCodec_init(pygear_ZlibCodecObject* self, PyObject* args, PyObject* kwds) {
+    PyObject* serializer = Py_None;
+    PyObject* dictionary = Py_None;
+    Py_ssize_t threshold = ZLIBCODEC_DEFAULT_THRESHOLD;
+    int level = ZLIBCODEC_DEFAULT_LEVEL;
+    Py_ssize_t max_size = ZLIBCODEC_DEFAULT_MAX_SIZE;
+    static char* kwlist[] = {"serializer", "threshold", "level", "dictionary", "max_size", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OniOn", kwlist, &serializer, &threshold, &level, &dictionary,
+            &max_size)) {
+        return -1;
+    }
+    if (max_size < 0) {
+        PyErr_SetString(PyExc_ValueError, "max_size can not be negative");
+        return -1;
+    }
+    if (level < 1 || level > 9) {
+        PyErr_SetString(PyExc_ValueError, "The zlib level is between 1 and 9");
+        return -1;
+    }
+    if (dictionary != Py_None && (!PyString_Check(dictionary) || !PyString_GET_SIZE(dictionary))) {
+        PyErr_SetString(PyExc_TypeError, "The preset dictionary is a non-empty string");
+        return -1;
+    }
+    if (serializer == Py_None) {
+        serializer = PyImport_ImportModule(PYTHON_SERIALIZER);
+        if (!serializer) {
+            return -1;
+        }
+    } else {
+        if (!PyObject_HasAttrString(serializer, "dumps") || !PyObject_HasAttrString(serializer, "loads")) {
+            PyErr_SetString(PyExc_AttributeError, "Serializer must implement 'dumps' and 'loads'");
+            return -1;
+        }
+        Py_INCREF(serializer);
+    }
+    Py_XDECREF(self->serializer);
+    self->serializer = serializer;
+    Py_CLEAR(self->dictionary);
+    if (dictionary != Py_None) {
+        Py_INCREF(dictionary);
+        self->dictionary = dictionary;
+    }
+    self->threshold = threshold;
+    self->level = level;
+    self->max_size = max_size;
+    self->compressed = 0;
+    self->uncompressed = 0;
+    self->bytes_in = 0;
+    self->bytes_out = 0;
+    return 0;
+}
+
+int ZlibCodec_traverse(pygear_ZlibCodecObject* self, visitproc visit, void* arg) {
+    Py_VISIT(self->serializer);
+    return 0;
+}
+
+int ZlibCodec_clear(pygear_ZlibCodecObject* self) {
+    Py_CLEAR(self->serializer);
+    Py_CLEAR(self->dictionary);
+    return 0;
+}
+
+void ZlibCodec_dealloc(pygear_ZlibCodecObject* self) {
+    ZlibCodec_clear(self);
+    self->ob_type->tp_free((PyObject*)self);
+}
+
+
+/*
+ * ZlibCodec private methods
+ */
+
+static bool _pygear_zlibcodec_is_compressed(const void* data, size_t size) {
+    return size >= ZLIBCODEC_HEADER_SIZE && !memcmp(data, ZLIBCODEC_MAGIC, ZLIBCODEC_MAGIC_SIZE);
+}
+
+/*
+ * Return value: New reference.
+ * The compressed payload, or NULL without an exception if compressing it
+ * does not make it smaller.
+ */
+static PyObject* _pygear_zlibcodec_compress(pygear_ZlibCodecObject* self, const char* data, size_t size) {
+    PyObject* ret = NULL;
+    PyObject* dictionary = self->dictionary;  /* kept while the GIL is released */
+    Py_XINCREF(dictionary);
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit(&stream, self->level) != Z_OK) {
+        Py_XDECREF(dictionary);
+        return PyErr_NoMemory();
+    }
+    if (dictionary && deflateSetDictionary(&stream, (const Bytef*) PyString_AS_STRING(dictionary),
+            PyString_GET_SIZE(dictionary)) != Z_OK) {
+        PyErr_SetString(PyExc_ValueError, "Invalid preset dictionary");
+        goto catch;
+    }
+    size_t bound = deflateBound(&stream, size);
+    ret = PyString_FromStringAndSize(NULL, ZLIBCODEC_HEADER_SIZE + bound);
+    if (!ret) {
+        goto catch;
+    }
+    char* out = PyString_AS_STRING(ret);
+    memcpy(out, ZLIBCODEC_MAGIC, ZLIBCODEC_MAGIC_SIZE);
+    out[3] = dictionary ? ZLIBCODEC_FLAG_DICTIONARY : 0;
+    _pygear_arraycodec_put_uint(out + 4, size, 4);
+    stream.next_in = (Bytef*) data;
+    stream.avail_in = size;
+    stream.next_out = (Bytef*) out + ZLIBCODEC_HEADER_SIZE;
+    stream.avail_out = bound;
+    int result;
+    Py_BEGIN_ALLOW_THREADS
+    result = deflate(&stream, Z_FINISH);
+    Py_END_ALLOW_THREADS
+    size_t compressed_size = ZLIBCODEC_HEADER_SIZE + stream.total_out;
+    if (result != Z_STREAM_END) {
+        Py_CLEAR(ret);
+        PyErr_SetString(PyExc_RuntimeError, "zlib failed to compress the payload");
+    } else if (compressed_size >= size) {
+        Py_CLEAR(ret);
+    } else {
+        _PyString_Resize(&ret, compressed_size);
+    }
+
+catch:
+    deflateEnd(&stream);
+    Py_XDECREF(dictionary);
+    return ret;
+}
+
+/* Return value: New reference. The payload following the header, decompressed */
+static PyObject* _pygear_zlibcodec_decompress(pygear_ZlibCodecObject* self, const char* data, size_t size) {
+    if ((data[3] & ZLIBCODEC_FLAG_DICTIONARY) && !self->dictionary) {
+        PyErr_SetString(PyExc_ValueError, "The payload was compressed with a preset dictionary");
+        return NULL;
+    }
+    size_t original_size = _pygear_arraycodec_get_uint(data + 4, 4);
+    // The size comes from the peer, check it before allocating that much
+    if (original_size > (size_t) self->max_size) {
+        PyErr_Format(PyExc_ValueError, "The payload decompresses to %zu bytes, more than max_size %zd",
+            original_size, self->max_size);
+        return NULL;
+    }
+    PyObject* ret = PyString_FromStringAndSize(NULL, original_size);
+    if (!ret) {
+        return NULL;
+    }
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+        Py_DECREF(ret);
+        return PyErr_NoMemory();
+    }
+    PyObject* dictionary = self->dictionary;  /* kept while the GIL is released */
+    Py_XINCREF(dictionary);
+    stream.next_in = (Bytef*) data + ZLIBCODEC_HEADER_SIZE;
+    stream.avail_in = size - ZLIBCODEC_HEADER_SIZE;
+    stream.next_out = (Bytef*) PyString_AS_STRING(ret);
+    stream.avail_out = original_size;
+    int result;
+    Py_BEGIN_ALLOW_THREADS
+    result = inflate(&stream, Z_FINISH);
+    if (result == Z_NEED_DICT && dictionary) {
+        result = inflateSetDictionary(&stream, (const Bytef*) PyString_AS_STRING(dictionary),
+            PyString_GET_SIZE(dictionary));
+        if (result == Z_OK) {
+            result = inflate(&stream, Z_FINISH);
+        }
+    }
+    Py_END_ALLOW_THREADS
+    size_t decompressed_size = stream.total_out;
+    inflateEnd(&stream);
+    Py_XDECREF(dictionary);
+    if (result != Z_STREAM_END || decompressed_size != original_size) {
+        Py_DECREF(ret);
+        PyErr_SetString(PyExc_ValueError, result == Z_DATA_ERROR ?
+            "Corrupt compressed payload, or a different preset dictionary" : "Corrupt compressed payload");
+        return NULL;
+    }
+    return ret;
+}
+
+
+/*
+ * ZlibCodec instance methods
+ */
+
+static PyObject* pygear_zlibcodec_dumps(pygear_ZlibCodecObject* self, PyObject* args) {
+    PyObject* obj;
+    if (!PyArg_ParseTuple(args, "O", &obj)) {
+        return NULL;
+    }
+    PyObject* serialized = PyObject_CallMethod(self->serializer, "dumps", "O", obj);
+    if (!serialized) {
+        return NULL;
+    }
+    const void* data;
+    Py_ssize_t size;
+    if (PyObject_AsReadBuffer(serialized, &data, &size) < 0) {
+        Py_DECREF(serialized);
+        return NULL;
+    }
+    if (size < self->threshold || (uint64_t) size > UINT32_MAX) {
+        self->uncompressed++;
+        return serialized;
+    }
+    PyObject* compressed = _pygear_zlibcodec_compress(self, data, size);
+    if (!compressed) {
+        if (PyErr_Occurred()) {
+            Py_DECREF(serialized);
+            return NULL;
+        }
+        self->uncompressed++;
+        return serialized;
+    }
+    self->compressed++;
+    self->bytes_in += size;
+    self->bytes_out += PyString_GET_SIZE(compressed);
+    Py_DECREF(serialized);
+    return compressed;
+}
+
+static PyObject* pygear_zlibcodec_loads(pygear_ZlibCodecObject* self, PyObject* args) {
+    PyObject* obj;
+    if (!PyArg_ParseTuple(args, "O", &obj)) {
+        return NULL;
+    }
+    const void* data = NULL;
+    Py_ssize_t size = 0;
+    if (PyObject_AsReadBuffer(obj, &data, &size) < 0) {
+        PyErr_Clear();
+        data = NULL;
+    }
+    if (!data || !_pygear_zlibcodec_is_compressed(data, size)) {
+        return PyObject_CallMethod(self->serializer, "loads", "O", obj);
+    }
+    PyObject* decompressed = _pygear_zlibcodec_decompress(self, data, size);
+    if (!decompressed) {
+        return NULL;
+    }
+    PyObject* ret = PyObject_CallMethod(self->serializer, "loads", "O", decompressed);
+    Py_DECREF(decompressed);
+    return ret;
+}
+
+static PyObject* pygear_zlibcodec_stats(pygear_ZlibCodecObject* self) {
+    return Py_BuildValue("{s:K,s:K,s:K,s:K}",
+        "compressed", self->compressed,
+        "uncompressed", self->uncompressed,
+        "bytes_in", self->bytes_in,
+        "bytes_out", self->bytes_out);
+}
@@ -0,0 +1,277 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <zlib.h>
+#include "structmember.h"
+
+#ifndef PyMODINIT_FUNC
+#define PyMODINIT_FUNC void
+#endif
+
+#ifndef CODEC_H
+#define CODEC_H
+
+#define _ARRAYCODECMETHOD(name,flags) {#name,(PyCFunction) pygear_arraycodec_##name,flags,pygear_arraycodec_##name##_doc},
+#define _ZLIBCODECMETHOD(name,flags) {#name,(PyCFunction) pygear_zlibcodec_##name,flags,pygear_zlibcodec_##name##_doc},
+
+/*
+ * An encoded array is a header followed by the array's bytes:
+ *   0  magic "PGA" and format version
+ *   4  uint8 number of dimensions
+ *   5  uint8 length of the dtype string
+ *   6  uint16 header length, padded to ARRAYCODEC_ALIGN
+ *   8  int64 shape, then int64 strides, one per dimension
+ *      dtype string, e.g. "<f8"
+ * Integers are little-endian.
+ */
+#define ARRAYCODEC_MAGIC "PGA\x01"
+#define ARRAYCODEC_MAGIC_SIZE 4
+#define ARRAYCODEC_FIXED_SIZE 8
+#define ARRAYCODEC_MAX_DIMS 32
+#define ARRAYCODEC_ALIGN 8
+
+typedef struct {
+    PyObject_HEAD
+    PyObject* fallback;     /* serializer for anything but arrays */
+} pygear_ArrayCodecObject;
+
+PyDoc_STRVAR(arraycodec_module_docstring,
+"Serializer sending numpy arrays as their raw bytes behind a small dtype,\n"
+"shape and strides header, for 'set_serializer' of a Client, Worker, Job or\n"
+"Task. Other objects go through the fallback serializer, json by default.\n"
+"numpy is only imported to decode an array, so it is an optional dependency.\n"
+"\n"
+"@param[in] fallback - Optional object with 'dumps' and 'loads'.\n\n"
+"Example:\n"
+"codec = pygear.ArrayCodec()\n"
+"client.set_serializer(codec)\n"
+"scores = client.do('score', numpy.zeros((128, 64), dtype='float32'))");
+
+/* Class init methods */
+int ArrayCodec_init(pygear_ArrayCodecObject* self, PyObject* args, PyObject* kwds);
+int ArrayCodec_traverse(pygear_ArrayCodecObject* self, visitproc visit, void* arg);
+int ArrayCodec_clear(pygear_ArrayCodecObject* self);
+void ArrayCodec_dealloc(pygear_ArrayCodecObject* self);
+
+/* Method definitions */
+static PyObject* pygear_arraycodec_dumps(pygear_ArrayCodecObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_arraycodec_dumps_doc,
+"Serialize an object. An ndarray that is not C-contiguous is copied once\n"
+"into one that is; otherwise its bytes are read through the buffer protocol.\n"
+"Arrays of objects or of structured dtypes are not supported.\n"
+"@param[in] obj - The object to serialize.\n"
+"@return a string.");
+
+static PyObject* pygear_arraycodec_loads(pygear_ArrayCodecObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_arraycodec_loads_doc,
+"Deserialize a string or buffer. An encoded array is returned as a read-only\n"
+"ndarray viewing the given bytes, without a copy, and keeps them alive. A\n"
+"Job or Task view first copies its bytes, which it only borrows.\n"
+"@param[in] data - The bytes to deserialize.\n"
+"@return the decoded object.");
+
+
+/* Module method specification */
+static PyMethodDef arraycodec_module_methods[] = {
+    _ARRAYCODECMETHOD(dumps,            METH_VARARGS)
+    _ARRAYCODECMETHOD(loads,            METH_VARARGS)
+    {NULL, NULL, 0, NULL}
+};
+
+PyTypeObject pygear_ArrayCodecType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /*ob_size*/
+    "pygear.ArrayCodec",                        /*tp_name*/
+    sizeof(pygear_ArrayCodecObject),            /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)ArrayCodec_dealloc,             /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_BASETYPE |
+    Py_TPFLAGS_HAVE_GC,                         /*tp_flags*/
+    arraycodec_module_docstring,                /* tp_doc */
+    (traverseproc)ArrayCodec_traverse,          /* tp_traverse */
+    (inquiry)ArrayCodec_clear,                  /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    arraycodec_module_methods,                  /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    (initproc)ArrayCodec_init,                  /* tp_init */
+};
+
+
+/*
+ * A compressed payload is a header followed by a zlib stream:
+ *   0  magic "PGZ"
+ *   3  uint8 flags, ZLIBCODEC_FLAG_*
+ *   4  uint32 size of the uncompressed payload, little-endian
+ * Payloads without the header are not compressed.
+ */
+#define ZLIBCODEC_MAGIC "PGZ"
+#define ZLIBCODEC_MAGIC_SIZE 3
+#define ZLIBCODEC_HEADER_SIZE 8
+#define ZLIBCODEC_FLAG_DICTIONARY 0x01
+#define ZLIBCODEC_DEFAULT_THRESHOLD 1024
+#define ZLIBCODEC_DEFAULT_LEVEL 6
+#define ZLIBCODEC_DEFAULT_MAX_SIZE (64 * 1024 * 1024)
+
+typedef struct {
+    PyObject_HEAD
+    PyObject* serializer;       /* encodes before compression */
+    PyObject* dictionary;       /* preset dictionary string, or NULL */
+    Py_ssize_t threshold;       /* smallest payload compressed */
+    int level;
+    Py_ssize_t max_size;        /* largest uncompressed size 'loads' accepts */
+    unsigned long long compressed;
+    unsigned long long uncompressed;
+    unsigned long long bytes_in;    /* of the payloads compressed */
+    unsigned long long bytes_out;   /* they were compressed to, with headers */
+} pygear_ZlibCodecObject;
+
+PyDoc_STRVAR(zlibcodec_module_docstring,
+"Serializer compressing the payloads of another one with zlib, for\n"
+"'set_serializer' of a Client, Worker, Job or Task. Payloads of at least\n"
+"'threshold' bytes are compressed behind a small header, unless that does\n"
+"not make them smaller; 'loads' only decompresses payloads carrying the\n"
+"header, so peers sending uncompressed payloads are still understood.\n"
+"\n"
+"@param[in] serializer - Optional serializer encoding the objects, json by default.\n"
+"@param[in] threshold - Optional, the smallest payload size compressed. 1024 by default.\n"
+"@param[in] level - Optional zlib level, from 1 (fastest) to 9 (smallest). 6 by default.\n"
+"@param[in] dictionary - Optional preset dictionary: a string of substrings\n"
+"\tcommon in the payloads, such as JSON keys. Both sides need the same one.\n"
+"@param[in] max_size - Optional, the largest uncompressed size 'loads' accepts,\n"
+"\tas claimed by the header of a payload. 64 MiB by default.\n\n"
+"Example:\n"
+"codec = pygear.ZlibCodec(threshold=4096, dictionary=open('keys.dict').read())\n"
+"client.set_serializer(codec)");
+
+/* Class init methods */
+int ZlibCodec_init(pygear_ZlibCodecObject* self, PyObject* args, PyObject* kwds);
+int ZlibCodec_traverse(pygear_ZlibCodecObject* self, visitproc visit, void* arg);
+int ZlibCodec_clear(pygear_ZlibCodecObject* self);
+void ZlibCodec_dealloc(pygear_ZlibCodecObject* self);
+
+/* Private methods */
+static bool _pygear_zlibcodec_is_compressed(const void* data, size_t size);
+
+/* Method definitions */
+static PyObject* pygear_zlibcodec_dumps(pygear_ZlibCodecObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_zlibcodec_dumps_doc,
+"Serialize an object, and compress it if it is large enough.\n"
+"@param[in] obj - The object to serialize.\n"
+"@return a string.");
+
+static PyObject* pygear_zlibcodec_loads(pygear_ZlibCodecObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_zlibcodec_loads_doc,
+"Decompress a payload if it is compressed, then deserialize it.\n"
+"@param[in] data - The bytes to deserialize.\n"
+"@return the decoded object.");
+
+static PyObject* pygear_zlibcodec_stats(pygear_ZlibCodecObject* self);
+PyDoc_STRVAR(pygear_zlibcodec_stats_doc,
+"@return a dict with the number of payloads 'compressed' and left\n"
+"'uncompressed' by 'dumps', and the 'bytes_in' of those compressed and the\n"
+"'bytes_out' they were compressed to, headers included.");
+
+
+/* Module method specification */
+static PyMethodDef zlibcodec_module_methods[] = {
+    _ZLIBCODECMETHOD(dumps,             METH_VARARGS)
+    _ZLIBCODECMETHOD(loads,             METH_VARARGS)
+    _ZLIBCODECMETHOD(stats,             METH_NOARGS)
+    {NULL, NULL, 0, NULL}
+};
+
+PyTypeObject pygear_ZlibCodecType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /*ob_size*/
+    "pygear.ZlibCodec",                         /*tp_name*/
+    sizeof(pygear_ZlibCodecObject),             /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)ZlibCodec_dealloc,              /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_BASETYPE |
+    Py_TPFLAGS_HAVE_GC,                         /*tp_flags*/
+    zlibcodec_module_docstring,                 /* tp_doc */
+    (traverseproc)ZlibCodec_traverse,           /* tp_traverse */
+    (inquiry)ZlibCodec_clear,                   /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    zlibcodec_module_methods,                   /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    (initproc)ZlibCodec_init,                   /* tp_init */
+};
+
+#endif
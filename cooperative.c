@@ -0,0 +1,344 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cooperative.h"
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+static bool _pygear_cooperative_enabled(void) {
+    return _pygear_wait_hook != NULL;
+}
+
+static double _pygear_monotonic(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void _pygear_cooperative_start(pygear_cooperative_state* state, int timeout_ms) {
+    state->deadline = (timeout_ms < 0 ? -1 : _pygear_monotonic() + timeout_ms / 1000.0);
+    state->slice_ms = PYGEAR_COOPERATIVE_MIN_SLICE_MS;
+}
+
+/*
+ * Hand control to the wait hook for the current slice, bounded by the deadline.
+ * Return GEARMAN_SUCCESS to keep waiting, GEARMAN_TIMEOUT once the deadline
+ * has passed, GEARMAN_ERROR with a python exception set if the hook raised.
+ */
+static gearman_return_t _pygear_cooperative_yield(pygear_cooperative_state* state) {
+    double wait = state->slice_ms / 1000.0;
+    if (state->deadline >= 0) {
+        double remaining = state->deadline - _pygear_monotonic();
+        if (remaining <= 0) {
+            return GEARMAN_TIMEOUT;
+        }
+        if (remaining < wait) {
+            wait = remaining;
+        }
+    }
+    // The hook may uninstall itself while it runs
+    PyObject* hook = _pygear_wait_hook;
+    if (!hook) {
+        return GEARMAN_SUCCESS;
+    }
+    Py_INCREF(hook);
+    PyObject* hook_return = PyObject_CallFunction(hook, "iOd", -1, Py_False, wait);
+    Py_DECREF(hook);
+    if (!hook_return) {
+        return GEARMAN_ERROR;
+    }
+    Py_DECREF(hook_return);
+    state->slice_ms *= 2;
+    if (state->slice_ms > PYGEAR_COOPERATIVE_MAX_SLICE_MS) {
+        state->slice_ms = PYGEAR_COOPERATIVE_MAX_SLICE_MS;
+    }
+    return GEARMAN_SUCCESS;
+}
+
+/*
+ * Wait until 'fd' is readable (or writable), going through the wait hook if
+ * one is installed. 'deadline' is in monotonic seconds, negative for none.
+ * Return 1 when the descriptor is ready, 0 on timeout, -1 with a python
+ * exception set on failure.
+ */
+static int _pygear_cooperative_wait_fd(int fd, bool for_write, double deadline) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = (for_write ? POLLOUT : POLLIN);
+    while (true) {
+        double remaining = (deadline < 0 ? -1 : deadline - _pygear_monotonic());
+        int poll_timeout = 0;
+        if (!_pygear_wait_hook) {
+            poll_timeout = (deadline < 0 ? -1 : (remaining > 0 ? (int) (remaining * 1000) : 0));
+        }
+        pfd.revents = 0;
+        int poll_result = poll(&pfd, 1, poll_timeout);
+        if (poll_result > 0) {
+            return 1;
+        }
+        if (poll_result < 0 && errno != EINTR) {
+            PyObject* err_string = PyString_FromFormat("Failed to poll socket: %s", strerror(errno));
+            PyErr_SetObject(PyGearExn_ERROR, err_string);
+            Py_XDECREF(err_string);
+            return -1;
+        }
+        if (deadline >= 0 && remaining <= 0) {
+            return 0;
+        }
+        if (!_pygear_wait_hook) {
+            if (poll_result == 0) {
+                return 0;
+            }
+            continue;  // interrupted, poll again
+        }
+        PyObject* hook = _pygear_wait_hook;
+        Py_INCREF(hook);
+        PyObject* hook_return = (deadline < 0 ?
+            PyObject_CallFunction(hook, "iOO", fd, (for_write ? Py_True : Py_False), Py_None) :
+            PyObject_CallFunction(hook, "iOd", fd, (for_write ? Py_True : Py_False), remaining));
+        Py_DECREF(hook);
+        if (!hook_return) {
+            return -1;
+        }
+        Py_DECREF(hook_return);
+    }
+}
+
+
+/*
+ * Check for activity on the client connections without blocking.
+ */
+static gearman_return_t _pygear_cooperative_client_poll(gearman_client_st* client) {
+    int timeout = gearman_client_timeout(client);
+    gearman_client_set_timeout(client, 0);
+    gearman_return_t ret = gearman_client_wait(client);
+    gearman_client_set_timeout(client, timeout);
+    return ret;
+}
+
+static gearman_return_t _pygear_cooperative_worker_poll(gearman_worker_st* worker) {
+    int timeout = gearman_worker_timeout(worker);
+    gearman_worker_set_timeout(worker, 0);
+    gearman_return_t ret = gearman_worker_wait(worker);
+    gearman_worker_set_timeout(worker, timeout);
+    return ret;
+}
+
+/*
+ * Cooperative equivalent of gearman_client_wait: yield to the hook until one
+ * of the connections has activity or the client timeout expires.
+ */
+static gearman_return_t _pygear_cooperative_client_wait(gearman_client_st* client) {
+    pygear_cooperative_state state;
+    _pygear_cooperative_start(&state, gearman_client_timeout(client));
+    while (true) {
+        gearman_return_t ret = _pygear_cooperative_client_poll(client);
+        if (ret != GEARMAN_TIMEOUT) {
+            return ret;
+        }
+        ret = _pygear_cooperative_yield(&state);
+        if (ret != GEARMAN_SUCCESS) {
+            return ret;
+        }
+    }
+}
+
+static gearman_return_t _pygear_cooperative_worker_wait(gearman_worker_st* worker) {
+    pygear_cooperative_state state;
+    _pygear_cooperative_start(&state, gearman_worker_timeout(worker));
+    while (true) {
+        gearman_return_t ret = _pygear_cooperative_worker_poll(worker);
+        if (ret != GEARMAN_TIMEOUT) {
+            return ret;
+        }
+        ret = _pygear_cooperative_yield(&state);
+        if (ret != GEARMAN_SUCCESS) {
+            return ret;
+        }
+    }
+}
+
+/*
+ * Cooperative equivalent of gearman_client_run_tasks.
+ * The client is switched to non-blocking mode for the duration of the call.
+ */
+static gearman_return_t _pygear_cooperative_client_run_tasks(gearman_client_st* client) {
+    bool was_non_blocking = gearman_client_has_option(client, GEARMAN_CLIENT_NON_BLOCKING);
+    gearman_client_add_options(client, GEARMAN_CLIENT_NON_BLOCKING);
+    gearman_return_t ret;
+    while ((ret = gearman_client_run_tasks(client)) == GEARMAN_IO_WAIT) {
+        ret = _pygear_cooperative_client_wait(client);
+        if (ret != GEARMAN_SUCCESS) {
+            break;
+        }
+    }
+    if (!was_non_blocking) {
+        gearman_client_remove_options(client, GEARMAN_CLIENT_NON_BLOCKING);
+    }
+    return ret;
+}
+
+/*
+ * Cooperative equivalent of gearman_client_do and gearman_client_do_background.
+ * libgearman always blocks inside its do functions, so the job is submitted
+ * as a task and driven through _pygear_cooperative_client_run_tasks.
+ * For background jobs pass 'job_handle', a GEARMAN_JOB_HANDLE_SIZE buffer.
+ * Return value: the malloc'd result of a foreground job, NULL otherwise.
+ */
+static void* _pygear_cooperative_client_do(gearman_client_st* client, pygear_add_task_fn add_task,
+    const char* function_name, const char* unique, const void* workload, size_t workload_size,
+    size_t* result_size, char* job_handle, gearman_return_t* ret_ptr) {
+    // The task has to outlive run_tasks to hand its result back
+    bool free_tasks = gearman_client_has_option(client, GEARMAN_CLIENT_FREE_TASKS);
+    gearman_client_remove_options(client, GEARMAN_CLIENT_FREE_TASKS);
+    void* result = NULL;
+    if (result_size) {
+        *result_size = 0;
+    }
+    gearman_task_st* task = add_task(client, NULL, NULL, function_name, unique,
+        workload, workload_size, ret_ptr);
+    if (gearman_success(*ret_ptr)) {
+        *ret_ptr = _pygear_cooperative_client_run_tasks(client);
+    }
+    if (gearman_success(*ret_ptr)) {
+        *ret_ptr = gearman_task_return(task);
+    }
+    if (gearman_success(*ret_ptr)) {
+        if (job_handle) {
+            strncpy(job_handle, gearman_task_job_handle(task), GEARMAN_JOB_HANDLE_SIZE - 1);
+            job_handle[GEARMAN_JOB_HANDLE_SIZE - 1] = '\0';
+        }
+        gearman_result_st* task_result = gearman_task_result(task);
+        if (result_size && task_result && gearman_result_size(task_result)) {
+            *result_size = gearman_result_size(task_result);
+            result = malloc(*result_size);
+            if (result) {
+                memcpy(result, gearman_result_value(task_result), *result_size);
+            } else {
+                *result_size = 0;
+                *ret_ptr = GEARMAN_MEMORY_ALLOCATION_FAILURE;
+            }
+        }
+    }
+    if (task) {
+        gearman_task_free(task);
+    }
+    if (free_tasks) {
+        gearman_client_add_options(client, GEARMAN_CLIENT_FREE_TASKS);
+    }
+    return result;
+}
+
+/*
+ * Cooperative equivalent of gearman_client_job_status.
+ */
+static gearman_return_t _pygear_cooperative_client_job_status(gearman_client_st* client,
+    const char* job_handle, bool* is_known, bool* is_running, unsigned* numerator, unsigned* denominator) {
+    bool free_tasks = gearman_client_has_option(client, GEARMAN_CLIENT_FREE_TASKS);
+    gearman_client_remove_options(client, GEARMAN_CLIENT_FREE_TASKS);
+    gearman_return_t ret;
+    gearman_task_st* task = gearman_client_add_task_status(client, NULL, NULL, job_handle, &ret);
+    if (gearman_success(ret)) {
+        ret = _pygear_cooperative_client_run_tasks(client);
+    }
+    if (gearman_success(ret)) {
+        *is_known = gearman_task_is_known(task);
+        *is_running = gearman_task_is_running(task);
+        *numerator = gearman_task_numerator(task);
+        *denominator = gearman_task_denominator(task);
+    }
+    if (task) {
+        gearman_task_free(task);
+    }
+    if (free_tasks) {
+        gearman_client_add_options(client, GEARMAN_CLIENT_FREE_TASKS);
+    }
+    return ret;
+}
+
+/*
+ * Cooperative equivalent of gearman_worker_work.
+ * In non-blocking mode libgearman returns GEARMAN_NO_JOBS after telling the
+ * server it is going to sleep; the server wakes the connection up with a NOOP
+ * once a job is available, which is what the wait loop watches for.
+ */
+static gearman_return_t _pygear_cooperative_worker_work(gearman_worker_st* worker) {
+    bool was_non_blocking = gearman_worker_options(worker) & GEARMAN_WORKER_NON_BLOCKING;
+    gearman_worker_add_options(worker, GEARMAN_WORKER_NON_BLOCKING);
+    gearman_return_t ret;
+    while (true) {
+        ret = gearman_worker_work(worker);
+        if (PyErr_Occurred() || (ret != GEARMAN_IO_WAIT && ret != GEARMAN_NO_JOBS)) {
+            break;
+        }
+        ret = _pygear_cooperative_worker_wait(worker);
+        if (ret != GEARMAN_SUCCESS) {
+            break;
+        }
+    }
+    if (!was_non_blocking) {
+        gearman_worker_remove_options(worker, GEARMAN_WORKER_NON_BLOCKING);
+    }
+    return ret;
+}
+
+
+/******************
+ * Module methods *
+ ******************/
+
+static PyObject* pygear_set_wait_hook(void* self, PyObject* args) {
+    PyObject* hook;
+    if (!PyArg_ParseTuple(args, "O", &hook)) {
+        return NULL;
+    }
+    if (hook != Py_None && !PyCallable_Check(hook)) {
+        PyErr_SetString(PyExc_TypeError, "set_wait_hook expected a callable or None");
+        return NULL;
+    }
+    if (hook == Py_None) {
+        Py_CLEAR(_pygear_wait_hook);
+    } else {
+        Py_INCREF(hook);
+        Py_XDECREF(_pygear_wait_hook);
+        _pygear_wait_hook = hook;
+    }
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_wait_hook(void* self) {
+    if (!_pygear_wait_hook) {
+        Py_RETURN_NONE;
+    }
+    Py_INCREF(_pygear_wait_hook);
+    return _pygear_wait_hook;
+}
@@ -0,0 +1,90 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <libgearman-1.0/gearman.h>
+#include <poll.h>
+#include <time.h>
+#include "exception.h"
+
+#ifndef COOPERATIVE_H
+#define COOPERATIVE_H
+
+/*
+ * Bounds, in milliseconds, of how long a cooperative wait yields to the hook
+ * when libgearman has no descriptor to offer. The slice doubles while nothing
+ * happens and drops back to the minimum as soon as there is progress.
+ */
+#define PYGEAR_COOPERATIVE_MIN_SLICE_MS 1
+#define PYGEAR_COOPERATIVE_MAX_SLICE_MS 32
+
+/* Python callable fn(fd, for_write, timeout), NULL when blocking I/O is used */
+static PyObject* _pygear_wait_hook = NULL;
+
+typedef struct {
+    double deadline;    /* monotonic seconds, negative means no deadline */
+    int slice_ms;
+} pygear_cooperative_state;
+
+typedef gearman_task_st* (*pygear_add_task_fn)(gearman_client_st*, gearman_task_st*, void*,
+    const char*, const char*, const void*, size_t, gearman_return_t*);
+
+/* Private methods */
+static bool _pygear_cooperative_enabled(void);
+static double _pygear_monotonic(void);
+static void _pygear_cooperative_start(pygear_cooperative_state* state, int timeout_ms);
+static gearman_return_t _pygear_cooperative_yield(pygear_cooperative_state* state);
+static int _pygear_cooperative_wait_fd(int fd, bool for_write, double deadline);
+static gearman_return_t _pygear_cooperative_client_run_tasks(gearman_client_st* client);
+static gearman_return_t _pygear_cooperative_client_wait(gearman_client_st* client);
+static void* _pygear_cooperative_client_do(gearman_client_st* client, pygear_add_task_fn add_task,
+    const char* function_name, const char* unique, const void* workload, size_t workload_size,
+    size_t* result_size, char* job_handle, gearman_return_t* ret_ptr);
+static gearman_return_t _pygear_cooperative_client_job_status(gearman_client_st* client,
+    const char* job_handle, bool* is_known, bool* is_running, unsigned* numerator, unsigned* denominator);
+static gearman_return_t _pygear_cooperative_worker_work(gearman_worker_st* worker);
+static gearman_return_t _pygear_cooperative_worker_wait(gearman_worker_st* worker);
+
+/* Module methods */
+static PyObject* pygear_set_wait_hook(void* self, PyObject* args);
+PyDoc_STRVAR(pygear_set_wait_hook_doc,
+"Install a hook that makes pygear I/O cooperative, e.g. under gevent.\n\n"
+"While a hook is installed, Client, Worker and Admin put their connections in\n"
+"non-blocking mode and, instead of blocking the thread, call\n"
+"hook(fd, for_write, timeout) whenever they have to wait. The hook should\n"
+"yield to the event loop until 'fd' is ready or 'timeout' seconds have passed,\n"
+"whichever comes first. 'fd' is -1 when libgearman does not expose the\n"
+"descriptor; the hook should then just sleep for 'timeout'. Exceptions raised\n"
+"by the hook abort the pending call and propagate to its caller.\n\n"
+"@param[in] hook - Callable, or None to restore blocking I/O.");
+
+static PyObject* pygear_wait_hook(void* self);
+PyDoc_STRVAR(pygear_wait_hook_doc,
+"@return the hook installed with set_wait_hook, or None.");
+
+#endif
@@ -0,0 +1,281 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "envelope.h"
+
+/* Codec id -> serializer, see pygear.register_codec */
+static PyObject* g_pygear_codecs = NULL;
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+static void _pygear_envelope_put_uint(char* out, uint64_t value, int size) {
+    int i;
+    for (i = 0; i < size; ++i) {
+        out[i] = (char) (value >> (8 * i));
+    }
+}
+
+static uint64_t _pygear_envelope_get_uint(const char* in, int size) {
+    uint64_t value = 0;
+    int i;
+    for (i = 0; i < size; ++i) {
+        value |= (uint64_t) (unsigned char) in[i] << (8 * i);
+    }
+    return value;
+}
+
+static uint64_t _pygear_envelope_now_us(void) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+static size_t _pygear_envelope_parse(const char* data, size_t size, pygear_envelope* envelope) {
+    if (!data || size < ENVELOPE_SIZE || memcmp(data, ENVELOPE_MAGIC, ENVELOPE_MAGIC_SIZE)) {
+        return 0;
+    }
+    size_t header_size = _pygear_envelope_get_uint(data + 4, 2);
+    if (header_size < ENVELOPE_SIZE || header_size > size) {
+        return 0;
+    }
+    envelope->version = data[3];
+    envelope->codec = data[6];
+    envelope->flags = data[7];
+    envelope->sent_us = _pygear_envelope_get_uint(data + 8, 8);
+    envelope->deadline_us = _pygear_envelope_get_uint(data + 16, 8);
+    memcpy(envelope->trace_id, data + 24, ENVELOPE_TRACE_ID_SIZE);
+    bool timed = header_size >= ENVELOPE_REPLY_SIZE;
+    envelope->grabbed_us = timed ? _pygear_envelope_get_uint(data + 40, 8) : 0;
+    envelope->started_us = timed ? _pygear_envelope_get_uint(data + 48, 8) : 0;
+    return header_size;
+}
+
+/* Header size _pygear_envelope_write uses, replies carry the worker times */
+static size_t _pygear_envelope_size(const pygear_envelope* envelope) {
+    return (envelope->flags & ENVELOPE_FLAG_REPLY) ? ENVELOPE_REPLY_SIZE : ENVELOPE_SIZE;
+}
+
+static void _pygear_envelope_write(const pygear_envelope* envelope, char* out) {
+    memcpy(out, ENVELOPE_MAGIC, ENVELOPE_MAGIC_SIZE);
+    out[3] = ENVELOPE_VERSION;
+    _pygear_envelope_put_uint(out + 4, _pygear_envelope_size(envelope), 2);
+    out[6] = envelope->codec;
+    out[7] = envelope->flags;
+    _pygear_envelope_put_uint(out + 8, envelope->sent_us, 8);
+    _pygear_envelope_put_uint(out + 16, envelope->deadline_us, 8);
+    memcpy(out + 24, envelope->trace_id, ENVELOPE_TRACE_ID_SIZE);
+    if (envelope->flags & ENVELOPE_FLAG_REPLY) {
+        _pygear_envelope_put_uint(out + 40, envelope->grabbed_us, 8);
+        _pygear_envelope_put_uint(out + 48, envelope->started_us, 8);
+    }
+}
+
+static int _pygear_envelope_wrap(pygear_payload* payload, const pygear_envelope* envelope) {
+    size_t header_size = _pygear_envelope_size(envelope);
+    char* wrapped = malloc(header_size + payload->size);
+    if (!wrapped) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    _pygear_envelope_write(envelope, wrapped);
+    memcpy(wrapped + header_size, payload->data, payload->size);
+    size_t size = header_size + payload->size;
+    _pygear_payload_release(payload);
+    payload->gathered = wrapped;
+    payload->data = wrapped;
+    payload->size = size;
+    return 0;
+}
+
+/* Return value: Borrowed reference. The registry, with json and cPickle registered */
+static PyObject* _pygear_envelope_codecs(void) {
+    if (!g_pygear_codecs) {
+        g_pygear_codecs = PyDict_New();
+        if (!g_pygear_codecs) {
+            return NULL;
+        }
+        const char* builtins[] = {NULL, "json", "cPickle"};
+        int codec;
+        for (codec = ENVELOPE_CODEC_JSON; codec <= ENVELOPE_CODEC_PICKLE; ++codec) {
+            PyObject* module = PyImport_ImportModule(builtins[codec]);
+            PyObject* key = PyInt_FromLong(codec);
+            if (!module || !key || PyDict_SetItem(g_pygear_codecs, key, module) < 0) {
+                PyErr_Clear();
+            }
+            Py_XDECREF(module);
+            Py_XDECREF(key);
+        }
+    }
+    return g_pygear_codecs;
+}
+
+static uint8_t _pygear_envelope_codec_id(PyObject* serializer) {
+    PyObject* codecs = _pygear_envelope_codecs();
+    PyObject* key;
+    PyObject* value;
+    Py_ssize_t pos = 0;
+    while (codecs && PyDict_Next(codecs, &pos, &key, &value)) {
+        if (value == serializer) {
+            return (uint8_t) PyInt_AS_LONG(key);
+        }
+    }
+    return ENVELOPE_CODEC_LOCAL;
+}
+
+static PyObject* _pygear_envelope_serializer(const pygear_envelope* envelope, PyObject* serializer) {
+    if (!envelope || envelope->codec == ENVELOPE_CODEC_LOCAL) {
+        return serializer;
+    }
+    if (envelope->codec == ENVELOPE_CODEC_RAW) {
+        return Py_None;
+    }
+    PyObject* codecs = _pygear_envelope_codecs();
+    PyObject* key = PyInt_FromLong(envelope->codec);
+    PyObject* registered = (codecs && key) ? PyDict_GetItem(codecs, key) : NULL;
+    Py_XDECREF(key);
+    return registered ? registered : serializer;
+}
+
+static PyObject* _pygear_envelope_loads(const pygear_envelope* envelope, PyObject* serializer,
+    const char* data, size_t size) {
+    PyObject* py_data = PyString_FromStringAndSize(data, size);
+    serializer = _pygear_envelope_serializer(envelope, serializer);
+    if (!py_data || serializer == Py_None) {
+        return py_data;
+    }
+    PyObject* ret = PyObject_CallMethod(serializer, "loads", "O", py_data);
+    Py_DECREF(py_data);
+    return ret;
+}
+
+static PyObject* _pygear_envelope_describe(const pygear_envelope* envelope) {
+    static const char hex[] = "0123456789abcdef";
+    char trace_id[2 * ENVELOPE_TRACE_ID_SIZE];
+    int i;
+    for (i = 0; i < ENVELOPE_TRACE_ID_SIZE; ++i) {
+        trace_id[2 * i] = hex[envelope->trace_id[i] >> 4];
+        trace_id[2 * i + 1] = hex[envelope->trace_id[i] & 0xF];
+    }
+    PyObject* deadline = envelope->deadline_us ? PyFloat_FromDouble(envelope->deadline_us / 1e6) : Py_None;
+    if (deadline == Py_None) {
+        Py_INCREF(deadline);
+    }
+    PyObject* ret = Py_BuildValue("{s:i,s:i,s:d,s:N,s:s#}",
+        "version", envelope->version,
+        "codec", envelope->codec,
+        "sent", envelope->sent_us / 1e6,
+        "deadline", deadline,
+        "trace_id", trace_id, 2 * ENVELOPE_TRACE_ID_SIZE);
+    // Replies also say when the worker grabbed and started the job
+    if (ret && envelope->grabbed_us) {
+        PyObject* started = envelope->started_us ? PyFloat_FromDouble(envelope->started_us / 1e6) : Py_None;
+        if (started == Py_None) {
+            Py_INCREF(started);
+        }
+        PyObject* grabbed = PyFloat_FromDouble(envelope->grabbed_us / 1e6);
+        if (!started || !grabbed || PyDict_SetItemString(ret, "grabbed", grabbed) < 0 ||
+            PyDict_SetItemString(ret, "started", started) < 0) {
+            Py_CLEAR(ret);
+        }
+        Py_XDECREF(started);
+        Py_XDECREF(grabbed);
+    }
+    return ret;
+}
+
+static gearman_return_t _pygear_envelope_reply(gearman_job_st* job,
+    gearman_return_t (*send)(gearman_job_st*, const void*, size_t),
+    const pygear_envelope* request, uint64_t grabbed_us, uint64_t started_us,
+    uint8_t codec, const void* data, size_t size) {
+    if (!request) {
+        return send(job, data, size);
+    }
+    char* wrapped = malloc(ENVELOPE_REPLY_SIZE + size);
+    if (!wrapped) {
+        return GEARMAN_MEMORY_ALLOCATION_FAILURE;
+    }
+    pygear_envelope envelope = *request;
+    envelope.codec = codec;
+    envelope.flags = ENVELOPE_FLAG_REPLY;
+    envelope.sent_us = _pygear_envelope_now_us();
+    envelope.grabbed_us = grabbed_us;
+    envelope.started_us = started_us;
+    _pygear_envelope_write(&envelope, wrapped);
+    if (size) {
+        memcpy(wrapped + ENVELOPE_REPLY_SIZE, data, size);
+    }
+    gearman_return_t ret = send(job, wrapped, ENVELOPE_REPLY_SIZE + size);
+    free(wrapped);
+    return ret;
+}
+
+
+/***************************
+ * Module instance methods *
+ ***************************/
+
+static PyObject* pygear_register_codec(PyObject* self, PyObject* args) {
+    int codec_id;
+    PyObject* serializer;
+    if (!PyArg_ParseTuple(args, "iO", &codec_id, &serializer)) {
+        return NULL;
+    }
+    if (codec_id <= ENVELOPE_CODEC_PICKLE || codec_id >= ENVELOPE_CODEC_LOCAL) {
+        PyErr_SetString(PyExc_ValueError, "Codec ids registered are from 3 to 254");
+        return NULL;
+    }
+    if (serializer != Py_None &&
+        (!PyObject_HasAttrString(serializer, "dumps") || !PyObject_HasAttrString(serializer, "loads"))) {
+        PyErr_SetString(PyExc_AttributeError, "Serializer must implement 'dumps' and 'loads'");
+        return NULL;
+    }
+    PyObject* codecs = _pygear_envelope_codecs();
+    PyObject* key = PyInt_FromLong(codec_id);
+    if (!codecs || !key) {
+        Py_XDECREF(key);
+        return NULL;
+    }
+    int ret;
+    if (serializer == Py_None) {
+        ret = PyDict_DelItem(codecs, key);
+        if (ret < 0 && PyErr_ExceptionMatches(PyExc_KeyError)) {
+            PyErr_Clear();
+            ret = 0;
+        }
+    } else {
+        ret = PyDict_SetItem(codecs, key, serializer);
+    }
+    Py_DECREF(key);
+    if (ret < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
@@ -0,0 +1,126 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include "payload.h"
+
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+/*
+ * Optional header in front of a payload, so that metadata can travel with
+ * it between pygear peers:
+ *   0  magic "PGE" and format version
+ *   4  uint16 header size, at least ENVELOPE_SIZE
+ *   6  uint8 codec id of the payload, ENVELOPE_CODEC_* or registered
+ *   7  uint8 flags, ENVELOPE_FLAG_*
+ *   8  uint64 time the message was sent, microseconds since the epoch
+ *  16  uint64 deadline of the job, microseconds since the epoch, 0 for none
+ *  24  16 byte trace id
+ * Replies of pygear workers append, growing the header size:
+ *  40  uint64 time the worker grabbed the job, microseconds since the epoch
+ *  48  uint64 time the worker started its callback, 0 if it did not run
+ * Integers are little-endian. Later versions append fields, which readers
+ * of this one skip using the header size.
+ * There is no negotiation: pygear workers take any workload that starts
+ * with "PGE" and a plausible header size for an envelope, and reply in one
+ * only to such requests. Clients only look for an envelope
+ * in replies to requests they sent in one (see Client.set_envelope), so a
+ * bare reply is never stripped.
+ */
+#define ENVELOPE_MAGIC "PGE"
+#define ENVELOPE_MAGIC_SIZE 3
+#define ENVELOPE_VERSION 1
+#define ENVELOPE_SIZE 40
+#define ENVELOPE_REPLY_SIZE 56
+#define ENVELOPE_TRACE_ID_SIZE 16
+
+#define ENVELOPE_CODEC_RAW 0        /* bytes sent with serialize=False */
+#define ENVELOPE_CODEC_JSON 1
+#define ENVELOPE_CODEC_PICKLE 2
+#define ENVELOPE_CODEC_LOCAL 255    /* unregistered, decoded by the receiver's serializer */
+
+#define ENVELOPE_FLAG_REPLY 0x01
+
+typedef struct {
+    uint8_t version;
+    uint8_t codec;
+    uint8_t flags;
+    uint64_t sent_us;
+    uint64_t deadline_us;
+    unsigned char trace_id[ENVELOPE_TRACE_ID_SIZE];
+    uint64_t grabbed_us;        /* replies only, 0 if the sender did not say */
+    uint64_t started_us;
+} pygear_envelope;
+
+/* Header size of the envelope 'data' starts with, 0 if it is a bare payload */
+static size_t _pygear_envelope_parse(const char* data, size_t size, pygear_envelope* envelope);
+/* Prepends the envelope to the payload. Returns -1 with a python exception set on failure */
+static int _pygear_envelope_wrap(pygear_payload* payload, const pygear_envelope* envelope);
+static uint64_t _pygear_envelope_now_us(void);
+
+/* Codec id of a serializer, ENVELOPE_CODEC_LOCAL if it is not registered */
+static uint8_t _pygear_envelope_codec_id(PyObject* serializer);
+/*
+ * Return value: New reference.
+ * Decodes a payload with the codec of its envelope, or with 'serializer' if
+ * 'envelope' is NULL or names no registered codec. Raw payloads are strings.
+ */
+static PyObject* _pygear_envelope_loads(const pygear_envelope* envelope, PyObject* serializer,
+    const char* data, size_t size);
+/* Return value: Borrowed reference. The serializer _pygear_envelope_loads uses */
+static PyObject* _pygear_envelope_serializer(const pygear_envelope* envelope, PyObject* serializer);
+/* Return value: New reference. A dict describing the envelope, for Job.envelope and Task.envelope */
+static PyObject* _pygear_envelope_describe(const pygear_envelope* envelope);
+/*
+ * Sends a reply through one of the gearman_job_send_* functions: in an
+ * envelope answering 'request' and carrying when the job was grabbed and
+ * started, or bare if 'request' is NULL.
+ */
+static gearman_return_t _pygear_envelope_reply(gearman_job_st* job,
+    gearman_return_t (*send)(gearman_job_st*, const void*, size_t),
+    const pygear_envelope* request, uint64_t grabbed_us, uint64_t started_us,
+    uint8_t codec, const void* data, size_t size);
+
+/* Module method definitions */
+static PyObject* pygear_register_codec(PyObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_register_codec_doc,
+"Register a serializer under a codec id, on senders and receivers alike.\n"
+"Payloads in an envelope (see Client.set_envelope) carry the codec id of the\n"
+"sender's serializer and are decoded with the codec registered under it,\n"
+"whatever serializer the receiver is set to. Payloads of unregistered\n"
+"serializers are decoded with the receiver's. json is registered as 1 and\n"
+"cPickle as 2.\n"
+"@param[in] codec_id - An id from 3 to 254.\n"
+"@param[in] serializer - An object with 'dumps' and 'loads', or None to\n"
+"\tunregister the id.");
+
+#endif
@@ -1,6 +1,5 @@
 import datetime
 import time
-import uuid
 
 import pygear
 print pygear.__file__
@@ -14,6 +13,7 @@ def main():
 
     c = pygear.Client()
     c.add_server(opts.server_host, opts.server_port)
+    c.set_unique_strategy('random')  # a fresh unique key for every job
     c.set_complete_fn(oncomplete_callback)  # complete callback for foreground job
 
     start_datetime = datetime.datetime.now()
@@ -31,17 +31,16 @@ def main():
     if opts.seconds > 0:
         while time.time() < stop_time:
             data = 'Hello %r' % n
-            unique = uuid.uuid4().hex
             if opts.async:
                 if opts.background:
-                    res = c.add_task_background('reverse', data, unique)
+                    res = c.add_task_background('reverse', data)
                 else:
-                    res = c.add_task('reverse', data, unique)
+                    res = c.add_task('reverse', data)
             else:
                 if opts.background:
-                    res = c.do_background('reverse', data, unique)
+                    res = c.do_background('reverse', data)
                 else:
-                    res = c.do('reverse', data, unique)
+                    res = c.do('reverse', data)
             if not opts.quiet:
                 print res
             n += 1
@@ -50,17 +49,16 @@ def main():
         n = opts.num_of_tasks
         for i in range(n):
             data = 'Hello %r' % i
-            unique = uuid.uuid4().hex
             if opts.async:
                 if opts.background:
-                    res = c.add_task_background('reverse', data, unique)
+                    res = c.add_task_background('reverse', data)
                 else:
-                    res = c.add_task('reverse', data, unique)
+                    res = c.add_task('reverse', data)
             else:
                 if opts.background:
-                    res = c.do_background('reverse', data, unique)
+                    res = c.do_background('reverse', data)
                 else:
-                    res = c.do('reverse', data, unique)
+                    res = c.do('reverse', data)
             if not opts.quiet:
                 print res
     else:
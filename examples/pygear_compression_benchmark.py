@@ -0,0 +1,63 @@
+"""Bytes on the wire against CPU time for pygear.ZlibCodec.
+
+Encodes and decodes sample payloads with plain json and with ZlibCodec at a
+few levels, with and without a preset dictionary, and prints the payload
+size and the microseconds per dumps + loads. No gearmand is needed.
+"""
+import json
+import random
+import time
+
+import pygear
+
+
+def sample_payloads():
+    rand = random.Random(42)
+    users = [
+        {
+            'user_id': rand.randint(1, 10 ** 9),
+            'name': 'user %d' % i,
+            'country': rand.choice(['US', 'CA', 'GB', 'DE', 'FR']),
+            'rating': round(rand.random() * 5, 2),
+            'tags': rand.sample(['new', 'vip', 'mobile', 'web', 'elite'], 2),
+        }
+        for i in range(2000)
+    ]
+    return [
+        ('small (1 row)', users[:1]),
+        ('medium (50 rows)', users[:50]),
+        ('large (2000 rows)', users),
+        ('random ids', [rand.getrandbits(64) for _ in range(1000)]),
+    ]
+
+
+def measure(codec, payload, repeat):
+    encoded = codec.dumps(payload)
+    start = time.time()
+    for _ in range(repeat):
+        codec.loads(codec.dumps(payload))
+    return len(encoded), (time.time() - start) * 1e6 / repeat
+
+
+def main():
+    dictionary = json.dumps(sample_payloads()[0][1])
+    codecs = [
+        ('json', json),
+        ('zlib level 1', pygear.ZlibCodec(level=1)),
+        ('zlib level 6', pygear.ZlibCodec(level=6)),
+        ('zlib level 9', pygear.ZlibCodec(level=9)),
+        ('zlib level 6 + dict', pygear.ZlibCodec(level=6, dictionary=dictionary)),
+    ]
+    print '%-20s %-20s %10s %8s %12s' % ('payload', 'codec', 'bytes', 'ratio', 'us/roundtrip')
+    for payload_name, payload in sample_payloads():
+        plain_size = len(json.dumps(payload))
+        repeat = max(10, 200000 // plain_size)
+        for codec_name, codec in codecs:
+            size, micros = measure(codec, payload, repeat)
+            print '%-20s %-20s %10d %7.2fx %12.1f' % (
+                payload_name, codec_name, size, float(plain_size) / size, micros)
+        print
+
+
+if __name__ == '__main__':
+    main()
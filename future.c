@@ -0,0 +1,226 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "future.h"
+#include "asyncclient.h"
+
+/*
+ * Class constructor / destructor methods
+ */
+
+int Future_init(pygear_FutureObject* self, PyObject* args, PyObject* kwds) {
+    self->owner = NULL;
+    self->result = NULL;
+    self->exception = NULL;
+    self->workload = NULL;
+    self->callbacks = PyList_New(0);
+    if (self->callbacks == NULL) {
+        return -1;
+    }
+    self->kind = PYGEAR_FUTURE_FOREGROUND;
+    self->done = false;
+    return 0;
+}
+
+int Future_traverse(pygear_FutureObject* self, visitproc visit, void* arg) {
+    Py_VISIT(self->owner);
+    Py_VISIT(self->result);
+    Py_VISIT(self->exception);
+    Py_VISIT(self->callbacks);
+    Py_VISIT(self->workload);
+    return 0;
+}
+
+int Future_clear(pygear_FutureObject* self) {
+    Py_CLEAR(self->owner);
+    Py_CLEAR(self->result);
+    Py_CLEAR(self->exception);
+    Py_CLEAR(self->callbacks);
+    Py_CLEAR(self->workload);
+    return 0;
+}
+
+void Future_dealloc(pygear_FutureObject* self) {
+    Future_clear(self);
+    self->ob_type->tp_free((PyObject*)self);
+}
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+/* Return value: New reference */
+static pygear_FutureObject* _pygear_future_new(PyObject* owner, int kind) {
+    pygear_FutureObject* future = (pygear_FutureObject*) PyObject_CallObject((PyObject*) &pygear_FutureType, NULL);
+    if (!future) {
+        return NULL;
+    }
+    Py_INCREF(owner);
+    future->owner = owner;
+    future->kind = kind;
+    return future;
+}
+
+static void _pygear_future_set_result(pygear_FutureObject* self, PyObject* result) {
+    if (self->done) {
+        return;
+    }
+    Py_INCREF(result);
+    self->result = result;
+    self->done = true;
+}
+
+static void _pygear_future_set_exception(pygear_FutureObject* self, PyObject* exception) {
+    if (self->done) {
+        return;
+    }
+    Py_INCREF(exception);
+    self->exception = exception;
+    self->done = true;
+}
+
+/*
+ * Move the currently raised python exception into the future.
+ * The error indicator is cleared afterwards.
+ */
+static void _pygear_future_set_exception_from_error(pygear_FutureObject* self) {
+    PyObject *ptype, *pvalue, *ptraceback;
+    PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+    if (!ptype) {
+        return;
+    }
+    PyErr_NormalizeException(&ptype, &pvalue, &ptraceback);
+    if (pvalue) {
+        _pygear_future_set_exception(self, pvalue);
+    }
+    Py_XDECREF(ptype);
+    Py_XDECREF(pvalue);
+    Py_XDECREF(ptraceback);
+}
+
+static void _pygear_future_run_callbacks(pygear_FutureObject* self) {
+    if (!self->callbacks) {
+        return;
+    }
+    PyObject* callbacks = self->callbacks;
+    self->callbacks = PyList_New(0);
+    Py_ssize_t i;
+    for (i = 0; i < PyList_Size(callbacks); ++i) {
+        PyObject* callback_return = PyObject_CallFunction(PyList_GetItem(callbacks, i), "O", self);
+        if (!callback_return) {
+            PyErr_Print();
+        }
+        Py_XDECREF(callback_return);
+    }
+    Py_DECREF(callbacks);
+}
+
+/*
+ * Drive the owning client until this future is resolved.
+ * Return 0 on success, -1 with a python exception set on failure.
+ */
+static int _pygear_future_wait(pygear_FutureObject* self) {
+    while (!self->done) {
+        if (!self->owner) {
+            PyErr_SetString(PyGearExn_ERROR, "Future is not attached to a client");
+            return -1;
+        }
+        pygear_AsyncClientObject* owner = (pygear_AsyncClientObject*) self->owner;
+        if (PySet_Size(owner->pending) == 0) {
+            PyErr_SetString(PyGearExn_ERROR, "Future is not pending on its client");
+            return -1;
+        }
+        bool timed_out = false;
+        int resolved = _pygear_asyncclient_poll(owner, gearman_client_timeout(owner->g_Client), &timed_out);
+        if (resolved < 0) {
+            return -1;
+        }
+        if (timed_out && !self->done) {
+            PyErr_SetString(PyGearExn_TIMEOUT, "TIMEOUT");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+/********************
+ * Instance methods *
+ ********************/
+
+static PyObject* pygear_future_add_done_callback(pygear_FutureObject* self, PyObject* args) {
+    PyObject* callback;
+    if (!PyArg_ParseTuple(args, "O", &callback)) {
+        return NULL;
+    }
+    if (!PyCallable_Check(callback)) {
+        PyErr_SetString(PyExc_TypeError, "Future.add_done_callback expected a callable");
+        return NULL;
+    }
+    if (self->done) {
+        return PyObject_CallFunction(callback, "O", self);
+    }
+    if (PyList_Append(self->callbacks, callback) < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_future_done(pygear_FutureObject* self) {
+    return PyBool_FromLong(self->done);
+}
+
+
+static PyObject* pygear_future_exception(pygear_FutureObject* self) {
+    if (_pygear_future_wait(self) < 0) {
+        return NULL;
+    }
+    if (!self->exception) {
+        Py_RETURN_NONE;
+    }
+    Py_INCREF(self->exception);
+    return self->exception;
+}
+
+
+static PyObject* pygear_future_result(pygear_FutureObject* self) {
+    if (_pygear_future_wait(self) < 0) {
+        return NULL;
+    }
+    if (self->exception) {
+        PyErr_SetObject((PyObject*) self->exception->ob_type, self->exception);
+        return NULL;
+    }
+    if (!self->result) {
+        Py_RETURN_NONE;
+    }
+    Py_INCREF(self->result);
+    return self->result;
+}
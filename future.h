@@ -0,0 +1,157 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <libgearman-1.0/gearman.h>
+#include <stdio.h>
+#include "structmember.h"
+#include "exception.h"
+
+#ifndef PyMODINIT_FUNC
+#define PyMODINIT_FUNC void
+#endif
+
+#ifndef FUTURE_H
+#define FUTURE_H
+
+#define _FUTUREMETHOD(name,flags) {#name,(PyCFunction) pygear_future_##name,flags,pygear_future_##name##_doc},
+
+/* What a future is waiting for; decides which task callback resolves it */
+enum pygear_future_kind {
+    PYGEAR_FUTURE_FOREGROUND,
+    PYGEAR_FUTURE_BACKGROUND,
+    PYGEAR_FUTURE_STATUS
+};
+
+typedef struct {
+    PyObject_HEAD
+    PyObject* owner;        /* AsyncClient driving the I/O for this future */
+    PyObject* result;
+    PyObject* exception;
+    PyObject* callbacks;
+    PyObject* workload;     /* serialized workload, kept alive until the job is sent */
+    int kind;
+    bool done;
+} pygear_FutureObject;
+
+PyDoc_STRVAR(future_module_docstring,
+"Represents the eventual result of a job submitted through an AsyncClient.");
+
+/* Class init methods */
+int Future_init(pygear_FutureObject *self, PyObject *args, PyObject *kwds);
+int Future_traverse(pygear_FutureObject *self, visitproc visit, void *arg);
+int Future_clear(pygear_FutureObject *self);
+void Future_dealloc(pygear_FutureObject* self);
+
+/* Private methods */
+static pygear_FutureObject* _pygear_future_new(PyObject* owner, int kind);
+static void _pygear_future_set_result(pygear_FutureObject* self, PyObject* result);
+static void _pygear_future_set_exception(pygear_FutureObject* self, PyObject* exception);
+static void _pygear_future_set_exception_from_error(pygear_FutureObject* self);
+static void _pygear_future_run_callbacks(pygear_FutureObject* self);
+
+/* Method definitions */
+static PyObject* pygear_future_add_done_callback(pygear_FutureObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_future_add_done_callback_doc,
+"Call a function once the future is resolved. Callbacks run from inside\n"
+"AsyncClient.poll, after libgearman has returned, so it is safe to submit\n"
+"new jobs from them. If the future is already resolved, the function is\n"
+"called immediately.\n\n"
+"@param[in] function - Function taking the Future as its only argument.");
+
+static PyObject* pygear_future_done(pygear_FutureObject* self);
+PyDoc_STRVAR(pygear_future_done_doc,
+"@return True if the future has a result or an exception.");
+
+static PyObject* pygear_future_exception(pygear_FutureObject* self);
+PyDoc_STRVAR(pygear_future_exception_doc,
+"Get the exception the job failed with, driving the client until the\n"
+"future is resolved.\n\n"
+"@return exception instance, or None if the job succeeded.");
+
+static PyObject* pygear_future_result(pygear_FutureObject* self);
+PyDoc_STRVAR(pygear_future_result_doc,
+"Get the result of the job, driving the client until the future is\n"
+"resolved. The client timeout (see AsyncClient.set_timeout) bounds each\n"
+"wait for activity.\n\n"
+"@return the deserialized result for 'do', the job handle for\n"
+"'do_background', or a status dictionary for 'job_status'.\n"
+"@return NULL and raises the job's exception on failure.");
+
+
+/* Module method specification */
+static PyMethodDef future_module_methods[] = {
+    _FUTUREMETHOD(add_done_callback,    METH_VARARGS)
+    _FUTUREMETHOD(done,                 METH_NOARGS)
+    _FUTUREMETHOD(exception,            METH_NOARGS)
+    _FUTUREMETHOD(result,               METH_NOARGS)
+    {NULL, NULL, 0, NULL}
+};
+
+PyTypeObject pygear_FutureType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /*ob_size*/
+    "pygear.Future",                            /*tp_name*/
+    sizeof(pygear_FutureObject),                /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)Future_dealloc,                 /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_HAVE_GC,                         /*tp_flags*/
+    future_module_docstring,                    /* tp_doc */
+    (traverseproc)Future_traverse,              /* tp_traverse */
+    (inquiry)Future_clear,                      /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    future_module_methods,                      /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    (initproc)Future_init,                      /* tp_init */
+};
+
+#endif
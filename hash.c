@@ -0,0 +1,162 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "hash.h"
+
+#define XXH_PRIME64_1 11400714785074694791ULL
+#define XXH_PRIME64_2 14029467366897019727ULL
+#define XXH_PRIME64_3 1609587929392839161ULL
+#define XXH_PRIME64_4 9650029242287828579ULL
+#define XXH_PRIME64_5 2870177450012600261ULL
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+static inline uint64_t _pygear_hash_rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+/* Little endian reads, independent of the host byte order and alignment */
+static inline uint64_t _pygear_hash_read64(const unsigned char* p) {
+    return (uint64_t) p[0] | ((uint64_t) p[1] << 8) | ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24)
+        | ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) | ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+static inline uint32_t _pygear_hash_read32(const unsigned char* p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline uint64_t _pygear_hash_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME64_2;
+    acc = _pygear_hash_rotl(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t _pygear_hash_merge_round(uint64_t acc, uint64_t value) {
+    acc ^= _pygear_hash_round(0, value);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static uint64_t _pygear_hash64(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* p = (const unsigned char*) data;
+    const unsigned char* end = p + size;
+    uint64_t h;
+    if (size >= 32) {
+        // Four independent lanes over 32 byte stripes
+        const unsigned char* limit = end - 32;
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+        do {
+            v1 = _pygear_hash_round(v1, _pygear_hash_read64(p));
+            v2 = _pygear_hash_round(v2, _pygear_hash_read64(p + 8));
+            v3 = _pygear_hash_round(v3, _pygear_hash_read64(p + 16));
+            v4 = _pygear_hash_round(v4, _pygear_hash_read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = _pygear_hash_rotl(v1, 1) + _pygear_hash_rotl(v2, 7) + _pygear_hash_rotl(v3, 12) + _pygear_hash_rotl(v4, 18);
+        h = _pygear_hash_merge_round(h, v1);
+        h = _pygear_hash_merge_round(h, v2);
+        h = _pygear_hash_merge_round(h, v3);
+        h = _pygear_hash_merge_round(h, v4);
+    } else {
+        h = seed + XXH_PRIME64_5;
+    }
+    h += (uint64_t) size;
+    while (p + 8 <= end) {
+        h ^= _pygear_hash_round(0, _pygear_hash_read64(p));
+        h = _pygear_hash_rotl(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t) _pygear_hash_read32(p) * XXH_PRIME64_1;
+        h = _pygear_hash_rotl(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * XXH_PRIME64_5;
+        h = _pygear_hash_rotl(h, 11) * XXH_PRIME64_1;
+        p++;
+    }
+    // Final avalanche
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint64_t _pygear_random64(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 2685821657736338717ULL;
+}
+
+/* Non-zero seed from the clock, the process and 'salt', e.g. the owner's address */
+static uint64_t _pygear_random_seed(const void* salt) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t parts[4] = {(uint64_t) now.tv_sec, (uint64_t) now.tv_nsec, (uint64_t) getpid(), (uint64_t) (uintptr_t) salt};
+    uint64_t seed = _pygear_hash64(parts, sizeof(parts), 0);
+    return seed ? seed : XXH_PRIME64_5;
+}
+
+static void _pygear_unique_format(uint64_t high, uint64_t low, char* unique) {
+    snprintf(unique, PYGEAR_UNIQUE_SIZE, "%016llx%016llx", (unsigned long long) high, (unsigned long long) low);
+}
+
+/*
+ * Two independent 64 bit hashes of the function name and the workload, so
+ * that identical jobs get the same key and distinct jobs practically never do.
+ */
+static void _pygear_hash_job(const char* function_name, const void* workload, size_t workload_size,
+    uint64_t* hash) {
+    size_t function_size = strlen(function_name) + 1; /* the NUL separates name and workload */
+    hash[0] = _pygear_hash64(workload, workload_size, _pygear_hash64(function_name, function_size, 0));
+    hash[1] = _pygear_hash64(workload, workload_size, _pygear_hash64(function_name, function_size, XXH_PRIME64_3));
+}
+
+static void _pygear_unique_content(const char* function_name, const void* workload, size_t workload_size,
+    char* unique) {
+    uint64_t hash[2];
+    _pygear_hash_job(function_name, workload, workload_size, hash);
+    _pygear_unique_format(hash[0], hash[1], unique);
+}
+
+static void _pygear_unique_random(uint64_t* state, char* unique) {
+    uint64_t high = _pygear_random64(state);
+    uint64_t low = _pygear_random64(state);
+    _pygear_unique_format(high, low, unique);
+}
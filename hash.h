@@ -0,0 +1,63 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef HASH_H
+#define HASH_H
+
+/*
+ * 64-bit xxHash (XXH64). Fast, well distributed and stable across platforms
+ * and releases, so its values can be used for placement decisions that other
+ * processes have to agree on.
+ */
+static uint64_t _pygear_hash64(const void* data, size_t size, uint64_t seed);
+
+/* 128 bit hash of a function name and encoded workload, into hash[0..1] */
+static void _pygear_hash_job(const char* function_name, const void* workload, size_t workload_size,
+    uint64_t* hash);
+
+/* Hex digits of a generated unique key, 128 bits, plus the terminating NUL */
+#define PYGEAR_UNIQUE_SIZE 33
+
+/* Unique key derived from the function name and encoded workload */
+static void _pygear_unique_content(const char* function_name, const void* workload, size_t workload_size,
+    char* unique);
+/* Random unique key, like uuid.uuid4().hex */
+static void _pygear_unique_random(uint64_t* state, char* unique);
+
+/* xorshift64* pseudo random numbers; *state must not be 0, see _pygear_random_seed */
+static uint64_t _pygear_random64(uint64_t* state);
+static uint64_t _pygear_random_seed(const void* salt);
+
+#endif
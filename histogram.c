@@ -0,0 +1,109 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "histogram.h"
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+static void _pygear_histogram_reset(pygear_histogram* histogram) {
+    memset(histogram, 0, sizeof(pygear_histogram));
+}
+
+static size_t _pygear_histogram_index(uint64_t micros) {
+    if (micros < HISTOGRAM_SUB_BUCKETS) {
+        return (size_t) micros;
+    }
+    int octave = 63 - __builtin_clzll(micros);
+    size_t sub = (size_t) (micros >> (octave - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1);
+    return (size_t) (octave - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+/* Smallest duration in microseconds counted in bucket 'index' */
+static uint64_t _pygear_histogram_lower_bound(size_t index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return (uint64_t) index;
+    }
+    int octave = (int) (index / HISTOGRAM_SUB_BUCKETS) + HISTOGRAM_SUB_BITS - 1;
+    uint64_t sub = index % HISTOGRAM_SUB_BUCKETS;
+    return (HISTOGRAM_SUB_BUCKETS + sub) << (octave - HISTOGRAM_SUB_BITS);
+}
+
+static void _pygear_histogram_record(pygear_histogram* histogram, double seconds) {
+    if (seconds < 0) {
+        seconds = 0;
+    }
+    double micros = seconds * 1e6;
+    uint64_t value = micros >= 1.8e19 ? UINT64_MAX : (uint64_t) micros;
+    histogram->counts[_pygear_histogram_index(value)]++;
+    histogram->count++;
+    histogram->sum += seconds;
+    if (seconds > histogram->max) {
+        histogram->max = seconds;
+    }
+}
+
+/*
+ * Upper bound in seconds of the bucket holding the given percentile (0-100),
+ * capped by the largest duration recorded. 0 for an empty histogram.
+ */
+static double _pygear_histogram_percentile(const pygear_histogram* histogram, double percentile) {
+    if (!histogram->count) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) (percentile / 100.0 * histogram->count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    size_t i;
+    for (i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    if (i + 1 >= HISTOGRAM_BUCKETS) {
+        return histogram->max;
+    }
+    double upper = _pygear_histogram_lower_bound(i + 1) / 1e6;
+    return upper < histogram->max ? upper : histogram->max;
+}
+
+/* {'count', 'mean', 'p50', 'p90', 'p99', 'max'}, durations in seconds */
+static PyObject* _pygear_histogram_summary(const pygear_histogram* histogram) {
+    return Py_BuildValue("{s:K,s:d,s:d,s:d,s:d,s:d}",
+        "count", (unsigned PY_LONG_LONG) histogram->count,
+        "mean", histogram->count ? histogram->sum / histogram->count : 0.0,
+        "p50", _pygear_histogram_percentile(histogram, 50),
+        "p90", _pygear_histogram_percentile(histogram, 90),
+        "p99", _pygear_histogram_percentile(histogram, 99),
+        "max", histogram->max);
+}
@@ -34,6 +34,12 @@
 
 int Job_init(pygear_JobObject* self, PyObject* args, PyObject* kwds) {
     self->g_Job = NULL;
+    self->envelope_size = 0;
+    self->grabbed_us = 0;
+    self->started_us = 0;
+    self->trace = false;
+    self->workload_view = NULL;
+    Py_CLEAR(self->workload_decoded);
     self->serializer = PyImport_ImportModule(PYTHON_SERIALIZER);
     if (self->serializer == NULL) {
         PyObject* err_string = PyString_FromFormat("Failed to import '%s'", PYTHON_SERIALIZER);
@@ -46,23 +52,54 @@ int Job_init(pygear_JobObject* self, PyObject* args, PyObject* kwds) {
 
 int Job_traverse(pygear_JobObject* self, visitproc visit, void* arg) {
     Py_VISIT(self->serializer);
+    Py_VISIT(self->workload_decoded);
     return 0;
 }
 
 int Job_clear(pygear_JobObject* self) {
     Py_CLEAR(self->serializer);
+    Py_CLEAR(self->workload_decoded);
     return 0;
 }
 
 void Job_dealloc(pygear_JobObject* self) {
     if (self->g_Job) {
         gearman_job_free(self->g_Job);
-        self->g_Job = NULL;
     }
+    _pygear_job_detach(self);
     Job_clear(self);
     self->ob_type->tp_free((PyObject*)self);
 }
 
+/*
+ * Private methods
+ */
+
+/* Bind the libgearman job, reading the envelope of its workload if any */
+static void _pygear_job_attach(pygear_JobObject* self, gearman_job_st* job, uint64_t grabbed_us) {
+    self->g_Job = job;
+    self->grabbed_us = grabbed_us;
+    self->envelope_size = _pygear_envelope_parse(gearman_job_workload(job), gearman_job_workload_size(job),
+        &self->envelope);
+}
+
+/* The workload without its envelope */
+static void _pygear_job_payload(pygear_JobObject* self, const char** data, size_t* size) {
+    *data = self->g_Job ? gearman_job_workload(self->g_Job) : NULL;
+    *size = self->g_Job ? gearman_job_workload_size(self->g_Job) : 0;
+    if (*data) {
+        *data += self->envelope_size;
+        *size -= self->envelope_size;
+    }
+}
+
+/* Forget the libgearman job, invalidating the views of its buffers */
+static void _pygear_job_detach(pygear_JobObject* self) {
+    self->g_Job = NULL;
+    _pygear_view_invalidate(self->workload_view);
+    Py_CLEAR(self->workload_view);
+}
+
 /*
  * Instance Methods
  */
@@ -83,56 +120,52 @@ static PyObject* pygear_job_set_serializer(pygear_JobObject* self, PyObject* arg
     Py_INCREF(serializer);
     Py_XDECREF(self->serializer);
     self->serializer = serializer;
+    Py_CLEAR(self->workload_decoded);
     Py_RETURN_NONE;
 }
 
 
-static PyObject* pygear_job_send_data(pygear_JobObject* self, PyObject* args) {
+/*
+ * Sends a payload through one of the gearman_job_send_* functions. The
+ * payload is serialized unless serialize=False is passed, in which case it
+ * is a buffer or a list of buffers, see _pygear_payload_init. A 'reply' to
+ * a workload that came in an envelope is put in one.
+ */
+static PyObject* _pygear_job_send(pygear_JobObject* self, PyObject* args, PyObject* kwargs,
+    gearman_return_t (*send)(gearman_job_st*, const void*, size_t), bool reply) {
     PyObject* data;
-    if (!PyArg_ParseTuple(args, "O", &data)) {
+    int serialize = 1;
+    static char* kwlist[] = {"data", "serialize", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", kwlist, &data, &serialize)) {
         return NULL;
     }
-    PyObject* pickled_data = PyObject_CallMethod(self->serializer, "dumps", "O", data);
-    if (!pickled_data) {
-        PyErr_SetString(PyExc_SystemError, "Could not pickle job_data data for transport\n");
+    pygear_payload payload;
+    if (_pygear_payload_init(&payload, self->serializer, data, serialize) < 0) {
         return NULL;
     }
-    char* c_data; Py_ssize_t c_data_size;
-    if (PyString_AsStringAndSize(pickled_data, &c_data, &c_data_size) == -1) {
-        Py_XDECREF(pickled_data);
-        PyErr_SetString(PyExc_SystemError, "Failed to convert pickled data to C string");
-        return NULL;
+    if (self->trace) {
+        _pygear_trace_begin("worker", "send", gearman_job_function_name(self->g_Job));
+    }
+    gearman_return_t result = _pygear_envelope_reply(self->g_Job, send,
+        (reply && self->envelope_size) ? &self->envelope : NULL, self->grabbed_us, self->started_us,
+        serialize ? _pygear_envelope_codec_id(self->serializer) : ENVELOPE_CODEC_RAW,
+        payload.data, payload.size);
+    if (self->trace) {
+        _pygear_trace_end("worker", "send");
     }
-    Py_XDECREF(pickled_data);
-    gearman_return_t result = gearman_job_send_data(self->g_Job, c_data, c_data_size);
+    _pygear_payload_release(&payload);
     if (_pygear_check_and_raise_exn(result)) {
         return NULL;
     }
     Py_RETURN_NONE;
 }
 
-static PyObject* pygear_job_send_warning(pygear_JobObject* self, PyObject* args) {
-    PyObject* data;
-    if (!PyArg_ParseTuple(args, "O", &data)) {
-        return NULL;
-    }
-    PyObject* pickled_data = PyObject_CallMethod(self->serializer, "dumps", "O", data);
-    if (!pickled_data) {
-        PyErr_SetString(PyExc_SystemError, "Could not pickle job_warning data for transport\n");
-        return NULL;
-    }
-    char* c_data; Py_ssize_t c_data_size;
-    if (PyString_AsStringAndSize(pickled_data, &c_data, &c_data_size) == -1) {
-        Py_XDECREF(pickled_data);
-        PyErr_SetString(PyExc_SystemError, "Failed to convert pickled warning data to C string");
-        return NULL;
-    }
-    Py_XDECREF(pickled_data);
-    gearman_return_t result = gearman_job_send_warning(self->g_Job, c_data, c_data_size);
-    if (_pygear_check_and_raise_exn(result)) {
-        return NULL;
-    }
-    Py_RETURN_NONE;
+static PyObject* pygear_job_send_data(pygear_JobObject* self, PyObject* args, PyObject* kwargs) {
+    return _pygear_job_send(self, args, kwargs, gearman_job_send_data, false);
+}
+
+static PyObject* pygear_job_send_warning(pygear_JobObject* self, PyObject* args, PyObject* kwargs) {
+    return _pygear_job_send(self, args, kwargs, gearman_job_send_warning, false);
 }
 
 static PyObject* pygear_job_send_status(pygear_JobObject* self, PyObject* args) {
@@ -147,53 +180,12 @@ static PyObject* pygear_job_send_status(pygear_JobObject* self, PyObject* args)
     Py_RETURN_NONE;
 }
 
-static PyObject* pygear_job_send_complete(pygear_JobObject* self, PyObject* args) {
-    PyObject* result;
-    if (!PyArg_ParseTuple(args, "O", &result)) {
-        return NULL;
-    }
-    PyObject* pickled_result = PyObject_CallMethod(self->serializer, "dumps", "O", result);
-    if (!pickled_result) {
-        PyErr_SetString(PyExc_SystemError, "Could not pickle job_complete data for transport\n");
-        return NULL;
-    }
-    char* c_result; Py_ssize_t c_result_size;
-    if (PyString_AsStringAndSize(pickled_result, &c_result, &c_result_size) == -1) {
-        Py_XDECREF(pickled_result);
-        PyErr_SetString(PyExc_SystemError, "Failed to convert pickled complete data to C string");
-        return NULL;
-    }
-    Py_XDECREF(pickled_result); 
-    gearman_return_t gearman_result = gearman_job_send_complete(self->g_Job, c_result, c_result_size);
-    if (_pygear_check_and_raise_exn(gearman_result)) {
-        return NULL;
-    }
-    Py_RETURN_NONE;
+static PyObject* pygear_job_send_complete(pygear_JobObject* self, PyObject* args, PyObject* kwargs) {
+    return _pygear_job_send(self, args, kwargs, gearman_job_send_complete, true);
 }
 
-static PyObject* pygear_job_send_exception(pygear_JobObject* self, PyObject* args) {
-    PyObject* data;
-    if (!PyArg_ParseTuple(args, "O", &data)) {
-        return NULL;
-    }
-    PyObject* pickled_data = PyObject_CallMethod(self->serializer, "dumps", "O", data);
-    if (!pickled_data) {
-        PyErr_SetString(PyExc_SystemError, "Could not pickle job_exception data for transport\n");
-        return NULL;
-    }
-
-    char* c_data; Py_ssize_t c_data_size;
-    if (PyString_AsStringAndSize(pickled_data, &c_data, &c_data_size) == -1) {
-        Py_XDECREF(pickled_data);
-        PyErr_SetString(PyExc_SystemError, "Failed to convert pickled exception data to C string");
-        return NULL;
-    }
-    Py_XDECREF(pickled_data);
-    gearman_return_t result = gearman_job_send_exception(self->g_Job, c_data, c_data_size);
-    if (_pygear_check_and_raise_exn(result)) {
-        return NULL;
-    }
-    Py_RETURN_NONE;
+static PyObject* pygear_job_send_exception(pygear_JobObject* self, PyObject* args, PyObject* kwargs) {
+    return _pygear_job_send(self, args, kwargs, gearman_job_send_exception, true);
 }
 
 static PyObject* pygear_job_send_fail(pygear_JobObject* self) {
@@ -217,23 +209,253 @@ static PyObject* pygear_job_unique(pygear_JobObject* self) {
 }
 
 static PyObject* pygear_job_workload(pygear_JobObject* self) {
-    const char* job_workload = gearman_job_workload(self->g_Job);
-    size_t job_size = gearman_job_workload_size(self->g_Job);
-    PyObject* py_result = Py_BuildValue("s#", job_workload, job_size);
-    PyObject* loadstr = PyString_FromString("loads");
-    PyObject* py_workload = PyObject_CallMethodObjArgs(
-        self->serializer,
-        loadstr,
-        py_result,
-        NULL
-    );
-    Py_XDECREF(py_result);
-    Py_XDECREF(loadstr);
-    return py_workload;
+    if (!self->workload_decoded) {
+        if (!self->g_Job) {
+            PyErr_SetString(PyGearExn_ERROR, "Job is no longer valid");
+            return NULL;
+        }
+        const char* job_workload;
+        size_t job_size;
+        _pygear_job_payload(self, &job_workload, &job_size);
+        if (self->trace) {
+            _pygear_trace_begin("worker", "decode", gearman_job_function_name(self->g_Job));
+        }
+        self->workload_decoded = _pygear_envelope_loads(self->envelope_size ? &self->envelope : NULL,
+            self->serializer, job_workload, job_size);
+        if (self->trace) {
+            _pygear_trace_end("worker", "decode");
+        }
+        if (!self->workload_decoded) {
+            return NULL;
+        }
+    }
+    Py_INCREF(self->workload_decoded);
+    return self->workload_decoded;
+}
+
+/*
+ * Whether the serialized workload can be scanned as JSON: the serializer is
+ * the json module, or codecs wrapping it that left this workload as is (an
+ * ArrayCodec for anything but an array, a ZlibCodec below its threshold).
+ */
+static bool _pygear_job_is_json(PyObject* serializer, const char* workload, size_t size) {
+    while (serializer) {
+        if (PyObject_TypeCheck(serializer, &pygear_ArrayCodecType)) {
+            if (size >= ARRAYCODEC_MAGIC_SIZE && !memcmp(workload, ARRAYCODEC_MAGIC, ARRAYCODEC_MAGIC_SIZE)) {
+                return false;
+            }
+            serializer = ((pygear_ArrayCodecObject*) serializer)->fallback;
+        } else if (PyObject_TypeCheck(serializer, &pygear_ZlibCodecType)) {
+            if (_pygear_zlibcodec_is_compressed(workload, size)) {
+                return false;
+            }
+            serializer = ((pygear_ZlibCodecObject*) serializer)->serializer;
+        } else {
+            return PyModule_Check(serializer) && !strcmp(PyModule_GetName(serializer), "json");
+        }
+    }
+    return false;
+}
+
+/*
+ * Return value: New reference.
+ * The keys and indices of a field path, see 'field'.
+ */
+static PyObject* _pygear_job_field_path(PyObject* path) {
+    PyObject* steps;
+    if (PyString_Check(path) || PyUnicode_Check(path)) {
+        steps = PyObject_CallMethod(path, "split", "s", ".");
+    } else if (PyTuple_Check(path) || PyList_Check(path)) {
+        steps = PySequence_List(path);
+    } else {
+        PyErr_SetString(PyExc_TypeError, "A field path is a string, or a tuple of keys and indices");
+        return NULL;
+    }
+    Py_ssize_t i;
+    for (i = 0; steps && i < PyList_GET_SIZE(steps); ++i) {
+        PyObject* step = PyList_GET_ITEM(steps, i);
+        if (PyInt_Check(step) || PyLong_Check(step)) {
+            Py_ssize_t index = PyNumber_AsSsize_t(step, PyExc_IndexError);
+            if (index < 0) {
+                if (!PyErr_Occurred()) {
+                    PyErr_SetString(PyExc_IndexError, "Field path indices must not be negative");
+                }
+                Py_CLEAR(steps);
+            }
+        } else if (!PyString_Check(step) && !PyUnicode_Check(step)) {
+            PyErr_SetString(PyExc_TypeError, "A field path is a string, or a tuple of keys and indices");
+            Py_CLEAR(steps);
+        }
+    }
+    return steps;
+}
+
+/*
+ * Return value: New reference.
+ * Looks the path up in a decoded workload. Returns NULL without an exception
+ * if it does not exist.
+ */
+static PyObject* _pygear_job_field_lookup(PyObject* workload, PyObject* steps) {
+    Py_INCREF(workload);
+    Py_ssize_t i;
+    for (i = 0; i < PyList_GET_SIZE(steps); ++i) {
+        PyObject* step = PyList_GET_ITEM(steps, i);
+        bool is_index = PyInt_Check(step) || PyLong_Check(step);
+        if (is_index && !PyList_Check(workload) && !PyTuple_Check(workload)) {
+            PyErr_Format(PyExc_TypeError, "Index %zd of the field path applies to a '%.200s', not a list",
+                i, Py_TYPE(workload)->tp_name);
+            Py_DECREF(workload);
+            return NULL;
+        }
+        PyObject* value = PyObject_GetItem(workload, step);
+        Py_DECREF(workload);
+        if (!value) {
+            if (PyErr_ExceptionMatches(PyExc_KeyError) || PyErr_ExceptionMatches(PyExc_IndexError)) {
+                PyErr_Clear();
+            }
+            return NULL;
+        }
+        workload = value;
+    }
+    return workload;
+}
+
+/*
+ * Return value: New reference.
+ * Scans the serialized JSON workload for the path and decodes the value
+ * found only. Returns NULL without an exception if it does not exist.
+ */
+static PyObject* _pygear_job_field_scan(PyObject* serializer, const char* workload, size_t size,
+    PyObject* steps) {
+    PyObject* ret = NULL;
+    Py_ssize_t count = PyList_GET_SIZE(steps);
+    pygear_json_step* json_steps = PyMem_New(pygear_json_step, count ? count : 1);
+    PyObject* encoded = PyList_New(0);  /* keeps the UTF-8 keys alive */
+    if (!json_steps || !encoded) {
+        PyErr_NoMemory();
+        goto catch;
+    }
+    Py_ssize_t i;
+    for (i = 0; i < count; ++i) {
+        PyObject* step = PyList_GET_ITEM(steps, i);
+        if (PyInt_Check(step) || PyLong_Check(step)) {
+            json_steps[i].key = NULL;
+            json_steps[i].key_size = 0;
+            json_steps[i].index = PyNumber_AsSsize_t(step, NULL);
+            continue;
+        }
+        PyObject* key = PyUnicode_Check(step) ? PyUnicode_AsUTF8String(step) : (Py_INCREF(step), step);
+        if (!key || PyList_Append(encoded, key) < 0) {
+            Py_XDECREF(key);
+            goto catch;
+        }
+        Py_DECREF(key);
+        json_steps[i].key = PyString_AS_STRING(key);
+        json_steps[i].key_size = PyString_GET_SIZE(key);
+        json_steps[i].index = 0;
+    }
+    const char* value;
+    size_t value_size;
+    switch (_pygear_json_find(workload, size, json_steps, count, &value, &value_size)) {
+        case PYGEAR_JSON_FOUND:
+            ret = PyObject_CallMethod(serializer, "loads", "s#", value, (int) value_size);
+            break;
+        case PYGEAR_JSON_MISSING:
+            break;
+        case PYGEAR_JSON_NOT_CONTAINER:
+            PyErr_SetString(PyExc_TypeError, "The field path does not apply to the workload");
+            break;
+        case PYGEAR_JSON_MALFORMED:
+            PyErr_SetString(PyExc_ValueError, "The workload is not valid JSON");
+            break;
+    }
+
+catch:
+    PyMem_Free(json_steps);
+    Py_XDECREF(encoded);
+    return ret;
+}
+
+static PyObject* pygear_job_field(pygear_JobObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject* path;
+    PyObject* default_value = NULL;
+    static char* kwlist[] = {"path", "default", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", kwlist, &path, &default_value)) {
+        return NULL;
+    }
+    PyObject* steps = _pygear_job_field_path(path);
+    if (!steps) {
+        return NULL;
+    }
+    PyObject* ret = NULL;
+    const char* workload;
+    size_t size;
+    _pygear_job_payload(self, &workload, &size);
+    PyObject* serializer = _pygear_envelope_serializer(self->envelope_size ? &self->envelope : NULL,
+        self->serializer);
+    if (!self->workload_decoded && self->g_Job && _pygear_job_is_json(serializer, workload, size)) {
+        ret = _pygear_job_field_scan(serializer, workload, size, steps);
+    } else {
+        PyObject* decoded = pygear_job_workload(self);
+        if (decoded) {
+            ret = _pygear_job_field_lookup(decoded, steps);
+            Py_DECREF(decoded);
+        }
+    }
+    Py_DECREF(steps);
+    if (ret || PyErr_Occurred()) {
+        return ret;
+    }
+    if (default_value) {
+        Py_INCREF(default_value);
+        return default_value;
+    }
+    PyObject* key = PyTuple_Pack(1, path);
+    if (key) {
+        PyErr_SetObject(PyExc_KeyError, key);
+        Py_DECREF(key);
+    }
+    return NULL;
+}
+
+static PyObject* pygear_job_workload_view(pygear_JobObject* self) {
+    if (!self->g_Job) {
+        PyErr_SetString(PyGearExn_ERROR, "Job is no longer valid");
+        return NULL;
+    }
+    if (!self->workload_view) {
+        const char* workload;
+        size_t size;
+        _pygear_job_payload(self, &workload, &size);
+        self->workload_view = _pygear_view_new(workload, size, NULL);
+        if (!self->workload_view) {
+            return NULL;
+        }
+    }
+    Py_INCREF(self->workload_view);
+    return self->workload_view;
 }
 
 static PyObject* pygear_job_workload_size(pygear_JobObject* self) {
-    return Py_BuildValue("I", gearman_job_workload_size(self->g_Job));
+    const char* workload;
+    size_t size;
+    _pygear_job_payload(self, &workload, &size);
+    return Py_BuildValue("I", size);
+}
+
+static PyObject* pygear_job_envelope(pygear_JobObject* self) {
+    if (!self->envelope_size) {
+        Py_RETURN_NONE;
+    }
+    return _pygear_envelope_describe(&self->envelope);
+}
+
+static PyObject* pygear_job_queued_seconds(pygear_JobObject* self) {
+    if (!self->envelope_size || !self->grabbed_us) {
+        Py_RETURN_NONE;
+    }
+    uint64_t sent_us = self->envelope.sent_us;
+    return PyFloat_FromDouble(self->grabbed_us > sent_us ? (self->grabbed_us - sent_us) / 1e6 : 0.0);
 }
 
 static PyObject* pygear_job_error(pygear_JobObject* self) {
@@ -31,6 +31,11 @@
 #include <stdio.h>
 #include "structmember.h"
 #include "worker.h"
+#include "view.h"
+#include "payload.h"
+#include "jsonscan.h"
+#include "envelope.h"
+#include "trace.h"
 
 #ifndef PyMODINIT_FUNC
 #define PyMODINIT_FUNC void
@@ -45,6 +50,13 @@ typedef struct {
     PyObject_HEAD
     struct gearman_job_st* g_Job;
     PyObject* serializer;
+    PyObject* workload_view;    /* pygear.View handed out by workload_view */
+    PyObject* workload_decoded; /* what workload() returned the first time */
+    pygear_envelope envelope;   /* of the workload, if envelope_size */
+    size_t envelope_size;       /* 0 for a bare workload */
+    uint64_t grabbed_us;        /* when the worker got the job, microseconds since the epoch */
+    uint64_t started_us;        /* when its callback was called, 0 if not by Worker.work */
+    bool trace;                 /* records trace events, see Worker.set_trace */
 } pygear_JobObject;
 
 PyDoc_STRVAR(job_module_docstring, "Represents a Gearman job");
@@ -55,32 +67,43 @@ int Job_traverse(pygear_JobObject *self,  visitproc visit, void *arg);
 int Job_clear(pygear_JobObject* self);
 void Job_dealloc(pygear_JobObject* self);
 
+/* Private methods */
+static void _pygear_job_attach(pygear_JobObject* self, gearman_job_st* job, uint64_t grabbed_us);
+static void _pygear_job_detach(pygear_JobObject* self);
+static void _pygear_job_payload(pygear_JobObject* self, const char** data, size_t* size);
+
 
 /* Method definitions */
-static PyObject* pygear_job_send_data(pygear_JobObject* self, PyObject* args);
+static PyObject* pygear_job_send_data(pygear_JobObject* self, PyObject* args, PyObject* kwargs);
 PyDoc_STRVAR(pygear_job_send_data_doc,
 "Send data for a running job.\n"
-"@param[in] data Data to send.");
+"@param[in] data Data to send.\n"
+"@param[in] serialize If False, data is sent as is without a copy: a string,\n"
+"\tan object supporting the buffer protocol (bytearray, mmap, numpy arrays,\n"
+"\tpygear.View...), or a list of them sent as one payload. True by default.");
 
-static PyObject* pygear_job_send_warning(pygear_JobObject* self, PyObject* args);
+static PyObject* pygear_job_send_warning(pygear_JobObject* self, PyObject* args, PyObject* kwargs);
 PyDoc_STRVAR(pygear_job_send_warning_doc,
 " Send warning for a running job."
-"@param[in] warning Warning to send");
+"@param[in] warning Warning to send\n"
+"@param[in] serialize See 'send_data'.");
 
 static PyObject* pygear_job_send_status(pygear_JobObject* self, PyObject* args);
 PyDoc_STRVAR(pygear_job_send_status_doc,
 "Send status information for a running job."
 "@param[in] information Information to send");
 
-static PyObject* pygear_job_send_complete(pygear_JobObject* self, PyObject* args);
+static PyObject* pygear_job_send_complete(pygear_JobObject* self, PyObject* args, PyObject* kwargs);
 PyDoc_STRVAR(pygear_job_send_complete_doc,
 "Send result and complete status for a job."
-"@param[in] result Result to send");
+"@param[in] result Result to send\n"
+"@param[in] serialize See 'send_data'.");
 
-static PyObject* pygear_job_send_exception(pygear_JobObject* self, PyObject* args);
+static PyObject* pygear_job_send_exception(pygear_JobObject* self, PyObject* args, PyObject* kwargs);
 PyDoc_STRVAR(pygear_job_send_exception_doc,
 "Send exception for a running job."
-"@param[in] exception Exception to send");
+"@param[in] exception Exception to send\n"
+"@param[in] serialize See 'send_data'.");
 
 static PyObject* pygear_job_send_fail(pygear_JobObject* self);
 PyDoc_STRVAR(pygear_job_send_fail_doc,
@@ -100,12 +123,54 @@ PyDoc_STRVAR(pygear_job_unique_doc,
 
 static PyObject* pygear_job_workload(pygear_JobObject* self);
 PyDoc_STRVAR(pygear_job_workload_doc,
-"Get the workload for a job.");
+"Get the workload for a job. It is decoded by the serializer on the first\n"
+"call only; later calls return the same object.");
+
+static PyObject* pygear_job_field(pygear_JobObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_job_field_doc,
+"Get one value out of the workload without decoding all of it. With the\n"
+"json serializer, the serialized workload is scanned for the path and only\n"
+"the value found is decoded. Otherwise, or once 'workload' has been called,\n"
+"the decoded workload is looked up.\n"
+"@param[in] path - A key, keys separated by dots, or a tuple of keys and\n"
+"\tlist indices, e.g. 'user.id' or ('items', 0, 'sku').\n"
+"@param[in] default - Optional value returned if the path does not exist.\n"
+"@return the value at the path.\n"
+"@return NULL and raises KeyError if the path does not exist and no default\n"
+"\tis given, TypeError if a step does not apply to the value it reaches,\n"
+"\tValueError if the workload is not valid JSON.\n\n"
+"Example:\n"
+"def handler(job):\n"
+"    return lookup(job.field('user.id'), job.field('locale', 'en_US'))");
 
 static PyObject* pygear_job_workload_size(pygear_JobObject* self);
 PyDoc_STRVAR(pygear_job_workload_size_doc,
 "Get size of the workload for a job.");
 
+static PyObject* pygear_job_envelope(pygear_JobObject* self);
+PyDoc_STRVAR(pygear_job_envelope_doc,
+"Get the metadata the client sent along with the workload, see\n"
+"Client.set_envelope. Replies sent by 'send_complete', 'send_exception' or\n"
+"by returning are then put in an envelope too.\n"
+"@return a dict with the 'version' of the envelope, the 'codec' id of the\n"
+"\tworkload, the time it was 'sent' and the 'deadline' of the job in\n"
+"\tseconds since the epoch (or None), and the 'trace_id' as a hex string.\n"
+"@return None if the workload came without an envelope.");
+
+static PyObject* pygear_job_queued_seconds(pygear_JobObject* self);
+PyDoc_STRVAR(pygear_job_queued_seconds_doc,
+"Get how long the job waited between the client sending it and this worker\n"
+"grabbing it, as measured by the clocks of both hosts. See Worker.stats.\n"
+"@return seconds as a float, or None if the workload came without an\n"
+"\tenvelope (see Client.set_envelope).");
+
+static PyObject* pygear_job_workload_view(pygear_JobObject* self);
+PyDoc_STRVAR(pygear_job_workload_view_doc,
+"Get the serialized workload as a read-only pygear.View over libgearman's\n"
+"buffer, without copying it. The view is only valid while the job is: it\n"
+"raises ValueError once the worker function has returned, unless a\n"
+"memoryview was taken from it, which copies the bytes into the view.");
+
 static PyObject* pygear_job_error(pygear_JobObject* self);
 PyDoc_STRVAR(pygear_job_error_doc,
 "Get a string representation of the last job error");
@@ -122,17 +187,21 @@ PyDoc_STRVAR(pygear_job_set_serializer_doc,
 
 /* Module method specification */
 static PyMethodDef job_module_methods[] = {
-     _JOBMETHOD(send_data,          METH_VARARGS)
-     _JOBMETHOD(send_warning,       METH_VARARGS)
+     _JOBMETHOD(send_data,          METH_VARARGS | METH_KEYWORDS)
+     _JOBMETHOD(send_warning,       METH_VARARGS | METH_KEYWORDS)
      _JOBMETHOD(send_status,        METH_VARARGS)
-     _JOBMETHOD(send_complete,      METH_VARARGS)
-     _JOBMETHOD(send_exception,     METH_VARARGS)
+     _JOBMETHOD(send_complete,      METH_VARARGS | METH_KEYWORDS)
+     _JOBMETHOD(send_exception,     METH_VARARGS | METH_KEYWORDS)
      _JOBMETHOD(send_fail,          METH_NOARGS)
      _JOBMETHOD(handle,             METH_NOARGS)
      _JOBMETHOD(function_name,      METH_NOARGS)
      _JOBMETHOD(unique,             METH_NOARGS)
      _JOBMETHOD(workload,           METH_NOARGS)
+     _JOBMETHOD(field,              METH_VARARGS | METH_KEYWORDS)
      _JOBMETHOD(workload_size,      METH_NOARGS)
+     _JOBMETHOD(workload_view,      METH_NOARGS)
+     _JOBMETHOD(envelope,           METH_NOARGS)
+     _JOBMETHOD(queued_seconds,     METH_NOARGS)
      _JOBMETHOD(error,              METH_NOARGS)
      _JOBMETHOD(set_serializer,     METH_VARARGS)
     {NULL, NULL, 0, NULL}
@@ -0,0 +1,273 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "jsonscan.h"
+
+static const char* _pygear_json_skip_space(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        ++p;
+    }
+    return p;
+}
+
+/* 'p' is at the opening quote. Returns past the closing one, NULL if there is none */
+static const char* _pygear_json_skip_string(const char* p, const char* end) {
+    for (++p; p < end; ++p) {
+        if (*p == '\\') {
+            ++p;
+        } else if (*p == '"') {
+            return p + 1;
+        }
+    }
+    return NULL;
+}
+
+/* 'p' is at the first character of a value. Returns past its last one, NULL if malformed */
+static const char* _pygear_json_skip_value(const char* p, const char* end) {
+    if (p >= end) {
+        return NULL;
+    }
+    if (*p == '"') {
+        return _pygear_json_skip_string(p, end);
+    }
+    if (*p == '{' || *p == '[') {
+        size_t depth = 0;
+        while (p < end) {
+            if (*p == '"') {
+                p = _pygear_json_skip_string(p, end);
+                if (!p) {
+                    return NULL;
+                }
+                continue;
+            }
+            if (*p == '{' || *p == '[') {
+                ++depth;
+            } else if (*p == '}' || *p == ']') {
+                if (--depth == 0) {
+                    return p + 1;
+                }
+            }
+            ++p;
+        }
+        return NULL;
+    }
+    const char* start = p;
+    while (p < end && !strchr(",:}] \t\n\r", *p)) {
+        ++p;
+    }
+    return p > start ? p : NULL;
+}
+
+static int _pygear_json_hex(const char* p, const char* end) {
+    int value = 0;
+    int i;
+    if (end - p < 4) {
+        return -1;
+    }
+    for (i = 0; i < 4; ++i) {
+        char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value |= c - 'A' + 10;
+        } else {
+            return -1;
+        }
+    }
+    return value;
+}
+
+/* Whether the string token between [p, end), without its quotes, decodes to the UTF-8 'key' */
+static bool _pygear_json_key_equals(const char* p, const char* end, const char* key, size_t key_size) {
+    const char* key_end = key + key_size;
+    while (p < end) {
+        if (*p != '\\') {
+            if (key == key_end || *key++ != *p++) {
+                return false;
+            }
+            continue;
+        }
+        if (++p == end) {
+            return false;
+        }
+        char decoded[4];
+        size_t decoded_size = 1;
+        switch (*p++) {
+            case '"': decoded[0] = '"'; break;
+            case '\\': decoded[0] = '\\'; break;
+            case '/': decoded[0] = '/'; break;
+            case 'b': decoded[0] = '\b'; break;
+            case 'f': decoded[0] = '\f'; break;
+            case 'n': decoded[0] = '\n'; break;
+            case 'r': decoded[0] = '\r'; break;
+            case 't': decoded[0] = '\t'; break;
+            case 'u': {
+                long code = _pygear_json_hex(p, end);
+                if (code < 0) {
+                    return false;
+                }
+                p += 4;
+                if (code >= 0xD800 && code < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                    int low = _pygear_json_hex(p + 2, end);
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    }
+                }
+                if (code < 0x80) {
+                    decoded[0] = (char) code;
+                } else if (code < 0x800) {
+                    decoded[0] = (char) (0xC0 | (code >> 6));
+                    decoded[1] = (char) (0x80 | (code & 0x3F));
+                    decoded_size = 2;
+                } else if (code < 0x10000) {
+                    decoded[0] = (char) (0xE0 | (code >> 12));
+                    decoded[1] = (char) (0x80 | ((code >> 6) & 0x3F));
+                    decoded[2] = (char) (0x80 | (code & 0x3F));
+                    decoded_size = 3;
+                } else {
+                    decoded[0] = (char) (0xF0 | (code >> 18));
+                    decoded[1] = (char) (0x80 | ((code >> 12) & 0x3F));
+                    decoded[2] = (char) (0x80 | ((code >> 6) & 0x3F));
+                    decoded[3] = (char) (0x80 | (code & 0x3F));
+                    decoded_size = 4;
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+        if ((size_t) (key_end - key) < decoded_size || memcmp(key, decoded, decoded_size)) {
+            return false;
+        }
+        key += decoded_size;
+    }
+    return key == key_end;
+}
+
+/* Moves 'p' from an object's '{' to the value of 'key' */
+static pygear_json_result _pygear_json_find_key(const char** p, const char* end, const char* key, size_t key_size) {
+    const char* q = _pygear_json_skip_space(*p + 1, end);
+    if (q < end && *q == '}') {
+        return PYGEAR_JSON_MISSING;
+    }
+    while (q < end) {
+        if (*q != '"') {
+            return PYGEAR_JSON_MALFORMED;
+        }
+        const char* key_end = _pygear_json_skip_string(q, end);
+        if (!key_end) {
+            return PYGEAR_JSON_MALFORMED;
+        }
+        bool match = _pygear_json_key_equals(q + 1, key_end - 1, key, key_size);
+        q = _pygear_json_skip_space(key_end, end);
+        if (q == end || *q != ':') {
+            return PYGEAR_JSON_MALFORMED;
+        }
+        q = _pygear_json_skip_space(q + 1, end);
+        if (match) {
+            *p = q;
+            return PYGEAR_JSON_FOUND;
+        }
+        q = _pygear_json_skip_value(q, end);
+        if (!q) {
+            return PYGEAR_JSON_MALFORMED;
+        }
+        q = _pygear_json_skip_space(q, end);
+        if (q < end && *q == '}') {
+            return PYGEAR_JSON_MISSING;
+        }
+        if (q == end || *q != ',') {
+            return PYGEAR_JSON_MALFORMED;
+        }
+        q = _pygear_json_skip_space(q + 1, end);
+    }
+    return PYGEAR_JSON_MALFORMED;
+}
+
+/* Moves 'p' from an array's '[' to the item at 'index' */
+static pygear_json_result _pygear_json_find_index(const char** p, const char* end, size_t index) {
+    const char* q = _pygear_json_skip_space(*p + 1, end);
+    if (q < end && *q == ']') {
+        return PYGEAR_JSON_MISSING;
+    }
+    size_t i;
+    for (i = 0; i < index; ++i) {
+        q = _pygear_json_skip_value(q, end);
+        if (!q) {
+            return PYGEAR_JSON_MALFORMED;
+        }
+        q = _pygear_json_skip_space(q, end);
+        if (q < end && *q == ']') {
+            return PYGEAR_JSON_MISSING;
+        }
+        if (q == end || *q != ',') {
+            return PYGEAR_JSON_MALFORMED;
+        }
+        q = _pygear_json_skip_space(q + 1, end);
+    }
+    *p = q;
+    return PYGEAR_JSON_FOUND;
+}
+
+static pygear_json_result _pygear_json_find(const char* data, size_t size,
+    const pygear_json_step* steps, size_t step_count, const char** value, size_t* value_size) {
+    const char* end = data + size;
+    const char* p = _pygear_json_skip_space(data, end);
+    size_t i;
+    for (i = 0; i < step_count; ++i) {
+        pygear_json_result result;
+        if (p == end) {
+            return PYGEAR_JSON_MALFORMED;
+        }
+        if (steps[i].key) {
+            if (*p != '{') {
+                return PYGEAR_JSON_NOT_CONTAINER;
+            }
+            result = _pygear_json_find_key(&p, end, steps[i].key, steps[i].key_size);
+        } else {
+            if (*p != '[') {
+                return PYGEAR_JSON_NOT_CONTAINER;
+            }
+            result = _pygear_json_find_index(&p, end, steps[i].index);
+        }
+        if (result != PYGEAR_JSON_FOUND) {
+            return result;
+        }
+    }
+    const char* value_end = _pygear_json_skip_value(p, end);
+    if (!value_end) {
+        return PYGEAR_JSON_MALFORMED;
+    }
+    *value = p;
+    *value_size = value_end - p;
+    return PYGEAR_JSON_FOUND;
+}
@@ -0,0 +1,62 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifndef JSONSCAN_H
+#define JSONSCAN_H
+
+/*
+ * Locates one value in a JSON document without decoding the rest of it:
+ * keys are compared in place and the values that are not on the path are
+ * skipped by matching quotes and brackets only. The value found is not
+ * validated either, it is left to the decoder it is handed to.
+ */
+
+/* One step of a path: an object key (UTF-8), or an array index if key is NULL */
+typedef struct {
+    const char* key;
+    size_t key_size;
+    size_t index;
+} pygear_json_step;
+
+typedef enum {
+    PYGEAR_JSON_FOUND,
+    PYGEAR_JSON_MISSING,        /* no such key or index */
+    PYGEAR_JSON_NOT_CONTAINER,  /* a step is applied to a value it does not fit */
+    PYGEAR_JSON_MALFORMED,
+} pygear_json_result;
+
+/* On PYGEAR_JSON_FOUND, [*value, *value + *value_size) is the value at the path */
+static pygear_json_result _pygear_json_find(const char* data, size_t size,
+    const pygear_json_step* steps, size_t step_count, const char** value, size_t* value_size);
+
+#endif
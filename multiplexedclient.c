@@ -0,0 +1,677 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "multiplexedclient.h"
+
+static gearman_return_t _pygear_multiplexedclient_on_created(gearman_task_st* gear_task);
+static gearman_return_t _pygear_multiplexedclient_on_complete(gearman_task_st* gear_task);
+static gearman_return_t _pygear_multiplexedclient_on_exception(gearman_task_st* gear_task);
+static gearman_return_t _pygear_multiplexedclient_on_fail(gearman_task_st* gear_task);
+static void _pygear_multiplexedclient_stop(pygear_MultiplexedClientObject* self);
+
+/*
+ * Class constructor / destructor methods
+ */
+
+int MultiplexedClient_init(pygear_MultiplexedClientObject* self, PyObject* args, PyObject* kwds) {
+    if (self->g_Client) {
+        PyErr_SetString(PyGearExn_ERROR, "MultiplexedClient is already initialized");
+        return -1;
+    }
+    self->g_Client = gearman_client_create(NULL);
+    self->serializer = PyImport_ImportModule(PYTHON_SERIALIZER);
+    if (self->serializer == NULL) {
+        PyObject* err_string = PyString_FromFormat("Failed to import '%s'", PYTHON_SERIALIZER);
+        PyErr_SetObject(PyExc_ImportError, err_string);
+        Py_XDECREF(err_string);
+        return -1;
+    }
+    if (self->g_Client == NULL) {
+        PyErr_SetString(PyGearExn_ERROR, "Failed to create internal gearman client structure");
+        return -1;
+    }
+    gearman_client_add_options(self->g_Client, GEARMAN_CLIENT_NON_BLOCKING | GEARMAN_CLIENT_FREE_TASKS);
+    gearman_client_set_timeout(self->g_Client, MULTIPLEXEDCLIENT_MIN_POLL_MS);
+    gearman_client_set_created_fn(self->g_Client, _pygear_multiplexedclient_on_created);
+    gearman_client_set_complete_fn(self->g_Client, _pygear_multiplexedclient_on_complete);
+    gearman_client_set_exception_fn(self->g_Client, _pygear_multiplexedclient_on_exception);
+    gearman_client_set_fail_fn(self->g_Client, _pygear_multiplexedclient_on_fail);
+    self->timeout = -1;
+    self->started = false;
+    self->stopping = false;
+    self->submissions = NULL;
+    self->inflight = NULL;
+    self->poll_ms = MULTIPLEXEDCLIENT_MIN_POLL_MS;
+    self->outstanding = 0;
+    self->idle = 0;
+    self->coalescing = PYGEAR_COALESCE_OFF;
+    self->coalesced = 0;
+    self->coalesce_table = calloc(MULTIPLEXEDCLIENT_COALESCE_BUCKETS, sizeof(pygear_mux_request*));
+    if (!self->coalesce_table) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->wakeup, NULL);
+    pthread_mutex_init(&self->coalesce_lock, NULL);
+    return 0;
+}
+
+int MultiplexedClient_traverse(pygear_MultiplexedClientObject* self, visitproc visit, void* arg) {
+    Py_VISIT(self->serializer);
+    return 0;
+}
+
+int MultiplexedClient_clear(pygear_MultiplexedClientObject* self) {
+    Py_CLEAR(self->serializer);
+    return 0;
+}
+
+void MultiplexedClient_dealloc(pygear_MultiplexedClientObject* self) {
+    _pygear_multiplexedclient_stop(self);
+    MultiplexedClient_clear(self);
+    if (self->g_Client) {
+        gearman_client_free(self->g_Client);
+        self->g_Client = NULL;
+        pthread_mutex_destroy(&self->lock);
+        pthread_cond_destroy(&self->wakeup);
+    }
+    if (self->coalesce_table) {
+        free(self->coalesce_table);
+        self->coalesce_table = NULL;
+        pthread_mutex_destroy(&self->coalesce_lock);
+    }
+    self->ob_type->tp_free((PyObject*)self);
+}
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+static void _pygear_mux_request_decref(pygear_mux_request* request) {
+    if (__sync_sub_and_fetch(&request->refcount, 1) > 0) {
+        return;
+    }
+    pthread_mutex_destroy(&request->lock);
+    pthread_cond_destroy(&request->finished);
+    free(request->function_name);
+    free(request->unique);
+    free(request->workload);
+    free(request->result);
+    free(request);
+}
+
+/* Stop new callers from joining a request. */
+static void _pygear_mux_request_unpublish(pygear_mux_request* request) {
+    pygear_MultiplexedClientObject* owner = request->owner;
+    pthread_mutex_lock(&owner->coalesce_lock);
+    pygear_mux_request** link = &owner->coalesce_table[request->coalesce_hash % MULTIPLEXEDCLIENT_COALESCE_BUCKETS];
+    while (*link && *link != request) {
+        link = &(*link)->coalesce_next;
+    }
+    if (*link) {
+        *link = request->coalesce_next;
+    }
+    request->coalesce_next = NULL;
+    request->joinable = false;
+    pthread_mutex_unlock(&owner->coalesce_lock);
+}
+
+/* Hand the outcome of a request to its callers. I/O thread only. */
+static void _pygear_mux_request_finish(pygear_mux_request* request, gearman_return_t ret) {
+    pygear_MultiplexedClientObject* owner = request->owner;
+    if (request->joinable) {
+        _pygear_mux_request_unpublish(request);
+    }
+    if (request->inflight_prev) {
+        request->inflight_prev->inflight_next = request->inflight_next;
+    } else if (owner->inflight == request) {
+        owner->inflight = request->inflight_next;
+    }
+    if (request->inflight_next) {
+        request->inflight_next->inflight_prev = request->inflight_prev;
+    }
+    request->inflight_prev = request->inflight_next = NULL;
+    pthread_mutex_lock(&request->lock);
+    request->ret = ret;
+    request->done = true;
+    pthread_cond_broadcast(&request->finished);
+    pthread_mutex_unlock(&request->lock);
+    __sync_fetch_and_sub(&owner->outstanding, 1);
+    _pygear_mux_request_decref(request);
+}
+
+static void _pygear_mux_request_copy_data(pygear_mux_request* request, gearman_task_st* gear_task) {
+    const char* task_data = gearman_task_data(gear_task);
+    size_t data_size = gearman_task_data_size(gear_task);
+    if (!task_data || !data_size || request->result) {
+        return;
+    }
+    request->result = malloc(data_size);
+    if (request->result) {
+        memcpy(request->result, task_data, data_size);
+        request->result_size = data_size;
+    }
+}
+
+/*
+ * Task callbacks, run by the I/O thread from inside gearman_client_run_tasks.
+ * The task context is the request the task was submitted for, detached once
+ * the request is finished since it may be freed right after.
+ */
+static gearman_return_t _pygear_multiplexedclient_on_created(gearman_task_st* gear_task) {
+    pygear_mux_request* request = (pygear_mux_request*) gearman_task_context(gear_task);
+    if (request && request->background) {
+        gearman_task_set_context(gear_task, NULL);
+        strncpy(request->job_handle, gearman_task_job_handle(gear_task), GEARMAN_JOB_HANDLE_SIZE - 1);
+        _pygear_mux_request_finish(request, GEARMAN_SUCCESS);
+    }
+    return GEARMAN_SUCCESS;
+}
+
+static gearman_return_t _pygear_multiplexedclient_on_complete(gearman_task_st* gear_task) {
+    pygear_mux_request* request = (pygear_mux_request*) gearman_task_context(gear_task);
+    if (request && !request->background) {
+        gearman_task_set_context(gear_task, NULL);
+        _pygear_mux_request_copy_data(request, gear_task);
+        _pygear_mux_request_finish(request, GEARMAN_SUCCESS);
+    }
+    return GEARMAN_SUCCESS;
+}
+
+static gearman_return_t _pygear_multiplexedclient_on_exception(gearman_task_st* gear_task) {
+    pygear_mux_request* request = (pygear_mux_request*) gearman_task_context(gear_task);
+    if (request && !request->background) {
+        gearman_task_set_context(gear_task, NULL);
+        _pygear_mux_request_finish(request, GEARMAN_WORK_EXCEPTION);
+    }
+    return GEARMAN_SUCCESS;
+}
+
+static gearman_return_t _pygear_multiplexedclient_on_fail(gearman_task_st* gear_task) {
+    pygear_mux_request* request = (pygear_mux_request*) gearman_task_context(gear_task);
+    if (request && !request->background) {
+        gearman_task_set_context(gear_task, NULL);
+        _pygear_mux_request_finish(request, GEARMAN_WORK_FAIL);
+    }
+    return GEARMAN_SUCCESS;
+}
+
+/* Fail every request in flight and drop their tasks. I/O thread only. */
+static void _pygear_multiplexedclient_fail_inflight(pygear_MultiplexedClientObject* self, gearman_return_t ret) {
+    gearman_client_task_free_all(self->g_Client);
+    while (self->inflight) {
+        _pygear_mux_request_finish(self->inflight, ret);
+    }
+}
+
+/*
+ * Move queued requests onto the connection, oldest first. I/O thread only.
+ * Returns whether there were any.
+ */
+static bool _pygear_multiplexedclient_submit_queued(pygear_MultiplexedClientObject* self) {
+    pygear_mux_request* queued = __sync_lock_test_and_set(&self->submissions, NULL);
+    bool submitted = queued != NULL;
+    pygear_mux_request* ordered = NULL;
+    while (queued) {
+        pygear_mux_request* next = queued->next;
+        queued->next = ordered;
+        ordered = queued;
+        queued = next;
+    }
+    while (ordered) {
+        pygear_mux_request* request = ordered;
+        ordered = ordered->next;
+        request->next = NULL;
+        if (self->stopping) {
+            _pygear_mux_request_finish(request, GEARMAN_SHUTDOWN);
+            continue;
+        }
+        // Linked first, the callbacks may finish it before add_task returns
+        request->inflight_next = self->inflight;
+        if (self->inflight) {
+            self->inflight->inflight_prev = request;
+        }
+        self->inflight = request;
+        gearman_return_t ret;
+        request->add_task(self->g_Client, NULL, request, request->function_name, request->unique,
+            request->workload, request->workload_size, &ret);
+        if (!gearman_success(ret)) {
+            _pygear_mux_request_finish(request, ret);
+        }
+    }
+    return submitted;
+}
+
+static void* _pygear_multiplexedclient_io_loop(void* arg) {
+    pygear_MultiplexedClientObject* self = (pygear_MultiplexedClientObject*) arg;
+    while (true) {
+        if (_pygear_multiplexedclient_submit_queued(self)) {
+            self->poll_ms = MULTIPLEXEDCLIENT_MIN_POLL_MS;
+        }
+        if (self->stopping) {
+            break;
+        }
+        if (!self->inflight) {
+            // Park until a caller queues a request, see _pygear_multiplexedclient_enqueue
+            pthread_mutex_lock(&self->lock);
+            __sync_lock_test_and_set(&self->idle, 1);
+            if (!self->submissions && !self->stopping) {
+                pthread_cond_wait(&self->wakeup, &self->lock);
+            }
+            __sync_lock_test_and_set(&self->idle, 0);
+            pthread_mutex_unlock(&self->lock);
+            continue;
+        }
+        gearman_return_t ret = gearman_client_run_tasks(self->g_Client);
+        if (ret == GEARMAN_IO_WAIT) {
+            // New submissions are only picked up between waits, see MULTIPLEXEDCLIENT_MIN_POLL_MS
+            gearman_client_set_timeout(self->g_Client, self->poll_ms);
+            ret = gearman_client_wait(self->g_Client);
+            if (ret == GEARMAN_TIMEOUT) {
+                ret = GEARMAN_IO_WAIT;
+                self->poll_ms *= 2;
+                if (self->poll_ms > MULTIPLEXEDCLIENT_MAX_POLL_MS) {
+                    self->poll_ms = MULTIPLEXEDCLIENT_MAX_POLL_MS;
+                }
+            } else {
+                self->poll_ms = MULTIPLEXEDCLIENT_MIN_POLL_MS;
+            }
+        } else if (ret == GEARMAN_SUCCESS) {
+            // Every task has run; whatever is left never got a callback
+            _pygear_multiplexedclient_fail_inflight(self, GEARMAN_UNKNOWN_STATE);
+        }
+        if (ret != GEARMAN_SUCCESS && ret != GEARMAN_IO_WAIT) {
+            _pygear_multiplexedclient_fail_inflight(self, ret);
+        }
+    }
+    _pygear_multiplexedclient_fail_inflight(self, GEARMAN_SHUTDOWN);
+    _pygear_multiplexedclient_submit_queued(self);
+    return NULL;
+}
+
+/* Stop and join the I/O thread, if it was started */
+static void _pygear_multiplexedclient_stop(pygear_MultiplexedClientObject* self) {
+    if (!self->started) {
+        return;
+    }
+    self->stopping = true;
+    __sync_synchronize();
+    pthread_mutex_lock(&self->lock);
+    pthread_cond_signal(&self->wakeup);
+    pthread_mutex_unlock(&self->lock);
+    Py_BEGIN_ALLOW_THREADS
+    pthread_join(self->io_thread, NULL);
+    Py_END_ALLOW_THREADS
+    self->started = false;
+}
+
+static void _pygear_multiplexedclient_enqueue(pygear_MultiplexedClientObject* self, pygear_mux_request* request) {
+    __sync_fetch_and_add(&self->outstanding, 1);
+    pygear_mux_request* head;
+    do {
+        head = self->submissions;
+        request->next = head;
+    } while (!__sync_bool_compare_and_swap(&self->submissions, head, request));
+    // The I/O thread flags itself idle under the lock before its last look
+    // at the queue, so it either sees this request or is woken up here.
+    if (__sync_fetch_and_add(&self->idle, 0)) {
+        pthread_mutex_lock(&self->lock);
+        pthread_cond_signal(&self->wakeup);
+        pthread_mutex_unlock(&self->lock);
+    }
+}
+
+/* Whether 'b' asks for the same job as 'a', for the given coalescing mode */
+static bool _pygear_mux_request_same_job(pygear_coalesce_mode mode, const pygear_mux_request* a,
+    const pygear_mux_request* b) {
+    if (a->coalesce_hash != b->coalesce_hash || a->add_task != b->add_task || strcmp(a->function_name, b->function_name)) {
+        return false;
+    }
+    if (mode == PYGEAR_COALESCE_UNIQUE) {
+        return a->unique && b->unique && !strcmp(a->unique, b->unique);
+    }
+    return a->workload_size == b->workload_size && !memcmp(a->workload, b->workload, a->workload_size);
+}
+
+/*
+ * With coalescing, return an identical request already in flight, with a
+ * reference taken for the caller; otherwise publish 'request' for later
+ * callers to join and return NULL.
+ */
+static pygear_mux_request* _pygear_multiplexedclient_join(pygear_MultiplexedClientObject* self, pygear_mux_request* request) {
+    pygear_coalesce_mode mode = self->coalescing;
+    if (mode == PYGEAR_COALESCE_OFF || request->background || (mode == PYGEAR_COALESCE_UNIQUE && !request->unique)) {
+        return NULL;
+    }
+    uint64_t hash = _pygear_hash64(request->function_name, strlen(request->function_name), 0);
+    if (mode == PYGEAR_COALESCE_UNIQUE) {
+        hash = _pygear_hash64(request->unique, strlen(request->unique), hash);
+    } else {
+        hash = _pygear_hash64(request->workload, request->workload_size, hash);
+    }
+    request->coalesce_hash = hash;
+    pthread_mutex_lock(&self->coalesce_lock);
+    pygear_mux_request** bucket = &self->coalesce_table[hash % MULTIPLEXEDCLIENT_COALESCE_BUCKETS];
+    pygear_mux_request* leader;
+    for (leader = *bucket; leader; leader = leader->coalesce_next) {
+        if (_pygear_mux_request_same_job(mode, leader, request)) {
+            __sync_fetch_and_add(&leader->refcount, 1);
+            break;
+        }
+    }
+    if (!leader) {
+        request->joinable = true;
+        request->coalesce_next = *bucket;
+        *bucket = request;
+    }
+    pthread_mutex_unlock(&self->coalesce_lock);
+    return leader;
+}
+
+/*
+ * Wait for the I/O thread to finish a request.
+ * Return false if the client timeout expired first; the request is then
+ * abandoned to the I/O thread. Return false with a python exception set if
+ * the wait hook raised.
+ */
+static bool _pygear_multiplexedclient_wait(pygear_MultiplexedClientObject* self, pygear_mux_request* request) {
+    int timeout = self->timeout;
+    if (_pygear_cooperative_enabled()) {
+        pygear_cooperative_state state;
+        _pygear_cooperative_start(&state, timeout);
+        while (!request->done) {
+            if (_pygear_cooperative_yield(&state) != GEARMAN_SUCCESS) {
+                break;
+            }
+        }
+        __sync_synchronize();
+        return request->done;
+    }
+    bool done;
+    Py_BEGIN_ALLOW_THREADS
+    struct timespec deadline;
+    if (timeout >= 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (timeout % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+    pthread_mutex_lock(&request->lock);
+    while (!request->done) {
+        if (timeout < 0) {
+            pthread_cond_wait(&request->finished, &request->lock);
+        } else if (pthread_cond_timedwait(&request->finished, &request->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    done = request->done;
+    pthread_mutex_unlock(&request->lock);
+    Py_END_ALLOW_THREADS
+    return done;
+}
+
+/*
+ * Serialize the workload, run it through the I/O thread and wait for it.
+ * Return value: New reference, the deserialized result or the job handle.
+ */
+static PyObject* _pygear_multiplexedclient_call(pygear_MultiplexedClientObject* self, pygear_add_task_fn add_task,
+    bool background, PyObject* args, PyObject* kwargs) {
+    char* function_name;
+    PyObject* workload;
+    char* unique = NULL; /* optional */
+    static char* kwlist[] = {"function", "workload", "unique", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|z", kwlist,
+        &function_name, &workload, &unique)) {
+        return NULL;
+    }
+    PyObject* dumpstr = PyString_FromString("dumps");
+    PyObject* pickled_input = PyObject_CallMethodObjArgs(self->serializer, dumpstr, workload, NULL);
+    Py_XDECREF(dumpstr);
+    if (!pickled_input) {
+        return NULL;
+    }
+    char* workload_string;
+    Py_ssize_t workload_size;
+    if (PyString_AsStringAndSize(pickled_input, &workload_string, &workload_size) == -1) {
+        Py_DECREF(pickled_input);
+        return NULL;
+    }
+
+    // The request outlives this call if it times out, so it owns copies
+    pygear_mux_request* request = calloc(1, sizeof(pygear_mux_request));
+    if (!request) {
+        Py_DECREF(pickled_input);
+        return PyErr_NoMemory();
+    }
+    request->owner = self;
+    request->add_task = add_task;
+    request->background = background;
+    request->function_name = strdup(function_name);
+    request->unique = (unique ? strdup(unique) : NULL);
+    request->workload = malloc(workload_size ? workload_size : 1);
+    request->workload_size = workload_size;
+    request->refcount = 2; /* caller and I/O thread */
+    pthread_mutex_init(&request->lock, NULL);
+    pthread_cond_init(&request->finished, NULL);
+    if (!request->function_name || (unique && !request->unique) || !request->workload) {
+        Py_DECREF(pickled_input);
+        request->refcount = 1;
+        _pygear_mux_request_decref(request);
+        return PyErr_NoMemory();
+    }
+    memcpy(request->workload, workload_string, workload_size);
+    Py_DECREF(pickled_input);
+
+    if (!self->started) {
+        self->stopping = false;
+        if (pthread_create(&self->io_thread, NULL, _pygear_multiplexedclient_io_loop, self) != 0) {
+            request->refcount = 1;
+            _pygear_mux_request_decref(request);
+            PyErr_SetString(PyGearExn_ERROR, "Failed to start the I/O thread");
+            return NULL;
+        }
+        self->started = true;
+    }
+    pygear_mux_request* leader = _pygear_multiplexedclient_join(self, request);
+    if (leader) {
+        // Wait for the identical call in flight instead
+        request->refcount = 1;
+        _pygear_mux_request_decref(request);
+        request = leader;
+        __sync_fetch_and_add(&self->coalesced, 1);
+    } else {
+        _pygear_multiplexedclient_enqueue(self, request);
+    }
+
+    PyObject* result = NULL;
+    if (!_pygear_multiplexedclient_wait(self, request)) {
+        if (!PyErr_Occurred()) {
+            PyErr_SetString(PyGearExn_TIMEOUT, "TIMEOUT");
+        }
+        goto catch;
+    }
+    if (_pygear_check_and_raise_exn(request->ret)) {
+        goto catch;
+    }
+    if (background) {
+        result = PyString_FromString(request->job_handle);
+        goto catch;
+    }
+    if (!request->result) {
+        Py_INCREF(Py_None);
+        result = Py_None;
+        goto catch;
+    }
+    PyObject* py_result = PyString_FromStringAndSize(request->result, request->result_size);
+    if (py_result) {
+        result = PyObject_CallMethod(self->serializer, "loads", "O", py_result);
+        Py_DECREF(py_result);
+    }
+catch:
+    _pygear_mux_request_decref(request);
+    return result;
+}
+
+
+/********************
+ * Instance methods *
+ ********************/
+
+static PyObject* pygear_multiplexedclient_add_server(pygear_MultiplexedClientObject* self, PyObject* args) {
+    char* host;
+    int port;
+    if (!PyArg_ParseTuple(args, "zi", &host, &port)) {
+        return NULL;
+    }
+    if (self->started) {
+        PyErr_SetString(PyGearExn_ERROR, "Servers must be added before the first job");
+        return NULL;
+    }
+    gearman_return_t result = gearman_client_add_server(self->g_Client, host, port);
+    if (_pygear_check_and_raise_exn(result)) {
+        return NULL;
+    }
+    // exception callbacks are only called if exceptions are enabled on the server
+    const char *EXCEPTIONS = "exceptions";
+    gearman_client_set_server_option(self->g_Client, EXCEPTIONS, strlen(EXCEPTIONS));
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_multiplexedclient_add_servers(pygear_MultiplexedClientObject* self, PyObject* args) {
+    PyObject* server_list;
+    if (!PyArg_ParseTuple(args, "O!", &PyList_Type, &server_list)) {
+        return NULL;
+    }
+    if (self->started) {
+        PyErr_SetString(PyGearExn_ERROR, "Servers must be added before the first job");
+        return NULL;
+    }
+    Py_ssize_t num_servers = PyList_Size(server_list);
+    Py_ssize_t i;
+    for (i = 0; i < num_servers; ++i) {
+        char* server_string = PyString_AsString(PyList_GetItem(server_list, i));
+        if (!server_string) {
+            return NULL;
+        }
+        gearman_return_t result = gearman_client_add_servers(self->g_Client, server_string);
+        if (_pygear_check_and_raise_exn(result)) {
+            return NULL;
+        }
+    }
+    const char *EXCEPTIONS = "exceptions";
+    gearman_client_set_server_option(self->g_Client, EXCEPTIONS, strlen(EXCEPTIONS));
+    Py_RETURN_NONE;
+}
+
+
+#define MULTIPLEXEDCLIENT_DO(DOTYPE, BACKGROUND) \
+static PyObject* pygear_multiplexedclient_do##DOTYPE(pygear_MultiplexedClientObject* self, PyObject* args, PyObject* kwargs) { \
+    return _pygear_multiplexedclient_call(self, gearman_client_add_task##DOTYPE, BACKGROUND, args, kwargs); \
+}
+
+MULTIPLEXEDCLIENT_DO(, false)
+MULTIPLEXEDCLIENT_DO(_high, false)
+MULTIPLEXEDCLIENT_DO(_low, false)
+MULTIPLEXEDCLIENT_DO(_background, true)
+MULTIPLEXEDCLIENT_DO(_high_background, true)
+MULTIPLEXEDCLIENT_DO(_low_background, true)
+
+
+static PyObject* pygear_multiplexedclient_pending(pygear_MultiplexedClientObject* self) {
+    return Py_BuildValue("l", self->outstanding);
+}
+
+
+static PyObject* pygear_multiplexedclient_coalesced(pygear_MultiplexedClientObject* self) {
+    return Py_BuildValue("l", self->coalesced);
+}
+
+
+static const char* pygear_coalesce_names[] = {"off", "unique", "content", NULL};
+
+static PyObject* pygear_multiplexedclient_set_coalescing(pygear_MultiplexedClientObject* self, PyObject* args) {
+    char* mode;
+    if (!PyArg_ParseTuple(args, "s", &mode)) {
+        return NULL;
+    }
+    int i;
+    for (i = 0; pygear_coalesce_names[i]; ++i) {
+        if (!strcmp(mode, pygear_coalesce_names[i])) {
+            self->coalescing = (pygear_coalesce_mode) i;
+            Py_RETURN_NONE;
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "Unknown coalescing mode '%s'", mode);
+    return NULL;
+}
+
+
+static PyObject* pygear_multiplexedclient_coalescing(pygear_MultiplexedClientObject* self) {
+    return PyString_FromString(pygear_coalesce_names[self->coalescing]);
+}
+
+
+static PyObject* pygear_multiplexedclient_set_serializer(pygear_MultiplexedClientObject* self, PyObject* args) {
+    PyObject* serializer;
+    if (!PyArg_ParseTuple(args, "O", &serializer)) {
+        return NULL;
+    }
+    if (!PyObject_HasAttrString(serializer, "loads")) {
+        PyErr_SetString(PyExc_AttributeError, "Serializer does not implement 'loads'");
+        return NULL;
+    }
+    if (!PyObject_HasAttrString(serializer, "dumps")) {
+        PyErr_SetString(PyExc_AttributeError, "Serializer does not implement 'dumps'");
+        return NULL;
+    }
+    Py_INCREF(serializer);
+    Py_XDECREF(self->serializer);
+    self->serializer = serializer;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_multiplexedclient_set_timeout(pygear_MultiplexedClientObject* self, PyObject* args) {
+    int timeout;
+    if (!PyArg_ParseTuple(args, "i", &timeout)) {
+        return NULL;
+    }
+    self->timeout = timeout;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_multiplexedclient_timeout(pygear_MultiplexedClientObject* self) {
+    return Py_BuildValue("i", self->timeout);
+}
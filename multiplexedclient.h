@@ -0,0 +1,277 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <libgearman-1.0/gearman.h>
+#include <pthread.h>
+#include <stdio.h>
+#include "structmember.h"
+#include "exception.h"
+#include "cooperative.h"
+#include "hash.h"
+
+#ifndef PyMODINIT_FUNC
+#define PyMODINIT_FUNC void
+#endif
+
+#ifndef MULTIPLEXEDCLIENT_H
+#define MULTIPLEXEDCLIENT_H
+
+#define _MULTIPLEXEDCLIENTMETHOD(name,flags) {#name,(PyCFunction) pygear_multiplexedclient_##name,flags,pygear_multiplexedclient_##name##_doc},
+
+/*
+ * Bounds, in milliseconds, of one wait of the I/O thread on the job servers.
+ * libgearman has no way to add a wakeup descriptor to its poll set, so a
+ * request queued during a wait is sent when the wait ends. The wait doubles
+ * while nothing is queued and nothing arrives, and drops back to the minimum
+ * as soon as either happens.
+ */
+#define MULTIPLEXEDCLIENT_MIN_POLL_MS 1
+#define MULTIPLEXEDCLIENT_MAX_POLL_MS 64
+
+/* Buckets of the table of foreground requests other callers can join */
+#define MULTIPLEXEDCLIENT_COALESCE_BUCKETS 256
+
+typedef enum {
+    PYGEAR_COALESCE_OFF,
+    PYGEAR_COALESCE_UNIQUE,     /* same function, priority and unique */
+    PYGEAR_COALESCE_CONTENT     /* same function, priority and encoded workload */
+} pygear_coalesce_mode;
+
+struct pygear_MultiplexedClientObject;
+
+/*
+ * One foreground or background call. Shared by the calling thread and the
+ * I/O thread, freed by whichever drops the last reference, so a caller that
+ * times out can walk away from a request still in flight.
+ */
+typedef struct pygear_mux_request {
+    struct pygear_mux_request* next;            /* submission queue */
+    struct pygear_mux_request* inflight_prev;   /* I/O thread only */
+    struct pygear_mux_request* inflight_next;
+    struct pygear_MultiplexedClientObject* owner;
+    pygear_add_task_fn add_task;
+    bool background;
+    char* function_name;
+    char* unique;
+    char* workload;
+    size_t workload_size;
+    char* result;
+    size_t result_size;
+    char job_handle[GEARMAN_JOB_HANDLE_SIZE];
+    gearman_return_t ret;
+    volatile bool done;
+    volatile int refcount;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    bool joinable;                              /* in the owner's coalesce table */
+    uint64_t coalesce_hash;
+    struct pygear_mux_request* coalesce_next;
+} pygear_mux_request;
+
+typedef struct pygear_MultiplexedClientObject {
+    PyObject_HEAD
+    struct gearman_client_st* g_Client;
+    PyObject* serializer;
+    int timeout;                                /* per call, milliseconds */
+    bool started;
+    pthread_t io_thread;
+    volatile bool stopping;
+    pygear_mux_request* volatile submissions;   /* lock-free stack, newest first */
+    pygear_mux_request* inflight;               /* I/O thread only */
+    int poll_ms;                                /* I/O thread only, length of its next wait */
+    volatile long outstanding;
+    volatile int idle;
+    pthread_mutex_t lock;                       /* only taken to park an idle I/O thread */
+    pthread_cond_t wakeup;
+    pygear_coalesce_mode coalescing;
+    pygear_mux_request** coalesce_table;        /* guarded by coalesce_lock */
+    pthread_mutex_t coalesce_lock;
+    volatile long coalesced;                    /* calls that joined another call's job */
+} pygear_MultiplexedClientObject;
+
+PyDoc_STRVAR(multiplexedclient_module_docstring,
+"Represents a Gearman client shared by any number of Python threads.\n\n"
+"A background C thread owns a single non-blocking connection and runs every\n"
+"job submitted through it concurrently. Callers hand their job over through\n"
+"a lock-free queue and sleep, with the GIL released, until the I/O thread\n"
+"wakes them up with the result. Servers must be added before the first job.");
+
+/* Class init methods */
+int MultiplexedClient_init(pygear_MultiplexedClientObject* self, PyObject* args, PyObject* kwds);
+int MultiplexedClient_traverse(pygear_MultiplexedClientObject* self, visitproc visit, void* arg);
+int MultiplexedClient_clear(pygear_MultiplexedClientObject* self);
+void MultiplexedClient_dealloc(pygear_MultiplexedClientObject* self);
+
+/* Method definitions */
+static PyObject* pygear_multiplexedclient_add_server(pygear_MultiplexedClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_multiplexedclient_add_server_doc,
+"Add a job server to the client. See Client.add_server.\n"
+"Raises pygear.ERROR once the client has started running jobs.");
+
+static PyObject* pygear_multiplexedclient_add_servers(pygear_MultiplexedClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_multiplexedclient_add_servers_doc,
+"Add a list of job servers to the client. See Client.add_servers.\n"
+"Raises pygear.ERROR once the client has started running jobs.");
+
+static PyObject* pygear_multiplexedclient_do(pygear_MultiplexedClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_multiplexedclient_do_doc,
+"Run a foreground job and wait for its result. Safe to call from any thread.\n"
+"See Client.do for parameters and return information.");
+
+static PyObject* pygear_multiplexedclient_do_high(pygear_MultiplexedClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_multiplexedclient_do_high_doc,
+"Run a high priority foreground job and wait for its result. See 'do'.");
+
+static PyObject* pygear_multiplexedclient_do_low(pygear_MultiplexedClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_multiplexedclient_do_low_doc,
+"Run a low priority foreground job and wait for its result. See 'do'.");
+
+static PyObject* pygear_multiplexedclient_do_background(pygear_MultiplexedClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_multiplexedclient_do_background_doc,
+"Submit a background job and wait for the server to accept it.\n"
+"See Client.do_background for parameters and return information.");
+
+static PyObject* pygear_multiplexedclient_do_high_background(pygear_MultiplexedClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_multiplexedclient_do_high_background_doc,
+"Submit a high priority background job. See 'do_background'.");
+
+static PyObject* pygear_multiplexedclient_do_low_background(pygear_MultiplexedClientObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_multiplexedclient_do_low_background_doc,
+"Submit a low priority background job. See 'do_background'.");
+
+static PyObject* pygear_multiplexedclient_pending(pygear_MultiplexedClientObject* self);
+PyDoc_STRVAR(pygear_multiplexedclient_pending_doc,
+"@return the number of jobs queued or in flight.");
+
+static PyObject* pygear_multiplexedclient_set_coalescing(pygear_MultiplexedClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_multiplexedclient_set_coalescing_doc,
+"Let concurrent foreground calls for the same job share a single gearman task.\n"
+"A call that finds an identical call in flight waits for that call's job\n"
+"instead of submitting its own, and decodes the same result. This absorbs\n"
+"bursts of identical requests, e.g. cache miss stampedes, before they reach\n"
+"the job servers.\n\n"
+"@param[in] mode - 'off' (the default); 'unique' to share calls with the same\n"
+"\tfunction, priority and unique; 'content' to share calls with the same\n"
+"\tfunction, priority and serialized workload.");
+
+static PyObject* pygear_multiplexedclient_coalescing(pygear_MultiplexedClientObject* self);
+PyDoc_STRVAR(pygear_multiplexedclient_coalescing_doc,
+"@return the mode set with 'set_coalescing'.");
+
+static PyObject* pygear_multiplexedclient_coalesced(pygear_MultiplexedClientObject* self);
+PyDoc_STRVAR(pygear_multiplexedclient_coalesced_doc,
+"@return the number of calls served by the job of another call.");
+
+static PyObject* pygear_multiplexedclient_set_serializer(pygear_MultiplexedClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_multiplexedclient_set_serializer_doc,
+"Specify the object to be used to serialize data passed through gearman.\n"
+"See Client.set_serializer.\n\n"
+"@param[in] serializer - Object implementing dumps and loads");
+
+static PyObject* pygear_multiplexedclient_set_timeout(pygear_MultiplexedClientObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_multiplexedclient_set_timeout_doc,
+"Set how long, in milliseconds, a call waits for its job.\n"
+"A negative value means wait indefinitely.\n\n"
+"@param[in] timeout - Duration to wait in milliseconds.");
+
+static PyObject* pygear_multiplexedclient_timeout(pygear_MultiplexedClientObject* self);
+PyDoc_STRVAR(pygear_multiplexedclient_timeout_doc,
+"Get the current timeout value, in milliseconds, for the client.\n"
+"@return integer.");
+
+
+/* Module method specification */
+static PyMethodDef multiplexedclient_module_methods[] = {
+    // Server management
+    _MULTIPLEXEDCLIENTMETHOD(add_server,            METH_VARARGS)
+    _MULTIPLEXEDCLIENTMETHOD(add_servers,           METH_VARARGS)
+
+    // Job submission
+    _MULTIPLEXEDCLIENTMETHOD(do,                    METH_VARARGS | METH_KEYWORDS)
+    _MULTIPLEXEDCLIENTMETHOD(do_high,               METH_VARARGS | METH_KEYWORDS)
+    _MULTIPLEXEDCLIENTMETHOD(do_low,                METH_VARARGS | METH_KEYWORDS)
+    _MULTIPLEXEDCLIENTMETHOD(do_background,         METH_VARARGS | METH_KEYWORDS)
+    _MULTIPLEXEDCLIENTMETHOD(do_high_background,    METH_VARARGS | METH_KEYWORDS)
+    _MULTIPLEXEDCLIENTMETHOD(do_low_background,     METH_VARARGS | METH_KEYWORDS)
+    _MULTIPLEXEDCLIENTMETHOD(pending,               METH_NOARGS)
+    _MULTIPLEXEDCLIENTMETHOD(coalesced,             METH_NOARGS)
+
+    // Client Options
+    _MULTIPLEXEDCLIENTMETHOD(timeout,               METH_NOARGS)
+    _MULTIPLEXEDCLIENTMETHOD(set_timeout,           METH_VARARGS)
+    _MULTIPLEXEDCLIENTMETHOD(set_serializer,        METH_VARARGS)
+    _MULTIPLEXEDCLIENTMETHOD(set_coalescing,        METH_VARARGS)
+    _MULTIPLEXEDCLIENTMETHOD(coalescing,            METH_NOARGS)
+
+    {NULL, NULL, 0, NULL}
+};
+
+PyTypeObject pygear_MultiplexedClientType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /*ob_size*/
+    "pygear.MultiplexedClient",                 /*tp_name*/
+    sizeof(pygear_MultiplexedClientObject),     /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)MultiplexedClient_dealloc,      /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_BASETYPE |
+    Py_TPFLAGS_HAVE_GC,                         /*tp_flags*/
+    multiplexedclient_module_docstring,         /* tp_doc */
+    (traverseproc)MultiplexedClient_traverse,   /* tp_traverse */
+    (inquiry)MultiplexedClient_clear,           /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    multiplexedclient_module_methods,           /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    (initproc)MultiplexedClient_init,           /* tp_init */
+};
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "payload.h"
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+static void _pygear_payload_clear(pygear_payload* payload) {
+    payload->data = "";
+    payload->size = 0;
+    payload->owner = NULL;
+    payload->has_view = false;
+    payload->gathered = NULL;
+}
+
+/* Points the payload at the bytes of a single buffer, without copying them */
+static int _pygear_payload_from_buffer(pygear_payload* payload, PyObject* obj) {
+    if (PyString_Check(obj)) {
+        payload->data = PyString_AS_STRING(obj);
+        payload->size = PyString_GET_SIZE(obj);
+        Py_INCREF(obj);
+        payload->owner = obj;
+        return 0;
+    }
+    if (PyUnicode_Check(obj)) {
+        PyErr_SetString(PyExc_TypeError, "Unicode payloads must be encoded first");
+        return -1;
+    }
+    if (PyObject_CheckBuffer(obj)) {
+        if (PyObject_GetBuffer(obj, &payload->view, PyBUF_SIMPLE) < 0) {
+            return -1;
+        }
+        payload->data = payload->view.buf;
+        payload->size = payload->view.len;
+        payload->has_view = true;
+        return 0;
+    }
+    const void* data;
+    if (PyObject_AsReadBuffer(obj, &data, &payload->size) < 0) {
+        return -1;
+    }
+    payload->data = data;
+    Py_INCREF(obj);
+    payload->owner = obj;
+    return 0;
+}
+
+/* Gathers a list or tuple of buffers into a single allocation */
+static int _pygear_payload_gather(pygear_payload* payload, PyObject* seq) {
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    pygear_payload* parts = calloc(count ? count : 1, sizeof(pygear_payload));
+    if (!parts) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    int ret = -1;
+    Py_ssize_t i, acquired, size = 0;
+    for (acquired = 0; acquired < count; ++acquired) {
+        _pygear_payload_clear(&parts[acquired]);
+        if (_pygear_payload_from_buffer(&parts[acquired], PySequence_Fast_GET_ITEM(seq, acquired)) < 0) {
+            goto catch;
+        }
+        size += parts[acquired].size;
+    }
+    payload->gathered = malloc(size ? size : 1);
+    if (!payload->gathered) {
+        PyErr_NoMemory();
+        goto catch;
+    }
+    for (i = 0, size = 0; i < count; ++i) {
+        memcpy(payload->gathered + size, parts[i].data, parts[i].size);
+        size += parts[i].size;
+    }
+    payload->data = payload->gathered;
+    payload->size = size;
+    ret = 0;
+
+catch:
+    for (i = 0; i < acquired; ++i) {
+        _pygear_payload_release(&parts[i]);
+    }
+    free(parts);
+    return ret;
+}
+
+/*
+ * With 'serialize', the payload is what the serializer's 'dumps' returns
+ * for 'obj', a string or any other buffer. Otherwise 'obj' is sent as is:
+ * it is a buffer, or a list or tuple of buffers sent as one payload.
+ * Returns -1 with a python exception set on failure.
+ */
+static int _pygear_payload_init(pygear_payload* payload, PyObject* serializer, PyObject* obj, bool serialize) {
+    _pygear_payload_clear(payload);
+    if (serialize) {
+        PyObject* serialized = PyObject_CallMethod(serializer, "dumps", "O", obj);
+        if (!serialized) {
+            return -1;
+        }
+        int ret = _pygear_payload_from_buffer(payload, serialized);
+        Py_DECREF(serialized);
+        return ret;
+    }
+    if (PyList_Check(obj) || PyTuple_Check(obj)) {
+        return _pygear_payload_gather(payload, obj);
+    }
+    return _pygear_payload_from_buffer(payload, obj);
+}
+
+static void _pygear_payload_release(pygear_payload* payload) {
+    if (payload->has_view) {
+        PyBuffer_Release(&payload->view);
+    }
+    Py_XDECREF(payload->owner);
+    free(payload->gathered);
+    _pygear_payload_clear(payload);
+}
+
+static void _pygear_payload_capsule_destructor(PyObject* capsule) {
+    pygear_payload* payload = PyCapsule_GetPointer(capsule, "pygear.payload");
+    _pygear_payload_release(payload);
+    free(payload);
+}
+
+/*
+ * Moves the payload into a capsule that releases it when collected, for
+ * bytes libgearman keeps pointing to after the call that was given them.
+ * The payload is released on failure.
+ */
+static PyObject* _pygear_payload_capsule(pygear_payload* payload) {
+    pygear_payload* moved = malloc(sizeof(pygear_payload));
+    if (!moved) {
+        _pygear_payload_release(payload);
+        return PyErr_NoMemory();
+    }
+    memcpy(moved, payload, sizeof(pygear_payload));
+    _pygear_payload_clear(payload);
+    PyObject* capsule = PyCapsule_New(moved, "pygear.payload", _pygear_payload_capsule_destructor);
+    if (!capsule) {
+        _pygear_payload_release(moved);
+        free(moved);
+    }
+    return capsule;
+}
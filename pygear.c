@@ -36,6 +36,9 @@ PyModule_AddObject(m, #EXN, PyGearExn_##EXN);
 PyMODINIT_FUNC initpygear(void) {
     PyObject* m;
 
+    // Writer and I/O threads call back into python with PyGILState_Ensure
+    PyEval_InitThreads();
+
     pygear_ClientType.tp_new = PyType_GenericNew;
     if (PyType_Ready(&pygear_ClientType) < 0) {
         return;
@@ -60,6 +63,48 @@ PyMODINIT_FUNC initpygear(void) {
         return;
     }
 
+    pygear_FutureType.tp_new = PyType_GenericNew;
+    if (PyType_Ready(&pygear_FutureType) < 0) {
+        return;
+    }
+
+    pygear_AsyncClientType.tp_new = PyType_GenericNew;
+    if (PyType_Ready(&pygear_AsyncClientType) < 0) {
+        return;
+    }
+
+    pygear_ClientPoolType.tp_new = PyType_GenericNew;
+    if (PyType_Ready(&pygear_ClientPoolType) < 0) {
+        return;
+    }
+
+    if (PyType_Ready(&pygear_ClientLeaseType) < 0) {
+        return;
+    }
+
+    if (PyType_Ready(&pygear_StreamType) < 0) {
+        return;
+    }
+
+    if (PyType_Ready(&pygear_ViewType) < 0) {
+        return;
+    }
+
+    pygear_ArrayCodecType.tp_new = PyType_GenericNew;
+    if (PyType_Ready(&pygear_ArrayCodecType) < 0) {
+        return;
+    }
+
+    pygear_ZlibCodecType.tp_new = PyType_GenericNew;
+    if (PyType_Ready(&pygear_ZlibCodecType) < 0) {
+        return;
+    }
+
+    pygear_MultiplexedClientType.tp_new = PyType_GenericNew;
+    if (PyType_Ready(&pygear_MultiplexedClientType) < 0) {
+        return;
+    }
+
     // Initialize pygear module
     m = Py_InitModule3("pygear", pygear_class_methods, pygear_class_docstring);
 
@@ -83,6 +128,42 @@ PyMODINIT_FUNC initpygear(void) {
     Py_INCREF(&pygear_AdminType);
     PyModule_AddObject(m, "Admin", (PyObject *)&pygear_AdminType);
 
+    // Add Future class
+    Py_INCREF(&pygear_FutureType);
+    PyModule_AddObject(m, "Future", (PyObject *)&pygear_FutureType);
+
+    // Add AsyncClient class
+    Py_INCREF(&pygear_AsyncClientType);
+    PyModule_AddObject(m, "AsyncClient", (PyObject *)&pygear_AsyncClientType);
+
+    // Add ClientPool class
+    Py_INCREF(&pygear_ClientPoolType);
+    PyModule_AddObject(m, "ClientPool", (PyObject *)&pygear_ClientPoolType);
+
+    // Add ClientLease class
+    Py_INCREF(&pygear_ClientLeaseType);
+    PyModule_AddObject(m, "ClientLease", (PyObject *)&pygear_ClientLeaseType);
+
+    // Add MultiplexedClient class
+    Py_INCREF(&pygear_MultiplexedClientType);
+    PyModule_AddObject(m, "MultiplexedClient", (PyObject *)&pygear_MultiplexedClientType);
+
+    // Add Stream class
+    Py_INCREF(&pygear_StreamType);
+    PyModule_AddObject(m, "Stream", (PyObject *)&pygear_StreamType);
+
+    // Add View class
+    Py_INCREF(&pygear_ViewType);
+    PyModule_AddObject(m, "View", (PyObject *)&pygear_ViewType);
+
+    // Add ArrayCodec class
+    Py_INCREF(&pygear_ArrayCodecType);
+    PyModule_AddObject(m, "ArrayCodec", (PyObject *)&pygear_ArrayCodecType);
+
+    // Add ZlibCodec class
+    Py_INCREF(&pygear_ZlibCodecType);
+    PyModule_AddObject(m, "ZlibCodec", (PyObject *)&pygear_ZlibCodecType);
+
     // Enum replacements
     PyModule_AddIntConstant(m, "PYGEAR_VERBOSE_NEVER", GEARMAN_VERBOSE_NEVER);
     PyModule_AddIntConstant(m, "PYGEAR_VERBOSE_FATAL", GEARMAN_VERBOSE_FATAL);
@@ -33,12 +33,30 @@
 
 #include <Python.h>
 #include <libgearman-1.0/gearman.h>
+#include "cooperative.c"
+#include "hash.c"
+#include "router.c"
+#include "histogram.c"
+#include "view.c"
+#include "payload.c"
+#include "jsonscan.c"
+#include "codec.c"
+#include "envelope.c"
+#include "trace.c"
+#include "statshm.c"
+#include "cache.c"
 #include "client.c"
+#include "stream.c"
+#include "submitter.c"
 #include "task.c"
 #include "job.c"
 #include "worker.c"
 #include "exception.h"
 #include "admin.c"
+#include "future.c"
+#include "asyncclient.c"
+#include "clientpool.c"
+#include "multiplexedclient.c"
 
 PyDoc_STRVAR(pygear_class_docstring,
 "PyGear is a python wrapper for the libgearman C/C++ library with minimal modifications.\n"
@@ -56,6 +74,11 @@ PyDoc_STRVAR(pygear_describe_returncode_doc,
 /* Module method specification */
 static PyMethodDef pygear_class_methods[] = {
     {"describe_returncode", (PyCFunction) pygear_describe_returncode, METH_VARARGS, pygear_describe_returncode_doc},
+    {"set_wait_hook", (PyCFunction) pygear_set_wait_hook, METH_VARARGS, pygear_set_wait_hook_doc},
+    {"wait_hook", (PyCFunction) pygear_wait_hook, METH_NOARGS, pygear_wait_hook_doc},
+    {"register_codec", (PyCFunction) pygear_register_codec, METH_VARARGS, pygear_register_codec_doc},
+    {"dump_trace", (PyCFunction) pygear_dump_trace, METH_VARARGS, pygear_dump_trace_doc},
+    {"clear_trace", (PyCFunction) pygear_clear_trace, METH_NOARGS, pygear_clear_trace_doc},
     {NULL, NULL, 0, NULL}
 };
 
@@ -0,0 +1,256 @@
+"""Read the stats pygear objects publish in shared memory.
+
+Worker.publish_stats, Client.publish_stats and ClientPool.publish_stats keep
+a copy of their stats in a file under /dev/shm, one per object and process.
+This module reads those files without calling into the processes, so an
+agent or a cron job can scrape every pygear process on a host:
+
+    python -m pygear_stats [--directory /dev/shm] [--remove-stale]
+
+prints the snapshots aggregated by kind and name as JSON. The layout of the
+files is documented in statshm.h.
+"""
+import errno
+import glob
+import json
+import mmap
+import optparse
+import os
+import struct
+import sys
+import time
+
+
+DEFAULT_DIRECTORY = '/dev/shm'
+MAGIC = b'PGSTATS\0'
+VERSION = 1
+
+COUNTER = 1
+GAUGE = 2
+HISTOGRAM = 3
+TYPES = {COUNTER: 'counter', GAUGE: 'gauge', HISTOGRAM: 'histogram'}
+
+# Native byte order, as the publishing process wrote them; the C structs
+# have no padding
+HEADER = struct.Struct('=8sIIIIIIQII16s64s')
+SERIES = struct.Struct('=64sIIQ')
+SEQ_OFFSET = 32
+SEQ = struct.Struct('=Q')
+
+# Must match histogram.h
+SUB_BITS = 3
+SUB_BUCKETS = 1 << SUB_BITS
+
+READ_ATTEMPTS = 1000
+
+
+class StatsError(Exception):
+    """The file is not a pygear stats file, or not one this module reads."""
+
+
+def _string(raw):
+    return raw.split(b'\0', 1)[0].decode('utf-8', 'replace')
+
+
+def _lower_bound(index):
+    """Smallest microsecond value counted in bucket 'index'."""
+    if index < SUB_BUCKETS:
+        return index
+    octave = index // SUB_BUCKETS + SUB_BITS - 1
+    sub = index % SUB_BUCKETS
+    return (SUB_BUCKETS + sub) << (octave - SUB_BITS)
+
+
+def percentile(histogram, p):
+    """The upper bound of the bucket holding percentile 'p', in seconds."""
+    count = histogram['count']
+    if not count:
+        return 0.0
+    rank = max(int(p / 100.0 * count + 0.5), 1)
+    seen = 0
+    buckets = histogram['buckets']
+    for i, bucket_count in enumerate(buckets):
+        seen += bucket_count
+        if seen >= rank:
+            break
+    if i + 1 >= len(buckets):
+        return histogram['max']
+    return min(_lower_bound(i + 1) / 1e6, histogram['max'])
+
+
+def summary(histogram):
+    """The summary Client.latency_stats returns, for a histogram read here."""
+    count = histogram['count']
+    return {
+        'count': count,
+        'mean': histogram['sum'] / count if count else 0.0,
+        'p50': percentile(histogram, 50),
+        'p90': percentile(histogram, 90),
+        'p99': percentile(histogram, 99),
+        'max': histogram['max'],
+    }
+
+
+def _copy(data):
+    """Copy the header and series while no histogram is being written."""
+    for _ in range(READ_ATTEMPTS):
+        seq, = SEQ.unpack_from(data, SEQ_OFFSET)
+        if seq % 2 == 0:
+            header = HEADER.unpack_from(data, 0)
+            size = header[2] + min(header[8], header[4]) * header[3]
+            if size > len(data):
+                raise StatsError('Stats file is truncated')
+            copy = data[:size]
+            if SEQ.unpack_from(data, SEQ_OFFSET)[0] == seq:
+                return header, copy
+        time.sleep(0.0001)
+    raise StatsError('Stats are being written too often to be read')
+
+
+def _parse_series(copy, offset, buckets):
+    raw_name, series_type, _, value = SERIES.unpack_from(copy, offset)
+    series = {'type': TYPES.get(series_type, 'unknown')}
+    if series_type == HISTOGRAM:
+        histogram_format = struct.Struct('={0}QQdd'.format(buckets))
+        fields = histogram_format.unpack_from(copy, offset + SERIES.size)
+        series['histogram'] = {
+            'buckets': list(fields[:buckets]),
+            'count': fields[buckets],
+            'sum': fields[buckets + 1],
+            'max': fields[buckets + 2],
+        }
+    else:
+        series['value'] = value
+    return _string(raw_name), series
+
+
+def read(path):
+    """Read one stats file.
+
+    Returns a dict with the 'path', 'pid', 'kind' ('worker', 'client' or
+    'pool') and 'name' of the publisher, and its 'series' by name: each a
+    dict with a 'type' and either a 'value' or a 'histogram' of 'buckets',
+    'count', 'sum' and 'max' in seconds.
+    Raises StatsError if the file is not a complete stats file, and IOError
+    or OSError if it can not be opened.
+    """
+    with open(path, 'rb') as f:
+        try:
+            data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        except (ValueError, mmap.error):
+            raise StatsError('{0} is empty'.format(path))
+    try:
+        if len(data) < HEADER.size or data[:len(MAGIC)] != MAGIC:
+            raise StatsError('{0} is not a pygear stats file'.format(path))
+        header, copy = _copy(data)
+    finally:
+        data.close()
+    (_, version, header_size, series_size, _, pid, buckets, _,
+     num_series, _, kind, name) = header
+    if version != VERSION:
+        raise StatsError('{0} has version {1}, expected {2}'.format(path, version, VERSION))
+    series = {}
+    for i in range(min(num_series, (len(copy) - header_size) // series_size)):
+        series_name, value = _parse_series(copy, header_size + i * series_size, buckets)
+        series[series_name] = value
+    return {
+        'path': path,
+        'pid': pid,
+        'kind': _string(kind),
+        'name': _string(name),
+        'series': series,
+    }
+
+
+def _alive(pid):
+    try:
+        os.kill(pid, 0)
+    except OSError as e:
+        return e.errno == errno.EPERM
+    return True
+
+
+def scan(directory=DEFAULT_DIRECTORY, remove_stale=False):
+    """Read every stats file in 'directory' of a process still running.
+
+    The files of processes that died without removing them are skipped, and
+    deleted with 'remove_stale'. Files that can not be read are skipped.
+    """
+    snapshots = []
+    for path in sorted(glob.glob(os.path.join(directory, 'pygear-*.stats'))):
+        try:
+            snapshot = read(path)
+        except (StatsError, IOError, OSError):
+            continue
+        if not _alive(snapshot['pid']):
+            if remove_stale:
+                try:
+                    os.unlink(path)
+                except OSError:
+                    pass
+            continue
+        snapshots.append(snapshot)
+    return snapshots
+
+
+def _merge(total, series):
+    if 'histogram' in series:
+        histogram = total.setdefault('histogram', {
+            'buckets': [0] * len(series['histogram']['buckets']),
+            'count': 0,
+            'sum': 0.0,
+            'max': 0.0,
+        })
+        other = series['histogram']
+        for i, count in enumerate(other['buckets']):
+            histogram['buckets'][i] += count
+        histogram['count'] += other['count']
+        histogram['sum'] += other['sum']
+        histogram['max'] = max(histogram['max'], other['max'])
+    else:
+        total['value'] = total.get('value', 0) + series['value']
+
+
+def aggregate(snapshots):
+    """Sum snapshots by kind and name.
+
+    Returns {kind: {name: {'publishers': number of files, 'series':
+    {series name: value}}}}, where counters and gauges are summed over the
+    publishers and histograms are merged and summarized, see 'summary'.
+    """
+    totals = {}
+    for snapshot in snapshots:
+        by_name = totals.setdefault(snapshot['kind'], {})
+        total = by_name.setdefault(snapshot['name'], {'publishers': 0, 'series': {}})
+        total['publishers'] += 1
+        for series_name, series in snapshot['series'].items():
+            _merge(total['series'].setdefault(series_name, {}), series)
+    for by_name in totals.values():
+        for total in by_name.values():
+            for series_name, series in total['series'].items():
+                if 'histogram' in series:
+                    total['series'][series_name] = summary(series['histogram'])
+                else:
+                    total['series'][series_name] = series['value']
+    return totals
+
+
+def main(argv=None):
+    parser = optparse.OptionParser(usage='%prog [options]', description=(
+        'Print the stats of the pygear processes on this host as JSON.'))
+    parser.add_option('-d', '--directory', default=DEFAULT_DIRECTORY,
+                      help='where the stats files are [%default]')
+    parser.add_option('--remove-stale', action='store_true', default=False,
+                      help='delete the files of processes that are gone')
+    parser.add_option('--raw', action='store_true', default=False,
+                      help='print every file instead of aggregating them')
+    opts, _ = parser.parse_args(argv)
+    snapshots = scan(opts.directory, opts.remove_stale)
+    result = snapshots if opts.raw else aggregate(snapshots)
+    json.dump(result, sys.stdout, indent=2, sort_keys=True)
+    sys.stdout.write('\n')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
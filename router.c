@@ -0,0 +1,634 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "router.h"
+#include "exception.h"
+#include "cooperative.h"
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+static void _pygear_router_init(pygear_router* router) {
+    router->mode = PYGEAR_ROUTING_DEFAULT;
+    router->servers = NULL;
+    router->num_servers = 0;
+    router->ring = NULL;
+    router->ring_size = 0;
+    router->next = 0;
+    router->probing = false;
+    router->stopping = false;
+    router->probe_interval_ms = ROUTER_DEFAULT_PROBE_INTERVAL_MS;
+    pthread_mutex_init(&router->lock, NULL);
+    pthread_condattr_t condattr;
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&router->wake, &condattr);
+    pthread_condattr_destroy(&condattr);
+}
+
+static void _pygear_router_loads_free(pygear_router_load* loads, size_t num_loads) {
+    size_t i;
+    for (i = 0; i < num_loads; ++i) {
+        free(loads[i].function);
+    }
+    free(loads);
+}
+
+static void _pygear_router_server_free(pygear_router_server* server) {
+    if (server->g_Client) {
+        gearman_client_free(server->g_Client);
+        server->g_Client = NULL;
+    }
+    _pygear_router_loads_free(server->loads, server->num_loads);
+    free(server->host);
+    free(server->name);
+}
+
+static void _pygear_router_clear(pygear_router* router) {
+    pthread_mutex_lock(&router->lock);
+    size_t i;
+    for (i = 0; i < router->num_servers; ++i) {
+        _pygear_router_server_free(&router->servers[i]);
+    }
+    free(router->servers);
+    free(router->ring);
+    router->servers = NULL;
+    router->num_servers = 0;
+    router->ring = NULL;
+    router->ring_size = 0;
+    pthread_mutex_unlock(&router->lock);
+}
+
+static void _pygear_router_free(pygear_router* router) {
+    _pygear_router_stop_probe(router);
+    _pygear_router_clear(router);
+    pthread_mutex_destroy(&router->lock);
+    pthread_cond_destroy(&router->wake);
+}
+
+static int _pygear_router_point_cmp(const void* a, const void* b) {
+    uint64_t point_a = ((const pygear_router_point*) a)->point;
+    uint64_t point_b = ((const pygear_router_point*) b)->point;
+    return (point_a > point_b) - (point_a < point_b);
+}
+
+/* Lay out the points of every server on the ring, sorted for binary search */
+static int _pygear_router_build_ring(pygear_router* router) {
+    free(router->ring);
+    router->ring = NULL;
+    router->ring_size = 0;
+    if (!router->num_servers) {
+        return 0;
+    }
+    pygear_router_point* ring = malloc(sizeof(pygear_router_point) * router->num_servers * ROUTER_POINTS_PER_SERVER);
+    if (!ring) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    size_t i, j, n = 0;
+    for (i = 0; i < router->num_servers; ++i) {
+        const char* name = router->servers[i].name;
+        for (j = 0; j < ROUTER_POINTS_PER_SERVER; ++j) {
+            ring[n].point = _pygear_hash64(name, strlen(name), j);
+            ring[n].server = i;
+            n++;
+        }
+    }
+    qsort(ring, n, sizeof(pygear_router_point), _pygear_router_point_cmp);
+    router->ring = ring;
+    router->ring_size = n;
+    return 0;
+}
+
+static int _pygear_router_add(pygear_router* router, const char* host, int port) {
+    if (!host || !*host) {
+        host = GEARMAN_DEFAULT_TCP_HOST;
+    }
+    if (port <= 0) {
+        port = GEARMAN_DEFAULT_TCP_PORT;
+    }
+    int ret = 0;
+    pthread_mutex_lock(&router->lock);
+    size_t i;
+    for (i = 0; i < router->num_servers; ++i) {
+        if (router->servers[i].port == port && !strcmp(router->servers[i].host, host)) {
+            goto finally;
+        }
+    }
+    pygear_router_server* servers = realloc(router->servers, sizeof(pygear_router_server) * (router->num_servers + 1));
+    if (!servers) {
+        PyErr_NoMemory();
+        ret = -1;
+        goto finally;
+    }
+    router->servers = servers;
+    pygear_router_server* server = &servers[router->num_servers];
+    memset(server, 0, sizeof(pygear_router_server));
+    server->host = strdup(host);
+    server->port = port;
+    server->name = malloc(strlen(host) + 16);
+    if (!server->host || !server->name) {
+        _pygear_router_server_free(server);
+        PyErr_NoMemory();
+        ret = -1;
+        goto finally;
+    }
+    sprintf(server->name, "%s:%d", host, port);
+    router->num_servers++;
+    ret = _pygear_router_build_ring(router);
+finally:
+    pthread_mutex_unlock(&router->lock);
+    return ret;
+}
+
+/*
+ * Add every server of a 'HOST[:PORT],HOST[:PORT]' list, the format
+ * gearman_client_add_servers takes. IPv6 addresses go in brackets.
+ */
+static int _pygear_router_add_list(pygear_router* router, const char* servers) {
+    char* list = strdup(servers);
+    if (!list) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    int ret = 0;
+    char* saveptr = NULL;
+    char* entry;
+    for (entry = strtok_r(list, ", ", &saveptr); entry && ret == 0; entry = strtok_r(NULL, ", ", &saveptr)) {
+        char* host = entry;
+        char* port_sep;
+        if (*host == '[') {
+            host++;
+            char* close = strchr(host, ']');
+            if (close) {
+                *close = '\0';
+            }
+            port_sep = close ? strchr(close + 1, ':') : NULL;
+        } else {
+            port_sep = strrchr(host, ':');
+        }
+        int port = 0;
+        if (port_sep) {
+            *port_sep = '\0';
+            port = atoi(port_sep + 1);
+        }
+        ret = _pygear_router_add(router, host, port);
+    }
+    free(list);
+    return ret;
+}
+
+static bool _pygear_router_remove(pygear_router* router, const char* host, int port) {
+    pthread_mutex_lock(&router->lock);
+    size_t i;
+    for (i = 0; i < router->num_servers; ++i) {
+        if (router->servers[i].port == port && !strcmp(router->servers[i].host, host)) {
+            break;
+        }
+    }
+    if (i == router->num_servers) {
+        pthread_mutex_unlock(&router->lock);
+        return false;
+    }
+    _pygear_router_server_free(&router->servers[i]);
+    memmove(&router->servers[i], &router->servers[i + 1],
+        sizeof(pygear_router_server) * (router->num_servers - i - 1));
+    router->num_servers--;
+    if (_pygear_router_build_ring(router) < 0) {
+        // Out of memory: keys fall back to the first server until the next rebuild
+        PyErr_Clear();
+    }
+    pthread_mutex_unlock(&router->lock);
+    return true;
+}
+
+/* Copy the server list and mode of 'from'; connections are not shared */
+static int _pygear_router_copy(pygear_router* router, const pygear_router* from) {
+    _pygear_router_stop_probe(router);
+    _pygear_router_clear(router);
+    router->mode = from->mode;
+    size_t i;
+    for (i = 0; i < from->num_servers; ++i) {
+        if (_pygear_router_add(router, from->servers[i].host, from->servers[i].port) < 0) {
+            return -1;
+        }
+    }
+    if (router->mode == PYGEAR_ROUTING_LEAST_LOADED) {
+        return _pygear_router_start_probe(router, from->probe_interval_ms);
+    }
+    return 0;
+}
+
+/* Drop the per-server connections, e.g. after the client options changed */
+static void _pygear_router_reset_connections(pygear_router* router) {
+    size_t i;
+    for (i = 0; i < router->num_servers; ++i) {
+        if (router->servers[i].g_Client) {
+            gearman_client_free(router->servers[i].g_Client);
+            router->servers[i].g_Client = NULL;
+        }
+    }
+}
+
+static bool _pygear_router_is_down(const pygear_router_server* server, double now) {
+    return server->down_until > now;
+}
+
+/*
+ * Index of the server owning a key hash on the ring, -1 without servers.
+ * Keys of a server marked down go to the next live server on the ring, and
+ * come back once it is up again; if every server is down the owner is kept.
+ */
+static int _pygear_router_pick(pygear_router* router, uint64_t hash) {
+    if (!router->num_servers) {
+        return -1;
+    }
+    if (!router->ring_size) {
+        return 0;
+    }
+    size_t low = 0, high = router->ring_size;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (router->ring[middle].point < hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == router->ring_size) {
+        low = 0;
+    }
+    double now = _pygear_monotonic();
+    size_t n;
+    for (n = 0; n < router->ring_size; ++n) {
+        size_t server = router->ring[(low + n) % router->ring_size].server;
+        if (!_pygear_router_is_down(&router->servers[server], now)) {
+            return (int) server;
+        }
+    }
+    return (int) router->ring[low].server;
+}
+
+/*
+ * Connection to one server only, cloned from 'template' so it has the same
+ * options and timeout. Returns NULL with a python exception set on failure.
+ */
+static gearman_client_st* _pygear_router_connection(pygear_router* router, int server,
+    const gearman_client_st* template) {
+    pygear_router_server* entry = &router->servers[server];
+    if (entry->g_Client) {
+        return entry->g_Client;
+    }
+    gearman_client_st* g_Client = gearman_client_clone(NULL, template);
+    if (!g_Client) {
+        PyErr_SetString(PyGearExn_ERROR, "Failed to create internal gearman client structure");
+        return NULL;
+    }
+    // Task contexts of the clone are never set
+    gearman_client_set_task_context_free_fn(g_Client, NULL);
+    gearman_client_remove_servers(g_Client);
+    gearman_return_t ret = gearman_client_add_server(g_Client, entry->host, entry->port);
+    if (_pygear_check_and_raise_exn(ret)) {
+        gearman_client_free(g_Client);
+        return NULL;
+    }
+    const char *EXCEPTIONS = "exceptions";
+    gearman_client_set_server_option(g_Client, EXCEPTIONS, strlen(EXCEPTIONS));
+    entry->g_Client = g_Client;
+    return g_Client;
+}
+
+
+/*
+ * Server with the most headroom for 'function_name': idle workers minus jobs
+ * waiting, as of the last probe. Servers that were probed but have no worker
+ * for the function come last. Ties, including servers never probed, go to
+ * the lowest observed latency, then rotate. Every pick counts as one more job
+ * on that server until the next probe, so bursts spread out.
+ * Returns -1 without servers.
+ */
+static int _pygear_router_pick_least_loaded(pygear_router* router, const char* function_name) {
+    uint64_t function_hash = _pygear_hash64(function_name, strlen(function_name), 0);
+    double now = _pygear_monotonic();
+    double stale = 3.0 * router->probe_interval_ms / 1000.0;
+    pthread_mutex_lock(&router->lock);
+    int best = -1;
+    bool best_down = false;
+    long best_headroom = 0;
+    double best_latency = 0;
+    pygear_router_load* best_load = NULL;
+    size_t n;
+    for (n = 0; n < router->num_servers; ++n) {
+        size_t i = (router->next + n) % router->num_servers;
+        pygear_router_server* server = &router->servers[i];
+        bool down = _pygear_router_is_down(server, now);
+        long headroom = 0;
+        pygear_router_load* load = NULL;
+        if (server->probed > 0 && now - server->probed < stale) {
+            size_t low = 0, high = server->num_loads;
+            while (low < high) {
+                size_t middle = low + (high - low) / 2;
+                if (server->loads[middle].function_hash < function_hash) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            if (low < server->num_loads && server->loads[low].function_hash == function_hash
+                && server->loads[low].workers > 0) {
+                load = &server->loads[low];
+                headroom = (long) load->workers - load->total;
+            } else {
+                headroom = LONG_MIN / 2;
+            }
+        }
+        // Servers marked down only when all are
+        if (best < 0 || (best_down && !down) || (best_down == down && (headroom > best_headroom
+            || (headroom == best_headroom && server->latency < best_latency)))) {
+            best = (int) i;
+            best_down = down;
+            best_headroom = headroom;
+            best_latency = server->latency;
+            best_load = load;
+        }
+    }
+    if (best_load) {
+        best_load->total++;
+    }
+    router->next++;
+    pthread_mutex_unlock(&router->lock);
+    return best;
+}
+
+/* Fold the round trip of a do* call through 'server' into its latency average */
+static void _pygear_router_observe(pygear_router* router, int server, double seconds) {
+    pthread_mutex_lock(&router->lock);
+    if (server >= 0 && (size_t) server < router->num_servers) {
+        pygear_router_server* entry = &router->servers[server];
+        if (entry->latency > 0) {
+            entry->latency += ROUTER_LATENCY_ALPHA * (seconds - entry->latency);
+        } else {
+            entry->latency = seconds;
+        }
+    }
+    pthread_mutex_unlock(&router->lock);
+}
+
+/* Keep routing away from 'server' for the next 'seconds' */
+static void _pygear_router_mark_down(pygear_router* router, int server, double seconds) {
+    pthread_mutex_lock(&router->lock);
+    if (server >= 0 && (size_t) server < router->num_servers) {
+        router->servers[server].down_until = _pygear_monotonic() + seconds;
+    }
+    pthread_mutex_unlock(&router->lock);
+}
+
+static int _pygear_router_load_cmp(const void* a, const void* b) {
+    uint64_t hash_a = ((const pygear_router_load*) a)->function_hash;
+    uint64_t hash_b = ((const pygear_router_load*) b)->function_hash;
+    return (hash_a > hash_b) - (hash_a < hash_b);
+}
+
+/*
+ * Ask one server for its admin 'status', without the GIL.
+ * On success, the parsed lines are put in *loads, sorted by function hash.
+ */
+static bool _pygear_router_probe_server(const char* host, int port, pygear_router_load** loads, size_t* num_loads) {
+    char port_string[16];
+    snprintf(port_string, sizeof(port_string), "%d", port);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* addresses = NULL;
+    if (getaddrinfo(host, port_string, &hints, &addresses) != 0) {
+        return false;
+    }
+    int sockfd = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+    if (sockfd < 0) {
+        freeaddrinfo(addresses);
+        return false;
+    }
+    // Bounds connect, send and every read
+    struct timeval tv;
+    tv.tv_sec = ROUTER_PROBE_TIMEOUT_MS / 1000;
+    tv.tv_usec = (ROUTER_PROBE_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (char*) &tv, sizeof(tv));
+    setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, (char*) &tv, sizeof(tv));
+    bool connected = connect(sockfd, addresses->ai_addr, addresses->ai_addrlen) == 0;
+    freeaddrinfo(addresses);
+    const char* command = "status\n";
+    if (!connected || send(sockfd, command, strlen(command), MSG_NOSIGNAL) != (ssize_t) strlen(command)) {
+        close(sockfd);
+        return false;
+    }
+    size_t size = 0, capacity = 4096;
+    char* answer = malloc(capacity);
+    bool complete = false;
+    while (answer && !complete) {
+        if (size + 1 >= capacity) {
+            char* larger = realloc(answer, capacity * 2);
+            if (!larger) {
+                break;
+            }
+            answer = larger;
+            capacity *= 2;
+        }
+        ssize_t received = recv(sockfd, answer + size, capacity - size - 1, 0);
+        if (received <= 0) {
+            break;
+        }
+        size += received;
+        answer[size] = '\0';
+        complete = (size >= 2 && !strcmp(answer + size - 2, ".\n"))
+            || strstr(answer, "\n.\n") != NULL;
+    }
+    close(sockfd);
+    if (!complete) {
+        free(answer);
+        return false;
+    }
+    size_t count = 0, lines = 0;
+    char* c;
+    for (c = answer; *c; ++c) {
+        lines += (*c == '\n');
+    }
+    pygear_router_load* parsed = calloc(lines ? lines : 1, sizeof(pygear_router_load));
+    char* saveptr = NULL;
+    char* line;
+    for (line = strtok_r(answer, "\n", &saveptr); parsed && line; line = strtok_r(NULL, "\n", &saveptr)) {
+        // FUNCTION\tTOTAL\tRUNNING\tAVAILABLE_WORKERS
+        char* tab = strchr(line, '\t');
+        if (!tab) {
+            continue;
+        }
+        pygear_router_load* load = &parsed[count];
+        if (sscanf(tab + 1, "%d\t%d\t%d", &load->total, &load->running, &load->workers) != 3) {
+            continue;
+        }
+        *tab = '\0';
+        load->function = strdup(line);
+        if (!load->function) {
+            continue;
+        }
+        load->function_hash = _pygear_hash64(line, strlen(line), 0);
+        count++;
+    }
+    free(answer);
+    if (!parsed) {
+        return false;
+    }
+    qsort(parsed, count, sizeof(pygear_router_load), _pygear_router_load_cmp);
+    *loads = parsed;
+    *num_loads = count;
+    return true;
+}
+
+/* Prober thread: probe every server, then sleep for the interval */
+static void* _pygear_router_probe_run(void* arg) {
+    pygear_router* router = (pygear_router*) arg;
+    pthread_mutex_lock(&router->lock);
+    while (!router->stopping) {
+        size_t i;
+        for (i = 0; i < router->num_servers && !router->stopping; ++i) {
+            char* host = strdup(router->servers[i].host);
+            int port = router->servers[i].port;
+            if (!host) {
+                continue;
+            }
+            // The list may change while probing, the result is matched back by address
+            pthread_mutex_unlock(&router->lock);
+            pygear_router_load* loads = NULL;
+            size_t num_loads = 0;
+            bool probed = _pygear_router_probe_server(host, port, &loads, &num_loads);
+            pthread_mutex_lock(&router->lock);
+            size_t j;
+            for (j = 0; probed && j < router->num_servers; ++j) {
+                pygear_router_server* server = &router->servers[j];
+                if (server->port == port && !strcmp(server->host, host)) {
+                    _pygear_router_loads_free(server->loads, server->num_loads);
+                    server->loads = loads;
+                    server->num_loads = num_loads;
+                    server->probed = _pygear_monotonic();
+                    loads = NULL;
+                    break;
+                }
+            }
+            _pygear_router_loads_free(loads, num_loads);
+            free(host);
+        }
+        double wake_at = _pygear_monotonic() + router->probe_interval_ms / 1000.0;
+        struct timespec deadline;
+        deadline.tv_sec = (time_t) wake_at;
+        deadline.tv_nsec = (long) ((wake_at - deadline.tv_sec) * 1e9);
+        while (!router->stopping && pthread_cond_timedwait(&router->wake, &router->lock, &deadline) != ETIMEDOUT) {
+        }
+    }
+    pthread_mutex_unlock(&router->lock);
+    return NULL;
+}
+
+/* Start the prober, or change its interval if it already runs */
+static int _pygear_router_start_probe(pygear_router* router, int interval_ms) {
+    pthread_mutex_lock(&router->lock);
+    router->probe_interval_ms = interval_ms;
+    bool running = router->probing;
+    if (running) {
+        pthread_cond_broadcast(&router->wake);
+    }
+    pthread_mutex_unlock(&router->lock);
+    if (running) {
+        return 0;
+    }
+    router->stopping = false;
+    if (pthread_create(&router->prober, NULL, _pygear_router_probe_run, router) != 0) {
+        PyErr_SetString(PyGearExn_ERROR, "Failed to start the load prober thread");
+        return -1;
+    }
+    router->probing = true;
+    return 0;
+}
+
+/* Stop the prober; waits for a probe in progress, call without the GIL if possible */
+static void _pygear_router_stop_probe(pygear_router* router) {
+    if (!router->probing) {
+        return;
+    }
+    pthread_mutex_lock(&router->lock);
+    router->stopping = true;
+    pthread_cond_broadcast(&router->wake);
+    pthread_mutex_unlock(&router->lock);
+    pthread_join(router->prober, NULL);
+    router->probing = false;
+}
+
+/* {'HOST:PORT': {'latency': seconds, 'probed': bool, 'down': bool, 'functions': {name: (total, running, workers)}}} */
+static PyObject* _pygear_router_stats(pygear_router* router) {
+    PyObject* stats = PyDict_New();
+    if (!stats) {
+        return NULL;
+    }
+    pthread_mutex_lock(&router->lock);
+    size_t i, j;
+    for (i = 0; i < router->num_servers; ++i) {
+        pygear_router_server* server = &router->servers[i];
+        PyObject* functions = PyDict_New();
+        for (j = 0; functions && j < server->num_loads; ++j) {
+            pygear_router_load* load = &server->loads[j];
+            PyObject* value = Py_BuildValue("(iii)", load->total, load->running, load->workers);
+            if (!value || PyDict_SetItemString(functions, load->function, value) < 0) {
+                Py_XDECREF(value);
+                Py_CLEAR(functions);
+                break;
+            }
+            Py_DECREF(value);
+        }
+        PyObject* entry = NULL;
+        if (functions) {
+            entry = Py_BuildValue("{s:d,s:O,s:O,s:O}",
+                "latency", server->latency,
+                "probed", server->probed > 0 ? Py_True : Py_False,
+                "down", _pygear_router_is_down(server, _pygear_monotonic()) ? Py_True : Py_False,
+                "functions", functions);
+        }
+        Py_XDECREF(functions);
+        if (!entry || PyDict_SetItemString(stats, server->name, entry) < 0) {
+            Py_XDECREF(entry);
+            Py_CLEAR(stats);
+            break;
+        }
+        Py_DECREF(entry);
+    }
+    pthread_mutex_unlock(&router->lock);
+    return stats;
+}
@@ -0,0 +1,119 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <libgearman-1.0/gearman.h>
+#include <pthread.h>
+#include <stdint.h>
+#include "hash.h"
+
+#ifndef ROUTER_H
+#define ROUTER_H
+
+/* Ring points per server; more points even out the share of each server */
+#define ROUTER_POINTS_PER_SERVER 160
+
+#define ROUTER_DEFAULT_PROBE_INTERVAL_MS 1000
+#define ROUTER_PROBE_TIMEOUT_MS 500
+/* Weight of the last round trip in the latency moving average */
+#define ROUTER_LATENCY_ALPHA 0.2
+
+typedef enum {
+    PYGEAR_ROUTING_DEFAULT,     /* libgearman picks the server */
+    PYGEAR_ROUTING_HASH,        /* consistent hashing of the routing key */
+    PYGEAR_ROUTING_LEAST_LOADED /* most headroom for the function, from probes */
+} pygear_routing_mode;
+
+/* One line of the admin 'status' answer of a server */
+typedef struct {
+    uint64_t function_hash;
+    char* function;
+    int total;                  /* jobs queued or running */
+    int running;
+    int workers;                /* workers registered for the function */
+} pygear_router_load;
+
+typedef struct {
+    char* host;
+    int port;
+    char* name;                 /* "host:port", what the ring points are derived from */
+    gearman_client_st* g_Client; /* connection to this server only, created on first use */
+    pygear_router_load* loads;  /* sorted by function_hash */
+    size_t num_loads;
+    double probed;              /* monotonic seconds of the last probe, 0 if never probed */
+    double latency;             /* moving average of do* round trips in seconds, 0 if unknown */
+    double down_until;          /* monotonic seconds; skipped by routing until then */
+} pygear_router_server;
+
+typedef struct {
+    uint64_t point;
+    size_t server;
+} pygear_router_point;
+
+/*
+ * Server list of a client and, in hash mode, a ketama style ring over it.
+ * Every server owns ROUTER_POINTS_PER_SERVER points derived from its name
+ * only, so removing a server moves just the keys that server owned.
+ * In least loaded mode a prober thread polls the admin 'status' of every
+ * server, off the submit path; 'lock' guards the server list and loads.
+ */
+typedef struct {
+    pygear_routing_mode mode;
+    pygear_router_server* servers;
+    size_t num_servers;
+    pygear_router_point* ring;
+    size_t ring_size;
+    unsigned next;              /* rotates the order ties are broken in */
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t prober;
+    bool probing;
+    bool stopping;
+    int probe_interval_ms;
+} pygear_router;
+
+/* Private methods */
+static void _pygear_router_init(pygear_router* router);
+static void _pygear_router_free(pygear_router* router);
+static int _pygear_router_add(pygear_router* router, const char* host, int port);
+static int _pygear_router_add_list(pygear_router* router, const char* servers);
+static bool _pygear_router_remove(pygear_router* router, const char* host, int port);
+static void _pygear_router_clear(pygear_router* router);
+static int _pygear_router_copy(pygear_router* router, const pygear_router* from);
+static void _pygear_router_reset_connections(pygear_router* router);
+static int _pygear_router_pick(pygear_router* router, uint64_t hash);
+static int _pygear_router_pick_least_loaded(pygear_router* router, const char* function_name);
+static void _pygear_router_observe(pygear_router* router, int server, double seconds);
+static void _pygear_router_mark_down(pygear_router* router, int server, double seconds);
+static int _pygear_router_start_probe(pygear_router* router, int interval_ms);
+static void _pygear_router_stop_probe(pygear_router* router);
+static PyObject* _pygear_router_stats(pygear_router* router);
+static gearman_client_st* _pygear_router_connection(pygear_router* router, int server,
+    const gearman_client_st* template);
+
+#endif
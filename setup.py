@@ -7,6 +7,7 @@ pygear = Extension(
     sources=["pygear.c"],
     runtime_library_dirs=["/usr/lib/"],  # libgearman7
     extra_link_args=["-l:libgearman.so.7"],
+    libraries=["z"],
 )
 
 
@@ -14,6 +15,7 @@ setup(
     name="pygear",
     version="0.9.2",
     ext_modules=[pygear],
+    py_modules=["pygear_stats"],
     test_requires=[
         'pytest',
         'mock',
@@ -0,0 +1,203 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "statshm.h"
+
+/* Bumped in forked children, whose inherited segments belong to the parent */
+static unsigned g_pygear_statshm_generation = 0;
+static pthread_once_t g_pygear_statshm_once = PTHREAD_ONCE_INIT;
+static unsigned g_pygear_statshm_opened = 0;
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+static void _pygear_statshm_forked(void) {
+    ++g_pygear_statshm_generation;
+}
+
+static void _pygear_statshm_register_fork(void) {
+    pthread_atfork(NULL, NULL, _pygear_statshm_forked);
+}
+
+static bool _pygear_statshm_live(const pygear_statshm* shm) {
+    return shm && shm->generation == g_pygear_statshm_generation;
+}
+
+static void _pygear_statshm_write_begin(pygear_statshm* shm) {
+    __atomic_store_n(&shm->header->seq, shm->header->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void _pygear_statshm_write_end(pygear_statshm* shm) {
+    __atomic_store_n(&shm->header->seq, shm->header->seq + 1, __ATOMIC_RELEASE);
+}
+
+static pygear_statshm* _pygear_statshm_open(const char* directory, const char* kind, const char* name) {
+    pthread_once(&g_pygear_statshm_once, _pygear_statshm_register_fork);
+    pygear_statshm* shm = calloc(1, sizeof(pygear_statshm));
+    PyObject* path = PyString_FromFormat("%s/pygear-%d-%u.stats", directory ? directory : STATSHM_DEFAULT_DIRECTORY,
+        (int) getpid(), g_pygear_statshm_opened++);
+    int fd = -1;
+    if (!shm || !path || !(shm->path = strdup(PyString_AS_STRING(path)))) {
+        if (!PyErr_Occurred()) {
+            PyErr_NoMemory();
+        }
+        goto catch;
+    }
+    shm->size = sizeof(pygear_statshm_header) + STATSHM_MAX_SERIES * sizeof(pygear_statshm_series);
+    fd = open(shm->path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, shm->size) < 0) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, shm->path);
+        goto catch;
+    }
+    void* mapping = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, shm->path);
+        goto catch;
+    }
+    close(fd);
+    Py_DECREF(path);
+    shm->header = mapping;
+    shm->series = (pygear_statshm_series*) ((char*) mapping + sizeof(pygear_statshm_header));
+    shm->refcount = 1;
+    shm->generation = g_pygear_statshm_generation;
+    pygear_statshm_header* header = shm->header;
+    header->version = STATSHM_VERSION;
+    header->header_size = sizeof(pygear_statshm_header);
+    header->series_size = sizeof(pygear_statshm_series);
+    header->max_series = STATSHM_MAX_SERIES;
+    header->pid = (uint32_t) getpid();
+    header->histogram_buckets = HISTOGRAM_BUCKETS;
+    strncpy(header->kind, kind, STATSHM_KIND_SIZE - 1);
+    strncpy(header->name, name, STATSHM_NAME_SIZE - 1);
+    // Readers ignore the file until the magic is there
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(header->magic, STATSHM_MAGIC, sizeof(STATSHM_MAGIC));
+    return shm;
+
+catch:
+    if (fd >= 0) {
+        close(fd);
+        unlink(shm->path);
+    }
+    Py_XDECREF(path);
+    if (shm) {
+        free(shm->path);
+        free(shm);
+    }
+    return NULL;
+}
+
+static void _pygear_statshm_incref(pygear_statshm* shm) {
+    if (shm) {
+        shm->refcount++;
+    }
+}
+
+static void _pygear_statshm_decref(pygear_statshm* shm) {
+    if (!shm || --shm->refcount > 0) {
+        return;
+    }
+    if (_pygear_statshm_live(shm)) {
+        unlink(shm->path);
+    }
+    munmap(shm->header, shm->size);
+    free(shm->path);
+    free(shm);
+}
+
+static PyObject* _pygear_statshm_path(const pygear_statshm* shm) {
+    return PyString_FromString(shm->path);
+}
+
+static pygear_statshm_series* _pygear_statshm_series(pygear_statshm* shm, const char* name, uint32_t type) {
+    if (!_pygear_statshm_live(shm)) {
+        return NULL;
+    }
+    uint32_t num_series = shm->header->num_series;
+    uint32_t i;
+    for (i = 0; i < num_series; ++i) {
+        if (!strncmp(shm->series[i].name, name, STATSHM_NAME_SIZE - 1)) {
+            return shm->series[i].type == type ? &shm->series[i] : NULL;
+        }
+    }
+    if (num_series >= STATSHM_MAX_SERIES) {
+        return NULL;
+    }
+    pygear_statshm_series* series = &shm->series[num_series];
+    _pygear_statshm_write_begin(shm);
+    strncpy(series->name, name, STATSHM_NAME_SIZE - 1);
+    series->type = type;
+    shm->header->num_series = num_series + 1;
+    _pygear_statshm_write_end(shm);
+    return series;
+}
+
+static void _pygear_statshm_add(pygear_statshm* shm, pygear_statshm_series* series, uint64_t delta) {
+    if (series && _pygear_statshm_live(shm)) {
+        __atomic_fetch_add(&series->value, delta, __ATOMIC_RELAXED);
+    }
+}
+
+static void _pygear_statshm_set(pygear_statshm* shm, pygear_statshm_series* series, uint64_t value) {
+    if (series && _pygear_statshm_live(shm)) {
+        __atomic_store_n(&series->value, value, __ATOMIC_RELAXED);
+    }
+}
+
+static void _pygear_statshm_record(pygear_statshm* shm, pygear_statshm_series* series, double seconds) {
+    if (series && _pygear_statshm_live(shm)) {
+        _pygear_statshm_write_begin(shm);
+        _pygear_histogram_record(&series->histogram, seconds);
+        _pygear_statshm_write_end(shm);
+    }
+}
+
+static void _pygear_statshm_merge(pygear_statshm* shm, pygear_statshm_series* series,
+    const pygear_histogram* histogram) {
+    if (series && _pygear_statshm_live(shm)) {
+        _pygear_statshm_write_begin(shm);
+        int i;
+        for (i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+            series->histogram.counts[i] += histogram->counts[i];
+        }
+        series->histogram.count += histogram->count;
+        series->histogram.sum += histogram->sum;
+        if (histogram->max > series->histogram.max) {
+            series->histogram.max = histogram->max;
+        }
+        _pygear_statshm_write_end(shm);
+    }
+}
@@ -0,0 +1,120 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "histogram.h"
+
+#ifndef STATSHM_H
+#define STATSHM_H
+
+/*
+ * Statistics a Worker, Client or ClientPool publishes in a file under
+ * /dev/shm (see Worker.publish_stats), for pygear_stats.py to read from
+ * other processes without calling into this one. The file is a header
+ * followed by up to STATSHM_MAX_SERIES series of 'series_size' bytes, in
+ * the byte order and alignment of the host:
+ *   0  magic "PGSTATS\0"
+ *   8  uint32 format version, uint32 header size
+ *  16  uint32 series size, uint32 max series
+ *  24  uint32 pid, uint32 histogram buckets
+ *  32  uint64 seq, odd while histograms or the series table are written
+ *  40  uint32 number of series, uint32 reserved
+ *  48  kind and name of the publisher, NUL terminated
+ * Histograms are only written with the GIL held, so there is a single
+ * writer, and readers retry until they copy them between two equal and
+ * even values of 'seq'. Counters and gauges are single words written
+ * atomically, outside of the seqlock.
+ */
+#define STATSHM_MAGIC "PGSTATS"
+#define STATSHM_VERSION 1
+#define STATSHM_MAX_SERIES 256
+#define STATSHM_NAME_SIZE 64
+#define STATSHM_KIND_SIZE 16
+#define STATSHM_DEFAULT_DIRECTORY "/dev/shm"
+
+#define STATSHM_COUNTER 1
+#define STATSHM_GAUGE 2
+#define STATSHM_HISTOGRAM 3
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t series_size;
+    uint32_t max_series;
+    uint32_t pid;
+    uint32_t histogram_buckets;
+    uint64_t seq;
+    uint32_t num_series;
+    uint32_t reserved;
+    char kind[STATSHM_KIND_SIZE];
+    char name[STATSHM_NAME_SIZE];
+} pygear_statshm_header;
+
+typedef struct {
+    char name[STATSHM_NAME_SIZE];
+    uint32_t type;              /* STATSHM_* */
+    uint32_t reserved;
+    uint64_t value;             /* counters and gauges */
+    pygear_histogram histogram;
+} pygear_statshm_series;
+
+/* A mapped segment, shared by the objects publishing in it */
+typedef struct {
+    pygear_statshm_header* header;
+    pygear_statshm_series* series;
+    size_t size;
+    char* path;
+    int refcount;               /* changed with the GIL held */
+    unsigned generation;        /* of the process that created it, see _pygear_statshm_live */
+} pygear_statshm;
+
+/* Private methods */
+/* Creates a segment with a reference count of 1. NULL with a python exception set on failure */
+static pygear_statshm* _pygear_statshm_open(const char* directory, const char* kind, const char* name);
+static void _pygear_statshm_incref(pygear_statshm* shm);
+/* Unmaps the segment on the last reference, and removes its file */
+static void _pygear_statshm_decref(pygear_statshm* shm);
+/* Return value: New reference. The path of the segment */
+static PyObject* _pygear_statshm_path(const pygear_statshm* shm);
+/*
+ * The series called 'name', added if there is none. NULL if 'shm' is
+ * NULL, full or was inherited through fork. The helpers below do nothing
+ * with a NULL series.
+ */
+static pygear_statshm_series* _pygear_statshm_series(pygear_statshm* shm, const char* name, uint32_t type);
+static void _pygear_statshm_add(pygear_statshm* shm, pygear_statshm_series* series, uint64_t delta);
+static void _pygear_statshm_set(pygear_statshm* shm, pygear_statshm_series* series, uint64_t value);
+static void _pygear_statshm_record(pygear_statshm* shm, pygear_statshm_series* series, double seconds);
+static void _pygear_statshm_merge(pygear_statshm* shm, pygear_statshm_series* series,
+    const pygear_histogram* histogram);
+
+#endif
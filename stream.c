@@ -0,0 +1,214 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stream.h"
+
+/*
+ * Class constructor / destructor methods
+ */
+
+int Stream_traverse(pygear_StreamObject* self, visitproc visit, void* arg) {
+    Py_VISIT(self->client);
+    Py_VISIT(self->workload);
+    return 0;
+}
+
+int Stream_clear(pygear_StreamObject* self) {
+    Py_CLEAR(self->client);
+    Py_CLEAR(self->workload);
+    return 0;
+}
+
+static void _pygear_stream_release(pygear_StreamObject* self) {
+    if (self->g_Task) {
+        gearman_task_free(self->g_Task);
+        self->g_Task = NULL;
+    }
+    if (self->g_Client) {
+        gearman_client_free(self->g_Client);
+        self->g_Client = NULL;
+    }
+    while (self->head) {
+        pygear_stream_chunk* next = self->head->next;
+        free(self->head);
+        self->head = next;
+    }
+    self->tail = NULL;
+    self->done = true;
+}
+
+void Stream_dealloc(pygear_StreamObject* self) {
+    PyObject_GC_UnTrack(self);
+    _pygear_stream_release(self);
+    Stream_clear(self);
+    self->ob_type->tp_free((PyObject*)self);
+}
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+static bool _pygear_stream_push(pygear_StreamObject* self, const void* data, size_t size) {
+    pygear_stream_chunk* chunk = malloc(sizeof(pygear_stream_chunk) + size);
+    if (!chunk) {
+        return false;
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    memcpy(chunk->data, data, size);
+    if (self->tail) {
+        self->tail->next = chunk;
+    } else {
+        self->head = chunk;
+    }
+    self->tail = chunk;
+    return true;
+}
+
+/* Runs from gearman_client_run_tasks, without the GIL */
+static gearman_return_t _pygear_stream_data_fn(gearman_task_st* task) {
+    pygear_StreamObject* self = gearman_task_context(task);
+    if (!_pygear_stream_push(self, gearman_task_data(task), gearman_task_data_size(task))) {
+        return GEARMAN_MEMORY_ALLOCATION_FAILURE;
+    }
+    return GEARMAN_SUCCESS;
+}
+
+/*
+ * Reads from the job server until a chunk is queued or the job is over.
+ * A handler that does not stream sends its whole result with WORK_COMPLETE,
+ * which is queued as the last chunk.
+ */
+static gearman_return_t _pygear_stream_pump(pygear_StreamObject* self, bool cooperative) {
+    gearman_return_t ret = GEARMAN_SUCCESS;
+    while (!self->head && gearman_task_is_active(self->g_Task)) {
+        ret = gearman_client_run_tasks(self->g_Client);
+        if (ret == GEARMAN_IO_WAIT && !self->head && gearman_task_is_active(self->g_Task)) {
+            ret = cooperative ? _pygear_cooperative_client_wait(self->g_Client) : gearman_client_wait(self->g_Client);
+        }
+        if (ret != GEARMAN_SUCCESS && ret != GEARMAN_IO_WAIT) {
+            return ret;
+        }
+    }
+    if (!gearman_task_is_active(self->g_Task)) {
+        ret = gearman_task_return(self->g_Task);
+        gearman_result_st* result = gearman_task_result(self->g_Task);
+        if (gearman_success(ret) && result && gearman_result_size(result)) {
+            if (!_pygear_stream_push(self, gearman_result_value(result), gearman_result_size(result))) {
+                ret = GEARMAN_MEMORY_ALLOCATION_FAILURE;
+            }
+        }
+        self->done = true;
+    }
+    return gearman_success(ret) || ret == GEARMAN_IO_WAIT ? GEARMAN_SUCCESS : ret;
+}
+
+/* Return value: New reference */
+static PyObject* _pygear_stream_new(PyObject* client, const gearman_client_st* template,
+    const char* function_name, const char* unique, PyObject* workload) {
+    pygear_StreamObject* self = PyObject_GC_New(pygear_StreamObject, &pygear_StreamType);
+    if (!self) {
+        return NULL;
+    }
+    Py_INCREF(client);
+    self->client = client;
+    Py_INCREF(workload);
+    self->workload = workload;
+    self->g_Task = NULL;
+    self->head = NULL;
+    self->tail = NULL;
+    self->ret = GEARMAN_SUCCESS;
+    self->done = false;
+    PyObject_GC_Track(self);
+    self->g_Client = gearman_client_clone(NULL, template);
+    if (!self->g_Client) {
+        Py_DECREF(self);
+        PyErr_SetString(PyGearExn_ERROR, "Failed to create internal gearman client structure.");
+        return NULL;
+    }
+    // Only this stream's callbacks run on the clone; the task is freed with the stream
+    gearman_client_clear_fn(self->g_Client);
+    gearman_client_set_task_context_free_fn(self->g_Client, NULL);
+    gearman_client_set_data_fn(self->g_Client, _pygear_stream_data_fn);
+    gearman_client_remove_options(self->g_Client, GEARMAN_CLIENT_FREE_TASKS);
+    gearman_client_add_options(self->g_Client, GEARMAN_CLIENT_NON_BLOCKING);
+    gearman_return_t ret;
+    self->g_Task = gearman_client_add_task(self->g_Client, NULL, self, function_name, unique,
+        PyString_AS_STRING(workload), PyString_GET_SIZE(workload), &ret);
+    if (_pygear_check_and_raise_exn(ret)) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject*) self;
+}
+
+
+/********************
+ * Instance methods *
+ ********************/
+
+static PyObject* Stream_iternext(pygear_StreamObject* self) {
+    if (!self->head && !self->done) {
+        if (_pygear_cooperative_enabled()) {
+            self->ret = _pygear_stream_pump(self, true);
+            if (PyErr_Occurred()) {
+                _pygear_stream_release(self);
+                return NULL;
+            }
+        } else {
+            Py_BEGIN_ALLOW_THREADS
+            self->ret = _pygear_stream_pump(self, false);
+            Py_END_ALLOW_THREADS
+        }
+        if (!gearman_success(self->ret)) {
+            _pygear_stream_release(self);
+        }
+    }
+    if (self->head) {
+        pygear_stream_chunk* chunk = self->head;
+        self->head = chunk->next;
+        if (!self->head) {
+            self->tail = NULL;
+        }
+        PyObject* data = PyString_FromStringAndSize(chunk->data, chunk->size);
+        free(chunk);
+        return data;
+    }
+    gearman_return_t ret = self->ret;
+    self->ret = GEARMAN_SUCCESS;
+    _pygear_stream_release(self);
+    _pygear_check_and_raise_exn(ret);
+    return NULL;
+}
+
+
+static PyObject* pygear_stream_close(pygear_StreamObject* self) {
+    _pygear_stream_release(self);
+    Py_RETURN_NONE;
+}
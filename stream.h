@@ -0,0 +1,129 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <libgearman-1.0/gearman.h>
+#include <stdbool.h>
+#include "structmember.h"
+#include "exception.h"
+#include "cooperative.h"
+
+#ifndef PyMODINIT_FUNC
+#define PyMODINIT_FUNC void
+#endif
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#define _STREAMMETHOD(name,flags) {#name,(PyCFunction) pygear_stream_##name,flags,pygear_stream_##name##_doc},
+
+typedef struct pygear_stream_chunk {
+    struct pygear_stream_chunk* next;
+    size_t size;
+    char data[];
+} pygear_stream_chunk;
+
+/*
+ * The job runs on a private non blocking clone of the client, whose data
+ * callback queues WORK_DATA packets as chunks. The socket is only read
+ * once the queue is drained, so a slow consumer holds at most one read's
+ * worth of chunks and pushes back on the worker through TCP flow control.
+ */
+typedef struct {
+    PyObject_HEAD
+    PyObject* client;               /* Client the stream was opened from */
+    PyObject* workload;             /* serialized workload, kept alive until the job is sent */
+    gearman_client_st* g_Client;
+    gearman_task_st* g_Task;
+    pygear_stream_chunk* head;
+    pygear_stream_chunk* tail;
+    gearman_return_t ret;
+    bool done;
+} pygear_StreamObject;
+
+PyDoc_STRVAR(stream_module_docstring,
+"Iterator over the chunks a job streams back, see Client.do_stream.");
+
+/* Class init methods */
+int Stream_traverse(pygear_StreamObject* self, visitproc visit, void* arg);
+int Stream_clear(pygear_StreamObject* self);
+void Stream_dealloc(pygear_StreamObject* self);
+static PyObject* Stream_iternext(pygear_StreamObject* self);
+
+/* Private methods */
+static PyObject* _pygear_stream_new(PyObject* client, const gearman_client_st* template,
+    const char* function_name, const char* unique, PyObject* workload);
+
+/* Method definitions */
+static PyObject* pygear_stream_close(pygear_StreamObject* self);
+PyDoc_STRVAR(pygear_stream_close_doc,
+"Stop reading the stream and drop the chunks that were not consumed. The job\n"
+"keeps running on the worker.");
+
+
+/* Module method specification */
+static PyMethodDef stream_module_methods[] = {
+    _STREAMMETHOD(close,                METH_NOARGS)
+    {NULL, NULL, 0, NULL}
+};
+
+PyTypeObject pygear_StreamType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /*ob_size*/
+    "pygear.Stream",                            /*tp_name*/
+    sizeof(pygear_StreamObject),                /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)Stream_dealloc,                 /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    0,                                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    0,                                          /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_HAVE_GC |
+    Py_TPFLAGS_HAVE_ITER,                       /*tp_flags*/
+    stream_module_docstring,                    /* tp_doc */
+    (traverseproc)Stream_traverse,              /* tp_traverse */
+    (inquiry)Stream_clear,                      /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    PyObject_SelfIter,                          /* tp_iter */
+    (iternextfunc)Stream_iternext,              /* tp_iternext */
+    stream_module_methods,                      /* tp_methods */
+};
+
+#endif
@@ -0,0 +1,288 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "submitter.h"
+#include "client.h"
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+static void _pygear_submitter_item_free(pygear_submitter_item* item) {
+    if (!item) {
+        return;
+    }
+    free(item->function_name);
+    free(item->unique);
+    free(item->workload);
+    free(item);
+}
+
+/* Absolute CLOCK_MONOTONIC time 'timeout_ms' from now, for pthread_cond_timedwait */
+static struct timespec _pygear_submitter_deadline(double from, int timeout_ms) {
+    double when = from + timeout_ms / 1000.0;
+    struct timespec deadline;
+    deadline.tv_sec = (time_t) when;
+    deadline.tv_nsec = (long) ((when - deadline.tv_sec) * 1e9);
+    return deadline;
+}
+
+static gearman_return_t _pygear_submitter_on_created(gearman_task_st* gear_task) {
+    pygear_submitter_item* item = (pygear_submitter_item*) gearman_task_context(gear_task);
+    if (item) {
+        item->created = true;
+    }
+    return GEARMAN_SUCCESS;
+}
+
+/*
+ * Report jobs the server never acknowledged to the owner's async fail
+ * callback, if one is set. Takes the GIL.
+ */
+static void _pygear_submitter_report_failures(pygear_submitter* submitter, pygear_submitter_item** batch,
+    size_t batch_count, gearman_return_t ret) {
+    PyGILState_STATE gstate = PyGILState_Ensure();
+    PyObject* callback = ((pygear_ClientObject*) submitter->owner)->cb_async_fail;
+    Py_XINCREF(callback);
+    size_t i;
+    for (i = 0; callback && i < batch_count; ++i) {
+        if (batch[i]->created) {
+            continue;
+        }
+        PyObject* callback_return = PyObject_CallFunction(callback, "ss#i",
+            batch[i]->function_name, batch[i]->workload, (int) batch[i]->workload_size, ret);
+        if (!callback_return) {
+            PyErr_Print();
+        }
+        Py_XDECREF(callback_return);
+    }
+    Py_XDECREF(callback);
+    PyGILState_Release(gstate);
+}
+
+/* Send one batch over the writer's connection, without holding the lock */
+static void _pygear_submitter_send(pygear_submitter* submitter, pygear_submitter_item** batch, size_t batch_count) {
+    gearman_return_t ret = GEARMAN_SUCCESS;
+    size_t i;
+    for (i = 0; i < batch_count && gearman_success(ret); ++i) {
+        batch[i]->add_task(submitter->g_Client, NULL, batch[i], batch[i]->function_name, batch[i]->unique,
+            batch[i]->workload, batch[i]->workload_size, &ret);
+    }
+    // All requests go out back to back, the JOB_CREATED answers are collected together
+    if (gearman_success(ret)) {
+        ret = gearman_client_run_tasks(submitter->g_Client);
+    }
+    gearman_client_task_free_all(submitter->g_Client);
+    size_t delivered = 0;
+    for (i = 0; i < batch_count; ++i) {
+        if (batch[i]->created) {
+            delivered++;
+        }
+    }
+    if (delivered < batch_count) {
+        _pygear_submitter_report_failures(submitter, batch, batch_count,
+            gearman_success(ret) ? GEARMAN_UNKNOWN_STATE : ret);
+    }
+    for (i = 0; i < batch_count; ++i) {
+        _pygear_submitter_item_free(batch[i]);
+    }
+    pthread_mutex_lock(&submitter->lock);
+    submitter->delivered += delivered;
+    submitter->failed += batch_count - delivered;
+    submitter->completed += batch_count;
+    pthread_cond_broadcast(&submitter->progress);
+    pthread_mutex_unlock(&submitter->lock);
+}
+
+static void* _pygear_submitter_run(void* arg) {
+    pygear_submitter* submitter = (pygear_submitter*) arg;
+    pygear_submitter_item** batch = malloc(sizeof(pygear_submitter_item*) * submitter->batch_size);
+    pthread_mutex_lock(&submitter->lock);
+    while (true) {
+        if (submitter->count == 0) {
+            if (submitter->stopping) {
+                break;
+            }
+            pthread_cond_wait(&submitter->not_empty, &submitter->lock);
+            continue;
+        }
+        // Wait for a full batch, a flush, or the oldest job to get stale
+        bool urgent = submitter->stopping || submitter->count >= submitter->batch_size ||
+            submitter->completed < submitter->flush_target;
+        if (!urgent) {
+            struct timespec deadline = _pygear_submitter_deadline(
+                submitter->ring[submitter->head]->enqueued, submitter->interval_ms);
+            if (pthread_cond_timedwait(&submitter->not_empty, &submitter->lock, &deadline) != ETIMEDOUT) {
+                continue;
+            }
+        }
+        size_t batch_count = 0;
+        while (batch_count < submitter->batch_size && submitter->count > 0) {
+            batch[batch_count++] = submitter->ring[submitter->head];
+            submitter->ring[submitter->head] = NULL;
+            submitter->head = (submitter->head + 1) % submitter->capacity;
+            submitter->count--;
+        }
+        pthread_cond_broadcast(&submitter->not_full);
+        pthread_mutex_unlock(&submitter->lock);
+        _pygear_submitter_send(submitter, batch, batch_count);
+        pthread_mutex_lock(&submitter->lock);
+    }
+    pthread_mutex_unlock(&submitter->lock);
+    free(batch);
+    return NULL;
+}
+
+/*
+ * Start a submitter sending through a clone of 'template'.
+ * Return NULL with a python exception set on failure.
+ */
+static pygear_submitter* _pygear_submitter_create(PyObject* owner, gearman_client_st* template,
+    size_t capacity, size_t batch_size, int interval_ms) {
+    pygear_submitter* submitter = calloc(1, sizeof(pygear_submitter));
+    if (!submitter) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    submitter->ring = calloc(capacity, sizeof(pygear_submitter_item*));
+    submitter->g_Client = gearman_client_clone(NULL, template);
+    if (!submitter->ring || !submitter->g_Client) {
+        if (submitter->g_Client) {
+            gearman_client_free(submitter->g_Client);
+        }
+        free(submitter->ring);
+        free(submitter);
+        PyErr_SetString(PyGearExn_ERROR, "Failed to create the background submitter");
+        return NULL;
+    }
+    // The clone must not call the owner's python callbacks
+    gearman_client_clear_fn(submitter->g_Client);
+    gearman_client_set_task_context_free_fn(submitter->g_Client, NULL);
+    gearman_client_remove_options(submitter->g_Client, GEARMAN_CLIENT_NON_BLOCKING | GEARMAN_CLIENT_FREE_TASKS);
+    gearman_client_set_created_fn(submitter->g_Client, _pygear_submitter_on_created);
+    submitter->owner = owner;
+    submitter->capacity = capacity;
+    submitter->batch_size = batch_size;
+    submitter->interval_ms = interval_ms;
+    pthread_mutex_init(&submitter->lock, NULL);
+    pthread_condattr_t condattr;
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&submitter->not_empty, &condattr);
+    pthread_cond_init(&submitter->not_full, &condattr);
+    pthread_cond_init(&submitter->progress, &condattr);
+    pthread_condattr_destroy(&condattr);
+    if (pthread_create(&submitter->writer, NULL, _pygear_submitter_run, submitter) != 0) {
+        pthread_mutex_destroy(&submitter->lock);
+        pthread_cond_destroy(&submitter->not_empty);
+        pthread_cond_destroy(&submitter->not_full);
+        pthread_cond_destroy(&submitter->progress);
+        gearman_client_free(submitter->g_Client);
+        free(submitter->ring);
+        free(submitter);
+        PyErr_SetString(PyGearExn_ERROR, "Failed to start the background submitter thread");
+        return NULL;
+    }
+    return submitter;
+}
+
+/*
+ * Send whatever is still queued, stop the writer and free the submitter.
+ * Must be called without the GIL, the writer may need it to report failures.
+ */
+static void _pygear_submitter_destroy(pygear_submitter* submitter) {
+    pthread_mutex_lock(&submitter->lock);
+    submitter->stopping = true;
+    pthread_cond_broadcast(&submitter->not_empty);
+    pthread_cond_broadcast(&submitter->not_full);
+    pthread_mutex_unlock(&submitter->lock);
+    pthread_join(submitter->writer, NULL);
+    pthread_mutex_destroy(&submitter->lock);
+    pthread_cond_destroy(&submitter->not_empty);
+    pthread_cond_destroy(&submitter->not_full);
+    pthread_cond_destroy(&submitter->progress);
+    gearman_client_free(submitter->g_Client);
+    free(submitter->ring);
+    free(submitter);
+}
+
+/*
+ * Queue an item, waiting up to 'timeout_ms' (negative for ever) for room.
+ * Return false if the ring stayed full or the submitter is stopping; the
+ * item then still belongs to the caller. Must be called without the GIL.
+ */
+static bool _pygear_submitter_push(pygear_submitter* submitter, pygear_submitter_item* item, int timeout_ms) {
+    bool queued = false;
+    double now = _pygear_monotonic();
+    struct timespec deadline = _pygear_submitter_deadline(now, timeout_ms);
+    item->enqueued = now;
+    pthread_mutex_lock(&submitter->lock);
+    while (submitter->count == submitter->capacity && !submitter->stopping) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&submitter->not_full, &submitter->lock);
+        } else if (pthread_cond_timedwait(&submitter->not_full, &submitter->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    if (submitter->count < submitter->capacity && !submitter->stopping) {
+        submitter->ring[(submitter->head + submitter->count) % submitter->capacity] = item;
+        submitter->count++;
+        submitter->enqueued++;
+        queued = true;
+        if (submitter->count == 1 || submitter->count >= submitter->batch_size) {
+            pthread_cond_signal(&submitter->not_empty);
+        }
+    }
+    pthread_mutex_unlock(&submitter->lock);
+    return queued;
+}
+
+/*
+ * Wait until every item queued before the call was delivered or failed.
+ * Return false if 'timeout_ms' expired first. Must be called without the GIL.
+ */
+static bool _pygear_submitter_flush(pygear_submitter* submitter, int timeout_ms) {
+    struct timespec deadline = _pygear_submitter_deadline(_pygear_monotonic(), timeout_ms);
+    pthread_mutex_lock(&submitter->lock);
+    uint64_t target = submitter->enqueued;
+    if (submitter->flush_target < target) {
+        submitter->flush_target = target;
+        pthread_cond_signal(&submitter->not_empty);
+    }
+    while (submitter->completed < target) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&submitter->progress, &submitter->lock);
+        } else if (pthread_cond_timedwait(&submitter->progress, &submitter->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    bool flushed = submitter->completed >= target;
+    pthread_mutex_unlock(&submitter->lock);
+    return flushed;
+}
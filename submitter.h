@@ -0,0 +1,90 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <libgearman-1.0/gearman.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "cooperative.h"
+
+#ifndef SUBMITTER_H
+#define SUBMITTER_H
+
+#define SUBMITTER_DEFAULT_CAPACITY 4096
+#define SUBMITTER_DEFAULT_BATCH_SIZE 64
+#define SUBMITTER_DEFAULT_INTERVAL_MS 10
+
+/* One queued background job, owned by the ring until its batch is sent */
+typedef struct {
+    pygear_add_task_fn add_task;
+    char* function_name;
+    char* unique;
+    char* workload;
+    size_t workload_size;
+    double enqueued;            /* monotonic seconds */
+    bool created;               /* set by the created callback */
+} pygear_submitter_item;
+
+/*
+ * Background submitter behind Client.submit_background_async.
+ * Callers append to a bounded ring; a writer thread with its own clone of the
+ * client sends the ring in pipelined batches of up to 'batch_size' jobs,
+ * as soon as a batch is full or its oldest job has waited 'interval_ms'.
+ */
+typedef struct {
+    gearman_client_st* g_Client;
+    PyObject* owner;            /* borrowed pygear.Client, for the fail callback */
+    pygear_submitter_item** ring;
+    size_t capacity;
+    size_t head;                /* next item to send */
+    size_t count;
+    size_t batch_size;
+    int interval_ms;
+    uint64_t enqueued;          /* items ever queued */
+    uint64_t completed;         /* items ever delivered or failed */
+    uint64_t flush_target;      /* send without waiting until completed reaches it */
+    uint64_t delivered;
+    uint64_t failed;
+    bool stopping;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pthread_cond_t progress;
+} pygear_submitter;
+
+/* Private methods */
+static pygear_submitter* _pygear_submitter_create(PyObject* owner, gearman_client_st* template,
+    size_t capacity, size_t batch_size, int interval_ms);
+static void _pygear_submitter_destroy(pygear_submitter* submitter);
+static bool _pygear_submitter_push(pygear_submitter* submitter, pygear_submitter_item* item, int timeout_ms);
+static bool _pygear_submitter_flush(pygear_submitter* submitter, int timeout_ms);
+static void _pygear_submitter_item_free(pygear_submitter_item* item);
+
+#endif
@@ -41,6 +41,8 @@ int Task_init(pygear_TaskObject* self, PyObject* args, PyObject* kwds) {
         return -1;
     }
     self->g_Task = NULL;
+    self->result_view = NULL;
+    self->envelope = false;
     return 0;
 }
 
@@ -57,12 +59,23 @@ int Task_clear(pygear_TaskObject* self) {
 void Task_dealloc(pygear_TaskObject* self) {
     if (self->g_Task) {
         gearman_task_free(self->g_Task);
-        self->g_Task = NULL;
     }
+    _pygear_task_detach(self);
     Task_clear(self);
     self->ob_type->tp_free((PyObject*)self);
 }
 
+/*
+ * Private methods
+ */
+
+/* Forget the libgearman task, invalidating the views of its buffers */
+static void _pygear_task_detach(pygear_TaskObject* self) {
+    self->g_Task = NULL;
+    _pygear_view_invalidate(self->result_view);
+    Py_CLEAR(self->result_view);
+}
+
 /*
  * Callback handling
  */
@@ -130,19 +143,50 @@ static PyObject* pygear_task_set_serializer(pygear_TaskObject* self, PyObject* a
     Py_RETURN_NONE;
 }
 
+static PyObject* pygear_task_result_view(pygear_TaskObject* self) {
+    if (!self->g_Task) {
+        PyErr_SetString(PyGearExn_ERROR, "Task is no longer valid");
+        return NULL;
+    }
+    const char* data = gearman_task_data(self->g_Task);
+    size_t data_size = gearman_task_data_size(self->g_Task);
+    pygear_envelope envelope;
+    size_t envelope_size = self->envelope ? _pygear_envelope_parse(data, data_size, &envelope) : 0;
+    data += envelope_size;
+    data_size -= envelope_size;
+    // The task data moves as packets arrive; views of older packets are not kept valid
+    if (!_pygear_view_is(self->result_view, data, data_size)) {
+        _pygear_view_invalidate(self->result_view);
+        Py_CLEAR(self->result_view);
+        self->result_view = _pygear_view_new(data, data_size, NULL);
+        if (!self->result_view) {
+            return NULL;
+        }
+    }
+    Py_INCREF(self->result_view);
+    return self->result_view;
+}
+
+static PyObject* pygear_task_envelope(pygear_TaskObject* self) {
+    const char* data = self->g_Task ? gearman_task_data(self->g_Task) : NULL;
+    size_t data_size = self->g_Task ? gearman_task_data_size(self->g_Task) : 0;
+    pygear_envelope envelope;
+    if (!self->envelope || !_pygear_envelope_parse(data, data_size, &envelope)) {
+        Py_RETURN_NONE;
+    }
+    return _pygear_envelope_describe(&envelope);
+}
+
 static PyObject* pygear_task_result(pygear_TaskObject* self) {
     const char* task_result = gearman_task_data(self->g_Task);
     size_t result_size = gearman_task_data_size(self->g_Task);
     if (!task_result) {
         Py_RETURN_NONE;
     }
-    PyObject* py_result = Py_BuildValue("s#", task_result, result_size);
-    if (!py_result) {
-        PyErr_SetString(PyExc_SystemError, "Failed to build value from Task result\n");
-        return NULL;
-    }
-    PyObject* unpickled_result = PyObject_CallMethod(self->serializer, "loads", "O", py_result);
-    Py_XDECREF(py_result);
+    pygear_envelope envelope;
+    size_t envelope_size = self->envelope ? _pygear_envelope_parse(task_result, result_size, &envelope) : 0;
+    PyObject* unpickled_result = _pygear_envelope_loads(envelope_size ? &envelope : NULL, self->serializer,
+        task_result + envelope_size, result_size - envelope_size);
     if (!unpickled_result) {
         PyErr_SetString(PyExc_SystemError," Failed to unpickle internal Task data\n");
         return NULL;
@@ -30,6 +30,8 @@
 #include <libgearman-1.0/gearman.h>
 #include <stdio.h>
 #include "structmember.h"
+#include "view.h"
+#include "envelope.h"
 
 #ifndef PyMODINIT_FUNC
 #define PyMODINIT_FUNC void
@@ -44,6 +46,8 @@ typedef struct {
     PyObject_HEAD
     struct gearman_task_st* g_Task;
     PyObject* serializer;
+    PyObject* result_view;      /* pygear.View handed out by result_view */
+    bool envelope;              /* sent in an envelope, so the result may be in one */
 } pygear_TaskObject;
 
 PyDoc_STRVAR(task_module_docstring, "Represents a Gearman task");
@@ -54,6 +58,9 @@ int Task_traverse(pygear_TaskObject *self,  visitproc visit, void *arg);
 int Task_clear(pygear_TaskObject* self);
 void Task_dealloc(pygear_TaskObject* self);
 
+/* Private methods */
+static void _pygear_task_detach(pygear_TaskObject* self);
+
 /* Method definitions */
 static PyObject* pygear_task_function_name(pygear_TaskObject* self);
 PyDoc_STRVAR(pygear_task_function_name_doc,
@@ -103,6 +110,20 @@ static PyObject* pygear_task_data_size(pygear_TaskObject* self);
 PyDoc_STRVAR(pygear_task_data_size_doc,
 "Get the size of the data for a completed task in bytes");
 
+static PyObject* pygear_task_result_view(pygear_TaskObject* self);
+PyDoc_STRVAR(pygear_task_result_view_doc,
+"Get the data of a task as a read-only pygear.View over libgearman's buffer,\n"
+"without copying it. The view is valid while the callback it was taken in\n"
+"runs, and until the task receives more data, unless a memoryview was taken\n"
+"from it, which copies the bytes into the view. An envelope is not part of it.");
+
+static PyObject* pygear_task_envelope(pygear_TaskObject* self);
+PyDoc_STRVAR(pygear_task_envelope_doc,
+"Get the metadata a pygear worker sent along with the data, see\n"
+"Job.envelope for the keys. Results and exceptions also say when the worker\n"
+"'grabbed' and 'started' the job, in seconds since the epoch.\n"
+"@return a dict, or None if the data came without an envelope.");
+
 static PyObject* pygear_task_set_serializer(pygear_TaskObject* self, PyObject* args);
 PyDoc_STRVAR(pygear_task_set_serializer_doc,
 "Specify the object to be used to serialize data passed through gearman.\n"
@@ -127,6 +148,8 @@ static PyMethodDef task_module_methods[] = {
     _TASKMETHOD(strstate, METH_NOARGS)
     _TASKMETHOD(result, METH_NOARGS)
     _TASKMETHOD(data_size, METH_NOARGS)
+    _TASKMETHOD(result_view, METH_NOARGS)
+    _TASKMETHOD(envelope, METH_NOARGS)
     _TASKMETHOD(set_serializer, METH_VARARGS)
     {NULL, NULL, 0, NULL}
 };
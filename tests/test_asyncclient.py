@@ -0,0 +1,93 @@
+import gc
+
+import mock
+import pytest
+import pygear
+
+from . import noop_serializer
+
+
+@pytest.fixture
+def c():
+    return pygear.AsyncClient()
+
+
+def test_asyncclient_add_server(c):
+    c.add_server('localhost', 4730)  # valid
+    with pytest.raises(pygear.GETADDRINFO):  # invalid
+        c.add_server("invalidhosturi", -1)
+
+
+def test_asyncclient_add_servers(c):
+    c.add_servers(['localhost:4730', 'srv1-devc', '192.168.0.1', '192.168.0.2:1234'])  # valid
+    with pytest.raises(pygear.GETADDRINFO):  # invalid
+        c.add_servers(["invalidhosturi"])
+
+
+def test_asyncclient_do(c):
+    f = c.do("reverse", "Jackdaws love my big sphynx of quartz")
+    assert type(f) == pygear.Future
+    assert not f.done()
+    assert c.pending() == 1
+    with pytest.raises(pygear.NO_SERVERS):
+        f.result()
+    assert f.done()
+    assert c.pending() == 0
+    # see test_integration.py for valid cases
+
+
+def test_asyncclient_do_background(c):
+    f = c.do_background("reverse", "Jackdaws love my big sphynx of quartz")
+    assert isinstance(f.exception(), pygear.NO_SERVERS)
+
+
+def test_asyncclient_do_many(c):
+    futures = c.do_many("reverse", ["one", "two", "three"])
+    assert len(futures) == 3
+    assert c.pending() == 3
+    assert c.poll(0) == 3
+    assert all(f.done() for f in futures)
+
+
+def test_asyncclient_poll_nothing_pending(c):
+    assert c.poll() == 0
+
+
+def test_asyncclient_done_callback(c):
+    cb_test = mock.Mock()
+    f = c.do("reverse", "A string to be reversed")
+    f.add_done_callback(cb_test)
+    assert not cb_test.called
+    c.poll(0)
+    cb_test.assert_called_once_with(f)
+    # callbacks added after resolution run immediately
+    cb_late = mock.Mock()
+    f.add_done_callback(cb_late)
+    cb_late.assert_called_once_with(f)
+
+
+def test_asyncclient_set_serializer(c):
+    c.set_serializer(noop_serializer())  # valid
+    with pytest.raises(AttributeError):  # invalid
+        c.set_serializer("a string doesn't implement loads.")
+
+
+def test_asyncclient_set_and_get_timeout(c):
+    assert c.timeout() == -1
+    c.set_timeout(30)
+    assert c.timeout() == 30
+
+
+def test_future_unattached():
+    f = pygear.Future()
+    assert not f.done()
+    with pytest.raises(pygear.ERROR):
+        f.result()
+
+
+def test_gc_traversal(c):
+    f = c.do("reverse", "A string to be reversed")
+    assert c in gc.get_referents(f)
+    sentinel = mock.Mock()
+    c.set_serializer(sentinel)
+    assert sentinel in gc.get_referents(c)
@@ -48,6 +48,26 @@ def test_client_clone(c):
     assert cl.get_options() == c.get_options()
 
 
+def test_client_set_envelope(c):
+    assert c.envelope() is False
+    c.set_envelope(True, deadline_ms=500)
+    assert c.envelope() is True
+    assert c.clone().envelope() is True
+    c.set_envelope(False)
+    assert c.envelope() is False
+    with pytest.raises(ValueError):
+        c.set_envelope(True, deadline_ms=-1)
+
+
+def test_register_codec():
+    pygear.register_codec(42, noop_serializer())
+    pygear.register_codec(42, None)
+    with pytest.raises(ValueError):
+        pygear.register_codec(1, noop_serializer())  # json is built in
+    with pytest.raises(ValueError):
+        pygear.register_codec(255, noop_serializer())
+
+
 def test_client_do(c):
     with pytest.raises(pygear.NO_SERVERS):
         c.do("reverse", "Jackdaws love my big sphynx of quartz")
@@ -59,6 +79,18 @@ def test_client_do(c):
 # do_high(...)
 
 
+def test_client_do_stream(c):
+    # stream without server
+    stream = c.do_stream('reverse', 'A string to be reversed')
+    assert type(stream) == pygear.Stream
+    with pytest.raises(pygear.NO_SERVERS):
+        next(stream)
+    # the stream is over once it failed
+    assert list(stream) == []
+    c.do_stream('reverse', 'A string to be reversed').close()
+    # see test_integration.py for streamed results
+
+
 def test_client_do_background(c):
     with pytest.raises(pygear.NO_SERVERS):
         c.do_background("reverse", "Jackdaws love my big sphynx of quartz")
@@ -78,6 +110,217 @@ def test_client_do_status(c):
     pass
 
 
+def test_client_submit_background_async(c):
+    failures = []
+    c.set_async_fail_fn(lambda *args: failures.append(args))
+    c.set_async_options(batch_size=2, flush_interval=5)
+    assert c.submit_background_async("reverse", "Jackdaws love my big sphynx of quartz") is None
+    c.flush(2000)
+    assert c.async_stats() == {'queued': 0, 'delivered': 0, 'failed': 1}
+    assert len(failures) == 1
+    function_name, workload, return_code = failures[0]
+    assert function_name == "reverse"
+    assert workload == '"Jackdaws love my big sphynx of quartz"'
+    # see test_integration.py for valid cases
+
+
+def test_client_set_async_options(c):
+    with pytest.raises(ValueError):
+        c.set_async_options(batch_size=0)
+    c.submit_background_async("reverse", "Jackdaws love my big sphynx of quartz")
+    with pytest.raises(pygear.ERROR):
+        c.set_async_options(batch_size=8)
+
+
+def test_client_flush_without_submissions(c):
+    c.flush()
+    assert c.async_stats() == {'queued': 0, 'delivered': 0, 'failed': 0}
+
+
+def test_client_set_max_in_flight(c):
+    assert c.max_in_flight() == 0
+    c.set_max_in_flight(2)
+    assert c.max_in_flight() == 2
+    assert c.get_options()['free_tasks']
+    with pytest.raises(ValueError):
+        c.set_max_in_flight(-1)
+    # The window turned free_tasks on, removing it turns it back off
+    c.set_max_in_flight(0)
+    assert not c.get_options()['free_tasks']
+    assert not c.clone().get_options()['free_tasks']
+
+
+def test_client_max_in_flight_keeps_free_tasks(c):
+    options = c.get_options()
+    options['free_tasks'] = True
+    c.set_options(**options)
+    c.set_max_in_flight(2)
+    c.set_max_in_flight(0)
+    assert c.get_options()['free_tasks']
+
+
+def test_client_max_in_flight_drives_tasks(c):
+    c.set_max_in_flight(2)
+    c.add_task("reverse", "Jackdaws love my big sphynx of quartz")
+    c.add_task("reverse", "Jackdaws love my big sphynx of quartz")
+    # the window is full, adding runs the queued tasks first
+    with pytest.raises(pygear.NO_SERVERS):
+        c.add_task("reverse", "Jackdaws love my big sphynx of quartz")
+
+
+def test_client_set_routing(c):
+    assert c.routing() == 'default'
+    c.set_routing('hash')
+    assert c.routing() == 'hash'
+    with pytest.raises(ValueError):
+        c.set_routing('random')
+
+
+def test_client_server_for(c):
+    with pytest.raises(pygear.NO_SERVERS):
+        c.server_for('key')
+    c.add_servers(['localhost:4730', '192.168.0.1', '192.168.0.2:1234'])
+    servers = set(['localhost:4730', '192.168.0.1:4730', '192.168.0.2:1234'])
+    owners = dict((key, c.server_for(key)) for key in ('key%d' % i for i in range(300)))
+    assert set(owners.values()) == servers
+    assert c.server_for('key1') == owners['key1']
+    # Only the keys of the removed server move
+    assert c.remove_server('192.168.0.2', 1234)
+    assert not c.remove_server('192.168.0.2', 1234)
+    for key, owner in owners.items():
+        if owner != '192.168.0.2:1234':
+            assert c.server_for(key) == owner
+        else:
+            assert c.server_for(key) in servers - set([owner])
+
+
+def test_client_clone_keeps_routing(c):
+    c.add_server('localhost', 4730)
+    c.set_routing('hash')
+    clone = c.clone()
+    assert clone.routing() == 'hash'
+    assert clone.server_for('key') == 'localhost:4730'
+
+
+def test_client_hash_routing_without_servers(c):
+    c.set_routing('hash')
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do('reverse', 'A string to be reversed', routing_key='key')
+
+
+def test_client_least_loaded_routing(c):
+    c.set_routing('least_loaded', 50)
+    assert c.routing() == 'least_loaded'
+    assert c.routing_stats() == {}
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do('reverse', 'A string to be reversed')
+    c.add_server('localhost', 1)
+    stats = c.routing_stats()['localhost:1']
+    assert stats['latency'] == 0.0
+    assert stats['functions'] == {}
+    with pytest.raises(ValueError):
+        c.set_routing('least_loaded', 0)
+    c.set_routing('default')
+
+
+def test_client_hedge_budget(c):
+    assert c.hedge_stats() == {'requests': 0, 'hedged': 0, 'won': 0}
+    assert c.latency_stats()['count'] == 0
+    c.set_hedge_budget(5)
+    with pytest.raises(ValueError):
+        c.set_hedge_budget(101)
+    with pytest.raises(ValueError):
+        c.set_hedge_budget(-1)
+
+
+def test_client_do_hedge_without_servers(c):
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do('reverse', 'A string to be reversed', hedge_after_ms=10)
+    assert c.hedge_stats()['requests'] == 1
+    # Too few calls to derive a delay, the call is not counted as hedgeable
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do('reverse', 'A string to be reversed', hedge_after_ms=0)
+    assert c.hedge_stats()['requests'] == 1
+
+
+def test_client_set_retry_policy(c):
+    c.set_retry_policy(attempts=3, backoff_ms=1, max_backoff_ms=2, retry_on=[pygear.NO_SERVERS])
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do('reverse', 'A string to be reversed')
+    assert c.retry_stats() == {'retries': 2}
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do_background('reverse', 'A string to be reversed')
+    assert c.retry_stats() == {'retries': 4}
+    # NO_SERVERS is not retried by default
+    c.set_retry_policy(attempts=3, backoff_ms=1, max_backoff_ms=2)
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do('reverse', 'A string to be reversed')
+    assert c.retry_stats() == {'retries': 4}
+    with pytest.raises(ValueError):
+        c.set_retry_policy(attempts=0)
+    with pytest.raises(ValueError):
+        c.set_retry_policy(retry_on=[ValueError])
+
+
+def test_client_retry_fails_over(c):
+    c.add_servers(['localhost:1', 'localhost:2'])
+    c.set_routing('hash')
+    c.set_timeout(100)
+    c.set_retry_policy(attempts=2, backoff_ms=1, max_backoff_ms=1, cooloff_ms=60000)
+    with pytest.raises(pygear.COULD_NOT_CONNECT):
+        c.do('reverse', 'A string to be reversed', routing_key='key')
+    # Both servers were tried, and are now skipped
+    assert c.retry_stats() == {'retries': 1}
+    assert all(stats['down'] for stats in c.routing_stats().values())
+
+
+def test_client_set_unique_strategy(c):
+    assert c.unique_strategy() == 'none'
+    for strategy in ('content', 'random', 'none'):
+        c.set_unique_strategy(strategy)
+        assert c.unique_strategy() == strategy
+        assert type(c.add_task('reverse', 'A string to be reversed')) == pygear.Task
+    c.set_unique_strategy('content')
+    assert c.clone().unique_strategy() == 'content'
+    with pytest.raises(ValueError):
+        c.set_unique_strategy('uuid')
+    # see test_integration.py for the keys jobs are submitted with
+
+
+def test_client_result_cache(c):
+    assert c.result_cache_stats() == {}
+    c.enable_result_cache('reverse', ttl_ms=1000, max_bytes=1024)
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do('reverse', 'A string to be reversed')
+    # Failures are not cached
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do('reverse', 'A string to be reversed')
+    assert c.result_cache_stats() == {
+        'reverse': {'hits': 0, 'misses': 2, 'evictions': 0, 'entries': 0, 'bytes': 0},
+    }
+    assert 'reverse' in c.clone().result_cache_stats()
+    c.disable_result_cache('reverse')
+    assert c.result_cache_stats() == {}
+    with pytest.raises(ValueError):
+        c.enable_result_cache('reverse', ttl_ms=0)
+    # see test_integration.py for cache hits
+
+
+def test_client_unserialized_workloads(c):
+    for workload in ('raw', bytearray('raw'), buffer('raw'), ['r', bytearray('a'), memoryview('w')]):
+        assert type(c.add_task('reverse', workload, serialize=False)) == pygear.Task
+        with pytest.raises(pygear.NO_SERVERS):
+            c.do('reverse', workload, serialize=False)
+        with pytest.raises(pygear.NO_SERVERS):
+            c.do_background('reverse', workload, serialize=False)
+    for workload in (u'raw', [u'raw'], 42, [42]):
+        with pytest.raises(TypeError):
+            c.add_task('reverse', workload, serialize=False)
+        with pytest.raises(TypeError):
+            c.do('reverse', workload, serialize=False)
+    # see test_integration.py for payloads reaching a worker
+
+
 def test_client_echo(c):
     pass
 
@@ -161,3 +404,5 @@ def test_gc_traversal(c):
     sentinel = mock.Mock()
     c.set_complete_fn(sentinel)
     assert sentinel in gc.get_referents(c)
+    c.set_async_fail_fn(sentinel.fail)
+    assert sentinel.fail in gc.get_referents(c)
@@ -0,0 +1,88 @@
+import gc
+import threading
+
+import pytest
+import pygear
+
+
+@pytest.fixture
+def p():
+    return pygear.ClientPool(2, ['localhost:4730'], {'free_tasks': True}, 30)
+
+
+def test_clientpool_invalid_size():
+    with pytest.raises(ValueError):
+        pygear.ClientPool(0)
+    with pytest.raises(ValueError):
+        pygear.ClientPool(1 << 32)
+
+
+def test_clientpool_size(p):
+    assert p.size() == 2
+    assert p.available() == 2
+
+
+def test_clientpool_checkout(p):
+    with p.checkout() as client:
+        assert type(client) == pygear.Client
+        assert p.available() == 1
+        assert client.timeout() == 30
+        assert client.get_options()['free_tasks']
+    assert p.available() == 2
+
+
+def test_clientpool_checkout_distinct_clients(p):
+    with p.checkout() as c1:
+        with p.checkout() as c2:
+            assert c1 is not c2
+            assert p.available() == 0
+
+
+def test_clientpool_checkout_timeout(p):
+    l1 = p.checkout()
+    l2 = p.checkout()
+    with pytest.raises(pygear.TIMEOUT):
+        p.checkout(timeout=10)
+    l1.release()
+    l1.release()  # no effect
+    assert p.available() == 1
+    del l2
+    gc.collect()
+    assert p.available() == 2
+
+
+def test_clientpool_checkout_timeout_default():
+    p = pygear.ClientPool(1, timeout=5000, checkout_timeout=0)
+    with p.checkout() as client:
+        assert client.timeout() == 5000
+        with pytest.raises(pygear.TIMEOUT):
+            p.checkout()
+
+
+def test_clientpool_checkout_wakes_waiter(p):
+    leases = [p.checkout(), p.checkout()]
+    acquired = []
+
+    def waiter():
+        with p.checkout(timeout=-1) as client:
+            acquired.append(client)
+
+    thread = threading.Thread(target=waiter)
+    thread.start()
+    leases.pop().release()
+    thread.join(5)
+    assert not thread.is_alive()
+    assert len(acquired) == 1
+
+
+def test_clientpool_do():
+    p = pygear.ClientPool(1)
+    with pytest.raises(pygear.NO_SERVERS):
+        p.do("reverse", "Jackdaws love my big sphynx of quartz")
+    # the client is returned to the pool on failure
+    assert p.available() == 1
+
+
+def test_gc_traversal(p):
+    lease = p.checkout()
+    assert p in gc.get_referents(lease)
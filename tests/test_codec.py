@@ -0,0 +1,120 @@
+import json
+import pickle
+
+import pytest
+import pygear
+
+
+@pytest.fixture
+def codec():
+    return pygear.ArrayCodec()
+
+
+def test_arraycodec_fallback(codec):
+    assert codec.loads(codec.dumps({'a': [1, 2]})) == {'a': [1, 2]}
+    assert codec.dumps('Some string') == '"Some string"'
+    codec = pygear.ArrayCodec(fallback=pickle)
+    assert codec.loads(codec.dumps(set([1, 2]))) == set([1, 2])
+    with pytest.raises(AttributeError):
+        pygear.ArrayCodec(fallback=object())
+
+
+def test_arraycodec_as_serializer(codec):
+    pygear.Client().set_serializer(codec)
+    pygear.Worker().set_serializer(codec)
+    pygear.Task(None, None).set_serializer(codec)
+
+
+def test_arraycodec_corrupt_header(codec):
+    with pytest.raises(ValueError):
+        codec.loads('PGA\x01\x40\x00\x08\x00')
+    with pytest.raises(ValueError):
+        codec.loads('PGA\x01\x00\x03\xff\xff<f8')
+
+
+def test_arraycodec_arrays(codec):
+    numpy = pytest.importorskip('numpy')
+    for array in (
+        numpy.arange(12, dtype='float32').reshape(3, 4),
+        numpy.arange(12, dtype='>i8').reshape(3, 4)[:, ::2],  # not contiguous
+        numpy.zeros((0, 5), dtype='uint8'),
+        numpy.array(3.5),
+        numpy.array(['ab', 'c']),
+    ):
+        decoded = codec.loads(codec.dumps(array))
+        assert decoded.dtype == array.dtype
+        assert decoded.shape == array.shape
+        assert (decoded == array).all()
+    with pytest.raises(TypeError):
+        codec.dumps(numpy.array([object()]))
+
+
+def test_arraycodec_loads_without_copy(codec):
+    numpy = pytest.importorskip('numpy')
+    data = codec.dumps(numpy.arange(1024, dtype='float64'))
+    decoded = codec.loads(data)
+    assert not decoded.flags.writeable
+    assert not decoded.flags.owndata
+    assert decoded.sum() == sum(range(1024))
+
+
+BIG_WORKLOAD = {'rows': [{'user_id': i, 'name': 'user %d' % i} for i in range(200)]}
+
+
+@pytest.fixture
+def zlib_codec():
+    return pygear.ZlibCodec()
+
+
+def test_zlibcodec_threshold(zlib_codec):
+    assert zlib_codec.dumps({'a': 1}) == '{"a": 1}'
+    compressed = zlib_codec.dumps(BIG_WORKLOAD)
+    assert compressed.startswith('PGZ')
+    assert len(compressed) < len(json.dumps(BIG_WORKLOAD)) / 2
+    assert zlib_codec.loads(compressed) == json.loads(json.dumps(BIG_WORKLOAD))
+    stats = zlib_codec.stats()
+    assert stats['compressed'] == 1
+    assert stats['uncompressed'] == 1
+    assert stats['bytes_in'] == len(json.dumps(BIG_WORKLOAD))
+    assert stats['bytes_out'] == len(compressed)
+
+
+def test_zlibcodec_reads_uncompressed_peers(zlib_codec):
+    assert zlib_codec.loads(json.dumps(BIG_WORKLOAD)) == json.loads(json.dumps(BIG_WORKLOAD))
+
+
+def test_zlibcodec_dictionary(zlib_codec):
+    codec = pygear.ZlibCodec(dictionary='{"rows": [{"user_id": , "name": "user ')
+    compressed = codec.dumps(BIG_WORKLOAD)
+    assert len(compressed) < len(zlib_codec.dumps(BIG_WORKLOAD))
+    assert codec.loads(compressed) == zlib_codec.loads(zlib_codec.dumps(BIG_WORKLOAD))
+    with pytest.raises(ValueError):
+        zlib_codec.loads(compressed)
+    with pytest.raises(ValueError):
+        pygear.ZlibCodec(dictionary='other').loads(compressed)
+
+
+def test_zlibcodec_corrupt_payload(zlib_codec):
+    compressed = zlib_codec.dumps(BIG_WORKLOAD)
+    with pytest.raises(ValueError):
+        zlib_codec.loads(compressed[:-5])
+
+
+def test_zlibcodec_max_size(zlib_codec):
+    # The header claims 4 GiB, nothing that large may be allocated
+    with pytest.raises(ValueError):
+        zlib_codec.loads('PGZ\0\xff\xff\xff\xff' + 'x')
+    codec = pygear.ZlibCodec(max_size=100)
+    with pytest.raises(ValueError):
+        codec.loads(zlib_codec.dumps(BIG_WORKLOAD))
+    with pytest.raises(ValueError):
+        pygear.ZlibCodec(max_size=-1)
+
+
+def test_zlibcodec_wraps_serializer():
+    codec = pygear.ZlibCodec(serializer=pickle, threshold=0, level=1)
+    assert codec.loads(codec.dumps(set(range(100)))) == set(range(100))
+    with pytest.raises(ValueError):
+        pygear.ZlibCodec(level=10)
+    with pytest.raises(AttributeError):
+        pygear.ZlibCodec(serializer=object())
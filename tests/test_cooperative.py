@@ -0,0 +1,41 @@
+import mock
+import pytest
+import pygear
+
+
+@pytest.yield_fixture
+def hook():
+    sentinel = mock.Mock()
+    pygear.set_wait_hook(sentinel)
+    yield sentinel
+    pygear.set_wait_hook(None)
+
+
+def test_wait_hook_default():
+    assert pygear.wait_hook() is None
+
+
+def test_set_wait_hook(hook):
+    assert pygear.wait_hook() is hook
+    pygear.set_wait_hook(None)
+    assert pygear.wait_hook() is None
+
+
+def test_set_wait_hook_invalid():
+    with pytest.raises(TypeError):
+        pygear.set_wait_hook("a string is not callable")
+    assert pygear.wait_hook() is None
+
+
+def test_cooperative_client_do(hook):
+    c = pygear.Client()
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do("reverse", "Jackdaws love my big sphynx of quartz")
+    assert not c.get_options()['non_blocking']
+
+
+def test_cooperative_client_run_tasks(hook):
+    c = pygear.Client()
+    c.add_task("reverse", "Jackdaws love my big sphynx of quartz")
+    with pytest.raises(pygear.NO_SERVERS):
+        c.run_tasks()
@@ -1,14 +1,19 @@
+import json
 import mock
 import multiprocessing
 import pytest
 import pygear
+import pygear_stats
 import sys
+import threading
+import time
 
 from . import TEST_SERVER_HOST
 from . import TEST_SERVER_PORT
 from . import TEST_TIMEOUT_MSEC
 from . import echo_function
 from . import cat_serializer
+from . import noop_serializer
 
 
 class TestError(Exception):
@@ -218,3 +223,683 @@ def test_change_serializer(c):
     c.add_task("test_integration_serializer", "Woof")
     c.run_tasks()
     worker_thread.join()
+
+
+@pytest.fixture
+def ac():
+    client = pygear.AsyncClient()
+    client.add_server(TEST_SERVER_HOST, TEST_SERVER_PORT)
+    client.set_timeout(TEST_TIMEOUT_MSEC)
+    return client
+
+
+def test_asyncclient_do_many(ac):
+    worker_thread = multiprocessing.Process(target=thread_worker_echo)
+    worker_thread.start()
+    workloads = ["Test string %d!" % i for i in range(10)]
+    futures = ac.do_many("test_integration_echo", workloads)
+    assert [f.result() for f in futures] == workloads
+    assert ac.pending() == 0
+    worker_thread.join()
+
+
+def test_asyncclient_do_background(ac):
+    future = ac.do_background("test_integration_echo", "Test string!")
+    assert type(future.result()) is str
+
+
+def test_asyncclient_exception(ac):
+    worker_thread = multiprocessing.Process(target=thread_worker_except)
+    worker_thread.start()
+    future = ac.do("test_integration_except", "Some string")
+    with pytest.raises(pygear.WORK_EXCEPTION):
+        future.result()
+    worker_thread.join()
+
+
+def test_cooperative_client_do(c):
+    hook = mock.Mock()
+    worker_thread = multiprocessing.Process(target=thread_worker_echo)
+    worker_thread.start()
+    pygear.set_wait_hook(hook)
+    try:
+        assert c.do("test_integration_echo", "Test string!") == "Test string!"
+    finally:
+        pygear.set_wait_hook(None)
+    worker_thread.join()
+    for call in hook.call_args_list:
+        fd, for_write, timeout = call[0]
+        assert fd == -1
+        assert timeout > 0
+
+
+def test_multiplexedclient_do():
+    client = pygear.MultiplexedClient()
+    client.add_server(TEST_SERVER_HOST, TEST_SERVER_PORT)
+    client.set_timeout(TEST_TIMEOUT_MSEC)
+    worker_thread = multiprocessing.Process(target=thread_worker_echo)
+    worker_thread.start()
+    results = {}
+
+    def call(i):
+        results[i] = client.do("test_integration_echo", "Test string %d!" % i)
+
+    threads = [threading.Thread(target=call, args=(i,)) for i in range(20)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    worker_thread.join()
+    assert results == dict((i, "Test string %d!" % i) for i in range(20))
+
+
+def test_multiplexedclient_coalescing():
+    client = pygear.MultiplexedClient()
+    client.add_server(TEST_SERVER_HOST, TEST_SERVER_PORT)
+    client.set_timeout(TEST_TIMEOUT_MSEC)
+    client.set_coalescing('content')
+    worker_thread = multiprocessing.Process(target=thread_worker_slow_primary)
+    worker_thread.start()
+    results = []
+
+    def call():
+        results.append(client.do("test_integration_slow_primary", "Test string!"))
+
+    threads = [threading.Thread(target=call) for _ in range(8)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    worker_thread.join()
+    assert results == ["Test string!"] * 8
+    assert client.coalesced() > 0
+
+
+def test_client_submit_background_async(c):
+    failures = []
+    c.set_async_fail_fn(lambda *args: failures.append(args))
+    for i in range(100):
+        c.submit_background_async("test_integration_echo", "Test string %d!" % i)
+    c.flush()
+    assert not failures
+    assert c.async_stats() == {'queued': 0, 'delivered': 100, 'failed': 0}
+
+
+def test_client_max_in_flight(c):
+    completed = []
+    c.set_complete_fn(lambda task: completed.append(task.result()))
+    c.set_max_in_flight(5)
+    worker_thread = multiprocessing.Process(target=thread_worker_echo)
+    worker_thread.start()
+    for i in range(50):
+        c.add_task("test_integration_echo", "Test string %d!" % i)
+    c.run_tasks()
+    worker_thread.join()
+    assert sorted(completed) == sorted("Test string %d!" % i for i in range(50))
+
+
+def test_client_max_in_flight_releases_workloads(c):
+    c.set_max_in_flight(4)
+    worker_thread = multiprocessing.Process(target=thread_worker_echo)
+    worker_thread.start()
+    # Unserialized workloads are not copied, the tasks reference the string
+    workload = '"Test string!"'
+    references = sys.getrefcount(workload)
+    for i in range(500):
+        c.add_task("test_integration_echo", workload, serialize=False)
+        assert sys.getrefcount(workload) - references <= 4
+    c.run_tasks()
+    worker_thread.join()
+    assert sys.getrefcount(workload) == references
+
+
+def test_client_max_in_flight_without_free_tasks(c):
+    completed = []
+    c.set_complete_fn(lambda task: completed.append(task.result()))
+    c.set_max_in_flight(2)
+    # Finished tasks still leave the window when they are not freed
+    options = c.get_options()
+    options['free_tasks'] = False
+    c.set_options(**options)
+    worker_thread = multiprocessing.Process(target=thread_worker_echo)
+    worker_thread.start()
+    for i in range(20):
+        c.add_task("test_integration_echo", "Test string %d!" % i)
+    c.add_task_status("H:localhost:1")
+    c.run_tasks()
+    worker_thread.join()
+    assert sorted(completed) == sorted("Test string %d!" % i for i in range(20))
+
+
+def test_client_hash_routing(c):
+    c.set_routing('hash')
+    worker_thread = multiprocessing.Process(target=thread_worker_echo)
+    worker_thread.start()
+    assert c.do("test_integration_echo", "Test string!", routing_key="key") == "Test string!"
+    assert c.do_background("test_integration_echo", "Test string!", unique="key")
+    worker_thread.join()
+
+
+def test_client_least_loaded_routing(c):
+    c.set_routing('least_loaded', 50)
+    worker_thread = multiprocessing.Process(target=thread_worker_echo)
+    worker_thread.start()
+    assert c.do("test_integration_echo", "Test string!") == "Test string!"
+    stats = c.routing_stats()['%s:%d' % (TEST_SERVER_HOST, TEST_SERVER_PORT)]
+    assert stats['latency'] > 0
+    worker_thread.join()
+
+
+def thread_worker_slow_primary():
+    worker = w()
+
+    def slow_primary(job):
+        # hedged copies get a '~h' suffix on their unique
+        if not (job.unique() or '').endswith('~h'):
+            time.sleep(0.5)
+        return job.workload()
+
+    worker.add_function("test_integration_slow_primary", 0, slow_primary)
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+def test_client_do_hedged(c):
+    worker_threads = [multiprocessing.Process(target=thread_worker_slow_primary) for _ in range(2)]
+    for worker_thread in worker_threads:
+        worker_thread.start()
+    result = c.do("test_integration_slow_primary", "Test string!", unique="slow", hedge_after_ms=100)
+    assert result == "Test string!"
+    assert c.hedge_stats() == {'requests': 1, 'hedged': 1, 'won': 1}
+    assert c.latency_stats()['count'] == 1
+    for worker_thread in worker_threads:
+        worker_thread.join()
+
+
+def thread_worker_unique():
+    worker = w()
+    worker.add_function("test_integration_unique", 0, lambda job: job.unique())
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+def test_client_unique_strategy(c):
+    worker_thread = multiprocessing.Process(target=thread_worker_unique)
+    worker_thread.start()
+    c.set_unique_strategy('content')
+    first = c.do("test_integration_unique", "Test string!")
+    assert len(first) == 32
+    assert c.do("test_integration_unique", "Test string!") == first
+    assert c.do("test_integration_unique", "Other string!") != first
+    c.set_unique_strategy('random')
+    assert c.do("test_integration_unique", "Test string!") != first
+    assert c.do("test_integration_unique", "Test string!", unique="explicit") == "explicit"
+    worker_thread.join()
+
+
+def thread_worker_clock():
+    worker = w()
+    worker.add_function("test_integration_clock", 0, lambda job: repr(time.time()))
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+def test_client_result_cache(c):
+    worker_thread = multiprocessing.Process(target=thread_worker_clock)
+    worker_thread.start()
+    c.enable_result_cache("test_integration_clock", ttl_ms=200)
+    first = c.do("test_integration_clock", "now")
+    assert c.do("test_integration_clock", "now") == first
+    assert c.do("test_integration_clock", "later") != first
+    time.sleep(0.3)
+    assert c.do("test_integration_clock", "now") != first
+    stats = c.result_cache_stats()["test_integration_clock"]
+    assert (stats['hits'], stats['misses']) == (1, 3)
+    worker_thread.join()
+
+
+def test_client_result_cache_envelope_toggled(c):
+    worker_thread = multiprocessing.Process(target=thread_worker_clock)
+    worker_thread.start()
+    c.enable_result_cache("test_integration_clock", ttl_ms=10000)
+    c.set_envelope(True)
+    first = c.do("test_integration_clock", "now")
+    # Cached without the reply envelope, so bare calls decode the same result
+    c.set_envelope(False)
+    assert c.do("test_integration_clock", "now") == first
+    assert c.do("test_integration_clock", "now", raw=True).tobytes() == json.dumps(first)
+    c.set_envelope(True)
+    assert c.do("test_integration_clock", "now") == first
+    assert c.result_cache_stats()["test_integration_clock"]['hits'] == 3
+    worker_thread.join()
+
+
+def thread_worker_memoized(worker):
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+def test_worker_shared_result_cache(c):
+    calls = multiprocessing.Value('i', 0)
+
+    def count_calls(job):
+        with calls.get_lock():
+            calls.value += 1
+        return job.workload()
+
+    worker = w()
+    worker.add_function("test_integration_memoized", 0, count_calls)
+    worker.enable_result_cache("test_integration_memoized", ttl_ms=10000, shared=True)
+    # Forked siblings share the cache of the worker they were forked from
+    worker_threads = [multiprocessing.Process(target=thread_worker_memoized, args=(worker,)) for _ in range(2)]
+    for worker_thread in worker_threads:
+        worker_thread.start()
+    for _ in range(4):
+        assert c.do("test_integration_memoized", "Test string!") == "Test string!"
+    assert calls.value == 1
+    assert worker.result_cache_stats()["test_integration_memoized"]['hits'] == 3
+    for worker_thread in worker_threads:
+        worker_thread.join()
+
+
+def test_worker_result_cache_keyed_on_codec(c):
+    calls = multiprocessing.Value('i', 0)
+
+    def count_calls(job):
+        with calls.get_lock():
+            calls.value += 1
+        return job.workload()
+
+    worker = w()
+    worker.add_function("test_integration_memoized", 0, count_calls)
+    worker.enable_result_cache("test_integration_memoized", ttl_ms=10000, shared=True)
+    worker_thread = multiprocessing.Process(target=thread_worker_memoized, args=(worker,))
+    worker_thread.start()
+    c.set_envelope(True)
+    # The same bytes, decoded as json and as a raw string
+    assert c.do("test_integration_memoized", "x") == "x"
+    assert c.do("test_integration_memoized", '"x"', serialize=False) == '"x"'
+    assert c.do("test_integration_memoized", "x") == "x"
+    assert calls.value == 2
+    worker_thread.join()
+
+
+def thread_worker_reserialized(worker):
+    worker.work()
+    worker.set_serializer(json)
+    thread_worker_memoized(worker)
+
+
+def test_worker_set_serializer_empties_result_cache(c):
+    calls = multiprocessing.Value('i', 0)
+
+    def count_calls(job):
+        with calls.get_lock():
+            calls.value += 1
+        return job.workload()
+
+    worker = w()
+    worker.add_function("test_integration_memoized", 0, count_calls)
+    worker.enable_result_cache("test_integration_memoized", ttl_ms=10000)
+    worker_thread = multiprocessing.Process(target=thread_worker_reserialized, args=(worker,))
+    worker_thread.start()
+    assert c.do("test_integration_memoized", "Test string!") == "Test string!"
+    assert c.do("test_integration_memoized", "Test string!") == "Test string!"
+    assert calls.value == 2
+    worker_thread.join()
+
+
+def thread_worker_stream():
+    worker = w()
+
+    def stream_lines(job):
+        for i in range(int(job.workload())):
+            yield 'line %d\n' % i
+
+    worker.add_function("test_integration_stream", 0, stream_lines)
+    worker.add_function("test_integration_echo", 0, echo_function)
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+def test_client_do_stream(c):
+    worker_thread = multiprocessing.Process(target=thread_worker_stream)
+    worker_thread.start()
+    # Small chunks are coalesced into packets by the worker
+    chunks = list(c.do_stream("test_integration_stream", "10000"))
+    assert 1 < len(chunks) < 10000
+    assert ''.join(chunks) == ''.join('line %d\n' % i for i in range(10000))
+    # A handler that returns is streamed as a single chunk
+    assert list(c.do_stream("test_integration_echo", "Test string!")) == ['"Test string!"']
+    worker_thread.join()
+
+
+def test_client_do_raw(c):
+    worker_thread = multiprocessing.Process(target=thread_worker_echo)
+    worker_thread.start()
+    result = c.do("test_integration_echo", "Test string!", raw=True)
+    assert type(result) is pygear.View
+    assert result.tobytes() == '"Test string!"'
+    assert memoryview(result).tobytes() == '"Test string!"'
+    worker_thread.join()
+
+
+def test_task_result_view(c):
+    views = []
+
+    def on_complete(task):
+        view = task.result_view()
+        assert view.tobytes() == '"Some string"'
+        views.append(view)
+
+    c.set_complete_fn(on_complete)
+    c.add_task("test_integration_echo", "Some string")
+    worker_thread = multiprocessing.Process(target=thread_worker_echo)
+    worker_thread.start()
+    c.run_tasks()
+    worker_thread.join()
+    # The view does not outlive the callback
+    assert not views[0].valid()
+    with pytest.raises(ValueError):
+        views[0].tobytes()
+
+
+def test_task_result_memoryview_outlives_callback(c):
+    memoryviews = []
+
+    def on_complete(task):
+        memoryviews.append(memoryview(task.result_view()))
+
+    c.set_complete_fn(on_complete)
+    c.add_task("test_integration_echo", "Some string")
+    worker_thread = multiprocessing.Process(target=thread_worker_echo)
+    worker_thread.start()
+    c.run_tasks()
+    worker_thread.join()
+    # The view copied the result when the memoryview was taken
+    assert memoryviews[0].tobytes() == '"Some string"'
+
+
+def thread_worker_unserialized():
+    worker = w()
+
+    def gathered(job):
+        job.send_data(['"Test', bytearray(' '), memoryview('string!"')], serialize=False)
+        return job.workload()
+
+    worker.add_function("test_integration_gathered", 0, gathered)
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+def test_client_unserialized_workloads(c):
+    worker_thread = multiprocessing.Process(target=thread_worker_unserialized)
+    worker_thread.start()
+    # Data sent by the worker as a list arrives as one chunk
+    chunks = list(c.do_stream("test_integration_gathered", "Some string"))
+    assert chunks == ['"Test string!"', '"Some string"']
+    # The worker deserializes the joined buffers as one workload
+    assert c.do("test_integration_gathered", ['"Another', bytearray(' string"')], serialize=False) == "Another string"
+    assert c.do("test_integration_gathered", bytearray('"Raw"'), serialize=False) == "Raw"
+    worker_thread.join()
+
+
+def thread_worker_arrays():
+    worker = w()
+    worker.set_serializer(pygear.ArrayCodec())
+    worker.add_function("test_integration_column_sums", 0, lambda job: job.workload().sum(axis=0))
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+def test_arraycodec_round_trip(c):
+    numpy = pytest.importorskip('numpy')
+    c.set_serializer(pygear.ArrayCodec())
+    worker_thread = multiprocessing.Process(target=thread_worker_arrays)
+    worker_thread.start()
+    features = numpy.arange(64 * 16, dtype='float32').reshape(64, 16)
+    assert (c.do("test_integration_column_sums", features) == features.sum(axis=0)).all()
+    worker_thread.join()
+
+
+def test_arraycodec_loads_result_view(c):
+    numpy = pytest.importorskip('numpy')
+    codec = pygear.ArrayCodec()
+    c.set_serializer(codec)
+    arrays = []
+    views = []
+
+    def on_complete(task):
+        view = task.result_view()
+        arrays.append(codec.loads(view))
+        views.append(view)
+
+    c.set_complete_fn(on_complete)
+    features = numpy.arange(64 * 16, dtype='float32').reshape(64, 16)
+    c.add_task("test_integration_column_sums", features)
+    worker_thread = multiprocessing.Process(target=thread_worker_arrays)
+    worker_thread.start()
+    c.run_tasks()
+    worker_thread.join()
+    # The view copied the result for the array, which outlives the task
+    assert views[0].valid()
+    assert (arrays[0] == features.sum(axis=0)).all()
+
+
+def thread_worker_compressed():
+    worker = w()
+    worker.set_serializer(pygear.ZlibCodec())
+    worker.add_function("test_integration_compressed", 0, lambda job: [job.field('name')] * 100)
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+def test_zlibcodec_round_trip(c):
+    c.set_serializer(pygear.ZlibCodec())
+    worker_thread = multiprocessing.Process(target=thread_worker_compressed)
+    worker_thread.start()
+    assert c.do("test_integration_compressed", {'name': 'x' * 2000}) == ['x' * 2000] * 100
+    # An uncompressed client is understood, and small results stay readable
+    c.set_serializer(json)
+    assert c.do("test_integration_compressed", {'name': 'y'}) == ['y'] * 100
+    worker_thread.join()
+
+
+def thread_worker_enveloped():
+    import cPickle
+    worker = w()
+    # Replies are pickled whatever the client used; the envelope says so
+    worker.set_serializer(cPickle)
+    worker.add_function("test_integration_enveloped", 0, lambda job: job.envelope())
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+def test_client_envelope(c):
+    worker_thread = multiprocessing.Process(target=thread_worker_enveloped)
+    worker_thread.start()
+    assert c.do("test_integration_enveloped", None) is None
+    c.set_envelope(True, deadline_ms=TEST_TIMEOUT_MSEC)
+    before = time.time()
+    envelope = c.do("test_integration_enveloped", None)
+    assert envelope['version'] == 1
+    assert envelope['codec'] == 1
+    assert before <= envelope['sent'] < envelope['deadline']
+    assert len(envelope['trace_id']) == 32
+    task = c.add_task("test_integration_enveloped", None)
+    c.run_tasks()
+    assert task.result()['trace_id'] != envelope['trace_id']
+    assert task.envelope()['codec'] == 2
+    worker_thread.join()
+
+
+def thread_worker_late():
+    worker = w()
+    worker.add_function("test_integration_late", 0, echo_function)
+    time.sleep(0.5)
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+PGE_LOOKALIKE = 'PGE\x01\x28\x00' + 'x' * 40
+
+
+def thread_worker_pge_lookalike():
+    worker = w()
+    worker.set_serializer(noop_serializer())
+    worker.add_function("test_integration_pge_lookalike", 0, lambda job: PGE_LOOKALIKE)
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+def test_client_bare_reply_not_stripped(c):
+    worker_thread = multiprocessing.Process(target=thread_worker_pge_lookalike)
+    worker_thread.start()
+    # Without set_envelope a reply is never taken for an envelope
+    assert c.do("test_integration_pge_lookalike", "x", raw=True).tobytes() == PGE_LOOKALIKE
+    completed = []
+    c.set_complete_fn(lambda task: completed.append((task.result_view().tobytes(), task.envelope())))
+    c.add_task("test_integration_pge_lookalike", "x")
+    c.run_tasks()
+    assert completed == [(PGE_LOOKALIKE, None)]
+    worker_thread.join()
+
+
+def test_client_envelope_deadline(c):
+    c.set_envelope(True, deadline_ms=100)
+    worker_thread = multiprocessing.Process(target=thread_worker_late)
+    worker_thread.start()
+    # The job is expired by the time the worker grabs it, so it fails unrun
+    with pytest.raises(pygear.WORK_FAIL):
+        c.do("test_integration_late", "too late")
+    worker_thread.join()
+
+
+def thread_worker_queue_delay():
+    worker = w()
+    worker.add_function("test_integration_queue_delay", 0,
+        lambda job: [job.queued_seconds(), worker.stats()])
+    time.sleep(0.3)
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+def test_worker_queue_delay(c):
+    worker_thread = multiprocessing.Process(target=thread_worker_queue_delay)
+    worker_thread.start()
+    assert c.do("test_integration_queue_delay", None)[0] is None
+    c.set_envelope(True)
+    queued, stats = c.do("test_integration_queue_delay", None)
+    assert 0 <= queued < 1
+    delays = stats["test_integration_queue_delay"]
+    # The bare job had no send time, so only the enveloped one was queued
+    assert delays["queue_delay"]["count"] == 1
+    assert delays["start_delay"]["count"] == 2
+    worker_thread.join()
+
+
+def test_client_do_timings(c):
+    worker_thread = multiprocessing.Process(target=thread_worker_echo)
+    worker_thread.start()
+    result, timings = c.do("test_integration_echo", "hello", timings=True)
+    assert result == "hello"
+    assert timings["start"] <= timings["serialized"] <= timings["submitted"] <= timings["received"]
+    assert timings["received"] <= timings["deserialized"]
+    assert timings["worker_grabbed"] is None
+    # Worker times come back in the reply envelope
+    c.set_envelope(True)
+    result, timings = c.do("test_integration_echo", "hello", timings=True)
+    assert result == "hello"
+    assert timings["worker_grabbed"] <= timings["worker_started"] <= timings["worker_finished"]
+    assert timings["worker_finished"] - timings["submitted"] < TEST_TIMEOUT_MSEC / 1000.0
+    view, timings = c.do("test_integration_echo", "hello", raw=True, timings=True)
+    assert view.tobytes() == '"hello"'
+    worker_thread.join()
+
+
+def thread_worker_traced(path):
+    worker = w()
+    worker.set_trace(True)
+    worker.add_function("test_integration_traced", 0, lambda job: job.workload())
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+    pygear.dump_trace(path)
+
+
+def test_trace_timeline(c, tmpdir):
+    pygear.clear_trace()
+    worker_trace = str(tmpdir.join('worker.json'))
+    client_trace = str(tmpdir.join('client.json'))
+    worker_thread = multiprocessing.Process(target=thread_worker_traced, args=(worker_trace,))
+    worker_thread.start()
+    c.set_trace(True)
+    assert c.do("test_integration_traced", "traced") == "traced"
+    pygear.dump_trace(client_trace)
+    worker_thread.join()
+    client_events = json.load(open(client_trace))['traceEvents']
+    assert [e['name'] for e in client_events] == ['encode', 'encode', 'submit', 'submit', 'decode', 'decode',
+        'complete']
+    worker_names = set(e['name'] for e in json.load(open(worker_trace))['traceEvents'])
+    assert worker_names == set(['grab', 'gil', 'handler', 'decode', 'encode', 'send'])
+
+
+def thread_worker_published(directory):
+    worker = w()
+    path = worker.publish_stats("test_integration", directory)
+
+    def published(job):
+        return pygear_stats.read(path)["series"]["test_integration_published.start_delay"]["histogram"]["count"]
+    worker.add_function("test_integration_published", 0, published)
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+def test_worker_publish_stats(c, tmpdir):
+    worker_thread = multiprocessing.Process(target=thread_worker_published, args=(str(tmpdir),))
+    worker_thread.start()
+    # The start delay is recorded before the callback runs
+    assert c.do("test_integration_published", None) == 1
+    assert c.do("test_integration_published", None) == 2
+    worker_thread.join()
@@ -1,4 +1,5 @@
 import gc
+import json
 import multiprocessing
 
 import mock
@@ -41,6 +42,11 @@ def job_test_function(job):
     assert job.unique() == TEST_UNIQUE
     assert job.workload() == TEST_WORKLOAD
     assert job.workload_size() == len(TEST_WORKLOAD)
+    view = job.workload_view()
+    assert view is job.workload_view()
+    assert len(view) == job.workload_size()
+    assert view.tobytes() == json.dumps(TEST_WORKLOAD)
+    assert str(buffer(view)) == view.tobytes()
 
 
 def thread_worker():
@@ -61,6 +67,68 @@ def test_job_methods(c):
     worker_thread.join()
 
 
+TEST_FIELDS_FUNCTION_NAME = 'test_job_fields'
+TEST_FIELDS_WORKLOAD = {
+    'user': {'id': 42, 'name': u'J\xf6rg'},
+    'items': [{'sku': 'a-1'}, {'sku': 'b-2'}],
+    'pad': ['x' * 100] * 100,
+}
+
+
+def job_fields_function(job):
+    assert job.field('user.id') == 42
+    assert job.field(('user', 'name')) == u'J\xf6rg'
+    assert job.field(('items', 1, 'sku')) == 'b-2'
+    assert job.field('missing', None) is None
+    with pytest.raises(KeyError):
+        job.field('user.email')
+    with pytest.raises(KeyError):
+        job.field(('items', 2))
+    with pytest.raises(TypeError):
+        job.field(('user', 0))
+    # Decoded once, then looked up in the decoded workload
+    workload = job.workload()
+    assert workload is job.workload()
+    assert job.field(('items', 0, 'sku')) == 'a-1'
+    with pytest.raises(KeyError):
+        job.field(('items', 2))
+
+
+def thread_worker_fields():
+    worker = w()
+    worker.add_function(TEST_FIELDS_FUNCTION_NAME, 0, job_fields_function)
+    try:
+        while True:
+            worker.work()
+    except pygear.TIMEOUT:
+        pass
+
+
+def test_job_field(c):
+    c.add_task(TEST_FIELDS_FUNCTION_NAME, TEST_FIELDS_WORKLOAD)
+    worker_thread = multiprocessing.Process(target=thread_worker_fields)
+    worker_thread.start()
+    c.run_tasks()
+    worker_thread.join()
+
+
+def test_job_field_without_job():
+    with pytest.raises(pygear.ERROR):
+        pygear.Job().field('user.id')
+    with pytest.raises(TypeError):
+        pygear.Job().field(42)
+
+
+def test_job_envelope_without_job():
+    assert pygear.Job().envelope() is None
+    assert pygear.Job().queued_seconds() is None
+
+
+def test_job_workload_view_without_job():
+    with pytest.raises(pygear.ERROR):
+        pygear.Job().workload_view()
+
+
 def test_gc_traversal():
     j = pygear.Job()
     sentinel = mock.Mock()
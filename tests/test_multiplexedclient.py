@@ -0,0 +1,97 @@
+import gc
+import threading
+
+import mock
+import pytest
+import pygear
+
+from . import noop_serializer
+
+
+@pytest.fixture
+def c():
+    client = pygear.MultiplexedClient()
+    client.set_timeout(2000)
+    return client
+
+
+def test_multiplexedclient_add_server(c):
+    c.add_server('localhost', 4730)  # valid
+    with pytest.raises(pygear.GETADDRINFO):  # invalid
+        c.add_server("invalidhosturi", -1)
+
+
+def test_multiplexedclient_add_servers(c):
+    c.add_servers(['localhost:4730', 'srv1-devc', '192.168.0.1', '192.168.0.2:1234'])  # valid
+    with pytest.raises(pygear.GETADDRINFO):  # invalid
+        c.add_servers(["invalidhosturi"])
+
+
+def test_multiplexedclient_do(c):
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do("reverse", "Jackdaws love my big sphynx of quartz")
+    assert c.pending() == 0
+    # see test_integration.py for valid cases
+
+
+def test_multiplexedclient_do_background(c):
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do_background("reverse", "Jackdaws love my big sphynx of quartz")
+
+
+def test_multiplexedclient_add_server_after_start(c):
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do("reverse", "Jackdaws love my big sphynx of quartz")
+    with pytest.raises(pygear.ERROR):
+        c.add_server('localhost', 4730)
+
+
+def test_multiplexedclient_many_threads(c):
+    errors = []
+
+    def call():
+        try:
+            c.do("reverse", "Jackdaws love my big sphynx of quartz")
+        except pygear.NO_SERVERS as e:
+            errors.append(e)
+
+    threads = [threading.Thread(target=call) for _ in range(16)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join(5)
+    assert len(errors) == 16
+    assert c.pending() == 0
+
+
+def test_multiplexedclient_set_coalescing(c):
+    assert c.coalescing() == 'off'
+    c.set_coalescing('content')
+    assert c.coalescing() == 'content'
+    c.set_coalescing('unique')
+    assert c.coalescing() == 'unique'
+    with pytest.raises(ValueError):
+        c.set_coalescing('everything')
+    with pytest.raises(pygear.NO_SERVERS):
+        c.do("reverse", "Jackdaws love my big sphynx of quartz", unique="quartz")
+    assert c.coalesced() == 0
+    assert c.pending() == 0
+
+
+def test_multiplexedclient_set_serializer(c):
+    c.set_serializer(noop_serializer())  # valid
+    with pytest.raises(AttributeError):  # invalid
+        c.set_serializer("a string doesn't implement loads.")
+
+
+def test_multiplexedclient_set_and_get_timeout():
+    c = pygear.MultiplexedClient()
+    assert c.timeout() == -1
+    c.set_timeout(30)
+    assert c.timeout() == 30
+
+
+def test_gc_traversal(c):
+    sentinel = mock.Mock()
+    c.set_serializer(sentinel)
+    assert sentinel in gc.get_referents(c)
@@ -0,0 +1,143 @@
+import gc
+import os
+
+import mock
+import pytest
+import pygear
+import pygear_stats
+
+
+@pytest.fixture
+def directory(tmpdir):
+    return str(tmpdir)
+
+
+def test_client_publish_stats(directory):
+    c = pygear.Client()
+    path = c.publish_stats('svc', directory=directory)
+    assert os.path.dirname(path) == directory
+    stats = pygear_stats.read(path)
+    assert stats['pid'] == os.getpid()
+    assert stats['kind'] == 'client'
+    assert stats['name'] == 'svc'
+    assert sorted(stats['series']) == ['hedges_sent', 'hedges_won', 'latency', 'retries']
+    assert stats['series']['retries'] == {'type': 'counter', 'value': 0}
+    latency = stats['series']['latency']
+    assert latency['type'] == 'histogram'
+    assert pygear_stats.summary(latency['histogram']) == c.latency_stats()
+
+
+def test_publish_stats_once(directory):
+    c = pygear.Client()
+    c.publish_stats('svc', directory)
+    with pytest.raises(pygear.ERROR):
+        c.publish_stats('svc', directory)
+
+
+def test_publish_stats_bad_directory():
+    with pytest.raises(OSError):
+        pygear.Client().publish_stats('svc', '/nonexistent')
+
+
+def test_publish_stats_removed_on_collect(directory):
+    c = pygear.Client()
+    path = c.publish_stats('svc', directory)
+    assert os.path.exists(path)
+    del c
+    gc.collect()
+    assert not os.path.exists(path)
+
+
+def test_worker_publish_stats(directory):
+    w = pygear.Worker()
+    stats = pygear_stats.read(w.publish_stats('svc', directory))
+    assert stats['kind'] == 'worker'
+    assert stats['series'] == {}
+
+
+def test_clientpool_publish_stats(directory):
+    p = pygear.ClientPool(2, checkout_timeout=0)
+    path = p.publish_stats('svc', directory)
+    series = pygear_stats.read(path)['series']
+    assert series['size']['value'] == 2
+    assert series['available']['value'] == 2
+    # The pooled clients publish into the same file
+    assert series['latency']['type'] == 'histogram'
+    with p.checkout():
+        with p.checkout():
+            with pytest.raises(pygear.TIMEOUT):
+                p.checkout()
+            series = pygear_stats.read(path)['series']
+            assert series['available']['value'] == 0
+    series = pygear_stats.read(path)['series']
+    assert series['available']['value'] == 2
+    assert series['checkouts']['value'] == 2
+    assert series['timeouts']['value'] == 1
+
+
+def test_read_not_stats(directory):
+    path = os.path.join(directory, 'pygear-1-0.stats')
+    with open(path, 'wb') as f:
+        f.write(b'\0' * 4096)
+    with pytest.raises(pygear_stats.StatsError):
+        pygear_stats.read(path)
+
+
+def test_scan(directory):
+    clients = [pygear.Client() for _ in range(2)]
+    paths = [c.publish_stats('svc', directory) for c in clients]
+    assert sorted(s['path'] for s in pygear_stats.scan(directory)) == sorted(paths)
+    with mock.patch('pygear_stats._alive', return_value=False):
+        assert pygear_stats.scan(directory) == []
+        assert all(os.path.exists(path) for path in paths)
+        assert pygear_stats.scan(directory, remove_stale=True) == []
+    assert not any(os.path.exists(path) for path in paths)
+
+
+def test_aggregate(directory):
+    clients = [pygear.Client() for _ in range(2)]
+    for c in clients:
+        c.publish_stats('svc', directory)
+    w = pygear.Worker()
+    w.publish_stats('svc', directory)
+    totals = pygear_stats.aggregate(pygear_stats.scan(directory))
+    assert sorted(totals) == ['client', 'worker']
+    svc = totals['client']['svc']
+    assert svc['publishers'] == 2
+    assert svc['series']['retries'] == 0
+    assert svc['series']['latency']['count'] == 0
+
+
+def test_percentile_matches_histogram():
+    # 1..100 ms, as _pygear_histogram_record counts them
+    buckets = [0] * 496
+    for ms in range(1, 101):
+        micros = ms * 1000
+        octave = len(bin(micros)) - 3
+        index = (octave - 2) * 8 + ((micros >> (octave - 3)) & 7)
+        buckets[index] += 1
+    histogram = {'buckets': buckets, 'count': 100, 'sum': 5.05, 'max': 0.1}
+    assert pygear_stats.percentile(histogram, 50) == 0.053248
+    assert pygear_stats.percentile(histogram, 90) == 0.090112
+    assert pygear_stats.percentile(histogram, 99) == 0.1
+
+
+def test_publish_stats_after_fork(directory):
+    c = pygear.Client()
+    w = pygear.Worker()
+    p = pygear.ClientPool(1)
+    parent_paths = [obj.publish_stats('svc', directory) for obj in (c, w, p)]
+    pid = os.fork()
+    if pid == 0:
+        status = 1
+        try:
+            # The inherited files belong to the parent
+            paths = [obj.publish_stats('svc', directory) for obj in (c, w, p)]
+            if all(pygear_stats.read(path)['pid'] == os.getpid() for path in paths):
+                status = 0
+        finally:
+            os._exit(status)
+    _, status = os.waitpid(pid, 0)
+    assert status == 0
+    assert all(os.path.exists(path) for path in parent_paths)
+    assert all(pygear_stats.read(path)['pid'] == os.getpid() for path in parent_paths)
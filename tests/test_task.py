@@ -48,6 +48,11 @@ def test_task_result(t):
     assert t.result() is None
 
 
+def test_task_result_view(t):
+    with pytest.raises(pygear.ERROR):
+        t.result_view()
+
+
 def test_task_returncode(t):
     assert pygear.describe_returncode(t.returncode()) == 'INVALID_ARGUMENT'
 
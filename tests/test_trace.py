@@ -0,0 +1,61 @@
+import json
+import threading
+
+import pytest
+import pygear
+
+
+@pytest.fixture
+def trace_file(tmpdir):
+    pygear.clear_trace()
+    return str(tmpdir.join('trace.json'))
+
+
+def test_dump_trace_empty(trace_file):
+    assert pygear.dump_trace(trace_file) == 0
+    assert json.load(open(trace_file))['traceEvents'] == []
+
+
+def test_dump_trace_bad_path():
+    with pytest.raises(IOError):
+        pygear.dump_trace('/nonexistent/trace.json')
+
+
+def traced_worker():
+    w = pygear.Worker()
+    w.add_server('localhost', 1)
+    w.add_function('traced', 0, lambda job: None)
+    w.set_timeout(10)
+    w.set_trace(True)
+    return w
+
+
+def test_worker_trace_grab(trace_file):
+    assert pygear.Worker().trace() is False
+    assert traced_worker().trace() is True
+
+    def work():
+        with pytest.raises(Exception):
+            traced_worker().work()
+    # Each thread writes to its own ring
+    threads = [threading.Thread(target=work) for _ in range(2)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert pygear.dump_trace(trace_file) == 4
+    events = json.load(open(trace_file))['traceEvents']
+    assert sorted((e['tid'], e['ph']) for e in events) == sorted(
+        (tid, ph) for tid in set(e['tid'] for e in events) for ph in 'BE')
+    assert set(e['name'] for e in events) == set(['grab'])
+    pygear.clear_trace()
+    assert pygear.dump_trace(trace_file) == 0
+
+
+def test_client_trace():
+    c = pygear.Client()
+    assert c.trace() is False
+    c.set_trace(True)
+    assert c.trace() is True
+    assert c.clone().trace() is True
+    # see test_integration.py for traced jobs
@@ -137,6 +137,28 @@ def test_worker_unregister_all(w):
     assert not w.function_exists("test_method")
 
 
+def test_worker_result_cache(w):
+    assert w.result_cache_stats() == {}
+    w.enable_result_cache('echo_function', ttl_ms=1000)
+    w.enable_result_cache('reverse', ttl_ms=1000, max_bytes=65536, shared=True, max_result_bytes=1024)
+    empty = {'hits': 0, 'misses': 0, 'evictions': 0, 'entries': 0, 'bytes': 0}
+    assert w.result_cache_stats() == {'echo_function': empty, 'reverse': empty}
+    w.disable_result_cache('echo_function')
+    assert w.result_cache_stats() == {'reverse': empty}
+    w.disable_result_cache()
+    assert w.result_cache_stats() == {}
+    with pytest.raises(ValueError):
+        w.enable_result_cache('reverse', ttl_ms=0)
+    with pytest.raises(ValueError):
+        w.enable_result_cache('reverse', ttl_ms=1000, max_bytes=1024, shared=True, max_result_bytes=1024)
+    # see test_integration.py for memoized jobs
+
+
+def test_worker_stats(w):
+    assert w.stats() == {}
+    # see test_integration.py for timed jobs
+
+
 def test_worker_misc(w):
     w.id()
     w.error()
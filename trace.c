@@ -0,0 +1,193 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "trace.h"
+
+static pthread_mutex_t g_pygear_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pygear_trace_ring* g_pygear_trace_rings = NULL;     /* guarded by the lock */
+static int g_pygear_trace_threads = 0;
+static pthread_once_t g_pygear_trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_pygear_trace_key;                    /* marks the ring exited */
+static __thread pygear_trace_ring* t_pygear_trace_ring = NULL;
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+static void _pygear_trace_thread_exit(void* ring) {
+    pthread_mutex_lock(&g_pygear_trace_lock);
+    ((pygear_trace_ring*) ring)->exited = true;
+    pthread_mutex_unlock(&g_pygear_trace_lock);
+}
+
+static void _pygear_trace_create_key(void) {
+    pthread_key_create(&g_pygear_trace_key, _pygear_trace_thread_exit);
+}
+
+/* The ring of the calling thread, NULL if it could not be allocated */
+static pygear_trace_ring* _pygear_trace_ring(void) {
+    if (t_pygear_trace_ring) {
+        return t_pygear_trace_ring;
+    }
+    pthread_once(&g_pygear_trace_once, _pygear_trace_create_key);
+    pygear_trace_ring* ring = malloc(sizeof(pygear_trace_ring));
+    if (!ring) {
+        return NULL;
+    }
+    ring->head = 0;
+    ring->tail = 0;
+    ring->exited = false;
+    pthread_mutex_lock(&g_pygear_trace_lock);
+    ring->tid = ++g_pygear_trace_threads;
+    ring->next = g_pygear_trace_rings;
+    g_pygear_trace_rings = ring;
+    pthread_mutex_unlock(&g_pygear_trace_lock);
+    pthread_setspecific(g_pygear_trace_key, ring);
+    t_pygear_trace_ring = ring;
+    return ring;
+}
+
+static void _pygear_trace(const char* category, const char* name, char phase, const char* function,
+    double seconds) {
+    pygear_trace_ring* ring = _pygear_trace_ring();
+    if (!ring) {
+        return;
+    }
+    uint64_t head = ring->head;
+    pygear_trace_event* event = &ring->events[head % TRACE_EVENTS_PER_THREAD];
+    event->category = category;
+    event->name = name;
+    event->ts = seconds * 1e6;
+    event->phase = phase;
+    event->function[0] = '\0';
+    if (function) {
+        strncpy(event->function, function, sizeof(event->function) - 1);
+        event->function[sizeof(event->function) - 1] = '\0';
+    }
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* Writes 's' as the contents of a JSON string, bytes above ASCII as latin-1 */
+static void _pygear_trace_write_string(FILE* out, const char* s) {
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char) *s;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20 || c >= 0x7F) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+}
+
+/*
+ * Writes the events of a ring still there once copied, as the owning thread
+ * may overwrite the oldest ones meanwhile. Returns the number written.
+ */
+static size_t _pygear_trace_write_ring(FILE* out, pygear_trace_ring* ring, pid_t pid, size_t written) {
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t first = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    if (head > TRACE_EVENTS_PER_THREAD && first < head - TRACE_EVENTS_PER_THREAD) {
+        first = head - TRACE_EVENTS_PER_THREAD;
+    }
+    size_t count = 0;
+    uint64_t i;
+    for (i = first; i < head; ++i) {
+        pygear_trace_event event = ring->events[i % TRACE_EVENTS_PER_THREAD];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (i + TRACE_EVENTS_PER_THREAD <= __atomic_load_n(&ring->head, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d",
+            (written + count) ? ",\n" : "", event.name, event.category, event.phase, event.ts, (int) pid, ring->tid);
+        if (event.phase == 'i') {
+            fputs(",\"s\":\"t\"", out);
+        }
+        if (event.function[0]) {
+            fputs(",\"args\":{\"function\":\"", out);
+            _pygear_trace_write_string(out, event.function);
+            fputs("\"}", out);
+        }
+        fputc('}', out);
+        ++count;
+    }
+    return count;
+}
+
+
+/***************************
+ * Module instance methods *
+ ***************************/
+
+static PyObject* pygear_dump_trace(PyObject* self, PyObject* args) {
+    char* path;
+    if (!PyArg_ParseTuple(args, "s", &path)) {
+        return NULL;
+    }
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+    }
+    size_t written = 0;
+    int failed;
+    Py_BEGIN_ALLOW_THREADS
+    fputs("{\"traceEvents\":[\n", out);
+    pthread_mutex_lock(&g_pygear_trace_lock);
+    pygear_trace_ring* ring;
+    for (ring = g_pygear_trace_rings; ring; ring = ring->next) {
+        written += _pygear_trace_write_ring(out, ring, getpid(), written);
+    }
+    pthread_mutex_unlock(&g_pygear_trace_lock);
+    fputs("\n],\"displayTimeUnit\":\"ms\"}\n", out);
+    failed = ferror(out);
+    failed |= fclose(out);
+    Py_END_ALLOW_THREADS
+    if (failed) {
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+    }
+    return PyInt_FromSize_t(written);
+}
+
+static PyObject* pygear_clear_trace(PyObject* self) {
+    pthread_mutex_lock(&g_pygear_trace_lock);
+    pygear_trace_ring** link = &g_pygear_trace_rings;
+    while (*link) {
+        pygear_trace_ring* ring = *link;
+        if (ring->exited) {
+            *link = ring->next;
+            free(ring);
+        } else {
+            __atomic_store_n(&ring->tail, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE), __ATOMIC_RELAXED);
+            link = &ring->next;
+        }
+    }
+    pthread_mutex_unlock(&g_pygear_trace_lock);
+    Py_RETURN_NONE;
+}
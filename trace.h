@@ -0,0 +1,91 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "cooperative.h"
+
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * Events recorded by the Worker and Client that have tracing enabled, see
+ * Worker.set_trace. Each thread writes to its own ring, allocated on its
+ * first event, which keeps the last TRACE_EVENTS_PER_THREAD events. Only
+ * the owning thread writes to a ring, publishing events by bumping 'head',
+ * so recording takes no lock and does not need the GIL. Rings outlive
+ * their threads until pygear.clear_trace.
+ */
+#define TRACE_EVENTS_PER_THREAD 16384
+#define TRACE_FUNCTION_SIZE 32
+
+typedef struct {
+    const char* category;       /* static strings */
+    const char* name;
+    double ts;                  /* monotonic microseconds */
+    char phase;                 /* 'B'egin, 'E'nd or 'i'nstant, as in the trace_event format */
+    char function[TRACE_FUNCTION_SIZE];     /* gearman function, truncated, on 'B' events */
+} pygear_trace_event;
+
+typedef struct pygear_trace_ring {
+    int tid;                    /* numbered in the order threads first recorded */
+    uint64_t head;              /* events ever written */
+    uint64_t tail;              /* events before this one were cleared */
+    bool exited;                /* the thread is gone, the ring can be freed */
+    struct pygear_trace_ring* next;
+    pygear_trace_event events[TRACE_EVENTS_PER_THREAD];
+} pygear_trace_ring;
+
+/* Private methods */
+/* Records an event that happened at 'seconds' on the monotonic clock */
+static void _pygear_trace(const char* category, const char* name, char phase, const char* function,
+    double seconds);
+#define _pygear_trace_begin(category, name, function) \
+    _pygear_trace(category, name, 'B', function, _pygear_monotonic())
+#define _pygear_trace_end(category, name) _pygear_trace(category, name, 'E', NULL, _pygear_monotonic())
+
+/* Module methods */
+static PyObject* pygear_dump_trace(PyObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_dump_trace_doc,
+"Write the events recorded by Workers and Clients with tracing enabled (see\n"
+"Worker.set_trace and Client.set_trace) to a file in the Chrome trace_event\n"
+"JSON format, which chrome://tracing and Perfetto load. Every thread is a\n"
+"row showing the spans of the jobs it ran or sent. Only the last 16384\n"
+"events of each thread are kept. Recording goes on while dumping.\n"
+"@param[in] path - File to write.\n"
+"@return the number of events written.");
+
+static PyObject* pygear_clear_trace(PyObject* self);
+PyDoc_STRVAR(pygear_clear_trace_doc,
+"Forget the events recorded so far, and the rings of exited threads.");
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "view.h"
+
+/*
+ * Class constructor / destructor methods
+ */
+
+void View_dealloc(pygear_ViewObject* self) {
+    free(self->owned);
+    self->ob_type->tp_free((PyObject*)self);
+}
+
+
+/*******************
+ * Private methods *
+ *******************/
+
+/*
+ * Return value: New reference.
+ * 'owned', if not NULL, is freed with the view, which never becomes invalid.
+ */
+static PyObject* _pygear_view_new(const char* data, size_t size, void* owned) {
+    pygear_ViewObject* self = PyObject_New(pygear_ViewObject, &pygear_ViewType);
+    if (!self) {
+        return NULL;
+    }
+    self->data = data ? data : "";
+    self->size = data ? size : 0;
+    self->owned = owned;
+    self->valid = true;
+    return (PyObject*) self;
+}
+
+/* Whether 'view' is still valid and over exactly these bytes */
+static bool _pygear_view_is(PyObject* view, const char* data, size_t size) {
+    pygear_ViewObject* self = (pygear_ViewObject*) view;
+    return view && self->valid && self->data == (data ? data : "") && (size_t) self->size == (data ? size : 0);
+}
+
+static void _pygear_view_invalidate(PyObject* view) {
+    pygear_ViewObject* self = (pygear_ViewObject*) view;
+    if (!view || self->owned) {
+        return;
+    }
+    self->data = "";
+    self->size = 0;
+    self->valid = false;
+}
+
+/*
+ * Copy borrowed bytes into 'owned', for consumers that keep the pointer past
+ * the job or task. Returns -1 with a python exception set on failure.
+ */
+static int _pygear_view_own(pygear_ViewObject* self) {
+    if (self->owned || !self->size) {
+        return 0;
+    }
+    void* copy = malloc(self->size);
+    if (!copy) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    memcpy(copy, self->data, self->size);
+    self->data = copy;
+    self->owned = copy;
+    return 0;
+}
+
+static int _pygear_view_check(pygear_ViewObject* self) {
+    if (!self->valid) {
+        PyErr_SetString(PyExc_ValueError, "The job or task this view was taken from has been released");
+        return -1;
+    }
+    return 0;
+}
+
+static Py_ssize_t View_length(pygear_ViewObject* self) {
+    return _pygear_view_check(self) < 0 ? -1 : self->size;
+}
+
+static Py_ssize_t View_getreadbuffer(pygear_ViewObject* self, Py_ssize_t segment, void** ptr) {
+    if (segment != 0) {
+        PyErr_SetString(PyExc_SystemError, "Accessing non-existent View segment");
+        return -1;
+    }
+    if (_pygear_view_check(self) < 0) {
+        return -1;
+    }
+    *ptr = (void*) self->data;
+    return self->size;
+}
+
+static Py_ssize_t View_getsegcount(pygear_ViewObject* self, Py_ssize_t* lenp) {
+    if (lenp) {
+        *lenp = self->size;
+    }
+    return 1;
+}
+
+static Py_ssize_t View_getcharbuffer(pygear_ViewObject* self, Py_ssize_t segment, char** ptr) {
+    return View_getreadbuffer(self, segment, (void**) ptr);
+}
+
+static int View_getbuffer(pygear_ViewObject* self, Py_buffer* view, int flags) {
+    if (_pygear_view_check(self) < 0) {
+        return -1;
+    }
+    // Only a PyBUF_SIMPLE request is known to be released before the storage goes
+    if (flags != PyBUF_SIMPLE && _pygear_view_own(self) < 0) {
+        return -1;
+    }
+    return PyBuffer_FillInfo(view, (PyObject*) self, (void*) self->data, self->size, 1, flags);
+}
+
+
+/********************
+ * Instance methods *
+ ********************/
+
+static PyObject* pygear_view_tobytes(pygear_ViewObject* self) {
+    if (_pygear_view_check(self) < 0) {
+        return NULL;
+    }
+    return PyString_FromStringAndSize(self->data, self->size);
+}
+
+
+static PyObject* pygear_view_valid(pygear_ViewObject* self) {
+    return PyBool_FromLong(self->valid);
+}
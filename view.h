@@ -0,0 +1,147 @@
+/*
+ *
+ * Copyright (c) 2014, Yelp Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Yelp Inc. nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL YELP INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Python.h>
+#include <stdbool.h>
+#include "structmember.h"
+
+#ifndef PyMODINIT_FUNC
+#define PyMODINIT_FUNC void
+#endif
+
+#ifndef VIEW_H
+#define VIEW_H
+
+#define _VIEWMETHOD(name,flags) {#name,(PyCFunction) pygear_view_##name,flags,pygear_view_##name##_doc},
+
+/*
+ * Read-only bytes that are not copied into a string. A view either borrows
+ * libgearman's storage, and is invalidated by the Job or Task it came from
+ * once that storage goes away, or owns a malloc'd buffer it frees itself.
+ * The old buffer protocol looks the pointer up on every access, so buffer()
+ * objects raise once the view is invalidated. A new-style buffer keeps the
+ * raw pointer: argument parsing ("s*") asks for PyBUF_SIMPLE and releases it
+ * before returning, so it borrows too, but any other request (a memoryview)
+ * may outlive the job or task and first copies the bytes into 'owned'.
+ */
+typedef struct {
+    PyObject_HEAD
+    const char* data;
+    Py_ssize_t size;
+    void* owned;
+    bool valid;
+} pygear_ViewObject;
+
+PyDoc_STRVAR(view_module_docstring,
+"Read-only buffer over a job workload or task result, without a copy.\n"
+"It supports len(), buffer(), memoryview() and the functions that accept\n"
+"buffers, such as struct.unpack_from or zlib.decompress. Views of a Job or\n"
+"Task are only valid while the job or task is, and raise ValueError after,\n"
+"unless a memoryview was taken from them: they then copy the bytes once and\n"
+"stay valid. Views returned by Client.do(raw=True) own their bytes.");
+
+/* Class init methods */
+void View_dealloc(pygear_ViewObject* self);
+
+/* Private methods */
+static PyObject* _pygear_view_new(const char* data, size_t size, void* owned);
+static bool _pygear_view_is(PyObject* view, const char* data, size_t size);
+static void _pygear_view_invalidate(PyObject* view);
+static int _pygear_view_own(pygear_ViewObject* self);
+
+/* Method definitions */
+static PyObject* pygear_view_tobytes(pygear_ViewObject* self);
+PyDoc_STRVAR(pygear_view_tobytes_doc,
+"@return a copy of the bytes as a string.");
+
+static PyObject* pygear_view_valid(pygear_ViewObject* self);
+PyDoc_STRVAR(pygear_view_valid_doc,
+"@return False once the storage the view borrows has been released.");
+
+
+/* Module method specification */
+static PyMethodDef view_module_methods[] = {
+    _VIEWMETHOD(tobytes,            METH_NOARGS)
+    _VIEWMETHOD(valid,              METH_NOARGS)
+    {NULL, NULL, 0, NULL}
+};
+
+static Py_ssize_t View_length(pygear_ViewObject* self);
+static Py_ssize_t View_getreadbuffer(pygear_ViewObject* self, Py_ssize_t segment, void** ptr);
+static Py_ssize_t View_getsegcount(pygear_ViewObject* self, Py_ssize_t* lenp);
+static Py_ssize_t View_getcharbuffer(pygear_ViewObject* self, Py_ssize_t segment, char** ptr);
+static int View_getbuffer(pygear_ViewObject* self, Py_buffer* view, int flags);
+
+static PySequenceMethods view_as_sequence = {
+    (lenfunc)View_length,                       /* sq_length */
+};
+
+static PyBufferProcs view_as_buffer = {
+    (readbufferproc)View_getreadbuffer,         /* bf_getreadbuffer */
+    0,                                          /* bf_getwritebuffer */
+    (segcountproc)View_getsegcount,             /* bf_getsegcount */
+    (charbufferproc)View_getcharbuffer,         /* bf_getcharbuffer */
+    (getbufferproc)View_getbuffer,              /* bf_getbuffer */
+    0,                                          /* bf_releasebuffer */
+};
+
+PyTypeObject pygear_ViewType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /*ob_size*/
+    "pygear.View",                              /*tp_name*/
+    sizeof(pygear_ViewObject),                  /*tp_basicsize*/
+    0,                                          /*tp_itemsize*/
+    (destructor)View_dealloc,                   /*tp_dealloc*/
+    0,                                          /*tp_print*/
+    0,                                          /*tp_getattr*/
+    0,                                          /*tp_setattr*/
+    0,                                          /*tp_compare*/
+    0,                                          /*tp_repr*/
+    0,                                          /*tp_as_number*/
+    &view_as_sequence,                          /*tp_as_sequence*/
+    0,                                          /*tp_as_mapping*/
+    0,                                          /*tp_hash */
+    0,                                          /*tp_call*/
+    0,                                          /*tp_str*/
+    0,                                          /*tp_getattro*/
+    0,                                          /*tp_setattro*/
+    &view_as_buffer,                            /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_HAVE_GETCHARBUFFER |
+    Py_TPFLAGS_HAVE_NEWBUFFER,                  /*tp_flags*/
+    view_module_docstring,                      /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    view_module_methods,                        /* tp_methods */
+};
+
+#endif
@@ -28,6 +28,9 @@
 
 #include "worker.h"
 
+/* Whether the 'grab' trace event of the worker on this thread is still open */
+static __thread bool t_pygear_worker_grabbing = false;
+
 /*
  * Class constructor / destructor methods
  */
@@ -55,6 +58,11 @@ int Worker_init(pygear_WorkerObject* self, PyObject* args, PyObject* kwds) {
         return -1;
     }
     self->cb_log = NULL;
+    self->result_caches = NULL;
+    self->stats = NULL;
+    self->trace = false;
+    _pygear_statshm_decref(self->shm);
+    self->shm = NULL;
     return 0;
 }
 
@@ -77,6 +85,19 @@ void Worker_dealloc(pygear_WorkerObject* self) {
         gearman_worker_free(self->g_Worker);
         self->g_Worker = NULL;
     }
+    while (self->result_caches) {
+        pygear_cache* next = self->result_caches->next;
+        _pygear_cache_free(self->result_caches);
+        self->result_caches = next;
+    }
+    while (self->stats) {
+        pygear_function_stats* next = self->stats->next;
+        free(self->stats->function_name);
+        free(self->stats);
+        self->stats = next;
+    }
+    _pygear_statshm_decref(self->shm);
+    self->shm = NULL;
     Worker_clear(self);
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -269,7 +290,13 @@ static PyObject* pygear_worker_get_options(pygear_WorkerObject* self) {
 
 static PyObject* pygear_worker_grab_job(pygear_WorkerObject* self) {
     gearman_return_t result;
+    if (self->trace) {
+        _pygear_trace_begin("worker", "grab", NULL);
+    }
     gearman_job_st* new_job = gearman_worker_grab_job(self->g_Worker, NULL, &result);
+    if (self->trace) {
+        _pygear_trace_end("worker", "grab");
+    }
     PyObject* argList = NULL;
     pygear_JobObject* python_job = NULL;
     PyObject* callmethod_result = NULL;
@@ -291,7 +318,8 @@ static PyObject* pygear_worker_grab_job(pygear_WorkerObject* self) {
     if (!callmethod_result) {
         goto catch;
     }
-    python_job->g_Job = new_job;
+    _pygear_job_attach(python_job, new_job, _pygear_envelope_now_us());
+    python_job->trace = self->trace;
     ret = Py_BuildValue("O", python_job);
 
 catch:
@@ -462,6 +490,11 @@ static PyObject* pygear_worker_set_serializer(pygear_WorkerObject* self, PyObjec
     Py_INCREF(serializer);
     Py_XDECREF(self->serializer);  // dealloc the old one
     self->serializer = serializer;
+    // Memoized results were encoded by the old serializer
+    pygear_cache* cache;
+    for (cache = self->result_caches; cache; cache = cache->next) {
+        _pygear_cache_clear(cache);
+    }
     Py_RETURN_NONE;
 }
 
@@ -482,19 +515,260 @@ static PyObject* pygear_worker_timeout(pygear_WorkerObject* self) {
 
 
 static PyObject* pygear_worker_wait(pygear_WorkerObject* self) {
-    gearman_return_t result = gearman_worker_wait(self->g_Worker);
-    if (_pygear_check_and_raise_exn(result)) {
+    gearman_return_t result = (_pygear_cooperative_enabled() ?
+        _pygear_cooperative_worker_wait(self->g_Worker) :
+        gearman_worker_wait(self->g_Worker));
+    if (PyErr_Occurred() || _pygear_check_and_raise_exn(result)) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_worker_enable_result_cache(pygear_WorkerObject* self, PyObject* args, PyObject* kwargs) {
+    char* function_name;
+    long ttl_ms;
+    Py_ssize_t max_bytes = CACHE_DEFAULT_MAX_BYTES;
+    PyObject* shared = Py_False;
+    Py_ssize_t max_result_bytes = CACHE_SHARED_DEFAULT_MAX_RESULT_BYTES;
+    static char* kwlist[] = {"function", "ttl_ms", "max_bytes", "shared", "max_result_bytes", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sl|nOn", kwlist,
+        &function_name, &ttl_ms, &max_bytes, &shared, &max_result_bytes)) {
+        return NULL;
+    }
+    if (ttl_ms <= 0 || max_bytes <= 0 || max_result_bytes < 0) {
+        PyErr_SetString(PyExc_ValueError, "ttl_ms and max_bytes must be positive");
+        return NULL;
+    }
+    pygear_cache* cache;
+    if (PyObject_IsTrue(shared)) {
+        cache = _pygear_cache_new_shared(function_name, ttl_ms, max_bytes, max_result_bytes);
+        if (!cache && errno == EINVAL) {
+            PyErr_SetString(PyExc_ValueError, "max_bytes does not hold a set of max_result_bytes slots");
+            return NULL;
+        }
+        if (!cache) {
+            return PyErr_SetFromErrno(PyExc_OSError);
+        }
+    } else {
+        cache = _pygear_cache_new(function_name, ttl_ms, max_bytes);
+        if (!cache) {
+            return PyErr_NoMemory();
+        }
+    }
+    pygear_cache** link = &self->result_caches;
+    while (*link && strcmp((*link)->function_name, function_name)) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        cache->next = (*link)->next;
+        _pygear_cache_free(*link);
+    }
+    *link = cache;
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_worker_disable_result_cache(pygear_WorkerObject* self, PyObject* args, PyObject* kwargs) {
+    char* function_name = NULL;
+    static char* kwlist[] = {"function", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|z", kwlist, &function_name)) {
+        return NULL;
+    }
+    pygear_cache** link = &self->result_caches;
+    while (*link) {
+        pygear_cache* cache = *link;
+        if (function_name && strcmp(cache->function_name, function_name)) {
+            link = &cache->next;
+            continue;
+        }
+        *link = cache->next;
+        _pygear_cache_free(cache);
+    }
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* pygear_worker_result_cache_stats(pygear_WorkerObject* self) {
+    PyObject* stats = PyDict_New();
+    if (!stats) {
+        return NULL;
+    }
+    pygear_cache* cache;
+    for (cache = self->result_caches; cache; cache = cache->next) {
+        PyObject* cache_stats = _pygear_cache_stats(cache);
+        if (!cache_stats || PyDict_SetItemString(stats, cache->function_name, cache_stats) < 0) {
+            Py_XDECREF(cache_stats);
+            Py_DECREF(stats);
+            return NULL;
+        }
+        Py_DECREF(cache_stats);
+    }
+    return stats;
+}
+
+static PyObject* pygear_worker_publish_stats(pygear_WorkerObject* self, PyObject* args, PyObject* kwargs) {
+    char* name;
+    char* directory = NULL;
+    static char* kwlist[] = {"name", "directory", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|z", kwlist, &name, &directory)) {
+        return NULL;
+    }
+    if (_pygear_statshm_live(self->shm)) {
+        PyErr_SetString(PyGearExn_ERROR, "Worker stats are already published");
+        return NULL;
+    }
+    // A segment inherited through fork belongs to the parent
+    _pygear_statshm_decref(self->shm);
+    self->shm = NULL;
+    self->shm = _pygear_statshm_open(directory, "worker", name);
+    if (!self->shm) {
         return NULL;
     }
+    pygear_function_stats* stats;
+    for (stats = self->stats; stats; stats = stats->next) {
+        _pygear_worker_publish_function(self, stats);
+    }
+    return _pygear_statshm_path(self->shm);
+}
+
+static PyObject* pygear_worker_set_trace(pygear_WorkerObject* self, PyObject* args) {
+    PyObject* enabled;
+    if (!PyArg_ParseTuple(args, "O", &enabled)) {
+        return NULL;
+    }
+    int truth = PyObject_IsTrue(enabled);
+    if (truth < 0) {
+        return NULL;
+    }
+    self->trace = truth;
     Py_RETURN_NONE;
 }
 
+static PyObject* pygear_worker_trace(pygear_WorkerObject* self) {
+    return PyBool_FromLong(self->trace);
+}
+
+static PyObject* pygear_worker_stats(pygear_WorkerObject* self) {
+    PyObject* stats = PyDict_New();
+    if (!stats) {
+        return NULL;
+    }
+    pygear_function_stats* function_stats;
+    for (function_stats = self->stats; function_stats; function_stats = function_stats->next) {
+        PyObject* queue_delay = _pygear_histogram_summary(&function_stats->queue_delay);
+        PyObject* start_delay = _pygear_histogram_summary(&function_stats->start_delay);
+        PyObject* entry = NULL;
+        if (queue_delay && start_delay) {
+            entry = Py_BuildValue("{s:O,s:O}", "queue_delay", queue_delay, "start_delay", start_delay);
+        }
+        Py_XDECREF(queue_delay);
+        Py_XDECREF(start_delay);
+        if (!entry || PyDict_SetItemString(stats, function_stats->function_name, entry) < 0) {
+            Py_XDECREF(entry);
+            Py_DECREF(stats);
+            return NULL;
+        }
+        Py_DECREF(entry);
+    }
+    return stats;
+}
+
+
+/* Timings of a function, created on its first job. NULL if out of memory */
+static pygear_function_stats* _pygear_worker_stats(pygear_WorkerObject* self, const char* function_name) {
+    pygear_function_stats* stats;
+    for (stats = self->stats; stats; stats = stats->next) {
+        if (!strcmp(stats->function_name, function_name)) {
+            return stats;
+        }
+    }
+    stats = malloc(sizeof(pygear_function_stats));
+    if (!stats || !(stats->function_name = strdup(function_name))) {
+        free(stats);
+        return NULL;
+    }
+    _pygear_histogram_reset(&stats->queue_delay);
+    _pygear_histogram_reset(&stats->start_delay);
+    stats->next = self->stats;
+    self->stats = stats;
+    _pygear_worker_publish_function(self, stats);
+    return stats;
+}
+
+/* Adds the histograms of a function to the published stats, if any */
+static void _pygear_worker_publish_function(pygear_WorkerObject* self, pygear_function_stats* stats) {
+    char name[STATSHM_NAME_SIZE];
+    snprintf(name, sizeof(name), "%s.queue_delay", stats->function_name);
+    stats->shm_queue_delay = _pygear_statshm_series(self->shm, name, STATSHM_HISTOGRAM);
+    _pygear_statshm_merge(self->shm, stats->shm_queue_delay, &stats->queue_delay);
+    snprintf(name, sizeof(name), "%s.start_delay", stats->function_name);
+    stats->shm_start_delay = _pygear_statshm_series(self->shm, name, STATSHM_HISTOGRAM);
+    _pygear_statshm_merge(self->shm, stats->shm_start_delay, &stats->start_delay);
+}
+
+/*
+ * Sends the strings 'chunks' yields as WORK_DATA, buffering the small ones so
+ * that a packet carries up to WORKER_STREAM_PACKET_SIZE bytes.
+ * Returns -1 with a python exception set on failure.
+ */
+static int _pygear_worker_send_stream(gearman_job_st* gear_job, PyObject* chunks) {
+    char* packet = malloc(WORKER_STREAM_PACKET_SIZE);
+    if (!packet) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    size_t packet_size = 0;
+    int ret = 0;
+    PyObject* chunk;
+    while (!ret && (chunk = PyIter_Next(chunks))) {
+        char* data;
+        Py_ssize_t size;
+        if (PyString_AsStringAndSize(chunk, &data, &size) < 0) {
+            ret = -1;
+        } else {
+            if (packet_size && packet_size + size > WORKER_STREAM_PACKET_SIZE) {
+                ret = _pygear_check_and_raise_exn(gearman_job_send_data(gear_job, packet, packet_size)) ? -1 : 0;
+                packet_size = 0;
+            }
+            if (!ret && (size_t) size >= WORKER_STREAM_PACKET_SIZE) {
+                ret = _pygear_check_and_raise_exn(gearman_job_send_data(gear_job, data, size)) ? -1 : 0;
+            } else if (!ret) {
+                memcpy(packet + packet_size, data, size);
+                packet_size += size;
+            }
+        }
+        Py_DECREF(chunk);
+    }
+    if (!ret && PyErr_Occurred()) {
+        ret = -1;
+    }
+    if (!ret && packet_size) {
+        ret = _pygear_check_and_raise_exn(gearman_job_send_data(gear_job, packet, packet_size)) ? -1 : 0;
+    }
+    free(packet);
+    return ret;
+}
+
 
 /* private method */
 void* _pygear_worker_function_mapper(gearman_job_st* gear_job, void* context,
     size_t* result_size, gearman_return_t* ret_ptr) {
 
+    // Waiting for the GIL counts towards the start delay
+    uint64_t grabbed_us = _pygear_envelope_now_us();
+    bool trace = ((pygear_WorkerObject*) context)->trace;
+    if (trace && t_pygear_worker_grabbing) {
+        _pygear_trace_end("worker", "grab");
+        t_pygear_worker_grabbing = false;
+    }
+    if (trace) {
+        _pygear_trace_begin("worker", "gil", NULL);
+    }
     PyGILState_STATE gstate = PyGILState_Ensure();
+    if (trace) {
+        _pygear_trace_end("worker", "gil");
+    }
 
     // borrowed refs
     pygear_WorkerObject* worker = ((pygear_WorkerObject*) context);
@@ -524,6 +798,59 @@ void* _pygear_worker_function_mapper(gearman_job_st* gear_job, void* context,
         goto catch;
     }
 
+    // Replies are put in an envelope if the workload came in one
+    pygear_envelope envelope;
+    const char* workload = gearman_job_workload(gear_job);
+    size_t envelope_size = _pygear_envelope_parse(workload, gearman_job_workload_size(gear_job), &envelope);
+    const pygear_envelope* request = envelope_size ? &envelope : NULL;
+    uint8_t codec = _pygear_envelope_codec_id(worker->serializer);
+
+    pygear_function_stats* stats = _pygear_worker_stats(worker, job_func_name);
+    if (stats && request) {
+        // Clocks of the client and worker hosts may disagree a little
+        double queue_delay = grabbed_us > envelope.sent_us ? (grabbed_us - envelope.sent_us) / 1e6 : 0.0;
+        _pygear_histogram_record(&stats->queue_delay, queue_delay);
+        _pygear_statshm_record(worker->shm, stats->shm_queue_delay, queue_delay);
+    }
+
+    // Nobody waits for the result of a job past its deadline
+    if (request && envelope.deadline_us && _pygear_envelope_now_us() > envelope.deadline_us) {
+        goto catch;
+    }
+
+    // A memoized result is sent as is, without building the job or calling Python
+    pygear_cache* cache = _pygear_cache_find(worker->result_caches, job_func_name);
+    uint64_t cache_key[2];
+    if (cache) {
+        void* cached;
+        size_t cached_size;
+        uint8_t cached_codec;
+        _pygear_hash_job(job_func_name, workload ? workload + envelope_size : NULL,
+            gearman_job_workload_size(gear_job) - envelope_size, cache_key);
+        // The same bytes are a different workload under another codec
+        uint8_t request_codec = request ? envelope.codec : ENVELOPE_CODEC_LOCAL;
+        cache_key[0] = _pygear_hash64(&request_codec, 1, cache_key[0]);
+        cache_key[1] = _pygear_hash64(&request_codec, 1, cache_key[1]);
+        if (_pygear_cache_get(cache, cache_key, &cached, &cached_size, &cached_codec)) {
+            if (trace) {
+                _pygear_trace_begin("worker", "send", job_func_name);
+            }
+            gearman_return_t sent = _pygear_envelope_reply(gear_job, gearman_job_send_complete, request,
+                grabbed_us, 0, cached_codec, cached, cached_size);
+            if (trace) {
+                _pygear_trace_end("worker", "send");
+            }
+            free(cached);
+            if (_pygear_check_and_raise_exn(sent)) {
+                PyErr_Print();
+                retptr = UNDEFINED;
+            } else {
+                retptr = SUCCESS;
+            }
+            goto catch;
+        }
+    }
+
     // Bind the job into a python representation, and call through the python callback method
     argList = Py_BuildValue("(O, O)", Py_None, Py_None);
     python_job = (pygear_JobObject*) PyObject_CallObject((PyObject *) &pygear_JobType, argList);
@@ -532,10 +859,29 @@ void* _pygear_worker_function_mapper(gearman_job_st* gear_job, void* context,
         goto catch;
     }
 
-    python_job->g_Job = gear_job;
+    _pygear_job_attach(python_job, gear_job, grabbed_us);
+    python_job->trace = trace;
 
+    python_job->started_us = _pygear_envelope_now_us();
+    if (stats) {
+        double start_delay = python_job->started_us > grabbed_us ? (python_job->started_us - grabbed_us) / 1e6 : 0.0;
+        _pygear_histogram_record(&stats->start_delay, start_delay);
+        _pygear_statshm_record(worker->shm, stats->shm_start_delay, start_delay);
+    }
+    if (trace) {
+        _pygear_trace_begin("worker", "handler", job_func_name);
+    }
     callback_return = PyObject_CallFunction(python_cb_method, "O", python_job);
 
+    // A generator streams its chunks; the job then completes with an empty result
+    bool streamed = (callback_return && PyGen_Check(callback_return));
+    if (streamed && _pygear_worker_send_stream(gear_job, callback_return) < 0) {
+        Py_CLEAR(callback_return);
+    }
+    if (trace) {
+        _pygear_trace_end("worker", "handler");
+    }
+
     if (!callback_return) {
 
         if (!PyErr_Occurred()) {
@@ -598,7 +944,13 @@ void* _pygear_worker_function_mapper(gearman_job_st* gear_job, void* context,
             }
             goto catch;
         }
+        if (trace) {
+            _pygear_trace_begin("worker", "encode", job_func_name);
+        }
         serialized_data = PyObject_CallMethod(worker->serializer, "dumps", "(O)", error_tuple);
+        if (trace) {
+            _pygear_trace_end("worker", "encode");
+        }
         if (!serialized_data) {
             if (!PyErr_Occurred()) {
                 PyErr_SetString(PyExc_SystemError, "Failed to serialize exception data\n");
@@ -611,7 +963,14 @@ void* _pygear_worker_function_mapper(gearman_job_st* gear_job, void* context,
             goto catch;
         }
 
-        gearman_return_t exn_sent = gearman_job_send_exception(gear_job, c_data, c_data_size);
+        if (trace) {
+            _pygear_trace_begin("worker", "send", job_func_name);
+        }
+        gearman_return_t exn_sent = _pygear_envelope_reply(gear_job, gearman_job_send_exception, request,
+            grabbed_us, python_job->started_us, codec, c_data, c_data_size);
+        if (trace) {
+            _pygear_trace_end("worker", "send");
+        }
 
         if (!gearman_success(exn_sent)) {
             PyObject* err_string = PyString_FromFormat("Failed to send exception data for job: %s\n", gearman_strerror(exn_sent));
@@ -622,8 +981,18 @@ void* _pygear_worker_function_mapper(gearman_job_st* gear_job, void* context,
 
         retptr = UNDEFINED;
 
+    } else if (streamed) {
+        if (_pygear_check_and_raise_exn(gearman_job_send_complete(gear_job, NULL, 0))) {
+            PyErr_Print();
+            retptr = UNDEFINED;
+        } else {
+            retptr = SUCCESS;
+        }
     } else {
         // Try to pickle the return from the function
+        if (trace) {
+            _pygear_trace_begin("worker", "encode", job_func_name);
+        }
         PyObject* dumpstr = PyString_FromString("dumps");
         pickled_result = PyObject_CallMethodObjArgs (
             worker->serializer,
@@ -632,6 +1001,9 @@ void* _pygear_worker_function_mapper(gearman_job_st* gear_job, void* context,
             NULL
         );
         Py_XDECREF(dumpstr);
+        if (trace) {
+            _pygear_trace_end("worker", "encode");
+        }
         if (!pickled_result) {
             if (!PyErr_Occurred()) {
                 PyErr_SetString(PyExc_SystemError, "Failed to serialize worker result data\n");
@@ -642,7 +1014,18 @@ void* _pygear_worker_function_mapper(gearman_job_st* gear_job, void* context,
             Py_ssize_t len;
             char* buffer;
             PyString_AsStringAndSize(pickled_result, &buffer, &len);
-            if (_pygear_check_and_raise_exn(gearman_job_send_complete(gear_job, buffer, len))) {
+            if (cache) {
+                _pygear_cache_put(cache, cache_key, buffer, len, codec);
+            }
+            if (trace) {
+                _pygear_trace_begin("worker", "send", job_func_name);
+            }
+            gearman_return_t sent = _pygear_envelope_reply(gear_job, gearman_job_send_complete, request,
+                grabbed_us, python_job->started_us, codec, buffer, len);
+            if (trace) {
+                _pygear_trace_end("worker", "send");
+            }
+            if (_pygear_check_and_raise_exn(sent)) {
                 PyErr_Print();
                 retptr = UNDEFINED;
             } else {
@@ -661,7 +1044,9 @@ catch:
     Py_XDECREF(string_traceback);
     Py_XDECREF(error_tuple);
     Py_XDECREF(serialized_data);
-    python_job->g_Job = NULL;
+    if (python_job) {
+        _pygear_job_detach(python_job);
+    }
     Py_XDECREF(python_job);
     Py_XDECREF(callback_return);
 
@@ -679,7 +1064,18 @@ catch:
 
 
 static PyObject* pygear_worker_work(pygear_WorkerObject* self) {
-    gearman_return_t result = gearman_worker_work(self->g_Worker);
+    if (self->trace) {
+        _pygear_trace_begin("worker", "grab", NULL);
+        t_pygear_worker_grabbing = true;
+    }
+    gearman_return_t result = (_pygear_cooperative_enabled() ?
+        _pygear_cooperative_worker_work(self->g_Worker) :
+        gearman_worker_work(self->g_Worker));
+    // No job came, or the worker stopped tracing meanwhile
+    if (t_pygear_worker_grabbing) {
+        _pygear_trace_end("worker", "grab");
+        t_pygear_worker_grabbing = false;
+    }
     if (PyErr_Occurred()) {
         return NULL;
     }
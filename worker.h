@@ -30,6 +30,11 @@
 #include <libgearman-1.0/gearman.h>
 #include <stdio.h>
 #include "structmember.h"
+#include "cooperative.h"
+#include "cache.h"
+#include "histogram.h"
+#include "trace.h"
+#include "statshm.h"
 
 #ifndef PyMODINIT_FUNC
 #define PyMODINIT_FUNC void
@@ -38,14 +43,31 @@
 #ifndef WORKER_H
 #define WORKER_H
 
+/* Chunks yielded by a streaming handler are coalesced into packets of up to this size */
+#define WORKER_STREAM_PACKET_SIZE (64 * 1024)
+
 #define _WORKERMETHOD(name,flags) {#name,(PyCFunction) pygear_worker_##name,flags,pygear_worker_##name##_doc},
 
+/* Timings of the jobs of one function run by the worker */
+typedef struct pygear_function_stats {
+    char* function_name;
+    pygear_histogram queue_delay;   /* client send to worker grab, enveloped jobs only */
+    pygear_histogram start_delay;   /* worker grab to callback start */
+    pygear_statshm_series* shm_queue_delay;     /* copies, once published */
+    pygear_statshm_series* shm_start_delay;
+    struct pygear_function_stats* next;
+} pygear_function_stats;
+
 typedef struct {
     PyObject_HEAD
     struct gearman_worker_st* g_Worker;
     PyObject* g_FunctionMap;
     PyObject* serializer;
     PyObject* cb_log;
+    pygear_cache* result_caches;    /* linked list, one per function */
+    pygear_function_stats* stats;   /* linked list, one per function that ran */
+    bool trace;                     /* see set_trace */
+    pygear_statshm* shm;            /* see publish_stats */
 } pygear_WorkerObject;
 
 PyDoc_STRVAR(worker_module_docstring, "Represents a Gearman worker.");
@@ -59,6 +81,9 @@ void Worker_dealloc(pygear_WorkerObject* self);
 /* Private methods */
 void* _pygear_worker_function_mapper(gearman_job_st* gear_job, void* context,
     size_t* result_size, gearman_return_t* ret_ptr);
+static int _pygear_worker_send_stream(gearman_job_st* gear_job, PyObject* chunks);
+static pygear_function_stats* _pygear_worker_stats(pygear_WorkerObject* self, const char* function_name);
+static void _pygear_worker_publish_function(pygear_WorkerObject* self, pygear_function_stats* stats);
 
 /* Method definitions */
 static PyObject* pygear_worker_add_function(pygear_WorkerObject* self, PyObject* args);
@@ -74,7 +99,11 @@ PyDoc_STRVAR(pygear_worker_add_function_doc,
 "Example:\n"
 "def reverse(job):\n"
 "    return job.workload()[::-1]\n\n"
-"w.add_function('reverse', 1, reverse)  # 1 second timeout");
+"w.add_function('reverse', 1, reverse)  # 1 second timeout\n\n"
+"A function that is a generator streams its result instead: every yielded\n"
+"string is sent as WORK_DATA, small ones coalesced into packets of up to\n"
+"64 KB, and the job completes with an empty result once the generator is\n"
+"exhausted. See Client.do_stream.");
 
 static PyObject* pygear_worker_add_server(pygear_WorkerObject* self, PyObject* args);
 PyDoc_STRVAR(pygear_worker_add_server_doc,
@@ -256,6 +285,68 @@ PyDoc_STRVAR(pygear_worker_unregister_all_doc,
 "@return None on success.\n"
 "@return NULL and raises pygear exception on failure.");
 
+static PyObject* pygear_worker_enable_result_cache(pygear_WorkerObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_worker_enable_result_cache_doc,
+"Memoize a function whose result only depends on its workload. A job whose\n"
+"serialized workload was seen in the last 'ttl_ms' is completed with the\n"
+"stored result, without calling Python. Jobs that raise are not cached.\n"
+"Workloads sent in envelopes of different codecs are cached apart. Enabling\n"
+"an enabled cache empties it, and so does 'set_serializer'.\n\n"
+"@param[in] function - Function name.\n"
+"@param[in] ttl_ms - How long a result is reused, in milliseconds.\n"
+"@param[in] max_bytes - Memory for the results, 16 MB by default.\n"
+"@param[in] shared - Keep the results in shared memory, so that workers forked\n"
+"\tafter this call share them. False by default.\n"
+"@param[in] max_result_bytes - With 'shared', the size of a slot: larger\n"
+"\tresults are not cached. 4096 by default.");
+
+static PyObject* pygear_worker_disable_result_cache(pygear_WorkerObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_worker_disable_result_cache_doc,
+"Drop the result cache of a function, or of every function.\n\n"
+"@param[in] function - Function name, None (the default) for all.");
+
+static PyObject* pygear_worker_result_cache_stats(pygear_WorkerObject* self);
+PyDoc_STRVAR(pygear_worker_result_cache_stats_doc,
+"@return a dict from cached function names to their 'hits', 'misses',\n"
+"'evictions', and current 'entries' and 'bytes'. Shared caches count the\n"
+"jobs of every process sharing them.");
+
+static PyObject* pygear_worker_publish_stats(pygear_WorkerObject* self, PyObject* args, PyObject* kwargs);
+PyDoc_STRVAR(pygear_worker_publish_stats_doc,
+"Keep a copy of 'stats' in a file that other processes can map and read\n"
+"without locks, see pygear_stats.py: the 'queue_delay' and 'start_delay'\n"
+"histograms of each function, as '<function>.queue_delay' and\n"
+"'<function>.start_delay'. The file is removed when the worker is\n"
+"collected. A forked child stops updating the file of its parent, and may\n"
+"publish its own.\n"
+"@param[in] name - Name the readers aggregate the processes by, such as the\n"
+"\tservice the worker belongs to.\n"
+"@param[in] directory - Optional, '/dev/shm' by default.\n"
+"@return the path of the file.");
+
+static PyObject* pygear_worker_set_trace(pygear_WorkerObject* self, PyObject* args);
+PyDoc_STRVAR(pygear_worker_set_trace_doc,
+"Record when the jobs of this worker go through each step, for\n"
+"pygear.dump_trace: 'grab' (waiting for a job), 'gil', 'handler', 'decode'\n"
+"(the first Job.workload call), 'encode' (serializing the result) and\n"
+"'send'. Off by default.\n"
+"@param[in] enabled - Whether to record.");
+
+static PyObject* pygear_worker_trace(pygear_WorkerObject* self);
+PyDoc_STRVAR(pygear_worker_trace_doc,
+"@return whether the worker records trace events, see 'set_trace'.");
+
+static PyObject* pygear_worker_stats(pygear_WorkerObject* self);
+PyDoc_STRVAR(pygear_worker_stats_doc,
+"Get how long the jobs of each function waited before they ran.\n"
+"'queue_delay' is from the time the client sent the job to the time this\n"
+"worker grabbed it, and only counts jobs sent in an envelope (see\n"
+"Client.set_envelope); it compares the clocks of two hosts, so keep them in\n"
+"sync. 'start_delay' is from the grab to the start of the callback.\n"
+"@return a dict from function names to a dict of 'queue_delay' and\n"
+"\t'start_delay', each with the 'count', 'mean', 'p50', 'p90', 'p99' and\n"
+"\t'max' in seconds.");
+
 
 /* Module method specification */
 static PyMethodDef worker_module_methods[] = {
@@ -285,6 +376,13 @@ static PyMethodDef worker_module_methods[] = {
     _WORKERMETHOD(namespace,        METH_NOARGS)
     _WORKERMETHOD(set_log_fn,       METH_VARARGS)
     _WORKERMETHOD(set_serializer,   METH_VARARGS)
+    _WORKERMETHOD(enable_result_cache,  METH_VARARGS | METH_KEYWORDS)
+    _WORKERMETHOD(disable_result_cache, METH_VARARGS | METH_KEYWORDS)
+    _WORKERMETHOD(result_cache_stats,   METH_NOARGS)
+    _WORKERMETHOD(stats,                METH_NOARGS)
+    _WORKERMETHOD(publish_stats,        METH_VARARGS | METH_KEYWORDS)
+    _WORKERMETHOD(set_trace,            METH_VARARGS)
+    _WORKERMETHOD(trace,                METH_NOARGS)
     {NULL, NULL, 0, NULL}
 };
 